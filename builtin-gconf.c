@@ -1448,7 +1448,7 @@ static void gconf_client_save_values(GConfClient *self, const char *path)
 
   if( data )
   {
-    mce_io_update_file_atomic(path, data, size, 0664, FALSE);
+    mce_io_persist_file(path, data, size, 0664);
   }
 
 cleanup:
@@ -1881,7 +1881,7 @@ void
 gconf_client_suggest_sync(GConfClient *client, GError **err)
 {
   if( gconf_client_is_valid(client, err) ) {
-    // FIXME: do we need delayed save?
+    // the write itself is delayed and batched by mce-io
     gconf_client_save_values(client, VALUES_PATH);
   }
 }
@@ -0,0 +1,475 @@
+/**
+ * @file datapipe-trace.c
+ * Datapipe record/replay log for the Mode Control Entity
+ * <p>
+ * Copyright © 2013 Jolla Ltd.
+ * Copyright © 2026 Jolla Mobile Ltd.
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The recorder logs every datapipe execution that is not made from
+ * within the triggers or filters of another datapipe, i.e. the input
+ * fed to the datapipes from hardware, D-Bus and timers, into a ring
+ * of fixed size records in a memory mapped file. Deferred executions
+ * requested only from within datapipe callbacks are not recorded
+ * either, since replaying the callbacks requests them again.
+ *
+ * The replayer feeds a recorded ring back to the datapipes with the
+ * original timing. Executions that the running modules make on their
+ * own, e.g. from timers, are not suppressed while replaying.
+ */
+
+#include <glib.h>
+
+#include <sys/mman.h>			/* mmap(), munmap() */
+
+#include <errno.h>			/* errno */
+#include <fcntl.h>			/* open(), O_RDWR, O_CREAT, O_TRUNC */
+#include <string.h>			/* memset(), memcpy(), strlen() */
+#include <time.h>			/* clock_gettime() */
+#include <unistd.h>			/* close(), ftruncate() */
+
+#include "datapipe-trace.h"
+
+#include "mce-log.h"			/* mce_log(), LL_* */
+
+/** Memory mapped trace file being recorded, or NULL */
+static datapipe_trace_header_t *trace_header = NULL;
+
+/** Record ring of the trace file being recorded */
+static datapipe_trace_record_t *trace_ring = NULL;
+
+/** Size of the memory mapped trace file */
+static gsize trace_size = 0;
+
+/** Sequence number of the latest record */
+static guint64 trace_seq = 0;
+
+/** Number of pipes in the name table of the trace file */
+static guint trace_pipes = 0;
+
+/** Set while replayed data is fed to the datapipes */
+static gboolean trace_replaying = FALSE;
+
+/** Contents of the trace file being replayed */
+static gchar *replay_data = NULL;
+
+/** Records to replay, in recording order */
+static GPtrArray *replay_queue = NULL;
+
+/** Next record to replay */
+static guint replay_pos = 0;
+
+/** Offset from recorded time stamps to the current time */
+static gint64 replay_offset = 0;
+
+/** Datapipes matching the name table of the trace being replayed */
+static datapipe_struct *replay_pipe[DATAPIPE_TRACE_PIPES_MAX];
+
+/** ID for the replay timer */
+static guint replay_timer_cb_id = 0;
+
+/**
+ * Get a monotonic time stamp
+ *
+ * @return Time stamp in microseconds
+ */
+static gint64 datapipe_trace_get_time_us(void)
+{
+	struct timespec ts = { 0, 0 };
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (gint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Record a datapipe execution
+ *
+ * Only executions made from outside of the callbacks of all
+ * datapipes are to be recorded; the nested ones are repeated
+ * by the callbacks when the trace is replayed
+ *
+ * @param datapipe The datapipe being executed
+ * @param indata The input data passed to execute_datapipe()
+ * @param use_cache The data source passed to execute_datapipe()
+ * @param cache_indata The caching policy passed to execute_datapipe()
+ */
+void datapipe_trace_record(const datapipe_struct *const datapipe,
+			   gconstpointer indata,
+			   const data_source_t use_cache,
+			   const caching_policy_t cache_indata)
+{
+	datapipe_trace_record_t *rec;
+	gsize len;
+
+	if ((trace_ring == NULL) || (trace_replaying == TRUE))
+		goto EXIT;
+
+	if (datapipe->id >= trace_pipes)
+		goto EXIT;
+
+	rec = &trace_ring[trace_seq % DATAPIPE_TRACE_RECORDS];
+	memset(rec, 0, sizeof *rec);
+
+	rec->time_us = datapipe_trace_get_time_us();
+	rec->pipe = datapipe->id;
+	rec->use_cache = use_cache;
+	rec->cache_indata = cache_indata;
+
+	if ((use_cache == USE_CACHE) || (indata == NULL)) {
+		rec->kind = DATAPIPE_TRACE_BOXED;
+	} else if (datapipe->datasize > DATAPIPE_INLINE_SIZE) {
+		rec->kind = DATAPIPE_TRACE_OPAQUE;
+	} else if (datapipe->datasize != 0) {
+		rec->kind = DATAPIPE_TRACE_INLINE;
+		rec->size = datapipe->datasize;
+		memcpy(rec->data.bytes, indata, datapipe->datasize);
+	} else if (datapipe->free_cache == FREE_CACHE) {
+		/* Pointer data owned by the pipe is a string; strings
+		 * that do not fit are marked so that they are not
+		 * replayed cut short */
+		len = strlen(indata);
+
+		if (len < sizeof rec->data.bytes) {
+			rec->kind = DATAPIPE_TRACE_STRING;
+		} else {
+			rec->kind = DATAPIPE_TRACE_TRUNCATED;
+			len = sizeof rec->data.bytes - 1;
+		}
+
+		memcpy(rec->data.bytes, indata, len);
+		rec->size = len + 1;
+	} else {
+		rec->kind = DATAPIPE_TRACE_BOXED;
+		rec->data.value = (gintptr)indata;
+	}
+
+	/* Mark the record valid only once it is complete */
+	rec->seq = ++trace_seq;
+
+EXIT:
+	return;
+}
+
+/**
+ * Start recording datapipe executions
+ *
+ * The pipes must have been set up before recording is started;
+ * pipes set up later are not recorded
+ *
+ * @param path The trace file to create
+ * @return TRUE on success, FALSE on failure
+ */
+gboolean datapipe_trace_start(const gchar *const path)
+{
+	gboolean status = FALSE;
+	datapipe_struct *datapipe;
+	gpointer map = MAP_FAILED;
+	gsize size;
+	int fd = -1;
+	guint i;
+
+	datapipe_trace_stop();
+
+	size = sizeof (datapipe_trace_header_t) +
+	       DATAPIPE_TRACE_RECORDS * sizeof (datapipe_trace_record_t);
+
+	if ((fd = TEMP_FAILURE_RETRY(open(path, O_RDWR | O_CREAT | O_TRUNC,
+					  0644))) == -1) {
+		mce_log(LL_ERR, "open(%s): %m", path);
+		goto EXIT;
+	}
+
+	if (ftruncate(fd, size) == -1) {
+		mce_log(LL_ERR, "ftruncate(%s): %m", path);
+		goto EXIT;
+	}
+
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	if (map == MAP_FAILED) {
+		mce_log(LL_ERR, "mmap(%s): %m", path);
+		goto EXIT;
+	}
+
+	trace_header = map;
+	trace_ring = (datapipe_trace_record_t *)(trace_header + 1);
+	trace_size = size;
+	trace_seq = 0;
+
+	memcpy(trace_header->magic, DATAPIPE_TRACE_MAGIC,
+	       sizeof trace_header->magic);
+	trace_header->record_size = sizeof (datapipe_trace_record_t);
+	trace_header->record_count = DATAPIPE_TRACE_RECORDS;
+
+	for (i = 0; i < DATAPIPE_TRACE_PIPES_MAX; i++) {
+		if ((datapipe = datapipe_get_nth(i)) == NULL)
+			break;
+
+		g_strlcpy(trace_header->pipe_name[i], datapipe->name ?: "",
+			  DATAPIPE_TRACE_NAME_MAX);
+	}
+
+	trace_pipes = trace_header->pipe_count = i;
+
+	mce_log(LL_NOTICE, "Recording datapipe trace to %s", path);
+
+	status = TRUE;
+
+EXIT:
+	if ((fd != -1) && (TEMP_FAILURE_RETRY(close(fd)) == -1))
+		mce_log(LL_WARN, "close(%s): %m", path);
+
+	return status;
+}
+
+/**
+ * Release the data of the trace being replayed
+ */
+static void datapipe_trace_replay_cancel(void)
+{
+	if (replay_timer_cb_id != 0) {
+		g_source_remove(replay_timer_cb_id);
+		replay_timer_cb_id = 0;
+	}
+
+	if (replay_queue != NULL) {
+		g_ptr_array_free(replay_queue, TRUE);
+		replay_queue = NULL;
+	}
+
+	g_free(replay_data);
+	replay_data = NULL;
+	replay_pos = 0;
+}
+
+/**
+ * Stop recording and replaying datapipe executions
+ */
+void datapipe_trace_stop(void)
+{
+	datapipe_trace_replay_cancel();
+
+	if (trace_header != NULL) {
+		if (munmap(trace_header, trace_size) == -1)
+			mce_log(LL_WARN, "munmap: %m");
+
+		mce_log(LL_NOTICE, "Recorded %" G_GUINT64_FORMAT
+			" datapipe executions", trace_seq);
+	}
+
+	trace_header = NULL;
+	trace_ring = NULL;
+	trace_size = 0;
+	trace_pipes = 0;
+}
+
+/**
+ * Feed one recorded execution to a datapipe
+ *
+ * @param rec The record to replay
+ */
+static void datapipe_trace_replay_record(datapipe_trace_record_t *rec)
+{
+	datapipe_struct *datapipe = NULL;
+	gpointer indata = NULL;
+
+	if (rec->pipe < DATAPIPE_TRACE_PIPES_MAX)
+		datapipe = replay_pipe[rec->pipe];
+
+	if (datapipe == NULL)
+		goto EXIT;
+
+	switch (rec->kind) {
+	case DATAPIPE_TRACE_BOXED:
+		indata = (gpointer)(gintptr)rec->data.value;
+		break;
+
+	case DATAPIPE_TRACE_INLINE:
+		if (rec->size != datapipe->datasize)
+			goto EXIT;
+
+		indata = rec->data.bytes;
+		break;
+
+	case DATAPIPE_TRACE_STRING:
+		rec->data.bytes[sizeof rec->data.bytes - 1] = 0;
+		indata = rec->data.bytes;
+
+		/* The pipe takes ownership of cached strings */
+		if (rec->cache_indata == CACHE_INDATA)
+			indata = g_strdup(indata);
+		break;
+
+	case DATAPIPE_TRACE_TRUNCATED:
+		mce_log(LL_WARN, "%s: string too long for the trace; "
+			"execution not replayed", datapipe->name);
+		goto EXIT;
+
+	default:
+		break;
+	}
+
+	trace_replaying = TRUE;
+	(void)execute_datapipe(datapipe, indata,
+			       rec->use_cache ? USE_CACHE : USE_INDATA,
+			       rec->cache_indata ? CACHE_INDATA :
+						   DONT_CACHE_INDATA);
+	trace_replaying = FALSE;
+
+EXIT:
+	return;
+}
+
+/**
+ * Timer callback for replaying datapipe executions
+ *
+ * @param data Unused
+ * @return Always returns FALSE to disable the timeout
+ */
+static gboolean datapipe_trace_replay_cb(gpointer data)
+{
+	datapipe_trace_record_t *rec = NULL;
+	gint64 now = datapipe_trace_get_time_us();
+	gint64 delay;
+
+	(void)data;
+
+	replay_timer_cb_id = 0;
+
+	for (; replay_pos < replay_queue->len; replay_pos++) {
+		rec = g_ptr_array_index(replay_queue, replay_pos);
+
+		if (rec->time_us + replay_offset > now)
+			break;
+
+		datapipe_trace_replay_record(rec);
+	}
+
+	if (replay_pos < replay_queue->len) {
+		delay = rec->time_us + replay_offset - now;
+		replay_timer_cb_id = g_timeout_add((delay + 999) / 1000,
+						   datapipe_trace_replay_cb,
+						   NULL);
+	} else {
+		mce_log(LL_NOTICE, "Datapipe trace replay finished");
+		datapipe_trace_replay_cancel();
+	}
+
+	return FALSE;
+}
+
+/**
+ * Compare datapipe trace records by sequence number
+ *
+ * @param a Pointer to the first record pointer
+ * @param b Pointer to the second record pointer
+ * @return <0, 0 or >0 as with strcmp()
+ */
+static gint datapipe_trace_compare_seq(gconstpointer a, gconstpointer b)
+{
+	const datapipe_trace_record_t *rec_a =
+		*(const datapipe_trace_record_t *const *)a;
+	const datapipe_trace_record_t *rec_b =
+		*(const datapipe_trace_record_t *const *)b;
+
+	return (rec_a->seq > rec_b->seq) - (rec_a->seq < rec_b->seq);
+}
+
+/**
+ * Start replaying a recorded datapipe trace
+ *
+ * @param path The trace file to replay
+ * @return TRUE if the replay was started, FALSE on failure
+ */
+gboolean datapipe_trace_replay(const gchar *const path)
+{
+	gboolean status = FALSE;
+	const datapipe_trace_header_t *header;
+	datapipe_trace_record_t *ring;
+	datapipe_trace_record_t *rec;
+	gchar name[DATAPIPE_TRACE_NAME_MAX];
+	GError *error = NULL;
+	gsize size = 0;
+	guint i;
+
+	datapipe_trace_replay_cancel();
+
+	if (g_file_get_contents(path, &replay_data, &size, &error) == FALSE) {
+		mce_log(LL_ERR, "%s: %s", path, error->message);
+		goto EXIT;
+	}
+
+	header = (const datapipe_trace_header_t *)replay_data;
+
+	if ((size < sizeof *header) ||
+	    (memcmp(header->magic, DATAPIPE_TRACE_MAGIC,
+		    sizeof header->magic) != 0) ||
+	    (header->record_size != sizeof *rec) ||
+	    (header->pipe_count > DATAPIPE_TRACE_PIPES_MAX) ||
+	    ((size - sizeof *header) / sizeof *rec <
+	     header->record_count)) {
+		mce_log(LL_ERR, "%s: not a valid datapipe trace", path);
+		goto EXIT;
+	}
+
+	for (i = 0; i < DATAPIPE_TRACE_PIPES_MAX; i++) {
+		replay_pipe[i] = NULL;
+
+		if (i >= header->pipe_count)
+			continue;
+
+		g_strlcpy(name, header->pipe_name[i], sizeof name);
+
+		if ((replay_pipe[i] = datapipe_lookup(name)) == NULL)
+			mce_log(LL_WARN, "%s: unknown datapipe; ignored",
+				name);
+	}
+
+	ring = (datapipe_trace_record_t *)(replay_data + sizeof *header);
+	replay_queue = g_ptr_array_new();
+
+	for (i = 0; i < header->record_count; i++) {
+		if (ring[i].seq != 0)
+			g_ptr_array_add(replay_queue, &ring[i]);
+	}
+
+	if (replay_queue->len == 0) {
+		mce_log(LL_WARN, "%s: datapipe trace is empty", path);
+		goto EXIT;
+	}
+
+	g_ptr_array_sort(replay_queue, datapipe_trace_compare_seq);
+
+	rec = g_ptr_array_index(replay_queue, 0);
+	replay_offset = datapipe_trace_get_time_us() - rec->time_us;
+	replay_pos = 0;
+
+	mce_log(LL_NOTICE, "Replaying %u datapipe executions from %s",
+		replay_queue->len, path);
+
+	replay_timer_cb_id = g_timeout_add(0, datapipe_trace_replay_cb, NULL);
+
+	status = TRUE;
+
+EXIT:
+	if (status == FALSE)
+		datapipe_trace_replay_cancel();
+
+	g_clear_error(&error);
+
+	return status;
+}
@@ -0,0 +1,99 @@
+/**
+ * @file datapipe-trace.h
+ * Headers for the datapipe record/replay log for the Mode Control Entity
+ * <p>
+ * Copyright © 2013 Jolla Ltd.
+ * Copyright © 2026 Jolla Mobile Ltd.
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DATAPIPE_TRACE_H_
+#define _DATAPIPE_TRACE_H_
+
+#include <glib.h>
+
+#include "datapipe.h"
+
+/** Magic bytes at the start of a datapipe trace file */
+#define DATAPIPE_TRACE_MAGIC		"MCEDPTR1"
+
+/** Number of records in the datapipe trace ring */
+#define DATAPIPE_TRACE_RECORDS		16384
+
+/** Maximum number of datapipes a trace file can describe */
+#define DATAPIPE_TRACE_PIPES_MAX	64
+
+/** Maximum length of a datapipe name in a trace file */
+#define DATAPIPE_TRACE_NAME_MAX		48
+
+/**
+ * How the value of a datapipe trace record is stored
+ */
+typedef enum {
+	/** Integer value boxed in the data pointer */
+	DATAPIPE_TRACE_BOXED = 0,
+	/** Fixed size data copied from the data pointer */
+	DATAPIPE_TRACE_INLINE = 1,
+	/** Zero terminated string */
+	DATAPIPE_TRACE_STRING = 2,
+	/** Data that can not be recorded; replayed as NULL */
+	DATAPIPE_TRACE_OPAQUE = 3,
+	/** String too long for the record; the start of it is kept
+	 *  for diagnostics, but the execution is not replayed */
+	DATAPIPE_TRACE_TRUNCATED = 4
+} datapipe_trace_kind_t;
+
+/**
+ * Datapipe trace file header
+ */
+typedef struct {
+	gchar magic[8];			/**< DATAPIPE_TRACE_MAGIC */
+	guint32 record_size;		/**< Size of one record */
+	guint32 record_count;		/**< Number of records in the ring */
+	guint32 pipe_count;		/**< Number of pipe names below */
+	guint32 reserved;		/**< Padding; zero */
+	gchar pipe_name[DATAPIPE_TRACE_PIPES_MAX][DATAPIPE_TRACE_NAME_MAX];	/**< Names of pipes by id */
+} datapipe_trace_header_t;
+
+/**
+ * Datapipe trace record
+ *
+ * Records are written to slot (seq % record_count) of the ring;
+ * slots with sequence number zero have not been written yet
+ */
+typedef struct {
+	guint64 seq;			/**< Sequence number; 1 for the first */
+	gint64 time_us;			/**< Monotonic time stamp */
+	guint16 pipe;			/**< Pipe id, index to the name table */
+	guint8 use_cache;		/**< data_source_t */
+	guint8 cache_indata;		/**< caching_policy_t */
+	guint8 kind;			/**< datapipe_trace_kind_t */
+	guint8 size;			/**< Number of bytes used in data */
+	guint8 reserved[2];		/**< Padding; zero */
+	union {
+		gint64 value;		/**< DATAPIPE_TRACE_BOXED value */
+		guint8 bytes[DATAPIPE_INLINE_SIZE];	/**< Other data */
+	} data;				/**< Recorded indata */
+} datapipe_trace_record_t;
+
+void datapipe_trace_record(const datapipe_struct *const datapipe,
+			   gconstpointer indata,
+			   const data_source_t use_cache,
+			   const caching_policy_t cache_indata);
+
+gboolean datapipe_trace_start(const gchar *const path);
+void datapipe_trace_stop(void);
+
+gboolean datapipe_trace_replay(const gchar *const path);
+
+#endif /* _DATAPIPE_TRACE_H_ */
@@ -21,9 +21,278 @@
  */
 #include <glib.h>
 
+#include <sys/eventfd.h>		/* eventfd(), EFD_* */
+
+#include <dlfcn.h>			/* dladdr() */
+#include <errno.h>			/* errno, EINTR, EAGAIN */
+#include <string.h>			/* memset(), strcmp(), strrchr() */
+#include <time.h>			/* clock_gettime() */
+#include <unistd.h>			/* read(), write(), close() */
+
 #include "datapipe.h"
 
 #include "mce-log.h"			/* mce_log(), LL_* */
+#include "datapipe-trace.h"		/* datapipe_trace_record() */
+
+/** Number of callback slots to add when a callback array grows */
+#define DATAPIPE_CBARRAY_STEP	4
+
+/** Labels for the datapipe callback latency histogram buckets */
+static const gchar *const datapipe_histogram_label[DATAPIPE_HISTOGRAM_BUCKETS] = {
+	"<10us", "<100us", "<1ms", "<10ms", "<100ms", ">=100ms"
+};
+
+/** Prefixes for callback types in the statistics, by priority class */
+static const gchar *const datapipe_priority_label[] = {
+	[TRIGGER_PRIORITY_CRITICAL] = "critical ",
+	[TRIGGER_PRIORITY_NORMAL] = "",
+	[TRIGGER_PRIORITY_IDLE] = "idle ",
+};
+
+/** List of datapipes that have been set up; used for diagnostics */
+static GSList *datapipe_list = NULL;
+
+/** Datapipes with a pending deferred execution; most recent first */
+static GSList *datapipe_deferred_list = NULL;
+
+/** ID for the idle callback running deferred datapipe executions */
+static guint datapipe_deferred_cb_id = 0;
+
+/** Datapipes with pending idle output triggers; most recent first */
+static GSList *datapipe_idle_list = NULL;
+
+/** ID for the idle callback running idle output triggers */
+static guint datapipe_idle_cb_id = 0;
+
+/**
+ * Execution of a datapipe from a callback of another datapipe
+ */
+typedef struct {
+	datapipe_struct *callee;	/**< The datapipe that was executed */
+	gpointer cb;			/**< The callback that executed it */
+	gboolean deferred;		/**< Executed via
+					 *   execute_datapipe_deferred()
+					 */
+	gboolean recursive;		/**< The callee was already executing */
+	guint64 count;			/**< Number of executions */
+} datapipe_edge_t;
+
+/** Datapipe whose callbacks are being run, or NULL */
+static datapipe_struct *datapipe_active = NULL;
+
+/** Callback of datapipe_active that is being run, or NULL */
+static gpointer datapipe_active_cb = NULL;
+
+/** Serial number of the input event being handled; an input event
+ *  is an execution of a datapipe from outside of any datapipe */
+static guint datapipe_cascade = 0;
+
+/**
+ * Get a monotonic time stamp
+ *
+ * @return Time stamp in microseconds
+ */
+static gint64 datapipe_get_time_us(void)
+{
+	struct timespec ts = { 0, 0 };
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (gint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Append a callback to a callback array
+ *
+ * @param self The callback array
+ * @param cb The callback to add
+ * @param priority The priority class of the callback
+ */
+static void datapipe_cbarray_append(datapipe_cbarray_t *const self,
+				    gpointer cb,
+				    const trigger_priority_t priority)
+{
+	if (self->used == self->alloc) {
+		self->alloc += DATAPIPE_CBARRAY_STEP;
+		self->cb = g_renew(gpointer, self->cb, self->alloc);
+		self->stats = g_renew(datapipe_cbstats_t, self->stats,
+				      self->alloc);
+		self->priority = g_renew(trigger_priority_t, self->priority,
+					 self->alloc);
+	}
+
+	memset(&self->stats[self->used], 0, sizeof *self->stats);
+	self->priority[self->used] = priority;
+	self->cb[self->used++] = cb;
+	self->live++;
+}
+
+/**
+ * Squeeze out slots of removed callbacks from a callback array
+ *
+ * @param self The callback array
+ */
+static void datapipe_cbarray_compact(datapipe_cbarray_t *const self)
+{
+	guint i, k;
+
+	for (i = k = 0; i < self->used; i++) {
+		if (self->cb[i] == NULL)
+			continue;
+
+		self->stats[k] = self->stats[i];
+		self->priority[k] = self->priority[i];
+		self->cb[k++] = self->cb[i];
+	}
+
+	self->used = k;
+}
+
+/**
+ * Remove the first instance of a callback from a callback array
+ *
+ * If the array is being iterated, the slot is only cleared and
+ * the array is compacted when the iteration finishes
+ *
+ * @param self The callback array
+ * @param cb The callback to remove
+ * @return TRUE if the callback was removed, FALSE if it was not found
+ */
+static gboolean datapipe_cbarray_remove(datapipe_cbarray_t *const self,
+					gconstpointer cb)
+{
+	gboolean removed = FALSE;
+	guint i;
+
+	for (i = 0; i < self->used; i++) {
+		if (self->cb[i] == cb)
+			break;
+	}
+
+	if (i == self->used)
+		goto EXIT;
+
+	self->cb[i] = NULL;
+	self->live--;
+
+	if (self->busy == 0)
+		datapipe_cbarray_compact(self);
+
+	removed = TRUE;
+
+EXIT:
+	return removed;
+}
+
+/**
+ * Mark a callback array as being iterated
+ *
+ * @param self The callback array
+ */
+static void datapipe_cbarray_lock(datapipe_cbarray_t *const self)
+{
+	self->busy++;
+}
+
+/**
+ * Mark iteration of a callback array finished
+ *
+ * Compacts the array if callbacks were removed during the
+ * outermost iteration
+ *
+ * @param self The callback array
+ */
+static void datapipe_cbarray_unlock(datapipe_cbarray_t *const self)
+{
+	if (--self->busy == 0 && self->live != self->used)
+		datapipe_cbarray_compact(self);
+}
+
+/**
+ * Release all memory held by a callback array
+ *
+ * @param self The callback array
+ */
+static void datapipe_cbarray_free(datapipe_cbarray_t *const self)
+{
+	g_free(self->cb);
+	self->cb = NULL;
+	g_free(self->stats);
+	self->stats = NULL;
+	g_free(self->priority);
+	self->priority = NULL;
+	self->used = self->alloc = self->live = self->busy = 0;
+}
+
+/**
+ * Account one call of a datapipe callback
+ *
+ * @param self The callback array the callback belongs to
+ * @param slot The slot of the callback in the array
+ * @param started Time stamp taken before the callback was called
+ */
+static void datapipe_cbarray_account(datapipe_cbarray_t *const self,
+				     const guint slot, const gint64 started)
+{
+	datapipe_cbstats_t *stats = &self->stats[slot];
+	gint64 elapsed = datapipe_get_time_us() - started;
+	guint us = (guint)CLAMP(elapsed, 0, G_MAXUINT);
+	guint bucket;
+	guint limit;
+
+	stats->calls++;
+	stats->total_us += us;
+
+	if (stats->max_us < us)
+		stats->max_us = us;
+
+	for (bucket = 0, limit = 10;
+	     bucket < DATAPIPE_HISTOGRAM_BUCKETS - 1; bucket++, limit *= 10) {
+		if (us < limit)
+			break;
+	}
+
+	stats->histogram[bucket]++;
+}
+
+/**
+ * Call the reference count triggers of a datapipe
+ *
+ * @param datapipe The datapipe whose reference count changed
+ */
+static void execute_datapipe_refcount_triggers(datapipe_struct *const datapipe)
+{
+	void (*refcount_trigger)(void);
+	gint64 started;
+	guint i;
+
+	datapipe_cbarray_lock(&datapipe->refcount_triggers);
+
+	for (i = 0; i < datapipe->refcount_triggers.used; i++) {
+		if ((refcount_trigger = datapipe->refcount_triggers.cb[i]) == NULL)
+			continue;
+
+		started = datapipe_get_time_us();
+		refcount_trigger();
+		datapipe_cbarray_account(&datapipe->refcount_triggers,
+					 i, started);
+	}
+
+	datapipe_cbarray_unlock(&datapipe->refcount_triggers);
+}
+
+/**
+ * Check whether a datapipe caches its data inside the datapipe
+ *
+ * @param datapipe The datapipe
+ * @return TRUE if the datapipe has fixed size data cached inline,
+ *         FALSE if the cache holds a pointer or a boxed value
+ */
+static gboolean datapipe_has_inline_cache(const datapipe_struct *const datapipe)
+{
+	return ((datapipe->datasize != 0) &&
+		(datapipe->datasize <= DATAPIPE_INLINE_SIZE));
+}
 
 /**
  * Execute the input triggers of a datapipe
@@ -35,162 +304,935 @@
  * @param cache_indata CACHE_INDATA to cache the indata,
  *                     DONT_CACHE_INDATA to keep the old data
  */
-void execute_datapipe_input_triggers(datapipe_struct *const datapipe,
-				     gpointer const indata,
-				     const data_source_t use_cache,
-				     const caching_policy_t cache_indata)
+void execute_datapipe_input_triggers(datapipe_struct *const datapipe,
+				     gpointer const indata,
+				     const data_source_t use_cache,
+				     const caching_policy_t cache_indata)
+{
+	void (*trigger)(gconstpointer const input);
+	gpointer data;
+	gint64 started;
+	guint i;
+
+	if (datapipe == NULL) {
+		/* Potential memory leak! */
+		mce_log(LL_ERR,
+			"execute_datapipe_input_triggers() called "
+			"without a valid datapipe");
+		goto EXIT;
+	}
+
+	data = (use_cache == USE_CACHE) ? datapipe->cached_data : indata;
+
+	if (cache_indata == CACHE_INDATA) {
+		if (use_cache == USE_INDATA) {
+			if (datapipe_has_inline_cache(datapipe) == TRUE) {
+				/* Copy fixed size data into the pipe */
+				if (data != NULL)
+					memcpy(datapipe->inline_cache.data,
+					       data, datapipe->datasize);
+			} else {
+				if (datapipe->free_cache == FREE_CACHE)
+					g_free(datapipe->cached_data);
+
+				datapipe->cached_data = data;
+			}
+		}
+	}
+
+	datapipe_cbarray_lock(&datapipe->input_triggers);
+
+	for (i = 0; i < datapipe->input_triggers.used; i++) {
+		if ((trigger = datapipe->input_triggers.cb[i]) == NULL)
+			continue;
+
+		datapipe_active_cb = trigger;
+		started = datapipe_get_time_us();
+		trigger(data);
+		datapipe_cbarray_account(&datapipe->input_triggers,
+					 i, started);
+	}
+
+	datapipe_cbarray_unlock(&datapipe->input_triggers);
+
+EXIT:
+	return;
+}
+
+/**
+ * Execute the filters of a datapipe
+ *
+ * @param datapipe The datapipe to execute
+ * @param indata The input data to run through the datapipe
+ * @param use_cache USE_CACHE to use data from cache,
+ *                  USE_INDATA to use indata
+ * @return The processed data
+ */
+gconstpointer execute_datapipe_filters(datapipe_struct *const datapipe,
+				       gpointer indata,
+				       const data_source_t use_cache)
+{
+	gpointer (*filter)(gpointer input);
+	gpointer data;
+	gconstpointer retval = NULL;
+	guint applied = 0;
+	gint64 started;
+	guint i;
+
+	if (datapipe == NULL) {
+		mce_log(LL_ERR,
+			"execute_datapipe_filters() called "
+			"without a valid datapipe");
+		goto EXIT;
+	}
+
+	data = (use_cache == USE_CACHE) ? datapipe->cached_data : indata;
+
+	datapipe_cbarray_lock(&datapipe->filters);
+
+	for (i = 0; i < datapipe->filters.used; i++) {
+		gpointer tmp;
+
+		if ((filter = datapipe->filters.cb[i]) == NULL)
+			continue;
+
+		datapipe_active_cb = filter;
+		started = datapipe_get_time_us();
+		tmp = filter(data);
+		datapipe_cbarray_account(&datapipe->filters, i, started);
+
+		/* If the data needs to be freed, and this isn't the indata,
+		 * or if we're not using the cache, then free the data
+		 */
+		if ((datapipe->free_cache == FREE_CACHE) &&
+		    ((applied > 0) || (use_cache == USE_INDATA)))
+			g_free(data);
+
+		data = tmp;
+		applied++;
+	}
+
+	datapipe_cbarray_unlock(&datapipe->filters);
+
+	retval = data;
+
+EXIT:
+	return retval;
+}
+
+/**
+ * Run the output triggers of one priority class
+ *
+ * The caller must have locked the output trigger array
+ *
+ * @param datapipe The datapipe
+ * @param data The data to pass to the triggers
+ * @param priority The priority class to run
+ */
+static void datapipe_run_output_class(datapipe_struct *const datapipe,
+				      gconstpointer data,
+				      const trigger_priority_t priority)
+{
+	void (*trigger)(gconstpointer input);
+	gint64 started;
+	guint i;
+
+	for (i = 0; i < datapipe->output_triggers.used; i++) {
+		if (datapipe->output_triggers.priority[i] != priority)
+			continue;
+
+		if ((trigger = datapipe->output_triggers.cb[i]) == NULL)
+			continue;
+
+		datapipe_active_cb = trigger;
+		started = datapipe_get_time_us();
+		trigger(data);
+		datapipe_cbarray_account(&datapipe->output_triggers,
+					 i, started);
+	}
+}
+
+/**
+ * Check whether a datapipe has output triggers in a priority class
+ *
+ * @param datapipe The datapipe
+ * @param priority The priority class
+ * @return TRUE if there are such triggers, FALSE otherwise
+ */
+static gboolean datapipe_has_output_class(const datapipe_struct *const datapipe,
+					  const trigger_priority_t priority)
+{
+	guint i;
+
+	for (i = 0; i < datapipe->output_triggers.used; i++) {
+		if ((datapipe->output_triggers.priority[i] == priority) &&
+		    (datapipe->output_triggers.cb[i] != NULL))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/**
+ * Cancel pending idle output triggers of a datapipe
+ *
+ * @param datapipe The datapipe
+ */
+static void datapipe_cancel_idle_triggers(datapipe_struct *const datapipe)
+{
+	if (datapipe->idle_pending == FALSE)
+		goto EXIT;
+
+	datapipe->idle_pending = FALSE;
+	datapipe_idle_list = g_slist_remove(datapipe_idle_list, datapipe);
+
+	if ((datapipe_idle_list == NULL) && (datapipe_idle_cb_id != 0)) {
+		g_source_remove(datapipe_idle_cb_id);
+		datapipe_idle_cb_id = 0;
+	}
+
+EXIT:
+	return;
+}
+
+/**
+ * Idle callback for running idle output triggers
+ *
+ * @param data Unused
+ * @return Always returns FALSE to disable the idle callback
+ */
+static gboolean datapipe_idle_triggers_cb(gpointer data)
+{
+	GSList *list;
+	GSList *item;
+
+	(void)data;
+
+	datapipe_idle_cb_id = 0;
+
+	list = g_slist_reverse(datapipe_idle_list);
+	datapipe_idle_list = NULL;
+
+	for (item = list; item != NULL; item = item->next) {
+		datapipe_struct *datapipe = item->data;
+
+		if (datapipe->idle_pending == FALSE)
+			continue;
+
+		datapipe->idle_pending = FALSE;
+
+		/* Each run is an input event of its own */
+		datapipe_cascade++;
+		datapipe_active = datapipe;
+
+		datapipe_cbarray_lock(&datapipe->output_triggers);
+		datapipe_run_output_class(datapipe, datapipe->idle_data,
+					  TRIGGER_PRIORITY_IDLE);
+		datapipe_cbarray_unlock(&datapipe->output_triggers);
+
+		datapipe_active = NULL;
+		datapipe_active_cb = NULL;
+	}
+
+	g_slist_free(list);
+
+	return FALSE;
+}
+
+/**
+ * Schedule the idle output triggers of a datapipe
+ *
+ * Only the latest data is remembered; when the datapipe is
+ * executed several times before the idle callback gets to run,
+ * the idle triggers are run only once
+ *
+ * @param datapipe The datapipe
+ * @param data The data to pass to the idle triggers
+ */
+static void datapipe_schedule_idle_triggers(datapipe_struct *const datapipe,
+					    gconstpointer data)
+{
+	datapipe->idle_data = data;
+
+	if (datapipe->idle_pending == TRUE) {
+		datapipe->idle_coalesced_count++;
+		goto EXIT;
+	}
+
+	datapipe->idle_pending = TRUE;
+	datapipe_idle_list = g_slist_prepend(datapipe_idle_list, datapipe);
+
+	if (datapipe_idle_cb_id == 0) {
+		datapipe_idle_cb_id =
+			g_idle_add_full(DATAPIPE_IDLE_TRIGGER_PRIORITY,
+					datapipe_idle_triggers_cb,
+					NULL, NULL);
+	}
+
+EXIT:
+	return;
+}
+
+/**
+ * Execute the output triggers of a datapipe
+ *
+ * Critical triggers are run first, then the normal ones, both in
+ * registration order. Idle triggers are run from an idle callback,
+ * except for datapipes that copy or free their data; those can't
+ * hold on to the data, so their idle triggers are run last instead.
+ *
+ * @param datapipe The datapipe to execute
+ * @param indata The input data to run through the datapipe
+ * @param use_cache USE_CACHE to use data from cache,
+ *                  USE_INDATA to use indata
+ */
+void execute_datapipe_output_triggers(datapipe_struct *const datapipe,
+				      gconstpointer indata,
+				      const data_source_t use_cache)
+{
+	gconstpointer data;
+
+	if (datapipe == NULL) {
+		mce_log(LL_ERR,
+			"execute_datapipe_output_triggers() called "
+			"without a valid datapipe");
+		goto EXIT;
+	}
+
+	data = (use_cache == USE_CACHE) ? datapipe->cached_data : indata;
+
+	datapipe_cbarray_lock(&datapipe->output_triggers);
+
+	datapipe_run_output_class(datapipe, data, TRIGGER_PRIORITY_CRITICAL);
+	datapipe_run_output_class(datapipe, data, TRIGGER_PRIORITY_NORMAL);
+
+	if (datapipe_has_output_class(datapipe,
+				      TRIGGER_PRIORITY_IDLE) == TRUE) {
+		if ((datapipe->datasize != 0) ||
+		    (datapipe->free_cache == FREE_CACHE)) {
+			datapipe_run_output_class(datapipe, data,
+						  TRIGGER_PRIORITY_IDLE);
+		} else {
+			datapipe_schedule_idle_triggers(datapipe, data);
+		}
+	}
+
+	datapipe_cbarray_unlock(&datapipe->output_triggers);
+
+EXIT:
+	return;
+}
+
+/**
+ * Cancel pending deferred execution of a datapipe
+ *
+ * @param datapipe The datapipe
+ */
+static void datapipe_cancel_deferred(datapipe_struct *const datapipe)
+{
+	if (datapipe->deferred == FALSE)
+		goto EXIT;
+
+	datapipe->deferred = FALSE;
+	datapipe_deferred_list = g_slist_remove(datapipe_deferred_list,
+						datapipe);
+
+	if ((datapipe_deferred_list == NULL) &&
+	    (datapipe_deferred_cb_id != 0)) {
+		g_source_remove(datapipe_deferred_cb_id);
+		datapipe_deferred_cb_id = 0;
+	}
+
+EXIT:
+	return;
+}
+
+/**
+ * Record execution of a datapipe from a callback of another datapipe
+ *
+ * @param callee The datapipe being executed
+ * @param deferred TRUE if the execution is deferred, FALSE if not
+ */
+static void datapipe_record_edge(datapipe_struct *const callee,
+				 const gboolean deferred)
+{
+	datapipe_struct *caller = datapipe_active;
+	datapipe_edge_t *edge = NULL;
+	GSList *item;
+
+	if (caller == NULL)
+		goto EXIT;
+
+	for (item = caller->edges; item != NULL; item = item->next) {
+		edge = item->data;
+
+		if ((edge->callee == callee) &&
+		    (edge->cb == datapipe_active_cb) &&
+		    (edge->deferred == deferred))
+			break;
+
+		edge = NULL;
+	}
+
+	if (edge == NULL) {
+		edge = g_new0(datapipe_edge_t, 1);
+		edge->callee = callee;
+		edge->cb = datapipe_active_cb;
+		edge->deferred = deferred;
+		caller->edges = g_slist_append(caller->edges, edge);
+	}
+
+	edge->count++;
+
+	if ((deferred == FALSE) && (callee->depth > 0) &&
+	    (edge->recursive == FALSE)) {
+		edge->recursive = TRUE;
+		mce_log(LL_DEBUG, "%s re-entered from a callback of %s",
+			callee->name ?: "unnamed", caller->name ?: "unnamed");
+	}
+
+EXIT:
+	return;
+}
+
+/**
+ * Count executions of a datapipe within the current input event
+ *
+ * @param datapipe The datapipe being executed
+ */
+static void datapipe_account_cascade(datapipe_struct *const datapipe)
+{
+	if (datapipe->cascade != datapipe_cascade) {
+		datapipe->cascade = datapipe_cascade;
+		datapipe->cascade_execs = 0;
+	}
+
+	if (++datapipe->cascade_execs == 2) {
+		datapipe->reexec_count++;
+		mce_log(LL_DEBUG, "%s executed more than once "
+			"for one input event", datapipe->name ?: "unnamed");
+	}
+
+	if (datapipe->max_cascade_execs < datapipe->cascade_execs)
+		datapipe->max_cascade_execs = datapipe->cascade_execs;
+}
+
+/**
+ * Execute the datapipe
+ *
+ * @param datapipe The datapipe to execute
+ * @param indata The input data to run through the datapipe
+ * @param use_cache USE_CACHE to use data from cache,
+ *                  USE_INDATA to use indata
+ * @param cache_indata CACHE_INDATA to cache the indata,
+ *                     DONT_CACHE_INDATA to keep the old data
+ * @param nested TRUE if the execution was caused by the callbacks
+ *               of another datapipe, FALSE if not
+ * @return The processed data
+ */
+static gconstpointer datapipe_execute(datapipe_struct *const datapipe,
+				      gpointer indata,
+				      const data_source_t use_cache,
+				      const caching_policy_t cache_indata,
+				      const gboolean nested)
+{
+	datapipe_struct *prev_active = datapipe_active;
+	gpointer prev_active_cb = datapipe_active_cb;
+	gconstpointer data = NULL;
+
+	/* A direct execution supersedes a pending deferred one */
+	datapipe_cancel_deferred(datapipe);
+
+	/* Executions caused by other datapipes are repeated
+	 * by their callbacks when the trace is replayed
+	 */
+	if (nested == FALSE)
+		datapipe_trace_record(datapipe, indata,
+				      use_cache, cache_indata);
+
+	datapipe->exec_count++;
+
+	if (datapipe_active == NULL)
+		datapipe_cascade++;
+
+	datapipe_record_edge(datapipe, FALSE);
+	datapipe_account_cascade(datapipe);
+
+	datapipe_active = datapipe;
+	datapipe_active_cb = NULL;
+
+	if (++datapipe->depth > datapipe->max_depth)
+		datapipe->max_depth = datapipe->depth;
+
+	execute_datapipe_input_triggers(datapipe, indata, use_cache,
+					cache_indata);
+
+	if (datapipe->read_only == READ_ONLY) {
+		data = indata;
+	} else {
+		data = execute_datapipe_filters(datapipe, indata, use_cache);
+	}
+
+	if ((datapipe->suppress_unchanged == SUPPRESS_UNCHANGED) &&
+	    (datapipe->emitted == TRUE) &&
+	    (datapipe->last_emitted == data)) {
+		datapipe->suppressed_count++;
+	} else {
+		datapipe->emitted = TRUE;
+		datapipe->last_emitted = data;
+		execute_datapipe_output_triggers(datapipe, data, USE_INDATA);
+	}
+
+	datapipe->depth--;
+
+	datapipe_active = prev_active;
+	datapipe_active_cb = prev_active_cb;
+
+	return data;
+}
+
+/**
+ * Execute the datapipe
+ *
+ * @param datapipe The datapipe to execute
+ * @param indata The input data to run through the datapipe
+ * @param use_cache USE_CACHE to use data from cache,
+ *                  USE_INDATA to use indata
+ * @param cache_indata CACHE_INDATA to cache the indata,
+ *                     DONT_CACHE_INDATA to keep the old data
+ * @return The processed data
+ */
+gconstpointer execute_datapipe(datapipe_struct *const datapipe,
+			       gpointer indata,
+			       const data_source_t use_cache,
+			       const caching_policy_t cache_indata)
+{
+	gconstpointer data = NULL;
+
+	if (datapipe == NULL) {
+		mce_log(LL_ERR,
+			"execute_datapipe() called "
+			"without a valid datapipe");
+		goto EXIT;
+	}
+
+	data = datapipe_execute(datapipe, indata, use_cache, cache_indata,
+				datapipe_active != NULL);
+
+EXIT:
+	return data;
+}
+
+/**
+ * Idle callback for running deferred datapipe executions
+ *
+ * @param data Unused
+ * @return Always returns FALSE to disable the idle callback
+ */
+static gboolean datapipe_deferred_cb(gpointer data)
+{
+	GSList *list;
+	GSList *item;
+
+	(void)data;
+
+	datapipe_deferred_cb_id = 0;
+
+	/* Detach the list; executions deferred from the triggers
+	 * that are run here will be handled in the next round
+	 */
+	list = g_slist_reverse(datapipe_deferred_list);
+	datapipe_deferred_list = NULL;
+
+	for (item = list; item != NULL; item = item->next) {
+		datapipe_struct *datapipe = item->data;
+
+		/* Skip pipes that have been executed directly
+		 * since the execution was deferred
+		 */
+		if (datapipe->deferred == FALSE)
+			continue;
+
+		datapipe->deferred = FALSE;
+
+		(void)datapipe_execute(datapipe, datapipe->deferred_data,
+				       datapipe->deferred_use_cache,
+				       datapipe->deferred_cache_indata,
+				       datapipe->deferred_nested);
+	}
+
+	g_slist_free(list);
+
+	return FALSE;
+}
+
+/**
+ * Execute the datapipe once the current mainloop callback returns
+ *
+ * Only the latest indata is remembered; when the datapipe is
+ * executed several times before the deferred execution gets to run,
+ * the filters and triggers are run only once. A direct call to
+ * execute_datapipe() cancels any pending deferred execution.
+ *
+ * The deferred executions are run from a G_PRIORITY_HIGH idle
+ * callback, i.e. in the next mainloop iteration before any source
+ * of default or lower priority is dispatched.
+ *
+ * Datapipes that copy or free their data can't hold on to
+ * the indata, and are executed immediately instead.
+ *
+ * @param datapipe The datapipe to execute
+ * @param indata The input data to run through the datapipe
+ * @param use_cache USE_CACHE to use data from cache,
+ *                  USE_INDATA to use indata
+ * @param cache_indata CACHE_INDATA to cache the indata,
+ *                     DONT_CACHE_INDATA to keep the old data
+ */
+void execute_datapipe_deferred(datapipe_struct *const datapipe,
+			       gpointer indata,
+			       const data_source_t use_cache,
+			       const caching_policy_t cache_indata)
+{
+	if (datapipe == NULL) {
+		mce_log(LL_ERR,
+			"execute_datapipe_deferred() called "
+			"without a valid datapipe");
+		goto EXIT;
+	}
+
+	if ((datapipe->datasize != 0) ||
+	    (datapipe->free_cache == FREE_CACHE)) {
+		(void)execute_datapipe(datapipe, indata,
+				       use_cache, cache_indata);
+		goto EXIT;
+	}
+
+	datapipe_record_edge(datapipe, TRUE);
+
+	if (datapipe->deferred == TRUE) {
+		datapipe->coalesced_count++;
+
+		if (datapipe_active == NULL)
+			datapipe->deferred_nested = FALSE;
+	} else {
+		datapipe->deferred = TRUE;
+		datapipe->deferred_nested = (datapipe_active != NULL);
+		datapipe_deferred_list = g_slist_prepend(datapipe_deferred_list,
+							 datapipe);
+	}
+
+	datapipe->deferred_data = indata;
+	datapipe->deferred_use_cache = use_cache;
+	datapipe->deferred_cache_indata = cache_indata;
+
+	if (datapipe_deferred_cb_id == 0) {
+		datapipe_deferred_cb_id =
+			g_idle_add_full(G_PRIORITY_HIGH,
+					datapipe_deferred_cb, NULL, NULL);
+	}
+
+EXIT:
+	return;
+}
+
+/**
+ * Slot in the cross-thread post queue
+ *
+ * The queue is a bounded lock-free multi producer, single consumer
+ * ring; the sequence number of a slot tells whether it is free for
+ * the producer claiming queue position seq, or holds a message for
+ * the consumer reading queue position seq - 1
+ */
+typedef struct {
+	volatile gint seq;		/**< Slot sequence number */
+	datapipe_post_cb_t cb;		/**< Handler to call */
+	gpointer user_data;		/**< User data for the handler */
+	gint64 stamp;			/**< Time stamp for the handler */
+	gdouble value;			/**< Value for the handler */
+} datapipe_post_slot_t;
+
+/** Cross-thread post queue slots */
+static datapipe_post_slot_t datapipe_post_ring[DATAPIPE_POST_SLOTS];
+
+/** Next queue position to claim; updated by producers */
+static volatile gint datapipe_post_head = 0;
+
+/** Next queue position to drain; used only from the mainloop */
+static guint datapipe_post_tail = 0;
+
+/** Non-zero while a wakeup is pending in the eventfd */
+static volatile gint datapipe_post_pending = 0;
+
+/** Number of messages dropped because the queue was full */
+static volatile gint datapipe_post_dropped = 0;
+
+/** Number of messages handled from the queue */
+static guint64 datapipe_post_handled = 0;
+
+/** Number of mainloop wakeups used for handling the messages */
+static guint64 datapipe_post_wakeups = 0;
+
+/** Eventfd used for waking up the mainloop; accessed atomically,
+ *  since the posting threads can race with datapipe_post_quit() */
+static volatile gint datapipe_post_fd = -1;
+
+/** I/O watch id for the eventfd */
+static guint datapipe_post_id = 0;
+
+/**
+ * Handle all messages posted to the cross-thread queue
+ */
+static void datapipe_post_drain(void)
+{
+	gint dropped;
+
+	for (;;) {
+		datapipe_post_slot_t *slot =
+			&datapipe_post_ring[datapipe_post_tail &
+					    (DATAPIPE_POST_SLOTS - 1)];
+		guint seq = (guint)g_atomic_int_get(&slot->seq);
+
+		/* Stop at the first slot that has not been published;
+		 * the producer will wake us up again once it is */
+		if ((gint)(seq - (datapipe_post_tail + 1)) < 0)
+			break;
+
+		datapipe_post_cb_t cb = slot->cb;
+		gpointer user_data = slot->user_data;
+		gint64 stamp = slot->stamp;
+		gdouble value = slot->value;
+
+		/* Release the slot before running the handler,
+		 * it can take a while */
+		g_atomic_int_set(&slot->seq,
+				 (gint)(datapipe_post_tail +
+					DATAPIPE_POST_SLOTS));
+		datapipe_post_tail++;
+		datapipe_post_handled++;
+
+		cb(user_data, stamp, value);
+	}
+
+	/* Report overflows once per batch, not from the posting threads */
+	do {
+		dropped = g_atomic_int_get(&datapipe_post_dropped);
+	} while (!g_atomic_int_compare_and_exchange(&datapipe_post_dropped,
+						    dropped, 0));
+
+	if (dropped != 0) {
+		mce_log(LL_WARN, "cross-thread queue overflow; "
+			"%d messages dropped", dropped);
+	}
+}
+
+/**
+ * I/O watch callback for the cross-thread post queue eventfd
+ *
+ * @param channel (not used)
+ * @param condition (not used)
+ * @param data (not used)
+ * @return TRUE to keep the I/O watch, FALSE to remove it
+ */
+static gboolean datapipe_post_cb(GIOChannel *channel,
+				 GIOCondition condition,
+				 gpointer data)
 {
-	void (*trigger)(gconstpointer const input);
-	gpointer data;
-	gint i;
-
-	if (datapipe == NULL) {
-		/* Potential memory leak! */
-		mce_log(LL_ERR,
-			"execute_datapipe_input_triggers() called "
-			"without a valid datapipe");
+	gboolean keep_going = TRUE;
+	guint64 count = 0;
+
+	(void)channel;
+	(void)condition;
+	(void)data;
+
+	if (read(datapipe_post_fd, &count, sizeof count) == -1) {
+		if ((errno != EINTR) && (errno != EAGAIN)) {
+			mce_log(LL_CRIT, "failed to read post eventfd: %m");
+			datapipe_post_id = 0;
+			keep_going = FALSE;
+		}
 		goto EXIT;
 	}
 
-	data = (use_cache == USE_CACHE) ? datapipe->cached_data : indata;
+	datapipe_post_wakeups++;
 
-	if (cache_indata == CACHE_INDATA) {
-		if (use_cache == USE_INDATA) {
-			if (datapipe->free_cache == FREE_CACHE)
-				g_free(datapipe->cached_data);
+	/* Clear the pending flag before draining, so that messages
+	 * published after this point will issue another wakeup */
+	g_atomic_int_set(&datapipe_post_pending, 0);
 
-			datapipe->cached_data = data;
+	datapipe_post_drain();
+
+EXIT:
+	return keep_going;
+}
+
+/**
+ * Claim a slot in the cross-thread post queue
+ *
+ * @param pos Where to store the claimed queue position
+ * @return The claimed slot, or NULL if the queue is full
+ */
+static datapipe_post_slot_t *datapipe_post_claim(guint *pos)
+{
+	datapipe_post_slot_t *slot = NULL;
+	guint head = (guint)g_atomic_int_get(&datapipe_post_head);
+
+	for (;;) {
+		slot = &datapipe_post_ring[head & (DATAPIPE_POST_SLOTS - 1)];
+
+		gint diff = (gint)((guint)g_atomic_int_get(&slot->seq) - head);
+
+		if (diff == 0) {
+			if (g_atomic_int_compare_and_exchange(&datapipe_post_head,
+							      (gint)head,
+							      (gint)(head + 1)))
+				break;
+		} else if (diff < 0) {
+			/* The consumer has not released the slot yet */
+			g_atomic_int_inc(&datapipe_post_dropped);
+			slot = NULL;
+			break;
 		}
-	}
 
-	for (i = 0; (trigger = g_slist_nth_data(datapipe->input_triggers,
-						i)) != NULL; i++) {
-		trigger(data);
+		head = (guint)g_atomic_int_get(&datapipe_post_head);
 	}
 
-EXIT:
-	return;
+	*pos = head;
+
+	return slot;
 }
 
 /**
- * Execute the filters of a datapipe
+ * Publish a filled slot and wake up the mainloop if needed
  *
- * @param datapipe The datapipe to execute
- * @param indata The input data to run through the datapipe
- * @param use_cache USE_CACHE to use data from cache,
- *                  USE_INDATA to use indata
- * @return The processed data
+ * @param slot The slot returned by datapipe_post_claim()
+ * @param pos The queue position returned by datapipe_post_claim()
  */
-gconstpointer execute_datapipe_filters(datapipe_struct *const datapipe,
-				       gpointer indata,
-				       const data_source_t use_cache)
+static void datapipe_post_publish(datapipe_post_slot_t *slot, guint pos)
 {
-	gpointer (*filter)(gpointer input);
-	gpointer data;
-	gconstpointer retval = NULL;
-	gint i;
+	static const guint64 one = 1;
+	gint fd;
 
-	if (datapipe == NULL) {
-		mce_log(LL_ERR,
-			"execute_datapipe_filters() called "
-			"without a valid datapipe");
-		goto EXIT;
+	g_atomic_int_set(&slot->seq, (gint)(pos + 1));
+
+	/* Only the first message of a batch needs a system call */
+	if (g_atomic_int_compare_and_exchange(&datapipe_post_pending, 0, 1)) {
+		if (((fd = g_atomic_int_get(&datapipe_post_fd)) == -1) ||
+		    (TEMP_FAILURE_RETRY(write(fd, &one, sizeof one)) == -1))
+			g_atomic_int_set(&datapipe_post_pending, 0);
 	}
+}
 
-	data = (use_cache == USE_CACHE) ? datapipe->cached_data : indata;
+/**
+ * Post a handler call from any thread to the mainloop
+ *
+ * @param cb The handler to call from the mainloop
+ * @param user_data The user data to pass to the handler
+ * @param stamp The time stamp to pass to the handler
+ * @param value The value to pass to the handler
+ * @return TRUE if the call was queued, FALSE if the queue is full
+ *         or has not been initialised
+ */
+gboolean datapipe_post_call(datapipe_post_cb_t cb, gpointer user_data,
+			    gint64 stamp, gdouble value)
+{
+	datapipe_post_slot_t *slot;
+	gboolean status = FALSE;
+	guint pos;
 
-	for (i = 0; (filter = g_slist_nth_data(datapipe->filters,
-					       i)) != NULL; i++) {
-		gpointer tmp = filter(data);
+	if ((cb == NULL) || (g_atomic_int_get(&datapipe_post_fd) == -1))
+		goto EXIT;
 
-		/* If the data needs to be freed, and this isn't the indata,
-		 * or if we're not using the cache, then free the data
-		 */
-		if ((datapipe->free_cache == FREE_CACHE) &&
-		    ((i > 0) || (use_cache == USE_INDATA)))
-			g_free(data);
+	if ((slot = datapipe_post_claim(&pos)) == NULL)
+		goto EXIT;
 
-		data = tmp;
-	}
+	slot->cb = cb;
+	slot->user_data = user_data;
+	slot->stamp = stamp;
+	slot->value = value;
 
-	retval = data;
+	datapipe_post_publish(slot, pos);
+	status = TRUE;
 
 EXIT:
-	return retval;
+	return status;
 }
 
 /**
- * Execute the output triggers of a datapipe
+ * Set up the cross-thread post queue
  *
- * @param datapipe The datapipe to execute
- * @param indata The input data to run through the datapipe
- * @param use_cache USE_CACHE to use data from cache,
- *                  USE_INDATA to use indata
+ * Must be called from the mainloop thread before any
+ * other thread can post to the queue
+ *
+ * @return TRUE on success, FALSE on failure
  */
-void execute_datapipe_output_triggers(const datapipe_struct *const datapipe,
-				      gconstpointer indata,
-				      const data_source_t use_cache)
+gboolean datapipe_post_init(void)
 {
-	void (*trigger)(gconstpointer input);
-	gconstpointer data;
-	gint i;
+	GIOChannel *chn = NULL;
+	gint fd;
+	guint i;
 
-	if (datapipe == NULL) {
-		mce_log(LL_ERR,
-			"execute_datapipe_output_triggers() called "
-			"without a valid datapipe");
+	if (datapipe_post_id != 0)
 		goto EXIT;
-	}
 
-	data = (use_cache == USE_CACHE) ? datapipe->cached_data : indata;
+	for (i = 0; i < DATAPIPE_POST_SLOTS; i++)
+		datapipe_post_ring[i].seq = (gint)i;
 
-	for (i = 0; (trigger = g_slist_nth_data(datapipe->output_triggers,
-						i)) != NULL; i++) {
-		trigger(data);
+	datapipe_post_head = 0;
+	datapipe_post_tail = 0;
+	datapipe_post_pending = 0;
+	datapipe_post_dropped = 0;
+
+	if ((fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) == -1) {
+		mce_log(LL_ERR, "failed to create post eventfd: %m");
+		goto EXIT;
 	}
 
+	g_atomic_int_set(&datapipe_post_fd, fd);
+
+	if ((chn = g_io_channel_unix_new(fd)) == NULL)
+		goto EXIT;
+
+	datapipe_post_id = g_io_add_watch(chn, G_IO_IN,
+					  datapipe_post_cb, NULL);
+
 EXIT:
-	return;
+	if (chn != NULL)
+		g_io_channel_unref(chn);
+
+	if (datapipe_post_id == 0)
+		datapipe_post_quit();
+
+	return datapipe_post_id != 0;
 }
 
 /**
- * Execute the datapipe
+ * Tear down the cross-thread post queue
  *
- * @param datapipe The datapipe to execute
- * @param indata The input data to run through the datapipe
- * @param use_cache USE_CACHE to use data from cache,
- *                  USE_INDATA to use indata
- * @param cache_indata CACHE_INDATA to cache the indata,
- *                     DONT_CACHE_INDATA to keep the old data
- * @return The processed data
+ * Messages still in the queue are discarded; the threads posting
+ * to the queue should be stopped before calling this, a post made
+ * while the queue is being torn down is dropped
  */
-gconstpointer execute_datapipe(datapipe_struct *const datapipe,
-			       gpointer indata,
-			       const data_source_t use_cache,
-			       const caching_policy_t cache_indata)
+void datapipe_post_quit(void)
 {
-	gconstpointer data = NULL;
+	gint fd;
 
-	if (datapipe == NULL) {
-		mce_log(LL_ERR,
-			"execute_datapipe() called "
-			"without a valid datapipe");
-		goto EXIT;
+	if (datapipe_post_id != 0) {
+		g_source_remove(datapipe_post_id);
+		datapipe_post_id = 0;
 	}
 
-	execute_datapipe_input_triggers(datapipe, indata, use_cache,
-					cache_indata);
-
-	if (datapipe->read_only == READ_ONLY) {
-		data = indata;
-	} else {
-		data = execute_datapipe_filters(datapipe, indata, use_cache);
-	}
+	/* Only the mainloop changes the fd; clear it before closing */
+	fd = g_atomic_int_get(&datapipe_post_fd);
+	g_atomic_int_set(&datapipe_post_fd, -1);
 
-	execute_datapipe_output_triggers(datapipe, data, USE_INDATA);
+	if (fd != -1)
+		close(fd);
 
-EXIT:
-	return data;
+	if (datapipe_post_handled != 0) {
+		mce_log(LL_DEBUG, "cross-thread queue: %" G_GUINT64_FORMAT
+			" messages in %" G_GUINT64_FORMAT " wakeups",
+			datapipe_post_handled, datapipe_post_wakeups);
+	}
 }
 
 /**
@@ -202,9 +1244,6 @@ EXIT:
 void append_filter_to_datapipe(datapipe_struct *const datapipe,
 			       gpointer (*filter)(gpointer data))
 {
-	void (*refcount_trigger)(void);
-	gint i;
-
 	if (datapipe == NULL) {
 		mce_log(LL_ERR,
 			"append_filter_to_datapipe() called "
@@ -226,11 +1265,10 @@ void append_filter_to_datapipe(datapipe_struct *const datapipe,
 		goto EXIT;
 	}
 
-	datapipe->filters = g_slist_append(datapipe->filters, filter);
+	datapipe_cbarray_append(&datapipe->filters, filter,
+				TRIGGER_PRIORITY_NORMAL);
 
-	for (i = 0; (refcount_trigger = g_slist_nth_data(datapipe->refcount_triggers, i)) != NULL; i++) {
-		refcount_trigger();
-	}
+	execute_datapipe_refcount_triggers(datapipe);
 
 EXIT:
 	return;
@@ -246,10 +1284,6 @@ EXIT:
 void remove_filter_from_datapipe(datapipe_struct *const datapipe,
 				 gpointer (*filter)(gpointer data))
 {
-	void (*refcount_trigger)(void);
-	guint oldlen;
-	gint i;
-
 	if (datapipe == NULL) {
 		mce_log(LL_ERR,
 			"remove_filter_from_datapipe() called "
@@ -271,20 +1305,13 @@ void remove_filter_from_datapipe(datapipe_struct *const datapipe,
 		goto EXIT;
 	}
 
-	oldlen = g_slist_length(datapipe->filters);
-
-	datapipe->filters = g_slist_remove(datapipe->filters, filter);
-
-	/* Did we remove any entry? */
-	if (oldlen == g_slist_length(datapipe->filters)) {
+	if (datapipe_cbarray_remove(&datapipe->filters, filter) == FALSE) {
 		mce_log(LL_DEBUG,
 			"Trying to remove non-existing filter");
 		goto EXIT;
 	}
 
-	for (i = 0; (refcount_trigger = g_slist_nth_data(datapipe->refcount_triggers, i)) != NULL; i++) {
-		refcount_trigger();
-	}
+	execute_datapipe_refcount_triggers(datapipe);
 
 EXIT:
 	return;
@@ -299,9 +1326,6 @@ EXIT:
 void append_input_trigger_to_datapipe(datapipe_struct *const datapipe,
 				      void (*trigger)(gconstpointer data))
 {
-	void (*refcount_trigger)(void);
-	gint i;
-
 	if (datapipe == NULL) {
 		mce_log(LL_ERR,
 			"append_input_trigger_to_datapipe() called "
@@ -316,12 +1340,10 @@ void append_input_trigger_to_datapipe(datapipe_struct *const datapipe,
 		goto EXIT;
 	}
 
-	datapipe->input_triggers = g_slist_append(datapipe->input_triggers,
-						  trigger);
+	datapipe_cbarray_append(&datapipe->input_triggers, trigger,
+				TRIGGER_PRIORITY_NORMAL);
 
-	for (i = 0; (refcount_trigger = g_slist_nth_data(datapipe->refcount_triggers, i)) != NULL; i++) {
-		refcount_trigger();
-	}
+	execute_datapipe_refcount_triggers(datapipe);
 
 EXIT:
 	return;
@@ -337,10 +1359,6 @@ EXIT:
 void remove_input_trigger_from_datapipe(datapipe_struct *const datapipe,
 					void (*trigger)(gconstpointer data))
 {
-	void (*refcount_trigger)(void);
-	guint oldlen;
-	gint i;
-
 	if (datapipe == NULL) {
 		mce_log(LL_ERR,
 			"remove_input_trigger_from_datapipe() called "
@@ -355,58 +1373,80 @@ void remove_input_trigger_from_datapipe(datapipe_struct *const datapipe,
 		goto EXIT;
 	}
 
-	oldlen = g_slist_length(datapipe->input_triggers);
-
-	datapipe->input_triggers = g_slist_remove(datapipe->input_triggers,
-						  trigger);
-
-	/* Did we remove any entry? */
-	if (oldlen == g_slist_length(datapipe->input_triggers)) {
+	if (datapipe_cbarray_remove(&datapipe->input_triggers, trigger) == FALSE) {
 		mce_log(LL_DEBUG,
 			"Trying to remove non-existing input trigger");
 		goto EXIT;
 	}
 
-	for (i = 0; (refcount_trigger = g_slist_nth_data(datapipe->refcount_triggers, i)) != NULL; i++) {
-		refcount_trigger();
-	}
+	execute_datapipe_refcount_triggers(datapipe);
 
 EXIT:
 	return;
 }
 
+/**
+ * Forget the data last passed to the output triggers
+ *
+ * Used when the output triggers change, so that the next execution
+ * reaches the current triggers even if the data stays the same
+ *
+ * @param datapipe The datapipe
+ */
+static void datapipe_reset_suppression(datapipe_struct *const datapipe)
+{
+	datapipe->emitted = FALSE;
+	datapipe->last_emitted = NULL;
+}
+
 /**
  * Append an output trigger to an existing datapipe
  *
+ * The trigger is run with TRIGGER_PRIORITY_NORMAL
+ *
  * @param datapipe The datapipe to manipulate
  * @param trigger The trigger to add to the datapipe
  */
 void append_output_trigger_to_datapipe(datapipe_struct *const datapipe,
 				       void (*trigger)(gconstpointer data))
 {
-	void (*refcount_trigger)(void);
-	gint i;
+	append_prioritized_output_trigger_to_datapipe(datapipe, trigger,
+						      TRIGGER_PRIORITY_NORMAL);
+}
 
+/**
+ * Append an output trigger with a priority class to an existing datapipe
+ *
+ * @param datapipe The datapipe to manipulate
+ * @param trigger The trigger to add to the datapipe
+ * @param priority TRIGGER_PRIORITY_CRITICAL to run the trigger before
+ *                 the others, TRIGGER_PRIORITY_NORMAL to run it in
+ *                 registration order, TRIGGER_PRIORITY_IDLE to run it
+ *                 from an idle callback with the latest data
+ */
+void append_prioritized_output_trigger_to_datapipe(datapipe_struct *const datapipe,
+						   void (*trigger)(gconstpointer data),
+						   const trigger_priority_t priority)
+{
 	if (datapipe == NULL) {
 		mce_log(LL_ERR,
-			"append_output_trigger_to_datapipe() called "
-			"without a valid datapipe");
+			"append_prioritized_output_trigger_to_datapipe() "
+			"called without a valid datapipe");
 		goto EXIT;
 	}
 
 	if (trigger == NULL) {
 		mce_log(LL_ERR,
-			"append_output_trigger_to_datapipe() called "
-			"without a valid trigger");
+			"append_prioritized_output_trigger_to_datapipe() "
+			"called without a valid trigger");
 		goto EXIT;
 	}
 
-	datapipe->output_triggers = g_slist_append(datapipe->output_triggers,
-						   trigger);
+	datapipe_cbarray_append(&datapipe->output_triggers, trigger,
+				priority);
+	datapipe_reset_suppression(datapipe);
 
-	for (i = 0; (refcount_trigger = g_slist_nth_data(datapipe->refcount_triggers, i)) != NULL; i++) {
-		refcount_trigger();
-	}
+	execute_datapipe_refcount_triggers(datapipe);
 
 EXIT:
 	return;
@@ -422,10 +1462,6 @@ EXIT:
 void remove_output_trigger_from_datapipe(datapipe_struct *const datapipe,
 					 void (*trigger)(gconstpointer data))
 {
-	void (*refcount_trigger)(void);
-	guint oldlen;
-	gint i;
-
 	if (datapipe == NULL) {
 		mce_log(LL_ERR,
 			"remove_output_trigger_from_datapipe() called "
@@ -440,21 +1476,15 @@ void remove_output_trigger_from_datapipe(datapipe_struct *const datapipe,
 		goto EXIT;
 	}
 
-	oldlen = g_slist_length(datapipe->output_triggers);
-
-	datapipe->output_triggers = g_slist_remove(datapipe->output_triggers,
-						   trigger);
-
-	/* Did we remove any entry? */
-	if (oldlen == g_slist_length(datapipe->output_triggers)) {
+	if (datapipe_cbarray_remove(&datapipe->output_triggers, trigger) == FALSE) {
 		mce_log(LL_DEBUG,
 			"Trying to remove non-existing output trigger");
 		goto EXIT;
 	}
 
-	for (i = 0; (refcount_trigger = g_slist_nth_data(datapipe->refcount_triggers, i)) != NULL; i++) {
-		refcount_trigger();
-	}
+	datapipe_reset_suppression(datapipe);
+
+	execute_datapipe_refcount_triggers(datapipe);
 
 EXIT:
 	return;
@@ -483,7 +1513,8 @@ void append_refcount_trigger_to_datapipe(datapipe_struct *const datapipe,
 		goto EXIT;
 	}
 
-	datapipe->refcount_triggers = g_slist_append(datapipe->refcount_triggers, trigger);
+	datapipe_cbarray_append(&datapipe->refcount_triggers, trigger,
+				TRIGGER_PRIORITY_NORMAL);
 
 EXIT:
 	return;
@@ -499,8 +1530,6 @@ EXIT:
 void remove_refcount_trigger_from_datapipe(datapipe_struct *const datapipe,
 					   void (*trigger)(void))
 {
-	guint oldlen;
-
 	if (datapipe == NULL) {
 		mce_log(LL_ERR,
 			"remove_refcount_trigger_from_datapipe() called "
@@ -515,12 +1544,8 @@ void remove_refcount_trigger_from_datapipe(datapipe_struct *const datapipe,
 		goto EXIT;
 	}
 
-	oldlen = g_slist_length(datapipe->refcount_triggers);
-
-	datapipe->refcount_triggers = g_slist_remove(datapipe->refcount_triggers, trigger);
-
-	/* Did we remove any entry? */
-	if (oldlen == g_slist_length(datapipe->refcount_triggers)) {
+	if (datapipe_cbarray_remove(&datapipe->refcount_triggers,
+				    trigger) == FALSE) {
 		mce_log(LL_DEBUG,
 			"Trying to remove non-existing refcount trigger");
 		goto EXIT;
@@ -534,17 +1559,30 @@ EXIT:
  * Initialise a datapipe
  *
  * @param datapipe The datapipe to manipulate
+ * @param name The name of the datapipe, used in diagnostics
  * @param read_only READ_ONLY if the datapipe is read only,
  *                  READ_WRITE if it's read/write
  * @param free_cache FREE_CACHE if the cached data needs to be freed,
  *                   DONT_FREE_CACHE if the cache data should not be freed
+ * @param suppress_unchanged SUPPRESS_UNCHANGED to skip the output triggers
+ *                           when the filtered data is the same as on
+ *                           the previous execution,
+ *                           DONT_SUPPRESS_UNCHANGED to always run them;
+ *                           only pipes passing data as pointers
+ *                           can suppress unchanged data
  * @param datasize Pass size of memory to copy,
- *		   or 0 if only passing pointers or data as pointers
- * @param initial_data Initial cache content
+ *		   or 0 if only passing pointers or data as pointers;
+ *		   data of up to DATAPIPE_INLINE_SIZE bytes is cached
+ *		   inside the datapipe and never needs to be freed
+ * @param initial_data Initial cache content; for fixed size data
+ *		       a pointer to the data to copy, or NULL to
+ *		       zero initialise the cache
  */
 void setup_datapipe(datapipe_struct *const datapipe,
+		    const gchar *const name,
 		    const read_only_policy_t read_only,
 		    const cache_free_policy_t free_cache,
+		    const change_policy_t suppress_unchanged,
 		    const gsize datasize, gpointer initial_data)
 {
 	if (datapipe == NULL) {
@@ -554,15 +1592,65 @@ void setup_datapipe(datapipe_struct *const datapipe,
 		goto EXIT;
 	}
 
-	datapipe->filters = NULL;
-	datapipe->input_triggers = NULL;
-	datapipe->output_triggers = NULL;
-	datapipe->refcount_triggers = NULL;
+	datapipe->name = name;
+	datapipe->id = g_slist_length(datapipe_list);
+	memset(&datapipe->filters, 0, sizeof datapipe->filters);
+	memset(&datapipe->input_triggers, 0, sizeof datapipe->input_triggers);
+	memset(&datapipe->output_triggers, 0, sizeof datapipe->output_triggers);
+	memset(&datapipe->refcount_triggers, 0,
+	       sizeof datapipe->refcount_triggers);
 	datapipe->datasize = datasize;
 	datapipe->read_only = read_only;
 	datapipe->free_cache = free_cache;
 	datapipe->cached_data = initial_data;
 
+	if (datapipe_has_inline_cache(datapipe) == TRUE) {
+		if (initial_data != NULL)
+			memcpy(datapipe->inline_cache.data,
+			       initial_data, datasize);
+		else
+			memset(&datapipe->inline_cache, 0,
+			       sizeof datapipe->inline_cache);
+
+		datapipe->cached_data = datapipe->inline_cache.data;
+		datapipe->free_cache = DONT_FREE_CACHE;
+	} else if (datasize != 0) {
+		mce_log(LL_WARN,
+			"%s: data size %" G_GSIZE_FORMAT " does not fit "
+			"in the inline cache", name, datasize);
+	}
+
+	datapipe->exec_count = 0;
+	datapipe->depth = 0;
+	datapipe->max_depth = 0;
+	datapipe->deferred = FALSE;
+	datapipe->deferred_data = NULL;
+	datapipe->deferred_nested = FALSE;
+	datapipe->coalesced_count = 0;
+	datapipe->suppress_unchanged = suppress_unchanged;
+	datapipe->emitted = FALSE;
+	datapipe->last_emitted = NULL;
+	datapipe->suppressed_count = 0;
+	datapipe->edges = NULL;
+	datapipe->cascade = 0;
+	datapipe->cascade_execs = 0;
+	datapipe->max_cascade_execs = 0;
+	datapipe->reexec_count = 0;
+	datapipe->idle_pending = FALSE;
+	datapipe->idle_data = NULL;
+	datapipe->idle_coalesced_count = 0;
+
+	if ((suppress_unchanged == SUPPRESS_UNCHANGED) &&
+	    ((datasize != 0) || (free_cache == FREE_CACHE))) {
+		mce_log(LL_ERR,
+			"setup_datapipe() called with SUPPRESS_UNCHANGED "
+			"for %s, which does not pass data as pointers",
+			name);
+		datapipe->suppress_unchanged = DONT_SUPPRESS_UNCHANGED;
+	}
+
+	datapipe_list = g_slist_append(datapipe_list, datapipe);
+
 EXIT:
 	return;
 }
@@ -582,25 +1670,25 @@ void free_datapipe(datapipe_struct *const datapipe)
 	}
 
 	/* Warn about still registered filters/triggers */
-	if (datapipe->filters != NULL) {
+	if (datapipe->filters.live != 0) {
 		mce_log(LL_INFO,
 			"free_datapipe() called on a datapipe that "
 			"still has registered filter(s)");
 	}
 
-	if (datapipe->input_triggers != NULL) {
+	if (datapipe->input_triggers.live != 0) {
 		mce_log(LL_INFO,
 			"free_datapipe() called on a datapipe that "
 			"still has registered input_trigger(s)");
 	}
 
-	if (datapipe->output_triggers != NULL) {
+	if (datapipe->output_triggers.live != 0) {
 		mce_log(LL_INFO,
 			"free_datapipe() called on a datapipe that "
 			"still has registered output_trigger(s)");
 	}
 
-	if (datapipe->refcount_triggers != NULL) {
+	if (datapipe->refcount_triggers.live != 0) {
 		mce_log(LL_INFO,
 			"free_datapipe() called on a datapipe that "
 			"still has registered refcount_trigger(s)");
@@ -610,6 +1698,304 @@ void free_datapipe(datapipe_struct *const datapipe)
 		g_free(datapipe->cached_data);
 	}
 
+	datapipe_cbarray_free(&datapipe->filters);
+	datapipe_cbarray_free(&datapipe->input_triggers);
+	datapipe_cbarray_free(&datapipe->output_triggers);
+	datapipe_cbarray_free(&datapipe->refcount_triggers);
+
+	datapipe_cancel_deferred(datapipe);
+	datapipe_cancel_idle_triggers(datapipe);
+
+	g_slist_free_full(datapipe->edges, g_free);
+	datapipe->edges = NULL;
+
+	datapipe_list = g_slist_remove(datapipe_list, datapipe);
+
 EXIT:
 	return;
 }
+
+/**
+ * Get a human readable name for a datapipe callback
+ *
+ * Callbacks are usually static functions, so the name is given
+ * as an offset into the object they live in unless an exactly
+ * matching exported symbol is found
+ *
+ * @param cb The callback
+ * @return The name of the callback; free with g_free()
+ */
+static gchar *datapipe_get_callback_name(gpointer cb)
+{
+	Dl_info info;
+	const gchar *file;
+
+	if (dladdr(cb, &info) == 0 || info.dli_fname == NULL)
+		return g_strdup_printf("%p", cb);
+
+	if (info.dli_sname != NULL && info.dli_saddr == cb)
+		return g_strdup(info.dli_sname);
+
+	if ((file = strrchr(info.dli_fname, '/')) != NULL)
+		file++;
+	else
+		file = info.dli_fname;
+
+	return g_strdup_printf("%s+%#lx", file,
+			       (gulong)((const gchar *)cb -
+					(const gchar *)info.dli_fbase));
+}
+
+/**
+ * Append statistics of a callback array to a text buffer
+ *
+ * @param text The text buffer to append to
+ * @param type The type of callbacks in the array
+ * @param self The callback array
+ */
+static void datapipe_cbarray_append_stats(GString *text,
+					  const gchar *const type,
+					  const datapipe_cbarray_t *const self)
+{
+	const datapipe_cbstats_t *stats;
+	gchar *name;
+	guint i, b;
+
+	for (i = 0; i < self->used; i++) {
+		if (self->cb[i] == NULL)
+			continue;
+
+		stats = &self->stats[i];
+		name = datapipe_get_callback_name(self->cb[i]);
+
+		g_string_append_printf(text,
+				       "\t%s%s %s: %" G_GUINT64_FORMAT " calls, "
+				       "avg %" G_GUINT64_FORMAT " us, "
+				       "max %u us;",
+				       datapipe_priority_label[self->priority[i]],
+				       type, name, stats->calls,
+				       stats->calls ?
+				       stats->total_us / stats->calls : 0,
+				       stats->max_us);
+
+		for (b = 0; b < DATAPIPE_HISTOGRAM_BUCKETS; b++) {
+			g_string_append_printf(text, " %s:%u",
+					       datapipe_histogram_label[b],
+					       stats->histogram[b]);
+		}
+
+		g_string_append_c(text, '\n');
+		g_free(name);
+	}
+}
+
+/**
+ * Get execution statistics of all datapipes
+ *
+ * @return Statistics as human readable text; free with g_free()
+ */
+gchar *datapipe_get_stats(void)
+{
+	GString *text = g_string_new(NULL);
+	GSList *item;
+
+	g_string_append_printf(text,
+			       "cross-thread queue: %" G_GUINT64_FORMAT
+			       " messages, %" G_GUINT64_FORMAT " wakeups\n",
+			       datapipe_post_handled, datapipe_post_wakeups);
+
+	for (item = datapipe_list; item != NULL; item = item->next) {
+		const datapipe_struct *datapipe = item->data;
+
+		g_string_append_printf(text,
+				       "%s: %" G_GUINT64_FORMAT " executions, "
+				       "%" G_GUINT64_FORMAT " coalesced, "
+				       "%" G_GUINT64_FORMAT " idle coalesced, "
+				       "%" G_GUINT64_FORMAT " suppressed, "
+				       "max depth %u, "
+				       "%" G_GUINT64_FORMAT " repeated in "
+				       "one input event (max %u)\n",
+				       datapipe->name ?: "unnamed",
+				       datapipe->exec_count,
+				       datapipe->coalesced_count,
+				       datapipe->idle_coalesced_count,
+				       datapipe->suppressed_count,
+				       datapipe->max_depth,
+				       datapipe->reexec_count,
+				       datapipe->max_cascade_execs);
+
+		datapipe_cbarray_append_stats(text, "filter",
+					      &datapipe->filters);
+		datapipe_cbarray_append_stats(text, "input trigger",
+					      &datapipe->input_triggers);
+		datapipe_cbarray_append_stats(text, "output trigger",
+					      &datapipe->output_triggers);
+		datapipe_cbarray_append_stats(text, "refcount trigger",
+					      &datapipe->refcount_triggers);
+	}
+
+	return g_string_free(text, FALSE);
+}
+
+/**
+ * Find the datapipe executions that close a cycle
+ *
+ * Depth first search; an edge leading to a datapipe that is still
+ * being visited closes a cycle. Deferred executions do not nest,
+ * so they are not followed.
+ *
+ * @param datapipe The datapipe to visit
+ * @param state Visiting state of datapipes; 1 = in progress, 2 = done
+ * @param cyclic Set of edges that close a cycle
+ */
+static void datapipe_graph_visit(datapipe_struct *const datapipe,
+				 GHashTable *state, GHashTable *cyclic)
+{
+	GSList *item;
+
+	g_hash_table_insert(state, datapipe, GINT_TO_POINTER(1));
+
+	for (item = datapipe->edges; item != NULL; item = item->next) {
+		datapipe_edge_t *edge = item->data;
+		gint visited;
+
+		if (edge->deferred == TRUE)
+			continue;
+
+		visited = GPOINTER_TO_INT(g_hash_table_lookup(state,
+							      edge->callee));
+
+		if (visited == 1)
+			g_hash_table_insert(cyclic, edge, edge);
+		else if (visited == 0)
+			datapipe_graph_visit(edge->callee, state, cyclic);
+	}
+
+	g_hash_table_insert(state, datapipe, GINT_TO_POINTER(2));
+}
+
+/**
+ * Get the datapipe execution graph in Graphviz format
+ *
+ * Edges are datapipe executions made from the callbacks of another
+ * datapipe, labeled with the callback and the number of executions;
+ * deferred executions are dashed, edges closing a cycle are red and
+ * datapipes executed more than once for a single input event are
+ * drawn in orange
+ *
+ * @return The graph as text; free with g_free()
+ */
+gchar *datapipe_get_graph(void)
+{
+	GString *text = g_string_new(NULL);
+	GHashTable *state = g_hash_table_new(g_direct_hash, g_direct_equal);
+	GHashTable *cyclic = g_hash_table_new(g_direct_hash, g_direct_equal);
+	guint repeated = 0;
+	GSList *item;
+	GSList *iter;
+
+	for (item = datapipe_list; item != NULL; item = item->next) {
+		datapipe_struct *datapipe = item->data;
+
+		if (g_hash_table_lookup(state, datapipe) == NULL)
+			datapipe_graph_visit(datapipe, state, cyclic);
+	}
+
+	g_string_append(text, "digraph datapipes {\n");
+	g_string_append(text, "\tnode [shape=box];\n");
+
+	for (item = datapipe_list; item != NULL; item = item->next) {
+		const datapipe_struct *datapipe = item->data;
+		const gchar *name = datapipe->name ?: "unnamed";
+
+		g_string_append_printf(text,
+				       "\t\"%s\" [label=\"%s\\n"
+				       "%" G_GUINT64_FORMAT " executions",
+				       name, name, datapipe->exec_count);
+
+		if (datapipe->reexec_count != 0) {
+			repeated++;
+			g_string_append_printf(text,
+					       "\\n%" G_GUINT64_FORMAT
+					       " repeated (max %u)\", "
+					       "color=orange, style=bold",
+					       datapipe->reexec_count,
+					       datapipe->max_cascade_execs);
+		} else {
+			g_string_append(text, "\"");
+		}
+
+		g_string_append(text, "];\n");
+	}
+
+	for (item = datapipe_list; item != NULL; item = item->next) {
+		const datapipe_struct *datapipe = item->data;
+
+		for (iter = datapipe->edges; iter != NULL; iter = iter->next) {
+			datapipe_edge_t *edge = iter->data;
+			gchar *cb = (edge->cb != NULL) ?
+				datapipe_get_callback_name(edge->cb) : NULL;
+
+			g_string_append_printf(text,
+					       "\t\"%s\" -> \"%s\" "
+					       "[label=\"%s\\n%"
+					       G_GUINT64_FORMAT "\"%s%s];\n",
+					       datapipe->name ?: "unnamed",
+					       edge->callee->name ?: "unnamed",
+					       cb ?: "?", edge->count,
+					       edge->deferred ?
+					       ", style=dashed" : "",
+					       (edge->recursive ||
+						g_hash_table_lookup(cyclic,
+								    edge)) ?
+					       ", color=red" : "");
+			g_free(cb);
+		}
+	}
+
+	g_string_append_printf(text,
+			       "\t/* %u edges close a cycle, "
+			       "%u datapipes repeated in one input event */\n",
+			       g_hash_table_size(cyclic), repeated);
+	g_string_append(text, "}\n");
+
+	g_hash_table_destroy(cyclic);
+	g_hash_table_destroy(state);
+
+	return g_string_free(text, FALSE);
+}
+
+/**
+ * Get a datapipe by its setup order index
+ *
+ * @param id The index of the datapipe
+ * @return The datapipe, or NULL if there is no such datapipe
+ */
+datapipe_struct *datapipe_get_nth(const guint id)
+{
+	return g_slist_nth_data(datapipe_list, id);
+}
+
+/**
+ * Get a datapipe by name
+ *
+ * @param name The name given to the datapipe at setup time
+ * @return The datapipe, or NULL if there is no such datapipe
+ */
+datapipe_struct *datapipe_lookup(const gchar *const name)
+{
+	datapipe_struct *datapipe = NULL;
+	GSList *item;
+
+	for (item = datapipe_list; item != NULL; item = item->next) {
+		datapipe_struct *candidate = item->data;
+
+		if ((candidate->name != NULL) &&
+		    (strcmp(candidate->name, name) == 0)) {
+			datapipe = candidate;
+			break;
+		}
+	}
+
+	return datapipe;
+}
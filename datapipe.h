@@ -23,24 +23,6 @@
 
 #include <glib.h>
 
-/**
- * Datapipe structure
- *
- * Only access this struct through the functions
- */
-typedef struct {
-	GSList *filters;		/**< The filters */
-	GSList *input_triggers;		/**< Triggers called on indata */
-	GSList *output_triggers;	/**< Triggers called on outdata */
-	GSList *refcount_triggers;	/**< Triggers called on
-					 *   reference count changes
-					 */
-	gpointer cached_data;		/**< Latest cached data */
-	gsize datasize;			/**< Size of data; NULL == automagic */
-	gboolean free_cache;		/**< Free the cache? */
-	gboolean read_only;		/**< Datapipe is read only */
-} datapipe_struct;
-
 /**
  * Read only policy type
  */
@@ -57,6 +39,17 @@ typedef enum {
 	FREE_CACHE = TRUE		/**< Free the cache */
 } cache_free_policy_t;
 
+/**
+ * Policy for output trigger execution when the data does not change
+ */
+typedef enum {
+	/** Run the output triggers on every execution */
+	DONT_SUPPRESS_UNCHANGED = FALSE,
+	/** Skip the output triggers if the data is the same as
+	 *  what was passed to them on the previous execution */
+	SUPPRESS_UNCHANGED = TRUE
+} change_policy_t;
+
 /**
  * Policy for the data source
  */
@@ -73,6 +66,154 @@ typedef enum {
 	CACHE_INDATA = TRUE		/**< Cache the indata */
 } caching_policy_t;
 
+/**
+ * Priority class of an output trigger
+ */
+typedef enum {
+	/** Run before all other output triggers; for the consumers
+	 *  that user perceived latency depends on */
+	TRIGGER_PRIORITY_CRITICAL = 0,
+	/** Run in registration order after the critical triggers */
+	TRIGGER_PRIORITY_NORMAL = 1,
+	/** Run from an idle callback after the mainloop has dispatched
+	 *  the events that are already pending; only the latest data is
+	 *  passed to the trigger. The callback has the same priority as
+	 *  the input I/O watches, so a steady stream of input can delay
+	 *  it by one mainloop iteration but never starve it */
+	TRIGGER_PRIORITY_IDLE = 2
+} trigger_priority_t;
+
+/** Mainloop priority of the callback running idle output triggers;
+ *  G_PRIORITY_DEFAULT_IDLE would let continuous input starve them */
+#define DATAPIPE_IDLE_TRIGGER_PRIORITY	G_PRIORITY_DEFAULT
+
+/** Largest fixed size data that is cached inside the datapipe itself */
+#define DATAPIPE_INLINE_SIZE		32
+
+/** Number of buckets in datapipe callback latency histograms */
+#define DATAPIPE_HISTOGRAM_BUCKETS	6
+
+/** Number of slots in the cross-thread post queue; must be a power of 2 */
+#define DATAPIPE_POST_SLOTS		256
+
+/**
+ * Mainloop handler for a call posted from another thread
+ *
+ * @param user_data The user_data passed to datapipe_post_call()
+ * @param stamp The time stamp passed to datapipe_post_call()
+ * @param value The value passed to datapipe_post_call()
+ */
+typedef void (*datapipe_post_cb_t)(gpointer user_data,
+				   gint64 stamp, gdouble value);
+
+/**
+ * Execution statistics for a datapipe callback
+ *
+ * Histogram bucket N counts calls that took less than 10^(N+1)
+ * microseconds; the last bucket counts everything slower than that
+ */
+typedef struct {
+	guint64 calls;			/**< Number of calls */
+	guint64 total_us;		/**< Accumulated run time */
+	guint max_us;			/**< Longest single run time */
+	guint histogram[DATAPIPE_HISTOGRAM_BUCKETS];	/**< Run time
+							 *   histogram
+							 */
+} datapipe_cbstats_t;
+
+/**
+ * Packed array of datapipe callbacks
+ *
+ * Callbacks are stored in registration order; slots of callbacks
+ * removed while the array is being iterated are set to NULL and
+ * compacted away once the outermost iteration has finished
+ */
+typedef struct {
+	gpointer *cb;			/**< Callback function pointers */
+	datapipe_cbstats_t *stats;	/**< Statistics for each slot */
+	trigger_priority_t *priority;	/**< Priority class of each slot */
+	guint used;			/**< Number of slots in use */
+	guint alloc;			/**< Number of slots allocated */
+	guint live;			/**< Number of non-NULL slots */
+	guint busy;			/**< Nesting level of iterations */
+} datapipe_cbarray_t;
+
+/**
+ * Datapipe structure
+ *
+ * Only access this struct through the functions
+ */
+typedef struct {
+	const gchar *name;		/**< Name used in diagnostics */
+	guint id;			/**< Index in setup order */
+	datapipe_cbarray_t filters;		/**< The filters */
+	datapipe_cbarray_t input_triggers;	/**< Triggers called on indata */
+	datapipe_cbarray_t output_triggers;	/**< Triggers called on outdata */
+	datapipe_cbarray_t refcount_triggers;	/**< Triggers called on
+						 *   reference count changes
+						 */
+	gpointer cached_data;		/**< Latest cached data */
+	gsize datasize;			/**< Size of data; NULL == automagic */
+	union {
+		gint64 align;		/**< Force 64-bit alignment */
+		guint8 data[DATAPIPE_INLINE_SIZE];	/**< Cached data */
+	} inline_cache;			/**< Storage for the cached data of
+					 *   pipes with fixed size data
+					 */
+	gboolean free_cache;		/**< Free the cache? */
+	gboolean read_only;		/**< Datapipe is read only */
+	guint64 exec_count;		/**< Number of executions */
+	guint depth;			/**< Current execution nesting level */
+	guint max_depth;		/**< Deepest execution nesting seen */
+	gboolean deferred;		/**< Deferred execution pending */
+	gpointer deferred_data;		/**< Indata for deferred execution */
+	data_source_t deferred_use_cache;	/**< Data source for
+						 *   deferred execution
+						 */
+	caching_policy_t deferred_cache_indata;	/**< Caching policy for
+						 *   deferred execution
+						 */
+	gboolean deferred_nested;	/**< Deferred execution was requested
+					 *   only from the callbacks of
+					 *   other datapipes
+					 */
+	guint64 coalesced_count;	/**< Executions merged into
+					 *   a pending deferred execution
+					 */
+	change_policy_t suppress_unchanged;	/**< Skip output triggers
+						 *   for unchanged data?
+						 */
+	gboolean emitted;		/**< Output triggers have been run */
+	gconstpointer last_emitted;	/**< Data last passed to the
+					 *   output triggers
+					 */
+	guint64 suppressed_count;	/**< Executions where unchanged data
+					 *   did not run the output triggers
+					 */
+	GSList *edges;			/**< Datapipes executed from the
+					 *   callbacks of this datapipe
+					 */
+	guint cascade;			/**< Input event of the latest
+					 *   execution
+					 */
+	guint cascade_execs;		/**< Executions during the latest
+					 *   input event
+					 */
+	guint max_cascade_execs;	/**< Most executions seen during
+					 *   a single input event
+					 */
+	guint64 reexec_count;		/**< Input events that executed
+					 *   the datapipe more than once
+					 */
+	gboolean idle_pending;		/**< Idle output triggers pending */
+	gconstpointer idle_data;	/**< Data for the idle output
+					 *   triggers
+					 */
+	guint64 idle_coalesced_count;	/**< Executions merged into
+					 *   a pending idle trigger run
+					 */
+} datapipe_struct;
+
 /* Data retrieval */
 
 /** Retrieve a gboolean from a datapipe */
@@ -89,11 +230,11 @@ typedef enum {
 /* Reference count */
 
 /** Retrieve the filter reference count from a datapipe */
-#define datapipe_get_filter_refcount(_datapipe)	(g_slist_length((_datapipe).filters))
+#define datapipe_get_filter_refcount(_datapipe)	((_datapipe).filters.live)
 /** Retrieve the input trigger reference count from a datapipe */
-#define datapipe_get_input_trigger_refcount(_datapipe)	(g_slist_length((_datapipe).input_triggers))
+#define datapipe_get_input_trigger_refcount(_datapipe)	((_datapipe).input_triggers.live)
 /** Retrieve the output trigger reference count from a datapipe */
-#define datapipe_get_output_trigger_refcount(_datapipe)	(g_slist_length((_datapipe).output_triggers))
+#define datapipe_get_output_trigger_refcount(_datapipe)	((_datapipe).output_triggers.live)
 
 /* Datapipe execution */
 void execute_datapipe_input_triggers(datapipe_struct *const datapipe,
@@ -103,13 +244,23 @@ void execute_datapipe_input_triggers(datapipe_struct *const datapipe,
 gconstpointer execute_datapipe_filters(datapipe_struct *const datapipe,
 				       gpointer indata,
 				       const data_source_t use_cache);
-void execute_datapipe_output_triggers(const datapipe_struct *const datapipe,
+void execute_datapipe_output_triggers(datapipe_struct *const datapipe,
 				      gconstpointer indata,
 				      const data_source_t use_cache);
 gconstpointer execute_datapipe(datapipe_struct *const datapipe,
 			       gpointer indata,
 			       const data_source_t use_cache,
 			       const caching_policy_t cache_indata);
+void execute_datapipe_deferred(datapipe_struct *const datapipe,
+			       gpointer indata,
+			       const data_source_t use_cache,
+			       const caching_policy_t cache_indata);
+
+/* Posting from other threads */
+gboolean datapipe_post_call(datapipe_post_cb_t cb, gpointer user_data,
+			    gint64 stamp, gdouble value);
+gboolean datapipe_post_init(void);
+void datapipe_post_quit(void);
 
 /* Filters */
 void append_filter_to_datapipe(datapipe_struct *const datapipe,
@@ -126,6 +277,9 @@ void remove_input_trigger_from_datapipe(datapipe_struct *const datapipe,
 /* Output triggers */
 void append_output_trigger_to_datapipe(datapipe_struct *const datapipe,
 				       void (*trigger)(gconstpointer data));
+void append_prioritized_output_trigger_to_datapipe(datapipe_struct *const datapipe,
+						   void (*trigger)(gconstpointer data),
+						   const trigger_priority_t priority);
 void remove_output_trigger_from_datapipe(datapipe_struct *const datapipe,
 					 void (*trigger)(gconstpointer data));
 
@@ -136,9 +290,17 @@ void remove_refcount_trigger_from_datapipe(datapipe_struct *const datapipe,
 					   void (*trigger)(void));
 
 void setup_datapipe(datapipe_struct *const datapipe,
+		    const gchar *const name,
 		    const read_only_policy_t read_only,
 		    const cache_free_policy_t free_cache,
+		    const change_policy_t suppress_unchanged,
 		    const gsize datasize, gpointer initial_data);
 void free_datapipe(datapipe_struct *const datapipe);
 
+/* Diagnostics */
+gchar *datapipe_get_stats(void);
+gchar *datapipe_get_graph(void);
+datapipe_struct *datapipe_get_nth(const guint id);
+datapipe_struct *datapipe_lookup(const gchar *const name);
+
 #endif /* _DATAPIPE_H_ */
@@ -20,24 +20,25 @@
  * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <glib.h>
-#include <gio/gio.h>
-#include <glib/gstdio.h>		/* g_access() */
-#include <glib-object.h>		/* g_signal_connect(),
-					 * G_OBJECT(),
-					 * G_CALLBACK()
-					 */
 
 #include <errno.h>			/* errno */
 #include <fcntl.h>			/* open() */
 #include <dirent.h>			/* opendir(), readdir(), telldir() */
-#include <string.h>			/* strcmp() */
+#include <stdint.h>			/* uintptr_t */
+#include <string.h>			/* strcmp(), memset() */
 #include <unistd.h>			/* close() */
 #include <sys/ioctl.h>			/* ioctl() */
+#include <sys/stat.h>			/* stat(), fstat() */
 #include <sys/types.h>			/* DIR */
 #include <linux/input.h>		/* struct input_event,
 					 * EVIOCGNAME, EVIOCGBIT, EVIOCGSW,
+					 * EVIOCSMASK, struct input_mask,
+					 * EVIOCGKEY, EVIOCGABS, EVIOCGMTSLOTS,
+					 * struct input_absinfo,
+					 * SYN_REPORT, SYN_DROPPED,
+					 * EVIOCGID, EVIOCGPHYS, struct input_id,
 					 * EV_ABS, EV_KEY, EV_SW,
-					 * ABS_PRESSURE,
+					 * ABS_PRESSURE, ABS_MT_TRACKING_ID, ABS_MT_SLOT,
 					 * SW_CAMERA_LENS_COVER,
 					 * SW_KEYPAD_SLIDE,
 					 * SW_FRONT_PROXIMITY,
@@ -61,6 +62,20 @@
 /** Input layer code for the camera focus button */
 #define KEY_CAMERA_FOCUS		0x0210
 #endif /* KEY_CAMERA_FOCUS */
+#ifndef SYN_DROPPED
+/** Input layer code for events dropped due to a full buffer */
+#define SYN_DROPPED			3
+#endif /* SYN_DROPPED */
+#ifndef EVIOCSMASK
+/** Kernel side event code filter; available since Linux 4.4 */
+struct input_mask {
+	__u32 type;			/**< Event type the mask applies to */
+	__u32 codes_size;		/**< Size of the code bitmap in bytes */
+	__u64 codes_ptr;		/**< Address of the code bitmap */
+};
+/** Input layer ioctl for setting the event code filter */
+#define EVIOCSMASK			_IOW('E', 0x93, struct input_mask)
+#endif /* EVIOCSMASK */
 
 #include "mce.h"
 #include "event-input.h"
@@ -69,10 +84,14 @@
 					 * mce_write_string_to_file(),
 					 * mce_suspend_io_monitor(),
 					 * mce_resume_io_monitor(),
-					 * mce_register_io_monitor_chunk(),
+					 * mce_register_io_monitor_batch(),
+					 * mce_set_io_monitor_timestamped(),
 					 * mce_unregister_io_monitor(),
 					 * mce_get_io_monitor_name(),
-					 * mce_get_io_monitor_fd()
+					 * mce_get_io_monitor_fd(),
+					 * mce_io_load_file(),
+					 * mce_io_persist_file(),
+					 * mce_io_cache_access()
 					 */
 #include "mce-lib.h"			/* bitsize_of(),
 					 * set_bit(), clear_bit(), test_bit(),
@@ -83,8 +102,20 @@
 #include "mce-conf.h"			/* mce_conf_get_int(),
 					 * mce_conf_get_string()
 					 */
-#include "datapipe.h"			/* execute_datapipe() */
+#include "datapipe.h"			/* execute_datapipe(),
+					 * execute_datapipe_deferred()
+					 */
+#include "mce-latency.h"			/* mce_latency_begin(),
+					 * mce_latency_mark()
+					 */
 #include "evdev.h"
+#include "filewatcher.h"		/* filewatcher_create_entries(),
+					 * filewatcher_delete()
+					 */
+#include "gesture.h"			/* gesture_process_frame(),
+					 * gesture_reset(),
+					 * GESTURE_DOUBLETAP, GESTURE_SWIPE
+					 */
 #ifdef ENABLE_DOUBLETAP_EMULATION
 # include "mce-gconf.h"
 #endif
@@ -92,6 +123,9 @@
 /** ID for touchscreen I/O monitor timeout source */
 static guint touchscreen_io_monitor_timeout_cb_id = 0;
 
+/** ID for touchscreen held finger activity timeout source */
+static guint touchscreen_hold_timeout_cb_id = 0;
+
 /** ID for keypress timeout source */
 static guint keypress_repeat_timeout_cb_id = 0;
 
@@ -105,12 +139,16 @@ static GSList *keyboard_dev_list = NULL;
 /** List of misc input devices */
 static GSList *misc_dev_list = NULL;
 
-/** GFile pointer for the directory we monitor */
-static GFile *dev_input_gfp = NULL;
-/** GFileMonitor pointer for the directory we monitor */
-static GFileMonitor *dev_input_gfmp = NULL;
-/** The handler ID for the signal handler */
-static gulong dev_input_handler_id = 0;
+/** Inotify watch for event nodes in the directory we monitor */
+static filewatcher_t *dev_input_watcher = NULL;
+/** ID for the coalesced input device rescan timeout source */
+static guint dev_input_rescan_id = 0;
+/** Number of input device rescans done after the initial scan */
+static guint dev_input_rescans = 0;
+/** Delay before reopening input devices after an error, in ms */
+static guint dev_input_reopen_delay = DEV_INPUT_RESCAN_DELAY;
+/** Time of the latest input device error, in monotonic us */
+static gint64 dev_input_reopen_stamp = 0;
 
 /** Time in milliseconds before the key press is considered long */
 static gint longdelay = DEFAULT_HOME_LONG_DELAY;
@@ -119,6 +157,8 @@ static gint longdelay = DEFAULT_HOME_LONG_DELAY;
 static gboolean gpio_key_disable_exists = FALSE;
 
 static void update_inputdevices(const gchar *device, gboolean add);
+static void schedule_rescan_inputdevices(guint delay);
+static void touchscreen_update_masks(gboolean force);
 
 #ifndef FF_STATUS_CNT
 # ifdef FF_STATUS_MAX
@@ -248,6 +288,99 @@ static int evdevbits_test(const evdevbits_t *self, int bit)
 	return res;
 }
 
+/** Set evdev event code in bitmap
+ *
+ * @param self evdevbits_t object, or NULL
+ * @param bit event code to set
+ */
+static void evdevbits_set(evdevbits_t *self, int bit)
+{
+	if( self && (unsigned)bit < (unsigned)self->cnt ) {
+		int i = bit / LONG_BIT;
+		unsigned long m = 1ul << (bit % LONG_BIT);
+		self->bit[i] |= m;
+	}
+}
+
+/** Clear evdev event code in bitmap
+ *
+ * @param self evdevbits_t object, or NULL
+ * @param bit event code to clear
+ */
+static void evdevbits_unset(evdevbits_t *self, int bit)
+{
+	if( self && (unsigned)bit < (unsigned)self->cnt ) {
+		int i = bit / LONG_BIT;
+		unsigned long m = 1ul << (bit % LONG_BIT);
+		self->bit[i] &= ~m;
+	}
+}
+
+/** Set all event codes in bitmap
+ *
+ * @param self evdevbits_t object, or NULL
+ */
+static void evdevbits_fill(evdevbits_t *self)
+{
+	if( self ) {
+		int len = EVDEVBITS_LEN(self->cnt);
+		memset(self->bit, 0xff, len * sizeof *self->bit);
+	}
+}
+
+/** Kernel does not support EVIOCSMASK */
+static gboolean evdev_mask_unsupported = FALSE;
+
+/** Set kernel side filter for the codes of one evdev event type
+ *
+ * Codes that are not set in the bitmap are dropped by the kernel
+ * before they are queued for reading; a NULL bitmap drops all the
+ * codes of the event type. Frames that end up empty do not wake
+ * up the reader at all.
+ *
+ * @param fd file descriptor of an evdev device node
+ * @param type evdev event type
+ * @param self evdevbits_t object for the type, or NULL
+ *
+ * @return 0 on success, -1 on errors
+ */
+static int evdev_set_mask(int fd, int type, const evdevbits_t *self)
+{
+	int res = -1;
+
+	struct input_mask mask = {
+		.type       = type,
+		.codes_size = 0,
+		.codes_ptr  = 0,
+	};
+
+	if( evdev_mask_unsupported || fd == -1 )
+		goto EXIT;
+
+	if( self ) {
+		mask.codes_size = EVDEVBITS_LEN(self->cnt) * sizeof *self->bit;
+		mask.codes_ptr  = (uintptr_t)self->bit;
+	}
+
+	if( ioctl(fd, EVIOCSMASK, &mask) == -1 ) {
+		if( errno == EINVAL || errno == ENOTTY ) {
+			mce_log(LL_NOTICE, "EVIOCSMASK not supported; "
+				"input events are filtered in mce");
+			evdev_mask_unsupported = TRUE;
+		} else {
+			mce_log(LL_WARN, "EVIOCSMASK(%s): %m",
+				evdev_get_event_type_name(type));
+		}
+		errno = 0;
+		goto EXIT;
+	}
+
+	res = 0;
+
+EXIT:
+	return res;
+}
+
 /** Supported event types and codes for an evdev device node
  */
 typedef struct
@@ -553,6 +686,265 @@ cleanup:
 	return res;
 }
 
+/** Magic bytes at the start of the evdev probe cache file;
+ *  bump whenever the get_evdev_type() heuristics change */
+#define EVDEV_CACHE_MAGIC		"MCEEVC01"
+
+/** Maximum length of device name and phys stored in the cache */
+#define EVDEV_CACHE_NAME_MAX		128
+
+/** Evdev probe cache file header */
+typedef struct {
+	gchar magic[8];			/**< EVDEV_CACHE_MAGIC */
+	guint32 record_size;		/**< Size of one record */
+	guint32 record_count;		/**< Number of records that follow */
+} evdev_cache_header_t;
+
+/** Evdev probe cache record; identifies a device and its class */
+typedef struct {
+	guint16 bustype;		/**< Bus type from EVIOCGID */
+	guint16 vendor;			/**< Vendor id from EVIOCGID */
+	guint16 product;		/**< Product id from EVIOCGID */
+	guint16 version;		/**< Version from EVIOCGID */
+	guint32 type;			/**< evdev_type_t from probing */
+	gchar name[EVDEV_CACHE_NAME_MAX];	/**< Name from EVIOCGNAME */
+	gchar phys[EVDEV_CACHE_NAME_MAX];	/**< Phys from EVIOCGPHYS */
+} evdev_cache_record_t;
+
+/** Evdev probe cache entry */
+typedef struct {
+	evdev_cache_record_t rec;	/**< Device identity and class */
+	gboolean seen;			/**< Device seen since startup */
+} evdev_cache_entry_t;
+
+/** Evdev probe cache; identity string -> evdev_cache_entry_t */
+static GHashTable *evdev_cache = NULL;
+
+/** Evdev probe cache has changes not yet saved */
+static gboolean evdev_cache_dirty = FALSE;
+
+/** Number of cached classifications during the latest scan */
+static guint evdev_cache_hits = 0;
+
+/** Number of devices probed during the latest scan */
+static guint evdev_cache_misses = 0;
+
+/**
+ * Get the cache key for a device identity
+ *
+ * @param rec Device identity
+ * @return Key string; free with g_free()
+ */
+static gchar *evdev_cache_key(const evdev_cache_record_t *rec)
+{
+	return g_strdup_printf("%04x:%04x:%04x:%04x:%s:%s",
+			       rec->bustype, rec->vendor,
+			       rec->product, rec->version,
+			       rec->name, rec->phys);
+}
+
+/**
+ * Add a record to the evdev probe cache
+ *
+ * @param rec Device identity and class
+ * @param seen TRUE if the device is present now
+ */
+static void evdev_cache_insert(const evdev_cache_record_t *rec,
+			       gboolean seen)
+{
+	evdev_cache_entry_t *entry = g_malloc0(sizeof *entry);
+
+	entry->rec = *rec;
+	entry->seen = seen;
+	g_hash_table_replace(evdev_cache, evdev_cache_key(rec), entry);
+}
+
+/**
+ * Fill in the identity of an evdev device
+ *
+ * @param rec Record to fill in
+ * @param fd File descriptor of the evdev device node
+ * @param name Name of the device
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean evdev_cache_identify(evdev_cache_record_t *rec, int fd,
+				     const char *name)
+{
+	gboolean status = FALSE;
+	struct input_id id;
+
+	memset(rec, 0, sizeof *rec);
+
+	if (ioctl(fd, EVIOCGID, &id) == -1) {
+		mce_log(LL_WARN, "EVIOCGID: %m");
+		errno = 0;
+		goto EXIT;
+	}
+
+	rec->bustype = id.bustype;
+	rec->vendor  = id.vendor;
+	rec->product = id.product;
+	rec->version = id.version;
+	g_strlcpy(rec->name, name, sizeof rec->name);
+
+	/* Virtual devices do not have a physical path */
+	if (ioctl(fd, EVIOCGPHYS(sizeof rec->phys - 1), rec->phys) == -1) {
+		*rec->phys = 0;
+		errno = 0;
+	}
+
+	status = TRUE;
+
+EXIT:
+	return status;
+}
+
+/**
+ * Classify an evdev device, using the probe cache if possible
+ *
+ * @param fd File descriptor of the evdev device node
+ * @param name Name of the device
+ * @return One of EVDEV_TOUCH, EVDEV_INPUT, ...
+ */
+static evdev_type_t evdev_cache_get_type(int fd, const char *name)
+{
+	evdev_cache_entry_t *entry = NULL;
+	evdev_cache_record_t rec;
+	evdev_type_t type;
+	gchar *key = NULL;
+
+	if (!evdev_cache || !evdev_cache_identify(&rec, fd, name)) {
+		type = get_evdev_type(fd);
+		goto EXIT;
+	}
+
+	key = evdev_cache_key(&rec);
+
+	if ((entry = g_hash_table_lookup(evdev_cache, key)) != NULL) {
+		evdev_cache_hits++;
+		if (!entry->seen)
+			evdev_cache_dirty = TRUE;
+		entry->seen = TRUE;
+		type = entry->rec.type;
+		goto EXIT;
+	}
+
+	evdev_cache_misses++;
+	type = get_evdev_type(fd);
+
+	rec.type = type;
+	evdev_cache_insert(&rec, TRUE);
+	evdev_cache_dirty = TRUE;
+
+EXIT:
+	g_free(key);
+
+	return type;
+}
+
+/**
+ * Load the evdev probe cache from the file system
+ */
+static void evdev_cache_load(void)
+{
+	const evdev_cache_header_t *head = NULL;
+	const evdev_cache_record_t *rec = NULL;
+	size_t size = 0;
+	void *data = NULL;
+
+	evdev_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+					    g_free, g_free);
+
+	if ((data = mce_io_load_file(EVDEV_CACHE_PATH, &size)) == NULL)
+		goto EXIT;
+
+	head = data;
+	rec = (const evdev_cache_record_t *)(head + 1);
+
+	if ((size < sizeof *head) ||
+	    memcmp(head->magic, EVDEV_CACHE_MAGIC, sizeof head->magic) ||
+	    (head->record_size != sizeof *rec) ||
+	    (size != sizeof *head + head->record_count * sizeof *rec)) {
+		mce_log(LL_NOTICE, "%s: stale or corrupted; ignored",
+			EVDEV_CACHE_PATH);
+		goto EXIT;
+	}
+
+	for (guint32 i = 0; i < head->record_count; ++i) {
+		evdev_cache_record_t tmp = rec[i];
+
+		tmp.name[sizeof tmp.name - 1] = 0;
+		tmp.phys[sizeof tmp.phys - 1] = 0;
+
+		if (tmp.type >= G_N_ELEMENTS(evdev_class))
+			continue;
+
+		evdev_cache_insert(&tmp, FALSE);
+	}
+
+	mce_log(LL_DEBUG, "%s: %u devices", EVDEV_CACHE_PATH,
+		g_hash_table_size(evdev_cache));
+
+EXIT:
+	g_free(data);
+}
+
+/**
+ * Queue the evdev probe cache to be saved if it has changed
+ *
+ * Only devices that have been present since startup are kept,
+ * so the cache does not grow with every device ever plugged in
+ */
+static void evdev_cache_save(void)
+{
+	evdev_cache_header_t *head = NULL;
+	evdev_cache_record_t *rec = NULL;
+	GHashTableIter iter;
+	gpointer value;
+	gsize size;
+	guint count = 0;
+
+	if (!evdev_cache || !evdev_cache_dirty)
+		goto EXIT;
+
+	size = sizeof *head + g_hash_table_size(evdev_cache) * sizeof *rec;
+	head = g_malloc0(size);
+	rec = (evdev_cache_record_t *)(head + 1);
+
+	g_hash_table_iter_init(&iter, evdev_cache);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		const evdev_cache_entry_t *entry = value;
+
+		if (entry->seen)
+			rec[count++] = entry->rec;
+	}
+
+	memcpy(head->magic, EVDEV_CACHE_MAGIC, sizeof head->magic);
+	head->record_size = sizeof *rec;
+	head->record_count = count;
+
+	mce_io_persist_file(EVDEV_CACHE_PATH, head,
+			    sizeof *head + count * sizeof *rec, 0644);
+
+	evdev_cache_dirty = FALSE;
+
+EXIT:
+	g_free(head);
+}
+
+/**
+ * Save and release the evdev probe cache
+ */
+static void evdev_cache_quit(void)
+{
+	evdev_cache_save();
+
+	if (evdev_cache != NULL) {
+		g_hash_table_destroy(evdev_cache);
+		evdev_cache = NULL;
+	}
+}
+
 /**
  * Enable the specified GPIO key
  * non-existing or already enabled keys are silently ignored
@@ -689,6 +1081,311 @@ static void unregister_io_monitor(gpointer io_monitor, gpointer user_data)
 	}
 }
 
+/** Maximum number of events in one assembled input frame */
+#define INPUT_FRAME_MAX			64
+
+/**
+ * Handler for one assembled input frame
+ *
+ * @param ev The events of the frame, ending in SYN_REPORT
+ *           unless the frame was too large to be held at once
+ * @param count The number of events
+ * @return FALSE to handle remaining events (if any),
+ *         TRUE to flush all remaining events
+ */
+typedef gboolean (*input_frame_cb)(struct input_event *ev, gsize count);
+
+/** Input frame assembly state for one evdev device */
+typedef struct {
+	/** Events of the frame being assembled */
+	struct input_event ev[INPUT_FRAME_MAX];
+	/** Number of events in ev */
+	gsize used;
+	/** Events are dropped until the next SYN_REPORT */
+	gboolean dropped;
+	/** Keys seen pressed; for resyncing after SYN_DROPPED */
+	evdevbits_t *keys;
+	/** Switches seen active; for resyncing after SYN_DROPPED */
+	evdevbits_t *switches;
+} input_frame_t;
+
+/** Input frame assembly state for each evdev I/O monitor */
+static GHashTable *input_frames = NULL;
+
+/**
+ * Delete input frame assembly state
+ *
+ * @param data input_frame_t object, or NULL
+ */
+static void input_frame_delete(gpointer data)
+{
+	input_frame_t *self = data;
+
+	if (self != NULL) {
+		evdevbits_delete(self->keys);
+		evdevbits_delete(self->switches);
+		g_free(self);
+	}
+}
+
+/**
+ * Get input frame assembly state for an I/O monitor
+ *
+ * @param io_monitor The I/O monitor
+ * @return input_frame_t object
+ */
+static input_frame_t *input_frame_get(gconstpointer io_monitor)
+{
+	input_frame_t *self = NULL;
+
+	if (input_frames == NULL) {
+		input_frames = g_hash_table_new_full(g_direct_hash,
+						     g_direct_equal,
+						     NULL,
+						     input_frame_delete);
+	}
+
+	self = g_hash_table_lookup(input_frames, io_monitor);
+
+	if (self == NULL) {
+		self = g_malloc0(sizeof *self);
+		self->keys = evdevbits_create(EV_KEY);
+		self->switches = evdevbits_create(EV_SW);
+		g_hash_table_insert(input_frames, (gpointer)io_monitor, self);
+	}
+
+	return self;
+}
+
+/**
+ * Forget input frame assembly state of an I/O monitor
+ *
+ * @param io_monitor The I/O monitor
+ */
+static void input_frame_forget(gconstpointer io_monitor)
+{
+	if (input_frames != NULL)
+		g_hash_table_remove(input_frames, io_monitor);
+}
+
+/**
+ * Pass the assembled input frame to a handler
+ *
+ * @param self input_frame_t object
+ * @param cb The frame handler
+ * @return TRUE if the handler wants the remaining events flushed
+ */
+static gboolean input_frame_deliver(input_frame_t *self, input_frame_cb cb)
+{
+	gboolean flush = FALSE;
+
+	if (self->used == 0)
+		goto EXIT;
+
+	/* Track key and switch state before the handler
+	 * gets a chance to rewrite the events */
+	for (gsize i = 0; i < self->used; ++i) {
+		const struct input_event *ev = self->ev + i;
+		evdevbits_t *bits = NULL;
+
+		if (ev->type == EV_KEY && ev->value != 2)
+			bits = self->keys;
+		else if (ev->type == EV_SW)
+			bits = self->switches;
+		else
+			continue;
+
+		if (ev->value)
+			evdevbits_set(bits, ev->code);
+		else
+			evdevbits_unset(bits, ev->code);
+	}
+
+	flush = cb(self->ev, self->used);
+
+	self->used = 0;
+
+EXIT:
+	return flush;
+}
+
+/**
+ * Synthesize events for state changes lost with dropped events
+ *
+ * @param self input_frame_t object
+ * @param type EV_KEY or EV_SW
+ * @param seen The states seen in the events handled so far
+ * @param fd File descriptor of the evdev device node
+ * @param stamp Time stamp for the synthesized events
+ * @param cb The frame handler
+ * @return TRUE if the handler wants the remaining events flushed
+ */
+static gboolean input_frame_resync_type(input_frame_t *self, int type,
+					const evdevbits_t *seen, int fd,
+					const struct timeval *stamp,
+					input_frame_cb cb)
+{
+	evdevbits_t *now = evdevbits_create(type);
+	gboolean flush = FALSE;
+	int len = EVDEVBITS_LEN(now->cnt) * sizeof *now->bit;
+	int rc;
+
+	if (type == EV_KEY)
+		rc = ioctl(fd, EVIOCGKEY(len), now->bit);
+	else
+		rc = ioctl(fd, EVIOCGSW(len), now->bit);
+
+	if (rc == -1) {
+		mce_log(LL_WARN, "%s state query failed: %m",
+			evdev_get_event_type_name(type));
+		errno = 0;
+		goto EXIT;
+	}
+
+	for (int code = 0; code < now->cnt && !flush; ++code) {
+		int value = evdevbits_test(now, code);
+
+		if (value == evdevbits_test(seen, code))
+			continue;
+
+		mce_log(LL_DEBUG, "resync %s: %d",
+			evdev_get_event_code_name(type, code), value);
+
+		/* Leave room for the terminating SYN_REPORT */
+		if (self->used == INPUT_FRAME_MAX - 1)
+			flush = input_frame_deliver(self, cb);
+
+		self->ev[self->used].time = *stamp;
+		self->ev[self->used].type = type;
+		self->ev[self->used].code = code;
+		self->ev[self->used].value = value;
+		self->used++;
+	}
+
+EXIT:
+	evdevbits_delete(now);
+
+	return flush;
+}
+
+/**
+ * Resync key and switch state after the kernel dropped events
+ *
+ * @param self input_frame_t object
+ * @param fd File descriptor of the evdev device node
+ * @param stamp Time stamp for the synthesized events
+ * @param cb The frame handler
+ * @return TRUE if the handler wants the remaining events flushed
+ */
+static gboolean input_frame_resync(input_frame_t *self, int fd,
+				   const struct timeval *stamp,
+				   input_frame_cb cb)
+{
+	gboolean flush = FALSE;
+
+	self->used = 0;
+
+	if (fd == -1)
+		goto EXIT;
+
+	flush = input_frame_resync_type(self, EV_KEY, self->keys,
+					fd, stamp, cb);
+
+	if (!flush) {
+		flush = input_frame_resync_type(self, EV_SW, self->switches,
+						fd, stamp, cb);
+	}
+
+	if (!flush && self->used > 0) {
+		self->ev[self->used].time = *stamp;
+		self->ev[self->used].type = EV_SYN;
+		self->ev[self->used].code = SYN_REPORT;
+		self->ev[self->used].value = 0;
+		self->used++;
+
+		flush = input_frame_deliver(self, cb);
+	}
+
+EXIT:
+	self->used = 0;
+
+	return flush;
+}
+
+/**
+ * Assemble evdev events read by an I/O monitor into frames
+ *
+ * Events are collected up to SYN_REPORT and then passed to
+ * the handler as one frame; frames split between reads are
+ * completed on the next read. After SYN_DROPPED, events are
+ * discarded up to the next SYN_REPORT and the key and switch
+ * state is resynced from the kernel instead.
+ *
+ * @param io_monitor The I/O monitor that read the events
+ * @param data The events read
+ * @param chunk_size The size of one event
+ * @param chunks The number of events read
+ * @param cb The frame handler
+ * @return FALSE to return remaining chunks (if any),
+ *         TRUE to flush all remaining chunks
+ */
+static gboolean input_frame_feed(gconstpointer io_monitor, gpointer data,
+				 gsize chunk_size, gsize chunks,
+				 input_frame_cb cb)
+{
+	struct input_event *ev = data;
+	input_frame_t *self = NULL;
+	gboolean flush = FALSE;
+
+	/* Don't process invalid reads */
+	if ((chunk_size != sizeof (*ev)) || (io_monitor == NULL)) {
+		goto EXIT;
+	}
+
+	self = input_frame_get(io_monitor);
+
+	for (gsize i = 0; i < chunks && !flush; ++i) {
+		gboolean report = ((ev[i].type == EV_SYN) &&
+				   (ev[i].code == SYN_REPORT));
+
+		if ((ev[i].type == EV_SYN) && (ev[i].code == SYN_DROPPED)) {
+			mce_log(LL_NOTICE, "%s: input events dropped",
+				mce_get_io_monitor_name(io_monitor));
+			self->used = 0;
+			self->dropped = TRUE;
+			continue;
+		}
+
+		if (self->dropped) {
+			if (report) {
+				self->dropped = FALSE;
+				flush = input_frame_resync(self,
+							   mce_get_io_monitor_fd(io_monitor),
+							   &ev[i].time, cb);
+			}
+			continue;
+		}
+
+		/* Pass oversized frames on in pieces */
+		if (self->used == INPUT_FRAME_MAX) {
+			if ((flush = input_frame_deliver(self, cb)))
+				break;
+		}
+
+		self->ev[self->used++] = ev[i];
+
+		if (report)
+			flush = input_frame_deliver(self, cb);
+	}
+
+	/* The rest of the frame is flushed too */
+	if (flush)
+		self->used = 0;
+
+EXIT:
+	return flush;
+}
+
 /**
  * Timeout function for touchscreen I/O monitor reprogramming
  *
@@ -734,11 +1431,124 @@ static void setup_touchscreen_io_monitor_timeout(void)
 				      touchscreen_io_monitor_timeout_cb, NULL);
 }
 
+/**
+ * Check whether a finger is resting on a touchscreen device
+ *
+ * Both single touch BTN_TOUCH and type B multitouch slots are
+ * queried, since releasing one of several contacts does not tell
+ * whether the others are still down
+ *
+ * @param io_monitor The I/O monitor of the touchscreen device
+ * @return TRUE if there is at least one contact, FALSE otherwise
+ */
+static gboolean touchscreen_contact_held(gconstpointer io_monitor)
+{
+	gboolean held = FALSE;
+	int fd = mce_get_io_monitor_fd(io_monitor);
+	unsigned long keys[KEY_CNT / bitsize_of(unsigned long) + 1];
+	struct input_absinfo info;
+	gint32 *slots = NULL;
+	int count;
+
+	if (fd == -1)
+		goto EXIT;
+
+	memset(keys, 0, sizeof keys);
+
+	if (ioctl(fd, EVIOCGKEY(sizeof keys), keys) != -1 &&
+	    test_bit(BTN_TOUCH, keys)) {
+		held = TRUE;
+		goto EXIT;
+	}
+
+	if (ioctl(fd, EVIOCGABS(ABS_MT_SLOT), &info) == -1)
+		goto EXIT;
+
+	if ((count = info.maximum - info.minimum + 1) <= 0)
+		goto EXIT;
+
+	/* Code followed by the tracking id of each slot */
+	slots = g_malloc0((count + 1) * sizeof *slots);
+	slots[0] = ABS_MT_TRACKING_ID;
+
+	if (ioctl(fd, EVIOCGMTSLOTS((count + 1) * sizeof *slots), slots) == -1)
+		goto EXIT;
+
+	for (int i = 1; i <= count && !held; ++i)
+		held = (slots[i] != -1);
+
+EXIT:
+	g_free(slots);
+
+	return held;
+}
+
+/**
+ * Timeout function for activity while a finger rests on the touchscreen
+ *
+ * @param data Unused
+ * @return TRUE while a finger is down, FALSE to stop the timeout
+ */
+static gboolean touchscreen_hold_timeout_cb(gpointer data)
+{
+	gboolean held = FALSE;
+
+	(void)data;
+
+	/* Multitouch releases are per contact; stop once
+	 * the last finger has been lifted */
+	for (GSList *item = touchscreen_dev_list; item; item = item->next) {
+		if ((held = touchscreen_contact_held(item->data)))
+			break;
+	}
+
+	if (!held) {
+		touchscreen_hold_timeout_cb_id = 0;
+		goto EXIT;
+	}
+
+	/* Motion events are filtered out by the kernel;
+	 * a finger kept on the screen is still activity */
+	execute_datapipe_deferred(&device_inactive_pipe,
+				  GINT_TO_POINTER(FALSE),
+				  USE_INDATA, CACHE_INDATA);
+
+EXIT:
+	return held;
+}
+
+/**
+ * Cancel timeout for held finger activity
+ */
+static void cancel_touchscreen_hold_timeout(void)
+{
+	if (touchscreen_hold_timeout_cb_id != 0) {
+		g_source_remove(touchscreen_hold_timeout_cb_id);
+		touchscreen_hold_timeout_cb_id = 0;
+	}
+}
+
+/**
+ * Setup timeout for held finger activity
+ */
+static void setup_touchscreen_hold_timeout(void)
+{
+	if (touchscreen_hold_timeout_cb_id == 0) {
+		touchscreen_hold_timeout_cb_id =
+			g_timeout_add_seconds(MONITORING_DELAY,
+					      touchscreen_hold_timeout_cb,
+					      NULL);
+	}
+}
+
 #ifdef ENABLE_DOUBLETAP_EMULATION
 
 /** Fake doubletap policy */
 static gboolean fake_doubletap_enabled = FALSE;
 
+/** Were touchscreen frames fed to the gesture recognizer last time? */
+static gboolean gesture_recognizing = FALSE;
+
 /** GConf callback ID for fake doubletap policy changes */
 static guint fake_doubletap_id = 0;
 
@@ -765,220 +1575,223 @@ static void fake_doubletap_cb(GConfClient *const client, const guint id,
 		mce_log(LL_NOTICE, "use fake doubletap change: %d -> %d",
 			fake_doubletap_enabled, enabled);
 		fake_doubletap_enabled = enabled;
+		touchscreen_update_masks(FALSE);
 	}
 }
 
-/** Maximum time betweem 1st click and 2nd release, in milliseconds */
-# define DOUBLETAP_TIME_LIMIT 500
-
-/** Maximum distance between 1st and 2nd clicks, in pixels */
-# define DOUBLETAP_DISTANCE_LIMIT 100
+#endif /* ENABLE_DOUBLETAP_EMULATION */
 
-/** History data for emulating double tap */
-typedef struct
-{
-	struct timeval time;
-	int x,y;
-	int click;
-} doubletap_t;
+/** Event filtering modes for touchscreen devices */
+typedef enum {
+	/** No mask has been applied yet */
+	TS_MASK_UNSET,
+	/** Touch events are used only as user activity hints */
+	TS_MASK_ACTIVITY,
+	/** Touch and gesture events are fed to the touchscreen pipe */
+	TS_MASK_GESTURE,
+	/** All events are needed; double tap emulation is active */
+	TS_MASK_ALL,
+} ts_mask_t;
+
+/** Event type and code pair */
+typedef struct {
+	int type;		/**< evdev event type */
+	int code;		/**< evdev event code */
+} evdev_code_t;
+
+/** Event types that are filtered on touchscreen devices */
+static const int touchscreen_mask_types[] = {
+	EV_KEY,
+	EV_REL,
+	EV_ABS,
+	EV_MSC,
+	-1
+};
 
-/** Check if two double tap history points are close enough in time
- *
- * @param e1 event data from the 1st click
- * @param e2 event data from the 2nd release
- *
- * @return TRUE if e1 and e2 times are valid and close enough,
- *         or FALSE otherwise
- */
-static int doubletap_time_p(const doubletap_t *e1, const doubletap_t *e2)
-{
-	static const struct timeval limit =
-	{
-		.tv_sec  = (DOUBLETAP_TIME_LIMIT / 1000),
-		.tv_usec = (DOUBLETAP_TIME_LIMIT % 1000) * 1000,
-	};
+/** Codes passed through while touch is only an activity hint;
+ *  contact start and end, but no motion */
+static const evdev_code_t touchscreen_activity_codes[] = {
+	{ EV_KEY, BTN_TOUCH },
+	{ EV_ABS, ABS_MT_TRACKING_ID },
+	{ EV_MSC, MSC_GESTURE },
+	{ -1, -1 }
+};
 
-	struct timeval delta;
+/** Codes passed through while touch events go to the touchscreen pipe */
+static const evdev_code_t touchscreen_gesture_codes[] = {
+	{ EV_KEY, BTN_TOUCH },
+	{ EV_ABS, ABS_PRESSURE },
+	{ EV_ABS, ABS_MT_TRACKING_ID },
+	{ EV_MSC, MSC_GESTURE },
+	{ -1, -1 }
+};
 
-	/* Reject empty/reset slots */
-	if( !timerisset(&e1->time) || !timerisset(&e2->time) )
-		return 0;
+/** Currently applied touchscreen event filtering mode */
+static ts_mask_t touchscreen_mask = TS_MASK_UNSET;
 
-	timersub(&e2->time, &e1->time, &delta);
-	return timercmp(&delta, &limit, <);
-}
+/** All touchscreen devices are filtered by the kernel */
+static gboolean touchscreen_masked = FALSE;
 
-/** Check if two double tap history points are close enough in pixels
- *
- * @param e1 event data from the 1st click
- * @param e2 event data from the 2nd click
+/**
+ * Check if touchscreen events are needed only as activity hints
  *
- * @return TRUE if e1 and e2 positions are close enough, or FALSE otherwise
+ * @param display_state The display state
+ * @param submode The submode
+ * @return TRUE if the display is on/dim and visual tklock is active
+ *         or autorelock isn't active, FALSE otherwise
  */
-static int doubletap_dist_p(const doubletap_t *e1, const doubletap_t *e2)
+static gboolean touchscreen_activity_only(display_state_t display_state,
+					  submode_t submode)
 {
-	int x = e2->x - e1->x;
-	int y = e2->y - e1->y;
-	int r = DOUBLETAP_DISTANCE_LIMIT;
-
-	return (x*x + y*y) < (r*r);
+	return (((display_state == MCE_DISPLAY_ON) ||
+		 (display_state == MCE_DISPLAY_DIM)) &&
+		(((submode & MCE_VISUAL_TKLOCK_SUBMODE) != 0) ||
+		 ((submode & MCE_AUTORELOCK_SUBMODE) == 0)));
 }
 
-/** Process mouse input events to simulate double tap
- *
- * Maintain a crude state machine, that will detect double clicks
- * made with mouse when fed with evdev events from a mouse device.
- *
- * @param eve input event
+/**
+ * Select touchscreen event filtering mode
  *
- * @return TRUE if double tap sequence was detected, FALSE otherwise
+ * @param display_state The display state
+ * @param submode The submode
+ * @return Filtering mode matching what the event handler consumes
  */
-static int doubletap_emulate(const struct input_event *eve)
+static ts_mask_t touchscreen_select_mask(display_state_t display_state,
+					 submode_t submode)
 {
-	static doubletap_t hist[4]; // click/release ring buffer
-
-	static unsigned i0       = 0; // current position
-	static int      x_accum  = 0; // x delta accumulator
-	static int      y_accum  = 0; // y delta accumulator
-	static int      skip_syn = FALSE; // flag: skip SYN_REPORTS
+	ts_mask_t mask = TS_MASK_GESTURE;
 
-	int result = FALSE; // assume: no doubletap
-
-	unsigned i1, i2, i3; // 3 last positions
+	if (touchscreen_activity_only(display_state, submode)) {
+		mask = TS_MASK_ACTIVITY;
+		goto EXIT;
+	}
 
-	switch( eve->type ) {
-	case EV_REL:
-		/* Ignore EV_SYN unless we see EV_KEY too */
-		skip_syn = TRUE;
-		/* Accumulate X/Y position */
-		switch( eve->code ) {
-		case REL_X: x_accum += eve->value; break;
-		case REL_Y: y_accum += eve->value; break;
-		default: break;
+#ifdef ENABLE_DOUBLETAP_EMULATION
+	if (fake_doubletap_enabled) {
+		switch (display_state) {
+		case MCE_DISPLAY_OFF:
+		case MCE_DISPLAY_LPM_OFF:
+		case MCE_DISPLAY_LPM_ON:
+			mask = TS_MASK_ALL;
+			break;
+		default:
+			break;
 		}
-		break;
+	}
+#endif
 
-	case EV_KEY:
-		/* Store click/release and position */
-		skip_syn = FALSE;
-		if( eve->code == BTN_MOUSE ) {
-			hist[i0].click += eve->value;
-			hist[i0].x = x_accum;
-			hist[i0].y = y_accum;
-		}
-		break;
+EXIT:
+	return mask;
+}
 
-	case EV_ABS:
-		/* Do multitouch too while at it */
-		skip_syn = FALSE;
-		switch( eve->code ) {
-		case ABS_MT_TOUCH_MAJOR: hist[i0].click += 1; break;
-		case ABS_MT_POSITION_X:  hist[i0].x = eve->value; break;
-		case ABS_MT_POSITION_Y:  hist[i0].y = eve->value; break;
-		default: break;
-		}
-		break;
+/**
+ * Apply event filtering mode to a touchscreen device
+ *
+ * @param io_monitor The I/O monitor of the touchscreen device
+ * @param mask The filtering mode
+ * @return TRUE if all event types were filtered, FALSE otherwise
+ */
+static gboolean touchscreen_apply_mask(gconstpointer io_monitor,
+				       ts_mask_t mask)
+{
+	const evdev_code_t *codes = touchscreen_gesture_codes;
+	int fd = mce_get_io_monitor_fd(io_monitor);
+	gboolean status = TRUE;
 
-	case EV_SYN:
-		if( eve->code != SYN_REPORT )
-			break;
+	if (mask == TS_MASK_ACTIVITY)
+		codes = touchscreen_activity_codes;
 
-		/* Have we seen button events? */
-		if( skip_syn ) {
-			skip_syn = FALSE;
-			break;
-		}
-		/* Set timestamp from syn event */
-		hist[i0].time = eve->time;
-
-		/* Last event before current */
-		i1 = (i0 + 3) & 3;
-
-		if( hist[i1].click != hist[i0].click ) {
-			/* 2nd and 3rd last events before current */
-			i2 = (i0 + 2) & 3;
-			i3 = (i0 + 1) & 3;
-
-			/* Release after click after release after click,
-			 * within the time and distance limits */
-			if( hist[i0].click == 0 && hist[i1].click == 1 &&
-			    hist[i2].click == 0 && hist[i3].click == 1 &&
-			    doubletap_time_p(&hist[i3], &hist[i0]) &&
-			    doubletap_dist_p(&hist[i3], &hist[i1]) ) {
-				/* Reached DOUBLETAP state */
-				result = TRUE;
-
-				/* Reset history, so that triple click
-				 * will not produce 2 double taps etc */
-				memset(hist, 0, sizeof hist);
-				x_accum = y_accum = 0;
-			}
+	for (size_t i = 0; touchscreen_mask_types[i] != -1; ++i) {
+		int type = touchscreen_mask_types[i];
+		evdevbits_t *bits = evdevbits_create(type);
 
-			/* Move to the next slot */
-			i0 = (i0 + 1) & 3;
+		if (mask == TS_MASK_ALL) {
+			evdevbits_fill(bits);
+		} else {
+			for (size_t k = 0; codes[k].type != -1; ++k) {
+				if (codes[k].type == type)
+					evdevbits_set(bits, codes[k].code);
+			}
 		}
 
-		/* Reset the current position in the ring buffer */
-		memset(&hist[i0], 0, sizeof *hist);
-		break;
+		if (evdev_set_mask(fd, type, bits) == -1)
+			status = FALSE;
 
-	default:
-		/* Unexpected events -> nothing to do at EV_SYN */
-		skip_syn = TRUE;
-		break;
+		evdevbits_delete(bits);
+
+		if (status == FALSE)
+			break;
 	}
 
-	return result;
+	return status;
 }
 
-#endif /* ENABLE_DOUBLETAP_EMULATION */
-
 /**
- * I/O monitor callback for the touchscreen
+ * Update kernel side event filtering of touchscreen devices
  *
- * @param data The new data
- * @param bytes_read The number of bytes read
- * @return FALSE to return remaining chunks (if any),
- *         TRUE to flush all remaining chunks
+ * When all touchscreen devices can be filtered, the motion events
+ * that are used only as activity hints never reach mce and the
+ * I/O monitors do not need to be suspended
+ *
+ * @param force TRUE to reapply the mask even if the mode is unchanged
  */
-static gboolean touchscreen_iomon_cb(gpointer data, gsize bytes_read)
+static void touchscreen_update_masks(gboolean force)
 {
 	display_state_t display_state = datapipe_get_gint(display_state_pipe);
 	submode_t submode = mce_get_submode_int32();
-	struct input_event *ev;
-	gboolean flush = FALSE;
+	ts_mask_t mask = touchscreen_select_mask(display_state, submode);
 
-	ev = data;
+	if (mask != TS_MASK_ACTIVITY)
+		cancel_touchscreen_hold_timeout();
 
-	/* Don't process invalid reads */
-	if (bytes_read != sizeof (*ev)) {
+	if (!force && mask == touchscreen_mask)
 		goto EXIT;
+
+	mce_log(LL_DEBUG, "touchscreen mask: %d -> %d",
+		touchscreen_mask, mask);
+
+	touchscreen_mask = mask;
+	touchscreen_masked = (touchscreen_dev_list != NULL);
+
+	for (GSList *item = touchscreen_dev_list; item; item = item->next) {
+		if (!touchscreen_apply_mask(item->data, mask))
+			touchscreen_masked = FALSE;
 	}
 
+	/* Undo suspend done before the kernel filtering took over */
+	if (touchscreen_masked &&
+	    touchscreen_io_monitor_timeout_cb_id != 0) {
+		cancel_touchscreen_io_monitor_timeout();
+		g_slist_foreach(touchscreen_dev_list,
+				(GFunc)resume_io_monitor, NULL);
+	}
+
+EXIT:
+	return;
+}
+
+/**
+ * Handle one touchscreen event
+ *
+ * @param ev The event
+ * @param display_state The display state; updated if it
+ *                      might have changed while handling the event
+ * @param submode The submode; updated if it
+ *                might have changed while handling the event
+ * @return FALSE to handle remaining events (if any),
+ *         TRUE to flush all remaining events
+ */
+static gboolean touchscreen_handle_event(struct input_event *ev,
+					 display_state_t *display_state,
+					 submode_t *submode)
+{
+	gboolean flush = FALSE;
+
 	mce_log(LL_DEBUG, "type: %s, code: %s, value: %d",
 		evdev_get_event_type_name(ev->type),
 		evdev_get_event_code_name(ev->type, ev->code),
 		ev->value);
 
-#ifdef ENABLE_DOUBLETAP_EMULATION
-	if( fake_doubletap_enabled ) {
-		switch( datapipe_get_gint(display_state_pipe) ) {
-		case MCE_DISPLAY_OFF:
-		case MCE_DISPLAY_LPM_OFF:
-		case MCE_DISPLAY_LPM_ON:
-			if( doubletap_emulate(ev) ) {
-				mce_log(LL_NOTICE, "EMULATING DOUBLETAP");
-				ev->type  = EV_MSC;
-				ev->code  = MSC_GESTURE;
-				ev->value = 0x4;
-			}
-			break;
-		default:
-			break;
-		}
-	}
-#endif
-
 	/* Ignore unwanted events */
 	if ((ev->type != EV_ABS) &&
 	    (ev->type != EV_KEY) &&
@@ -986,26 +1799,47 @@ static gboolean touchscreen_iomon_cb(gpointer data, gsize bytes_read)
 		goto EXIT;
 	}
 
-	/* Generate activity */
-	(void)execute_datapipe(&device_inactive_pipe, GINT_TO_POINTER(FALSE),
-			       USE_INDATA, CACHE_INDATA);
+	/* Generate activity; touch streams and noisy input
+	 * devices produce lots of events, so coalesce them */
+	execute_datapipe_deferred(&device_inactive_pipe,
+				  GINT_TO_POINTER(FALSE),
+				  USE_INDATA, CACHE_INDATA);
+
+	/* Stop held finger activity on release */
+	if ((ev->type == EV_KEY) && (ev->code == BTN_TOUCH) &&
+	    (ev->value == 0)) {
+		cancel_touchscreen_hold_timeout();
+	}
 
 	/* If the display is on/dim and visual tklock is active
-	 * or autorelock isn't active, suspend I/O monitors
+	 * or autorelock isn't active, the events are just activity
 	 */
-	if (((display_state == MCE_DISPLAY_ON) ||
-	     (display_state == MCE_DISPLAY_DIM)) &&
-	    (((submode & MCE_VISUAL_TKLOCK_SUBMODE) != 0) ||
-	     ((submode & MCE_AUTORELOCK_SUBMODE) == 0))) {
-		if (touchscreen_dev_list != NULL) {
-			g_slist_foreach(touchscreen_dev_list,
-					(GFunc)suspend_io_monitor, NULL);
-		}
+	if (touchscreen_activity_only(*display_state, *submode)) {
+		if (touchscreen_masked) {
+			/* Motion is filtered out by the kernel;
+			 * repeat activity while the finger is down */
+			if ((ev->type == EV_KEY) && (ev->code == BTN_TOUCH) &&
+			    (ev->value != 0)) {
+				setup_touchscreen_hold_timeout();
+			} else if ((ev->type == EV_ABS) &&
+				   (ev->code == ABS_MT_TRACKING_ID) &&
+				   (ev->value != -1)) {
+				/* New type B multitouch contact */
+				setup_touchscreen_hold_timeout();
+			}
+		} else {
+			/* Suspend I/O monitors */
+			if (touchscreen_dev_list != NULL) {
+				g_slist_foreach(touchscreen_dev_list,
+						(GFunc)suspend_io_monitor,
+						NULL);
+			}
 
-		/* Setup a timeout I/O monitor reprogramming */
-		setup_touchscreen_io_monitor_timeout();
+			/* Setup a timeout I/O monitor reprogramming */
+			setup_touchscreen_io_monitor_timeout();
 
-		flush = TRUE;
+			flush = TRUE;
+		}
 	}
 
 	/* Only send pressure and gesture events */
@@ -1015,10 +1849,11 @@ static gboolean touchscreen_iomon_cb(gpointer data, gsize bytes_read)
 		goto EXIT;
 	}
 
-	/* If we get a double tap gesture, flush the remaining data */
+	/* If we get a wakeup gesture, flush the remaining data */
 	if ((ev->type == EV_MSC) &&
 	    (ev->code == MSC_GESTURE) &&
-	    (ev->value == 0x4)) {
+	    ((ev->value == GESTURE_DOUBLETAP) ||
+	     (ev->value == GESTURE_SWIPE))) {
 		flush = TRUE;
 	}
 
@@ -1026,15 +1861,108 @@ static gboolean touchscreen_iomon_cb(gpointer data, gsize bytes_read)
 	 *
 	 * If the event eater is active, don't send anything
 	 */
-	if ((submode & MCE_EVEATER_SUBMODE) == 0) {
-		(void)execute_datapipe(&touchscreen_pipe, &ev,
+	if ((*submode & MCE_EVEATER_SUBMODE) == 0) {
+		(void)execute_datapipe(&touchscreen_pipe, ev,
 				       USE_INDATA, DONT_CACHE_INDATA);
+
+		/* The touchscreen pipe consumers may change the state */
+		*display_state = datapipe_get_gint(display_state_pipe);
+		*submode = mce_get_submode_int32();
 	}
 
 EXIT:
 	return flush;
 }
 
+/**
+ * Handle one touchscreen input frame
+ *
+ * @param ev The events of the frame
+ * @param count The number of events
+ * @return FALSE to handle remaining events (if any),
+ *         TRUE to flush all remaining events
+ */
+static gboolean touchscreen_handle_frame(struct input_event *ev, gsize count)
+{
+	display_state_t display_state = datapipe_get_gint(display_state_pipe);
+	submode_t submode = mce_get_submode_int32();
+	gboolean flush = FALSE;
+
+#ifdef ENABLE_DOUBLETAP_EMULATION
+	gboolean recognize = FALSE;
+	int gesture = -1;
+
+	if (fake_doubletap_enabled) {
+		switch (display_state) {
+		case MCE_DISPLAY_OFF:
+		case MCE_DISPLAY_LPM_OFF:
+		case MCE_DISPLAY_LPM_ON:
+			recognize = TRUE;
+			break;
+		default:
+			break;
+		}
+	}
+
+	/* Contacts seen while not recognizing are stale by now */
+	if (recognize && !gesture_recognizing)
+		gesture_reset();
+
+	gesture_recognizing = recognize;
+
+	if (recognize)
+		gesture = gesture_process_frame(ev, count);
+#endif
+
+	for (gsize i = 0; i < count && !flush; ++i)
+		flush = touchscreen_handle_event(ev + i, &display_state,
+						 &submode);
+
+#ifdef ENABLE_DOUBLETAP_EMULATION
+	/* Report the emulated gesture after the frame it completed */
+	if (gesture != -1 && !flush) {
+		struct input_event eve = {
+			.time  = ev[count - 1].time,
+			.type  = EV_MSC,
+			.code  = MSC_GESTURE,
+			.value = gesture,
+		};
+
+		mce_log(LL_NOTICE, "EMULATING GESTURE 0x%x", gesture);
+
+		/* Gestures are only recognized with the display off;
+		 * trace the ones that turn it on */
+		if ((gesture == GESTURE_DOUBLETAP) ||
+		    (gesture == GESTURE_SWIPE)) {
+			mce_latency_begin(&eve.time);
+			mce_latency_mark(MCE_LATENCY_INPUT);
+		}
+
+		flush = touchscreen_handle_event(&eve, &display_state,
+						 &submode);
+	}
+#endif
+
+	return flush;
+}
+
+/**
+ * I/O monitor callback for the touchscreen
+ *
+ * @param io_monitor The I/O monitor that read the events
+ * @param data The events read
+ * @param chunk_size The size of one event
+ * @param chunks The number of events read
+ * @return FALSE to return remaining chunks (if any),
+ *         TRUE to flush all remaining chunks
+ */
+static gboolean touchscreen_iomon_cb(gconstpointer io_monitor, gpointer data,
+				     gsize chunk_size, gsize chunks)
+{
+	return input_frame_feed(io_monitor, data, chunk_size, chunks,
+				touchscreen_handle_frame);
+}
+
 /**
  * Timeout function for keypress repeats
  * @note Empty function; we check the callback id
@@ -1077,23 +2005,35 @@ static void setup_keypress_repeat_timeout(void)
 }
 
 /**
- * I/O monitor callback for keypresses
+ * Start a latency trace if a key press is likely to turn the display on
  *
- * @param data The new data
- * @param bytes_read The number of bytes read
- * @return Always returns FALSE to return remaining chunks (if any)
+ * @param ev The key press event
  */
-static gboolean keypress_iomon_cb(gpointer data, gsize bytes_read)
+static void keypress_trace_wakeup(const struct input_event *ev)
 {
-	submode_t submode = mce_get_submode_int32();
-	struct input_event *ev;
-
-	ev = data;
+	display_state_t display_state = datapipe_get_gint(display_state_pipe);
 
-	/* Don't process invalid reads */
-	if (bytes_read != sizeof (*ev)) {
+	if ((display_state == MCE_DISPLAY_ON) ||
+	    (display_state == MCE_DISPLAY_DIM))
 		goto EXIT;
-	}
+
+	mce_latency_begin(&ev->time);
+	mce_latency_mark(MCE_LATENCY_INPUT);
+
+EXIT:
+	return;
+}
+
+/**
+ * Handle one keypress event
+ *
+ * @param ev The event
+ * @return TRUE if the event generated activity, FALSE otherwise
+ */
+static gboolean keypress_handle_event(struct input_event *ev)
+{
+	submode_t submode = mce_get_submode_int32();
+	gboolean activity = FALSE;
 
 	mce_log(LL_DEBUG, "type: %s, code: %s, value: %d",
 		evdev_get_event_type_name(ev->type),
@@ -1130,7 +2070,10 @@ static gboolean keypress_iomon_cb(gpointer data, gsize bytes_read)
 		     ((((submode & MCE_EVEATER_SUBMODE) == 0) &&
 		       (ev->value == 1)) || (ev->value == 0))) &&
 		    ((submode & MCE_PROXIMITY_TKLOCK_SUBMODE) == 0)) {
-			(void)execute_datapipe(&keypress_pipe, &ev,
+			if ((ev->code == KEY_POWER) && (ev->value == 1))
+				keypress_trace_wakeup(ev);
+
+			(void)execute_datapipe(&keypress_pipe, ev,
 					       USE_INDATA, DONT_CACHE_INDATA);
 		}
 	}
@@ -1189,9 +2132,7 @@ static gboolean keypress_iomon_cb(gpointer data, gsize bytes_read)
 	 */
 	if ((ev->value == 0) || (ev->value == 1) ||
 	    ((ev->value == 2) && (keypress_repeat_timeout_cb_id == 0))) {
-		(void)execute_datapipe(&device_inactive_pipe,
-				       GINT_TO_POINTER(FALSE),
-				       USE_INDATA, CACHE_INDATA);
+		activity = TRUE;
 
 		if (ev->value == 2) {
 			setup_keypress_repeat_timeout();
@@ -1199,6 +2140,50 @@ static gboolean keypress_iomon_cb(gpointer data, gsize bytes_read)
 	}
 
 EXIT:
+	return activity;
+}
+
+/**
+ * Handle one keypress input frame
+ *
+ * @param ev The events of the frame
+ * @param count The number of events
+ * @return Always returns FALSE to handle remaining events (if any)
+ */
+static gboolean keypress_handle_frame(struct input_event *ev, gsize count)
+{
+	gboolean activity = FALSE;
+
+	for (gsize i = 0; i < count; ++i) {
+		if (keypress_handle_event(ev + i))
+			activity = TRUE;
+	}
+
+	/* Generate activity once per frame */
+	if (activity) {
+		(void)execute_datapipe(&device_inactive_pipe,
+				       GINT_TO_POINTER(FALSE),
+				       USE_INDATA, CACHE_INDATA);
+	}
+
+	return FALSE;
+}
+
+/**
+ * I/O monitor callback for keypresses
+ *
+ * @param io_monitor The I/O monitor that read the events
+ * @param data The events read
+ * @param chunk_size The size of one event
+ * @param chunks The number of events read
+ * @return Always returns FALSE to return remaining chunks (if any)
+ */
+static gboolean keypress_iomon_cb(gconstpointer io_monitor, gpointer data,
+				  gsize chunk_size, gsize chunks)
+{
+	(void)input_frame_feed(io_monitor, data, chunk_size, chunks,
+			       keypress_handle_frame);
+
 	return FALSE;
 }
 
@@ -1248,22 +2233,39 @@ static void setup_misc_io_monitor_timeout(void)
 }
 
 /**
- * I/O monitor callback for misc /dev/input devices
+ * Apply event filtering to a misc device
  *
- * @param data Unused
- * @param bytes_read Unused
- * @return Always returns FALSE to return remaining chunks (if any)
+ * LED, sound and force feedback events are not activity;
+ * drop them in the kernel instead of waking up for them
+ *
+ * @param io_monitor The I/O monitor of the misc device
  */
-static gboolean misc_iomon_cb(gpointer data, gsize bytes_read)
+static void misc_apply_mask(gconstpointer io_monitor)
 {
-	struct input_event *ev;
+	static const int ignored_types[] = {
+		EV_LED,
+		EV_SND,
+		EV_FF,
+		-1
+	};
 
-	ev = data;
+	int fd = mce_get_io_monitor_fd(io_monitor);
 
-	/* Don't process invalid reads */
-	if (bytes_read != sizeof (*ev)) {
-		goto EXIT;
+	for (size_t i = 0; ignored_types[i] != -1; ++i) {
+		if (evdev_set_mask(fd, ignored_types[i], NULL) == -1)
+			break;
 	}
+}
+
+/**
+ * Handle one event from misc /dev/input devices
+ *
+ * @param ev The event
+ * @return TRUE if the event generated activity, FALSE if it was ignored
+ */
+static gboolean misc_handle_event(struct input_event *ev)
+{
+	gboolean activity = FALSE;
 
 	mce_log(LL_DEBUG, "type: %s, code: %s, value: %d",
 		evdev_get_event_type_name(ev->type),
@@ -1288,9 +2290,11 @@ static gboolean misc_iomon_cb(gpointer data, gsize bytes_read)
 	/* ev->type for the jack sense is EV_SW */
 	mce_log(LL_DEBUG, "ev->type: %d", ev->type);
 
-	/* Generate activity */
-	(void)execute_datapipe(&device_inactive_pipe, GINT_TO_POINTER(FALSE),
-			       USE_INDATA, CACHE_INDATA);
+	/* Generate activity; touch streams and noisy input
+	 * devices produce lots of events, so coalesce them */
+	execute_datapipe_deferred(&device_inactive_pipe,
+				  GINT_TO_POINTER(FALSE),
+				  USE_INDATA, CACHE_INDATA);
 
 	/* Suspend I/O monitors */
 	if (misc_dev_list != NULL) {
@@ -1301,7 +2305,47 @@ static gboolean misc_iomon_cb(gpointer data, gsize bytes_read)
 	/* Setup a timeout I/O monitor reprogramming */
 	setup_misc_io_monitor_timeout();
 
+	activity = TRUE;
+
 EXIT:
+	return activity;
+}
+
+/**
+ * Handle one misc input frame
+ *
+ * @param ev The events of the frame
+ * @param count The number of events
+ * @return FALSE to handle remaining events (if any),
+ *         TRUE to flush all remaining events
+ */
+static gboolean misc_handle_frame(struct input_event *ev, gsize count)
+{
+	gboolean flush = FALSE;
+
+	/* The monitors are suspended after the first event
+	 * that generates activity; skip the rest */
+	for (gsize i = 0; i < count && !flush; ++i)
+		flush = misc_handle_event(ev + i);
+
+	return flush;
+}
+
+/**
+ * I/O monitor callback for misc /dev/input devices
+ *
+ * @param io_monitor The I/O monitor that read the events
+ * @param data The events read
+ * @param chunk_size The size of one event
+ * @param chunks The number of events read
+ * @return Always returns FALSE to return remaining chunks (if any)
+ */
+static gboolean misc_iomon_cb(gconstpointer io_monitor, gpointer data,
+			      gsize chunk_size, gsize chunks)
+{
+	(void)input_frame_feed(io_monitor, data, chunk_size, chunks,
+			       misc_handle_frame);
+
 	return FALSE;
 }
 
@@ -1397,19 +2441,46 @@ static gint iomon_name_compare(gconstpointer iomon_id,
 }
 
 /**
- * I/O monitor error callback for misc devices. Removes device
- * if suitable error condition.
+ * I/O monitor error callback for evdev devices
+ *
+ * The evdev monitors are registered with a file descriptor that has
+ * been probed, grabbed and masked here, so the I/O monitor layer can
+ * not reopen the node by itself. Instead the monitor is dropped and
+ * a rescan is scheduled; the rescan opens the node again, if it
+ * still exists, through the usual probing. Errors that keep coming
+ * back make the rescan delay grow up to DEV_INPUT_REOPEN_DELAY_MAX.
  *
  * @param iomon An I/O monitor cookie
  * @param condition I/O condition
  */
-static void misc_err_cb(gpointer iomon, GIOCondition condition)
+static void evdev_err_cb(gpointer iomon, GIOCondition condition)
 {
-	if (condition == G_IO_HUP) {
-		mce_log(LL_DEBUG, "removing monitor for misc device %s", mce_get_io_monitor_name(iomon));
-		misc_dev_list = g_slist_remove(misc_dev_list, iomon);
-		mce_unregister_io_monitor(iomon);
-	}
+	gchar *filename = NULL;
+	gint64 now = g_get_monotonic_time();
+
+	if ((condition & (G_IO_ERR | G_IO_HUP)) == 0)
+		goto EXIT;
+
+	/* Start over with a short delay after a quiet period */
+	if (now - dev_input_reopen_stamp >
+	    DEV_INPUT_REOPEN_DELAY_MAX * (gint64)1000)
+		dev_input_reopen_delay = DEV_INPUT_RESCAN_DELAY;
+	else
+		dev_input_reopen_delay = MIN(dev_input_reopen_delay * 2,
+					     DEV_INPUT_REOPEN_DELAY_MAX);
+
+	dev_input_reopen_stamp = now;
+
+	filename = g_strdup(mce_get_io_monitor_name(iomon));
+
+	mce_log(LL_NOTICE, "%s: error; reopening in %u ms",
+		filename, dev_input_reopen_delay);
+
+	update_inputdevices(filename, FALSE);
+	schedule_rescan_inputdevices(dev_input_reopen_delay);
+
+EXIT:
+	g_free(filename);
 }
 
 /**
@@ -1441,7 +2512,7 @@ static void match_and_register_io_monitor(const gchar *filename)
 	}
 
 	/* Probe how mce could use the evdev node */
-	type = get_evdev_type(fd);
+	type = evdev_cache_get_type(fd, name);
 	mce_log(LL_NOTICE, "%s: \"%s\", probe: %s", filename, name, evdev_class[type]);
 
 	/* Check if the device is blacklisted by name in the config files */
@@ -1461,32 +2532,42 @@ static void match_and_register_io_monitor(const gchar *filename)
 		break;
 
 	case EVDEV_TOUCH:
-		iomon = mce_register_io_monitor_chunk(fd, filename, MCE_IO_ERROR_POLICY_WARN,
+		iomon = mce_register_io_monitor_batch(fd, filename, MCE_IO_ERROR_POLICY_WARN,
 						      G_IO_IN | G_IO_ERR, FALSE, touchscreen_iomon_cb,
 						      sizeof (struct input_event));
-		if( iomon )
+		if( iomon ) {
+			mce_set_io_monitor_err_cb(iomon, evdev_err_cb);
 			touchscreen_dev_list = g_slist_prepend(touchscreen_dev_list, (gpointer)iomon);
+			touchscreen_update_masks(TRUE);
+		}
 		break;
 
 	case EVDEV_INPUT:
-		iomon = mce_register_io_monitor_chunk(fd, filename, MCE_IO_ERROR_POLICY_WARN,
+		iomon = mce_register_io_monitor_batch(fd, filename, MCE_IO_ERROR_POLICY_WARN,
 						      G_IO_IN | G_IO_ERR, FALSE, keypress_iomon_cb,
 						      sizeof (struct input_event));
-		if( iomon )
+		if( iomon ) {
+			mce_set_io_monitor_err_cb(iomon, evdev_err_cb);
 			keyboard_dev_list = g_slist_prepend(keyboard_dev_list, (gpointer)iomon);
+		}
 		break;
 
 	case EVDEV_ACTIVITY:
-		iomon = mce_register_io_monitor_chunk(fd, filename, MCE_IO_ERROR_POLICY_WARN,
+		iomon = mce_register_io_monitor_batch(fd, filename, MCE_IO_ERROR_POLICY_WARN,
 						      G_IO_IN | G_IO_ERR, FALSE, misc_iomon_cb,
 						      sizeof (struct input_event));
 		if( iomon ) {
-			mce_set_io_monitor_err_cb(iomon, misc_err_cb);
+			mce_set_io_monitor_err_cb(iomon, evdev_err_cb);
+			misc_apply_mask(iomon);
 			misc_dev_list = g_slist_prepend(misc_dev_list, (gpointer)iomon);
 		}
 		break;
 	}
 
+	/* Track the delay from kernel event time stamps to handling */
+	if( iomon )
+		mce_set_io_monitor_timestamped(iomon, TRUE);
+
 EXIT:
 	/* Close unmonitored file descriptors */
 	if( !iomon && fd != -1 ) {
@@ -1523,7 +2604,12 @@ static void update_inputdevices(const gchar *device, gboolean add)
 		iomon_id = list_entry->data;
 		touchscreen_dev_list = g_slist_remove(touchscreen_dev_list,
 						      iomon_id);
-		mce_unregister_io_monitor(iomon_id);
+		input_frame_forget(iomon_id);
+		unregister_io_monitor((gpointer)iomon_id, NULL);
+
+		/* The released finger might not get reported */
+		cancel_touchscreen_hold_timeout();
+		touchscreen_update_masks(TRUE);
 	}
 
 	/* Try to find a matching keyboard I/O monitor */
@@ -1537,7 +2623,8 @@ static void update_inputdevices(const gchar *device, gboolean add)
 		iomon_id = list_entry->data;
 		keyboard_dev_list = g_slist_remove(keyboard_dev_list,
 						   iomon_id);
-		mce_unregister_io_monitor(iomon_id);
+		input_frame_forget(iomon_id);
+		unregister_io_monitor((gpointer)iomon_id, NULL);
 	}
 
 	/* Try to find a matching touchscreen I/O monitor */
@@ -1551,11 +2638,30 @@ static void update_inputdevices(const gchar *device, gboolean add)
 		iomon_id = list_entry->data;
 		misc_dev_list = g_slist_remove(misc_dev_list,
 					       iomon_id);
-		mce_unregister_io_monitor(iomon_id);
+		input_frame_forget(iomon_id);
+		unregister_io_monitor((gpointer)iomon_id, NULL);
 	}
 
-	if (add == TRUE)
+	if (add == TRUE) {
 		match_and_register_io_monitor(device);
+		evdev_cache_save();
+	}
+}
+
+/**
+ * Check if an input device node is already monitored
+ *
+ * @param filename Path to the device node
+ * @return TRUE if there is an I/O monitor for the node, FALSE otherwise
+ */
+static gboolean inputdevice_is_monitored(const gchar *filename)
+{
+	return ((g_slist_find_custom(touchscreen_dev_list, filename,
+				     iomon_name_compare) != NULL) ||
+		(g_slist_find_custom(keyboard_dev_list, filename,
+				     iomon_name_compare) != NULL) ||
+		(g_slist_find_custom(misc_dev_list, filename,
+				     iomon_name_compare) != NULL));
 }
 
 /**
@@ -1569,6 +2675,11 @@ static gboolean scan_inputdevices(void)
 	DIR *dir = NULL;
 	struct dirent *direntry = NULL;
 	gboolean status = FALSE;
+	gint64 started = g_get_monotonic_time();
+
+	/* The counters describe this scan only */
+	evdev_cache_hits = 0;
+	evdev_cache_misses = 0;
 
 	if ((dir = opendir(DEV_INPUT_PATH)) == NULL) {
 		mce_log(LL_ERR, "opendir() failed; %s", g_strerror(errno));
@@ -1592,7 +2703,8 @@ static gboolean scan_inputdevices(void)
 
 		filename = g_strconcat(DEV_INPUT_PATH, "/",
 				       direntry->d_name, NULL);
-		match_and_register_io_monitor(filename);
+		if (!inputdevice_is_monitored(filename))
+			match_and_register_io_monitor(filename);
 		g_free(filename);
 	}
 
@@ -1611,6 +2723,19 @@ static gboolean scan_inputdevices(void)
 		errno = 0;
 	}
 
+	/* Devices that went away are dropped from the cache */
+	if (evdev_cache != NULL && dev_input_rescans == 0 &&
+	    g_hash_table_size(evdev_cache) != evdev_cache_hits +
+						evdev_cache_misses) {
+		evdev_cache_dirty = TRUE;
+	}
+	evdev_cache_save();
+
+	mce_log(LL_NOTICE, "input devices scanned in %" G_GINT64_FORMAT
+		" us; %u cached, %u probed",
+		g_get_monotonic_time() - started,
+		evdev_cache_hits, evdev_cache_misses);
+
 	status = TRUE;
 
 EXIT:
@@ -1642,53 +2767,129 @@ static void unregister_inputdevices(void)
 		g_slist_free(misc_dev_list);
 		misc_dev_list = NULL;
 	}
+
+	if (input_frames != NULL) {
+		g_hash_table_destroy(input_frames);
+		input_frames = NULL;
+	}
 }
 
 /**
- * Callback for directory changes
+ * Check if a monitored input device node has gone away
  *
- * @param monitor Unused
- * @param file The file that changed
- * @param other_file Unused
- * @param event_type The event that occured
- * @param user_data Unused
+ * A node that was removed and recreated with the same name
+ * within one coalescing window refers to a different device
+ *
+ * @param io_monitor The I/O monitor of the device
+ * @return TRUE if the node is gone or replaced, FALSE otherwise
  */
-static void dir_changed_cb(GFileMonitor *monitor,
-			   GFile *file, GFile *other_file,
-			   GFileMonitorEvent event_type, gpointer user_data)
+static gboolean inputdevice_is_stale(gconstpointer io_monitor)
 {
-	char *filename = g_file_get_basename(file);
-	char *filepath = g_file_get_path(file);
-
-	(void)monitor;
-	(void)other_file;
-	(void)user_data;
+	const gchar *filename = mce_get_io_monitor_name(io_monitor);
+	int fd = mce_get_io_monitor_fd(io_monitor);
+	struct stat st_node, st_open;
+	gboolean stale = TRUE;
 
-	if ((filename == NULL) || (filepath == NULL))
+	if (stat(filename, &st_node) == -1) {
+		errno = 0;
 		goto EXIT;
+	}
 
-	if (strncmp(filename,
-		    EVENT_FILE_PREFIX, strlen(EVENT_FILE_PREFIX)) != 0)
-		goto EXIT;
+	if (fd != -1 && fstat(fd, &st_open) == 0)
+		stale = (st_node.st_rdev != st_open.st_rdev);
+	else
+		stale = FALSE;
 
-	switch (event_type) {
-	case G_FILE_MONITOR_EVENT_CREATED:
-		update_inputdevices(filepath, TRUE);
-		break;
+EXIT:
+	return stale;
+}
 
-	case G_FILE_MONITOR_EVENT_DELETED:
-		update_inputdevices(filepath, FALSE);
-		break;
+/**
+ * Collect the names of stale input devices
+ *
+ * @param list List of I/O monitors
+ * @param stale List to prepend copies of the stale names to
+ * @return The updated list of stale names
+ */
+static GSList *collect_stale_inputdevices(GSList *list, GSList *stale)
+{
+	for (GSList *item = list; item != NULL; item = item->next) {
+		if (inputdevice_is_stale(item->data)) {
+			const gchar *filename =
+				mce_get_io_monitor_name(item->data);
+			stale = g_slist_prepend(stale, g_strdup(filename));
+		}
+	}
 
-	default:
-		break;
+	return stale;
+}
+
+/**
+ * Timeout callback for the coalesced input device rescan
+ *
+ * @param data Unused
+ * @return Always returns FALSE, to disable the timeout
+ */
+static gboolean rescan_inputdevices_cb(gpointer data)
+{
+	GSList *stale = NULL;
+
+	(void)data;
+
+	dev_input_rescan_id = 0;
+	dev_input_rescans++;
+
+	mce_log(LL_NOTICE, "rescan #%u of %s",
+		dev_input_rescans, DEV_INPUT_PATH);
+
+	/* Drop monitors for nodes that are gone */
+	stale = collect_stale_inputdevices(touchscreen_dev_list, stale);
+	stale = collect_stale_inputdevices(keyboard_dev_list, stale);
+	stale = collect_stale_inputdevices(misc_dev_list, stale);
+
+	for (GSList *item = stale; item != NULL; item = item->next)
+		update_inputdevices(item->data, FALSE);
+
+	g_slist_free_full(stale, g_free);
+
+	/* Add monitors for new nodes */
+	(void)scan_inputdevices();
+
+	return FALSE;
+}
+
+/**
+ * Schedule a coalesced rescan of the input devices
+ *
+ * @param delay Delay in milliseconds; ignored if a rescan
+ *              is already pending
+ */
+static void schedule_rescan_inputdevices(guint delay)
+{
+	if (dev_input_rescan_id == 0) {
+		dev_input_rescan_id =
+			g_timeout_add(delay, rescan_inputdevices_cb, NULL);
 	}
+}
 
-EXIT:
-	g_free(filepath);
-	g_free(filename);
+/**
+ * Callback for event node changes in the input device directory
+ *
+ * A burst of changes, e.g. during boot or when a dock with
+ * several input devices is attached, results in one rescan
+ *
+ * @param path Unused
+ * @param file Unused
+ * @param user_data Unused
+ */
+static void dir_changed_cb(const char *path, const char *file,
+			   gpointer user_data)
+{
+	(void)path;
+	(void)file;
+	(void)user_data;
 
-	return;
+	schedule_rescan_inputdevices(DEV_INPUT_RESCAN_DELAY);
 }
 
 /**
@@ -1717,6 +2918,33 @@ static void submode_trigger(gconstpointer data)
 	}
 
 	old_submode = submode;
+
+	/* Visual tklock and autorelock affect touchscreen filtering */
+	touchscreen_update_masks(FALSE);
+}
+
+/**
+ * Handle display state change
+ *
+ * @param data The display state stored in a pointer
+ */
+static void display_state_trigger(gconstpointer data)
+{
+	(void)data;
+
+	touchscreen_update_masks(FALSE);
+}
+
+/**
+ * Get statistics for the /dev/input event component
+ * in human readable form
+ *
+ * @return The statistics as text; free with g_free()
+ */
+gchar *mce_input_get_stats(void)
+{
+	return g_strdup_printf("%s: %u rescans\n",
+			       DEV_INPUT_PATH, dev_input_rescans);
 }
 
 /**
@@ -1726,7 +2954,6 @@ static void submode_trigger(gconstpointer data)
  */
 gboolean mce_input_init(void)
 {
-	GError *error = NULL;
 	gboolean status = FALSE;
 
 #ifdef ENABLE_DOUBLETAP_EMULATION
@@ -1742,37 +2969,34 @@ gboolean mce_input_init(void)
 	/* Append triggers/filters to datapipes */
 	append_output_trigger_to_datapipe(&submode_pipe,
 					  submode_trigger);
-
-	/* Retrieve a GFile pointer to the directory to monitor */
-	dev_input_gfp = g_file_new_for_path(DEV_INPUT_PATH);
-
-	/* Monitor the directory */
-	if ((dev_input_gfmp = g_file_monitor_directory(dev_input_gfp,
-						       G_FILE_MONITOR_NONE,
-						       NULL, &error)) == NULL) {
+	append_output_trigger_to_datapipe(&display_state_pipe,
+					  display_state_trigger);
+
+	/* Monitor the event nodes in the directory */
+	dev_input_watcher = filewatcher_create_entries(DEV_INPUT_PATH,
+						       EVENT_FILE_PREFIX "*",
+						       dir_changed_cb,
+						       NULL, NULL);
+	if (dev_input_watcher == NULL) {
 		mce_log(LL_ERR,
-			"Failed to add monitor for directory `%s'; %s",
-			DEV_INPUT_PATH, error->message);
+			"Failed to add monitor for directory `%s'",
+			DEV_INPUT_PATH);
 		goto EXIT;
 	}
 
-	/* XXX: There is a race condition here; if a file (dis)appears
-	 *      after this scan, but before we start monitoring,
-	 *      then we'll miss that device.  The race is miniscule though,
-	 *      and any workarounds are likely to be cumbersome
+	/* Nodes that (dis)appear after the watch was set up but
+	 * before or during this scan are picked up by the rescan
+	 * the watch schedules for them
 	 */
 	/* Find the initial set of input devices */
+	evdev_cache_load();
+
 	if ((status = scan_inputdevices()) == FALSE) {
-		g_file_monitor_cancel(dev_input_gfmp);
-		dev_input_gfmp = NULL;
+		filewatcher_delete(dev_input_watcher);
+		dev_input_watcher = NULL;
 		goto EXIT;
 	}
 
-	/* Connect "changed" signal for the directory monitor */
-	dev_input_handler_id =
-		g_signal_connect(G_OBJECT(dev_input_gfmp), "changed",
-				 G_CALLBACK(dir_changed_cb), NULL);
-
 	/* Get configuration options */
 	longdelay = mce_conf_get_int(MCE_CONF_HOMEKEY_GROUP,
 				     MCE_CONF_HOMEKEY_LONG_DELAY,
@@ -1780,11 +3004,10 @@ gboolean mce_input_init(void)
 
 	update_switch_states();
 
-	gpio_key_disable_exists = (g_access(GPIO_KEY_DISABLE_PATH, W_OK) == 0);
+	gpio_key_disable_exists = mce_io_cache_access(GPIO_KEY_DISABLE_PATH, W_OK);
 
 EXIT:
 	errno = 0;
-	g_clear_error(&error);
 
 	return status;
 }
@@ -1805,18 +3028,25 @@ void mce_input_exit(void)
 	/* Remove triggers/filters from datapipes */
 	remove_output_trigger_from_datapipe(&submode_pipe,
 					    submode_trigger);
+	remove_output_trigger_from_datapipe(&display_state_pipe,
+					    display_state_trigger);
+
+	if (dev_input_watcher != NULL) {
+		filewatcher_delete(dev_input_watcher);
+		dev_input_watcher = NULL;
+	}
 
-	if (dev_input_gfmp != NULL) {
-		g_signal_handler_disconnect(G_OBJECT(dev_input_gfmp),
-					    dev_input_handler_id);
-		dev_input_handler_id = 0;
-		g_file_monitor_cancel(dev_input_gfmp);
+	if (dev_input_rescan_id != 0) {
+		g_source_remove(dev_input_rescan_id);
+		dev_input_rescan_id = 0;
 	}
 
 	unregister_inputdevices();
+	evdev_cache_quit();
 
 	/* Remove all timer sources */
 	cancel_touchscreen_io_monitor_timeout();
+	cancel_touchscreen_hold_timeout();
 	cancel_keypress_repeat_timeout();
 	cancel_misc_io_monitor_timeout();
 
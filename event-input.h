@@ -31,6 +31,8 @@
 #define EVENT_FILE_PREFIX		"event"
 /** Path to the GPIO key disable interface */
 #define GPIO_KEY_DISABLE_PATH		"/sys/devices/platform/gpio-keys/disabled_keys"
+/** Path to the evdev probe cache file */
+#define EVDEV_CACHE_PATH		G_STRINGIFY(MCE_VAR_DIR) "/evdev.cache"
 
 /** Path to the GConf settings for the event input */
 #define MCE_GCONF_EVENT_INPUT_PATH	"/system/osso/dsm/event_input"
@@ -45,6 +47,18 @@
  */
 #define MONITORING_DELAY		1
 
+/**
+ * Delay for coalescing input device node changes into one rescan;
+ * 100 milliseconds
+ */
+#define DEV_INPUT_RESCAN_DELAY		100
+
+/**
+ * Longest delay for reopening input devices after repeated errors;
+ * 5 seconds
+ */
+#define DEV_INPUT_REOPEN_DELAY_MAX	5000
+
 /** Name of Homekey configuration group */
 #define MCE_CONF_HOMEKEY_GROUP		"HomeKey"
 
@@ -63,5 +77,6 @@
 /* When MCE is made modular, this will be handled differently */
 gboolean mce_input_init(void);
 void mce_input_exit(void);
+gchar *mce_input_get_stats(void);
 
 #endif /* _EVENT_INPUT_H_ */
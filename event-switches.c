@@ -19,7 +19,6 @@
  * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <glib.h>
-#include <glib/gstdio.h>		/* g_access() */
 
 #include <errno.h>			/* errno */
 #include <string.h>			/* strncmp(), strlen() */
@@ -31,7 +30,8 @@
 #include "mce-io.h"			/* mce_read_string_from_file(),
 					 * mce_write_string_to_file(),
 					 * mce_register_io_monitor_string(),
-					 * mce_unregister_io_monitor()
+					 * mce_unregister_io_monitor(),
+					 * mce_io_cache_access()
 					 */
 #include "datapipe.h"			/* execute_datapipe(),
 					 * append_input_trigger_to_datapipe(),
@@ -521,10 +521,10 @@ gboolean mce_switches_init(void)
 		has_flicker_key = TRUE;
 
 	proximity_sensor_disable_exists =
-		(g_access(MCE_PROXIMITY_SENSOR_DISABLE_PATH, W_OK) == 0);
+		mce_io_cache_access(MCE_PROXIMITY_SENSOR_DISABLE_PATH, W_OK);
 
 	cam_focus_disable_exists =
-		(g_access(MCE_CAM_FOCUS_DISABLE_PATH, W_OK) == 0);
+		mce_io_cache_access(MCE_CAM_FOCUS_DISABLE_PATH, W_OK);
 
 	errno = 0;
 
@@ -142,6 +142,9 @@ struct filewatcher_t
   /** the file in the watch_path to track */
   char *watch_file;
 
+  /** inotify events to watch for */
+  uint32_t watch_mask;
+
   /** function to call when watch_path/watch_file changes */
   filewatcher_changed_fn changed_cb;
 
@@ -164,6 +167,7 @@ filewatcher_ctor(filewatcher_t *self)
   self->inotify_wd = -1;
   self->watch_path = 0;
   self->watch_file = 0;
+  self->watch_mask = 0;
 
   self->watch_id   = 0;
 
@@ -301,7 +305,7 @@ filewatcher_process_events(filewatcher_t *self)
     inotify_event_debug(eve);
 #endif
 
-    if( eve->len && !strcmp(self->watch_file, eve->name) )
+    if( eve->len && g_pattern_match_simple(self->watch_file, eve->name) )
     {
       flg = TRUE;
     }
@@ -371,11 +375,7 @@ filewatcher_setup_inotify(filewatcher_t *self)
   gboolean success = FALSE;
 
   uint32_t mask = (0
-                   | IN_CREATE
-                   | IN_DELETE
-                   | IN_CLOSE_WRITE
-                   | IN_MOVED_TO
-                   | IN_MOVED_FROM
+                   | self->watch_mask
                    | IN_DONT_FOLLOW
                    | IN_ONLYDIR);
 
@@ -454,32 +454,25 @@ cleanup:
   return success;
 }
 
-/** Create an filewatcher_t object
- *
- * An inotify watcher is started for the given director/file.
- * A glib io watch is used to process the inotify events.
- * The change_cb is called when contents of the tracked file
- * are assumed to have changed.
- *
- * @note The change_cb function will not be called during the
- *       initialization. You can make initial state evaluation
- *       to happen by calling filewatcher_force_trigger() after
- *       succesfull filewatcher_create().
+/** Create an filewatcher_t object for given inotify events
  *
  * @param dirpath directory to watch over
  * @param filename file to watch in dirpath
+ * @param mask inotify events to watch for
  * @param change_cb function to call when dirpath/filename changes
  * @param user_data extra parameter to pass to change_cb
  * @param delete_cb called on user_data when filewatcher_t itself is deleted
  *
  * @return pointer to filewatcher_t object, or NULL in case of errors
  */
+static
 filewatcher_t *
-filewatcher_create(const char *dirpath,
-                   const char *filename,
-                   filewatcher_changed_fn change_cb,
-                   gpointer user_data,
-                   GDestroyNotify delete_cb)
+filewatcher_create_mask(const char *dirpath,
+                        const char *filename,
+                        uint32_t mask,
+                        filewatcher_changed_fn change_cb,
+                        gpointer user_data,
+                        GDestroyNotify delete_cb)
 {
   gboolean success = FALSE;
 
@@ -488,6 +481,7 @@ filewatcher_create(const char *dirpath,
 
   self->watch_path = g_strdup(dirpath);
   self->watch_file = g_strdup(filename);
+  self->watch_mask = mask;
 
   self->changed_cb = change_cb;
 
@@ -515,6 +509,78 @@ cleanup:
   return self;
 }
 
+/** Create an filewatcher_t object
+ *
+ * An inotify watcher is started for the given director/file.
+ * A glib io watch is used to process the inotify events.
+ * The change_cb is called when contents of the tracked file
+ * are assumed to have changed. The filename can contain '*' and
+ * '?' wildcards to track a set of files; all changes seen in one
+ * batch of inotify events are reported with a single call.
+ *
+ * @note The change_cb function will not be called during the
+ *       initialization. You can make initial state evaluation
+ *       to happen by calling filewatcher_force_trigger() after
+ *       succesfull filewatcher_create().
+ *
+ * @param dirpath directory to watch over
+ * @param filename file to watch in dirpath
+ * @param change_cb function to call when dirpath/filename changes
+ * @param user_data extra parameter to pass to change_cb
+ * @param delete_cb called on user_data when filewatcher_t itself is deleted
+ *
+ * @return pointer to filewatcher_t object, or NULL in case of errors
+ */
+filewatcher_t *
+filewatcher_create(const char *dirpath,
+                   const char *filename,
+                   filewatcher_changed_fn change_cb,
+                   gpointer user_data,
+                   GDestroyNotify delete_cb)
+{
+  uint32_t mask = (0
+                   | IN_CREATE
+                   | IN_DELETE
+                   | IN_CLOSE_WRITE
+                   | IN_MOVED_TO
+                   | IN_MOVED_FROM);
+
+  return filewatcher_create_mask(dirpath, filename, mask,
+                                 change_cb, user_data, delete_cb);
+}
+
+/** Create an filewatcher_t object for directory entries only
+ *
+ * Like filewatcher_create(), but change_cb is called only when
+ * matching files are created, deleted or renamed. Writes to the
+ * files are not reported, which suits watching device nodes.
+ *
+ * @param dirpath directory to watch over
+ * @param filename file to watch in dirpath
+ * @param change_cb function to call when dirpath/filename appears
+ *                  or disappears
+ * @param user_data extra parameter to pass to change_cb
+ * @param delete_cb called on user_data when filewatcher_t itself is deleted
+ *
+ * @return pointer to filewatcher_t object, or NULL in case of errors
+ */
+filewatcher_t *
+filewatcher_create_entries(const char *dirpath,
+                           const char *filename,
+                           filewatcher_changed_fn change_cb,
+                           gpointer user_data,
+                           GDestroyNotify delete_cb)
+{
+  uint32_t mask = (0
+                   | IN_CREATE
+                   | IN_DELETE
+                   | IN_MOVED_TO
+                   | IN_MOVED_FROM);
+
+  return filewatcher_create_mask(dirpath, filename, mask,
+                                 change_cb, user_data, delete_cb);
+}
+
 /** Force calling the change notification callback
  *
  * This can be useful for example to feed initial
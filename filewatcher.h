@@ -27,6 +27,12 @@ filewatcher_t *filewatcher_create(const char *dirpath,
                                   gpointer user_data,
                                   GDestroyNotify delete_cb);
 
+filewatcher_t *filewatcher_create_entries(const char *dirpath,
+                                          const char *filename,
+                                          filewatcher_changed_fn change_cb,
+                                          gpointer user_data,
+                                          GDestroyNotify delete_cb);
+
 void filewatcher_delete(filewatcher_t *self);
 
 void filewatcher_force_trigger(filewatcher_t *self);
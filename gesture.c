@@ -0,0 +1,433 @@
+/**
+ * @file gesture.c
+ * Touch gesture recognizer for the Mode Control Entity
+ * <p>
+ * Copyright © 2026 Jolla Mobile Ltd.
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <glib.h>
+
+#include <string.h>			/* memset() */
+#include <sys/time.h>			/* timersub() */
+#include <linux/input.h>		/* struct input_event,
+					 * EV_KEY, EV_REL, EV_ABS, EV_SYN,
+					 * BTN_TOUCH, BTN_MOUSE,
+					 * REL_X, REL_Y, ABS_X, ABS_Y,
+					 * ABS_MT_POSITION_X, ABS_MT_POSITION_Y,
+					 * ABS_MT_SLOT, ABS_MT_TRACKING_ID,
+					 * ABS_MT_TOUCH_MAJOR, SYN_MT_REPORT
+					 */
+
+#include "gesture.h"
+#include "mce-log.h"			/* mce_log(), LL_* */
+
+/** Maximum time betweem 1st click and 2nd release, in milliseconds */
+#define DOUBLETAP_TIME_LIMIT 500
+
+/** Maximum distance between 1st and 2nd clicks, in pixels */
+#define DOUBLETAP_DISTANCE_LIMIT 100
+
+/** Minimum distance between press and release of a swipe, in pixels */
+#define SWIPE_DISTANCE_MIN 300
+
+/** Maximum time between press and release of a swipe, in milliseconds */
+#define SWIPE_TIME_LIMIT 1000
+
+/** Minimum time between press and release of a long press,
+ *  in milliseconds */
+#define LONGPRESS_TIME_MIN 800
+
+/** Maximum time between press and release of a long press,
+ *  in milliseconds */
+#define LONGPRESS_TIME_LIMIT 5000
+
+/** Maximum number of press/release steps in a gesture */
+#define GESTURE_STEPS_MAX 4
+
+/** Number of multitouch slots tracked for contact state */
+#define GESTURE_SLOTS_MAX 32
+
+/** Contact edges that drive the gesture recognizer */
+typedef enum {
+	GESTURE_PRESS,		/**< First finger down */
+	GESTURE_RELEASE,	/**< Last finger up */
+} gesture_edge_t;
+
+/** One step of a gesture; a limit of -1 means no limit */
+typedef struct {
+	/** Contact edge that completes the step */
+	gesture_edge_t edge;
+	/** Earlier step that the distance is measured from */
+	int ref;
+	/** Minimum distance from the ref step, in pixels */
+	int min_dist;
+	/** Maximum distance from the ref step, in pixels */
+	int max_dist;
+	/** Minimum time since the first step, in milliseconds */
+	int min_ms;
+	/** Maximum time since the first step, in milliseconds */
+	int max_ms;
+} gesture_step_t;
+
+/** Gesture definition */
+typedef struct {
+	/** Name for diagnostics */
+	const char *name;
+	/** MSC_GESTURE value to report */
+	gesture_t code;
+	/** Number of steps */
+	int steps;
+	/** Steps to match in order */
+	gesture_step_t step[GESTURE_STEPS_MAX];
+} gesture_def_t;
+
+/** Gestures recognized from touch input while the display is off */
+static const gesture_def_t gesture_table[] = {
+	{
+		.name  = "doubletap",
+		.code  = GESTURE_DOUBLETAP,
+		.steps = 4,
+		.step  = {
+			{ GESTURE_PRESS,   0, -1, -1, -1, -1 },
+			{ GESTURE_RELEASE, 0, -1, -1, -1,
+			  DOUBLETAP_TIME_LIMIT },
+			{ GESTURE_PRESS,   0, -1, DOUBLETAP_DISTANCE_LIMIT, -1,
+			  DOUBLETAP_TIME_LIMIT },
+			{ GESTURE_RELEASE, 0, -1, -1, -1,
+			  DOUBLETAP_TIME_LIMIT },
+		},
+	},
+	{
+		.name  = "swipe",
+		.code  = GESTURE_SWIPE,
+		.steps = 2,
+		.step  = {
+			{ GESTURE_PRESS,   0, -1, -1, -1, -1 },
+			{ GESTURE_RELEASE, 0, SWIPE_DISTANCE_MIN, -1, -1,
+			  SWIPE_TIME_LIMIT },
+		},
+	},
+	{
+		.name  = "longpress",
+		.code  = GESTURE_LONGPRESS,
+		.steps = 2,
+		.step  = {
+			{ GESTURE_PRESS,   0, -1, -1, -1, -1 },
+			{ GESTURE_RELEASE, 0, -1, DOUBLETAP_DISTANCE_LIMIT,
+			  LONGPRESS_TIME_MIN, LONGPRESS_TIME_LIMIT },
+		},
+	},
+};
+
+/** Contact edge with time stamp and position */
+typedef struct {
+	struct timeval time;	/**< Time of the frame */
+	int x;			/**< Position of the first contact */
+	int y;			/**< Position of the first contact */
+} gesture_point_t;
+
+/** Matching state of one gesture */
+typedef struct {
+	int pos;		/**< Number of steps matched */
+	gesture_point_t hist[GESTURE_STEPS_MAX];	/**< Matched points */
+} gesture_state_t;
+
+/** Matching state of each gesture in gesture_table */
+static gesture_state_t gesture_state[G_N_ELEMENTS(gesture_table)];
+
+/** Touch contact tracking state */
+static struct {
+	int key_seen;		/**< Device reports BTN_TOUCH/BTN_MOUSE */
+	int key_down;		/**< BTN_TOUCH/BTN_MOUSE is down */
+	int mt_seen;		/**< Device reports multitouch positions */
+	int slot;		/**< Current multitouch slot */
+	guint32 slots_down;	/**< Bitmask of slots with a contact */
+	int first_slot;		/**< Slot of the first contact, or -1 */
+	int slot_x[GESTURE_SLOTS_MAX];	/**< Last known x of each slot */
+	int slot_y[GESTURE_SLOTS_MAX];	/**< Last known y of each slot */
+	int down;		/**< Contact state after the latest frame */
+	int x;			/**< Last known x of the first contact */
+	int y;			/**< Last known y of the first contact */
+} gesture_touch = {
+	.first_slot = -1,
+};
+
+/** Reset matching state of all gestures */
+static void gesture_reset_matching(void)
+{
+	memset(gesture_state, 0, sizeof gesture_state);
+}
+
+/** Check if a point satisfies the constraints of a gesture step
+ *
+ * @param def gesture definition
+ * @param state matching state of the gesture
+ * @param pt the point to check
+ *
+ * @return TRUE if the point completes the next step, FALSE otherwise
+ */
+static gboolean gesture_step_p(const gesture_def_t *def,
+			       const gesture_state_t *state,
+			       const gesture_point_t *pt)
+{
+	const gesture_step_t *step = &def->step[state->pos];
+	const gesture_point_t *ref = &state->hist[step->ref];
+	struct timeval delta;
+	int ms, dx, dy, d2;
+
+	timersub(&pt->time, &state->hist[0].time, &delta);
+	ms = delta.tv_sec * 1000 + delta.tv_usec / 1000;
+
+	if( step->min_ms >= 0 && ms < step->min_ms )
+		return FALSE;
+	if( step->max_ms >= 0 && ms >= step->max_ms )
+		return FALSE;
+
+	dx = pt->x - ref->x;
+	dy = pt->y - ref->y;
+	d2 = dx*dx + dy*dy;
+
+	if( step->min_dist >= 0 && d2 < step->min_dist * step->min_dist )
+		return FALSE;
+	if( step->max_dist >= 0 && d2 >= step->max_dist * step->max_dist )
+		return FALSE;
+
+	return TRUE;
+}
+
+/** Feed a contact edge to the gesture state machines
+ *
+ * @param edge GESTURE_PRESS or GESTURE_RELEASE
+ * @param pt time and position of the edge
+ *
+ * @return recognized gesture, or -1 if none
+ */
+static int gesture_feed_edge(gesture_edge_t edge, const gesture_point_t *pt)
+{
+	for( size_t i = 0; i < G_N_ELEMENTS(gesture_table); ++i ) {
+		const gesture_def_t *def = &gesture_table[i];
+		gesture_state_t *state = &gesture_state[i];
+
+		if( state->pos > 0 &&
+		    def->step[state->pos].edge == edge &&
+		    gesture_step_p(def, state, pt) ) {
+			state->hist[state->pos++] = *pt;
+		}
+		else if( def->step[0].edge == edge ) {
+			/* Start over from this edge */
+			state->hist[0] = *pt;
+			state->pos = 1;
+		}
+		else {
+			state->pos = 0;
+		}
+
+		if( state->pos == def->steps ) {
+			mce_log(LL_DEBUG, "gesture %s recognized", def->name);
+
+			/* Start from scratch, so that a triple
+			 * tap does not produce 2 double taps etc */
+			gesture_reset_matching();
+			return def->code;
+		}
+	}
+
+	return -1;
+}
+
+/** Track a multitouch position update
+ *
+ * With protocol B the position belongs to the current slot and
+ * moves the first contact only if that is the slot it occupies.
+ * With protocol A the contacts of a frame are separated by
+ * SYN_MT_REPORT and the first one reported is used.
+ *
+ * @param axis ABS_MT_POSITION_X or ABS_MT_POSITION_Y
+ * @param value the position
+ * @param contact index of the protocol A contact within the frame
+ */
+static void gesture_track_mt_position(int axis, int value, int contact)
+{
+	int slot = gesture_touch.slot;
+
+	gesture_touch.mt_seen = TRUE;
+
+	if( (unsigned)slot < GESTURE_SLOTS_MAX ) {
+		if( axis == ABS_MT_POSITION_X )
+			gesture_touch.slot_x[slot] = value;
+		else
+			gesture_touch.slot_y[slot] = value;
+	}
+
+	/* Protocol A contact other than the first one in the frame */
+	if( contact != 0 )
+		return;
+
+	/* Protocol B contact other than the first one */
+	if( gesture_touch.first_slot != -1 ) {
+		if( slot != gesture_touch.first_slot )
+			return;
+	}
+	else if( gesture_touch.slots_down != 0 ) {
+		return;
+	}
+
+	if( axis == ABS_MT_POSITION_X )
+		gesture_touch.x = value;
+	else
+		gesture_touch.y = value;
+}
+
+/** Track a multitouch protocol B tracking id update
+ *
+ * The contact that lands while no other contact is down becomes the
+ * first contact; its last position is kept after it is lifted, so
+ * that the release edge reports where the first finger left.
+ *
+ * @param value the tracking id, -1 for a lifted contact
+ */
+static void gesture_track_mt_tracking_id(int value)
+{
+	int slot = gesture_touch.slot;
+
+	if( (unsigned)slot >= GESTURE_SLOTS_MAX )
+		return;
+
+	if( value != -1 ) {
+		if( gesture_touch.slots_down == 0 ) {
+			gesture_touch.first_slot = slot;
+			gesture_touch.x = gesture_touch.slot_x[slot];
+			gesture_touch.y = gesture_touch.slot_y[slot];
+		}
+		gesture_touch.slots_down |= 1u << slot;
+	}
+	else {
+		if( slot == gesture_touch.first_slot )
+			gesture_touch.first_slot = -1;
+		gesture_touch.slots_down &= ~(1u << slot);
+	}
+}
+
+/** Process an assembled touch frame to recognize gestures
+ *
+ * Single touch, multitouch protocol A and B and mouse events
+ * are reduced to press and release of the first contact, which
+ * are then matched against the steps in gesture_table. Frames
+ * are expected only while gestures are wanted; call gesture_reset()
+ * before feeding frames again after a pause.
+ *
+ * @param ev the events of the frame
+ * @param count number of events
+ *
+ * @return recognized gesture, or -1 if none
+ */
+int gesture_process_frame(const struct input_event *ev, gsize count)
+{
+	int result = -1;
+	int major_seen = FALSE;
+	int contact = 0;
+	int down;
+
+	for( gsize i = 0; i < count; ++i ) {
+		switch( ev[i].type ) {
+		case EV_KEY:
+			if( ev[i].code == BTN_TOUCH || ev[i].code == BTN_MOUSE ) {
+				gesture_touch.key_seen = TRUE;
+				gesture_touch.key_down = (ev[i].value != 0);
+			}
+			break;
+
+		case EV_REL:
+			switch( ev[i].code ) {
+			case REL_X: gesture_touch.x += ev[i].value; break;
+			case REL_Y: gesture_touch.y += ev[i].value; break;
+			default: break;
+			}
+			break;
+
+		case EV_ABS:
+			switch( ev[i].code ) {
+			case ABS_X:
+				/* Single touch emulation of multitouch
+				 * devices need not follow the first contact */
+				if( !gesture_touch.mt_seen )
+					gesture_touch.x = ev[i].value;
+				break;
+			case ABS_Y:
+				if( !gesture_touch.mt_seen )
+					gesture_touch.y = ev[i].value;
+				break;
+			case ABS_MT_POSITION_X:
+			case ABS_MT_POSITION_Y:
+				gesture_track_mt_position(ev[i].code,
+							  ev[i].value,
+							  contact);
+				break;
+			case ABS_MT_SLOT:
+				gesture_touch.slot = ev[i].value;
+				break;
+			case ABS_MT_TRACKING_ID:
+				gesture_track_mt_tracking_id(ev[i].value);
+				break;
+			case ABS_MT_TOUCH_MAJOR:
+				if( ev[i].value > 0 )
+					major_seen = TRUE;
+				break;
+			default:
+				break;
+			}
+			break;
+
+		case EV_SYN:
+			if( ev[i].code == SYN_MT_REPORT )
+				++contact;
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	/* Protocol A devices without touch keys report contacts
+	 * only by including them in the frame */
+	if( gesture_touch.key_seen )
+		down = gesture_touch.key_down;
+	else
+		down = (gesture_touch.slots_down != 0) || major_seen;
+
+	if( count > 0 && down != gesture_touch.down ) {
+		gesture_point_t pt = {
+			.time = ev[count - 1].time,
+			.x    = gesture_touch.x,
+			.y    = gesture_touch.y,
+		};
+
+		gesture_touch.down = down;
+
+		result = gesture_feed_edge(down ? GESTURE_PRESS :
+					   GESTURE_RELEASE, &pt);
+	}
+
+	return result;
+}
+
+/** Forget all contact and gesture matching state
+ */
+void gesture_reset(void)
+{
+	memset(&gesture_touch, 0, sizeof gesture_touch);
+	gesture_touch.first_slot = -1;
+
+	gesture_reset_matching();
+}
@@ -0,0 +1,36 @@
+/**
+ * @file gesture.h
+ * Headers for the touch gesture recognizer
+ * <p>
+ * Copyright © 2026 Jolla Mobile Ltd.
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _GESTURE_H_
+#define _GESTURE_H_
+
+#include <glib.h>
+
+#include <linux/input.h>
+
+/** Touch gestures; MSC_GESTURE values in touchscreen_pipe */
+typedef enum {
+	GESTURE_DOUBLETAP = 0x4,	/**< Double tap */
+	GESTURE_SWIPE = 0x10,		/**< Swipe; only emulated by mce */
+	GESTURE_LONGPRESS = 0x11,	/**< Long press; only emulated by mce */
+} gesture_t;
+
+int gesture_process_frame(const struct input_event *ev, gsize count);
+void gesture_reset(void);
+
+#endif /* _GESTURE_H_ */
@@ -35,6 +35,22 @@
 
 #include "mce-gconf.h"
 
+#include "mce-lib.h"			/* mce_translate_int_to_string() */
+
+#include "mce-io.h"			/* mce_io_get_stats() */
+
+#include "datapipe.h"			/* datapipe_get_stats(),
+					 * datapipe_get_gint()
+					 */
+
+#include "mce-latency.h"		/* mce_latency_get_stats() */
+
+#include "event-input.h"		/* mce_input_get_stats() */
+
+#include <mce/mode-names.h>		/* MCE_CALL_STATE_NONE,
+					 * MCE_NORMAL_CALL
+					 */
+
 /** List of all D-Bus handlers */
 static GSList *dbus_handlers = NULL;
 /** List iterator for msg_handler */
@@ -623,26 +639,24 @@ static const char *value_signature(GConfValue *conf)
 	return 0;
 }
 
-/** Helper for appending GConfValue to dbus message
+/** Helper for appending GConfValue as variant to dbus message iterator
  *
- * @param reply DBusMessage under construction
- * @param conf GConfValue to be added to the reply
+ * @param body DBusMessageIter where the variant is to be added
+ * @param conf GConfValue to be added
  *
  * @return TRUE if the value was succesfully appended, or FALSE on failure
  */
-static gboolean append_gconf_value_to_dbus_message(DBusMessage *reply, GConfValue *conf)
+static gboolean append_gconf_value_to_dbus_iter(DBusMessageIter *body, GConfValue *conf)
 {
 	const char *sig = 0;
 
-	DBusMessageIter body, variant, array;
+	DBusMessageIter variant, array;
 
 	if( !(sig = value_signature(conf)) ) {
 		goto bailout_message;
 	}
 
-	dbus_message_iter_init_append(reply, &body);
-
-	if( !dbus_message_iter_open_container(&body, DBUS_TYPE_VARIANT,
+	if( !dbus_message_iter_open_container(body, DBUS_TYPE_VARIANT,
 					      sig, &variant) ) {
 		goto bailout_message;
 	}
@@ -753,7 +767,7 @@ static gboolean append_gconf_value_to_dbus_message(DBusMessage *reply, GConfValu
 		goto bailout_variant;
 	}
 
-	if( !dbus_message_iter_close_container(&body, &variant) ) {
+	if( !dbus_message_iter_close_container(body, &variant) ) {
 		goto bailout_message;
 	}
 	return TRUE;
@@ -762,12 +776,28 @@ bailout_array:
 	dbus_message_iter_abandon_container(&variant, &array);
 
 bailout_variant:
-	dbus_message_iter_abandon_container(&body, &variant);
+	dbus_message_iter_abandon_container(body, &variant);
 
 bailout_message:
 	return FALSE;
 }
 
+/** Helper for appending GConfValue to dbus message
+ *
+ * @param reply DBusMessage under construction
+ * @param conf GConfValue to be added to the reply
+ *
+ * @return TRUE if the value was succesfully appended, or FALSE on failure
+ */
+static gboolean append_gconf_value_to_dbus_message(DBusMessage *reply, GConfValue *conf)
+{
+	DBusMessageIter body;
+
+	dbus_message_iter_init_append(reply, &body);
+
+	return append_gconf_value_to_dbus_iter(&body, conf);
+}
+
 /* FIXME: Once the constants are in mce-dev these can be removed */
 #ifndef MCE_CONFIG_GET
 # define MCE_CONFIG_GET         "get_config"
@@ -1192,6 +1222,436 @@ EXIT:
 	return status;
 }
 
+/**
+ * Send a text report as the reply to a method call
+ *
+ * @param msg The D-Bus message to reply to
+ * @param method Name of the method, for diagnostics
+ * @param text The report; freed here
+ *
+ * @return TRUE if reply message was successfully sent, FALSE on failure
+ */
+static gboolean dbus_send_text_reply(DBusMessage *const msg,
+				     const gchar *const method,
+				     gchar *text)
+{
+	DBusMessage *reply = NULL;
+	gboolean status = FALSE;
+
+	/* Create a reply */
+	reply = dbus_new_method_reply(msg);
+
+	/* Append the text */
+	if (dbus_message_append_args(reply,
+				     DBUS_TYPE_STRING, &text,
+				     DBUS_TYPE_INVALID) == FALSE) {
+		mce_log(LL_CRIT,
+			"Failed to append reply argument to D-Bus message "
+			"for %s.%s",
+			MCE_REQUEST_IF, method);
+		dbus_message_unref(reply);
+		goto EXIT;
+	}
+
+	/* Send the message */
+	status = dbus_send_message(reply);
+
+EXIT:
+	g_free(text);
+
+	return status;
+}
+
+/**
+ * D-Bus callback for the get datapipe statistics method call
+ *
+ * @param msg The D-Bus message to reply to
+ *
+ * @return TRUE if reply message was successfully sent, FALSE on failure
+ */
+static gboolean datapipe_stats_get_dbus_cb(DBusMessage *const msg)
+{
+	mce_log(LL_DEBUG, "Received datapipe statistics request");
+
+	return dbus_send_text_reply(msg, MCE_DATAPIPE_STATS_GET,
+				    datapipe_get_stats());
+}
+
+/**
+ * D-Bus callback for the get I/O monitor statistics method call
+ *
+ * @param msg The D-Bus message to reply to
+ *
+ * @return TRUE if reply message was successfully sent, FALSE on failure
+ */
+static gboolean iomon_stats_get_dbus_cb(DBusMessage *const msg)
+{
+	gchar *iomon_stats = mce_io_get_stats();
+	gchar *input_stats = mce_input_get_stats();
+	gchar *text = g_strconcat(iomon_stats, input_stats, NULL);
+
+	mce_log(LL_DEBUG, "Received I/O monitor statistics request");
+
+	g_free(input_stats);
+	g_free(iomon_stats);
+
+	return dbus_send_text_reply(msg, MCE_IOMON_STATS_GET, text);
+}
+
+/**
+ * D-Bus callback for the get latency statistics method call
+ *
+ * @param msg The D-Bus message to reply to
+ *
+ * @return TRUE if reply message was successfully sent, FALSE on failure
+ */
+static gboolean latency_stats_get_dbus_cb(DBusMessage *const msg)
+{
+	mce_log(LL_DEBUG, "Received latency statistics request");
+
+	return dbus_send_text_reply(msg, MCE_LATENCY_STATS_GET,
+				    mce_latency_get_stats());
+}
+
+/**
+ * D-Bus callback for the get datapipe graph method call
+ *
+ * @param msg The D-Bus message to reply to
+ *
+ * @return TRUE if reply message was successfully sent, FALSE on failure
+ */
+static gboolean datapipe_graph_get_dbus_cb(DBusMessage *const msg)
+{
+	mce_log(LL_DEBUG, "Received datapipe graph request");
+
+	return dbus_send_text_reply(msg, MCE_DATAPIPE_GRAPH_GET,
+				    datapipe_get_graph());
+}
+
+/** Call state names used in the state snapshot */
+static const mce_translation_t snapshot_call_state_translation[] = {
+	{
+		.number = CALL_STATE_NONE,
+		.string = MCE_CALL_STATE_NONE
+	}, {
+		.number = CALL_STATE_RINGING,
+		.string = MCE_CALL_STATE_RINGING,
+	}, {
+		.number = CALL_STATE_ACTIVE,
+		.string = MCE_CALL_STATE_ACTIVE,
+	}, {
+		.number = CALL_STATE_SERVICE,
+		.string = MCE_CALL_STATE_SERVICE
+	}, { /* MCE_INVALID_TRANSLATION marks the end of this array */
+		.number = MCE_INVALID_TRANSLATION,
+		.string = MCE_CALL_STATE_NONE
+	}
+};
+
+/** Call type names used in the state snapshot */
+static const mce_translation_t snapshot_call_type_translation[] = {
+	{
+		.number = NORMAL_CALL,
+		.string = MCE_NORMAL_CALL
+	}, {
+		.number = EMERGENCY_CALL,
+		.string = MCE_EMERGENCY_CALL
+	}, { /* MCE_INVALID_TRANSLATION marks the end of this array */
+		.number = MCE_INVALID_TRANSLATION,
+		.string = MCE_NORMAL_CALL
+	}
+};
+
+/** Module callbacks adding entries to state snapshots */
+static GSList *snapshot_providers = NULL;
+
+/** Register a module callback for adding entries to state snapshots
+ *
+ * @param cb Function to call for each get_state_snapshot method call
+ */
+void mce_dbus_snapshot_add_provider(mce_dbus_snapshot_cb_t cb)
+{
+	snapshot_providers = g_slist_append(snapshot_providers, cb);
+}
+
+/** Unregister a callback added with mce_dbus_snapshot_add_provider()
+ *
+ * @param cb Function to remove
+ */
+void mce_dbus_snapshot_remove_provider(mce_dbus_snapshot_cb_t cb)
+{
+	snapshot_providers = g_slist_remove(snapshot_providers, cb);
+}
+
+/** Map display state to the string used in display status D-Bus messages
+ *
+ * @param state The display state
+ *
+ * @return MCE_DISPLAY_ON_STRING, MCE_DISPLAY_DIM_STRING or
+ *         MCE_DISPLAY_OFF_STRING
+ */
+const gchar *mce_dbus_display_status_name(display_state_t state)
+{
+	const gchar *name = MCE_DISPLAY_ON_STRING;
+
+	switch (state) {
+	case MCE_DISPLAY_UNDEF:
+	case MCE_DISPLAY_OFF:
+	case MCE_DISPLAY_LPM_OFF:
+	case MCE_DISPLAY_LPM_ON:
+	case MCE_DISPLAY_POWER_DOWN:
+	case MCE_DISPLAY_POWER_UP:
+		name = MCE_DISPLAY_OFF_STRING;
+		break;
+
+	case MCE_DISPLAY_DIM:
+		name = MCE_DISPLAY_DIM_STRING;
+		break;
+
+	case MCE_DISPLAY_ON:
+	default:
+		break;
+	}
+
+	return name;
+}
+
+/** Helper for appending a basic type dict entry to a state snapshot
+ *
+ * @param dict DBusMessageIter for the a{sv} array
+ * @param key  Name of the entry
+ * @param type DBUS_TYPE_STRING, DBUS_TYPE_BOOLEAN, etc
+ * @param val  Pointer to the value, as with dbus_message_iter_append_basic()
+ *
+ * @return TRUE if the entry was succesfully appended, or FALSE on failure
+ */
+gboolean mce_dbus_snapshot_append_basic(DBusMessageIter *dict,
+					const char *key,
+					int type, const void *val)
+{
+	const char sig[2] = { (char)type, 0 };
+	DBusMessageIter entry, variant;
+
+	if( !dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY,
+					      0, &entry) )
+		goto bailout_dict;
+
+	if( !dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key) )
+		goto bailout_entry;
+
+	if( !dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT,
+					      sig, &variant) )
+		goto bailout_entry;
+
+	if( !dbus_message_iter_append_basic(&variant, type, val) )
+		goto bailout_variant;
+
+	if( !dbus_message_iter_close_container(&entry, &variant) )
+		goto bailout_entry;
+
+	return dbus_message_iter_close_container(dict, &entry);
+
+bailout_variant:
+	dbus_message_iter_abandon_container(&entry, &variant);
+
+bailout_entry:
+	dbus_message_iter_abandon_container(dict, &entry);
+
+bailout_dict:
+	return FALSE;
+}
+
+/** Helper for appending a gconf value dict entry to a state snapshot
+ *
+ * @param dict DBusMessageIter for the a{sv} array
+ * @param key  GConf key; also used as the name of the entry
+ *
+ * @return TRUE if the entry was succesfully appended or the key
+ *         does not exist, or FALSE on failure
+ */
+static gboolean snapshot_append_gconf(DBusMessageIter *dict, const char *key)
+{
+	gboolean status = FALSE;
+	GError *err = NULL;
+	GConfValue *conf = 0;
+	DBusMessageIter entry;
+
+	if( !(conf = gconf_client_get(gconf_client_get_default(), key, &err)) ) {
+		mce_log(LL_DEBUG, "%s: %s", key,
+			err ? err->message : "unknown");
+		status = TRUE;
+		goto EXIT;
+	}
+
+	if( !dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY,
+					      0, &entry) )
+		goto EXIT;
+
+	if( !dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key) ||
+	    !append_gconf_value_to_dbus_iter(&entry, conf) ) {
+		dbus_message_iter_abandon_container(dict, &entry);
+		goto EXIT;
+	}
+
+	status = dbus_message_iter_close_container(dict, &entry);
+
+EXIT:
+	if( conf )
+		gconf_value_free(conf);
+
+	g_clear_error(&err);
+
+	return status;
+}
+
+/**
+ * D-Bus callback for the get state snapshot method call
+ *
+ * Replies with an a{sv} dictionary holding the mce state that is
+ * available from the datapipe caches, the state added by the modules
+ * via mce_dbus_snapshot_add_provider(), plus the values of the gconf
+ * keys listed in the optional string array argument; this allows
+ * status queries to be done with one round trip instead of a
+ * separate method call for each item
+ *
+ * @param msg The D-Bus message to reply to
+ *
+ * @return TRUE if reply message was successfully sent, FALSE on failure
+ */
+static gboolean state_snapshot_get_dbus_cb(DBusMessage *const msg)
+{
+	static const gchar *const versionstring = G_STRINGIFY(PRG_VERSION);
+	DBusMessage *reply = NULL;
+	gboolean status = FALSE;
+	const char *str = 0;
+	dbus_bool_t flag = FALSE;
+
+	DBusMessageIter args, keys, body, dict;
+
+	mce_log(LL_DEBUG, "Received state snapshot request");
+
+	/* Validate the optional gconf key list before doing anything else */
+	dbus_message_iter_init(msg, &args);
+
+	switch( dbus_message_iter_get_arg_type(&args) ) {
+	case DBUS_TYPE_INVALID:
+		break;
+
+	case DBUS_TYPE_ARRAY:
+		if( dbus_message_iter_get_element_type(&args) == DBUS_TYPE_STRING )
+			break;
+		/* Fall through */
+
+	default:
+		reply = dbus_message_new_error(msg, DBUS_ERROR_INVALID_ARGS,
+					       "expected string array");
+		goto EXIT;
+	}
+
+	if( !(reply = dbus_new_method_reply(msg)) )
+		goto EXIT;
+
+	dbus_message_iter_init_append(reply, &body);
+
+	if( !dbus_message_iter_open_container(&body, DBUS_TYPE_ARRAY,
+					      DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					      DBUS_TYPE_STRING_AS_STRING
+					      DBUS_TYPE_VARIANT_AS_STRING
+					      DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+					      &dict) )
+		goto FAILED;
+
+	if( !mce_dbus_snapshot_append_basic(&dict, "version",
+					    DBUS_TYPE_STRING, &versionstring) )
+		goto ABANDON;
+
+	str = mce_dbus_display_status_name(datapipe_get_gint(display_state_pipe));
+
+	if( !mce_dbus_snapshot_append_basic(&dict, "display_status",
+					    DBUS_TYPE_STRING, &str) )
+		goto ABANDON;
+
+	str = mce_translate_int_to_string(snapshot_call_state_translation,
+					  datapipe_get_gint(call_state_pipe));
+
+	if( !mce_dbus_snapshot_append_basic(&dict, "call_state",
+					    DBUS_TYPE_STRING, &str) )
+		goto ABANDON;
+
+	str = mce_translate_int_to_string(snapshot_call_type_translation,
+					  datapipe_get_gint(call_type_pipe));
+
+	if( !mce_dbus_snapshot_append_basic(&dict, "call_type",
+					    DBUS_TYPE_STRING, &str) )
+		goto ABANDON;
+
+	flag = datapipe_get_gbool(power_saving_mode_pipe) ? TRUE : FALSE;
+
+	if( !mce_dbus_snapshot_append_basic(&dict, "psm_state",
+					    DBUS_TYPE_BOOLEAN, &flag) )
+		goto ABANDON;
+
+	str = ((mce_get_submode_int32() & MCE_TKLOCK_SUBMODE) ?
+	       MCE_TK_LOCKED : MCE_TK_UNLOCKED);
+
+	if( !mce_dbus_snapshot_append_basic(&dict, "tklock_mode",
+					    DBUS_TYPE_STRING, &str) )
+		goto ABANDON;
+
+	for( GSList *item = snapshot_providers; item; item = item->next ) {
+		mce_dbus_snapshot_cb_t cb = item->data;
+
+		if( !cb(&dict) )
+			goto ABANDON;
+	}
+
+	if( dbus_message_iter_get_arg_type(&args) == DBUS_TYPE_ARRAY ) {
+		dbus_message_iter_recurse(&args, &keys);
+
+		while( dbus_message_iter_get_arg_type(&keys) == DBUS_TYPE_STRING ) {
+			const char *key = 0;
+
+			dbus_message_iter_get_basic(&keys, &key);
+			dbus_message_iter_next(&keys);
+
+			if( !snapshot_append_gconf(&dict, key) )
+				goto ABANDON;
+		}
+	}
+
+	if( !dbus_message_iter_close_container(&body, &dict) )
+		goto FAILED;
+
+	goto EXIT;
+
+ABANDON:
+	dbus_message_iter_abandon_container(&body, &dict);
+
+FAILED:
+	mce_log(LL_CRIT,
+		"Failed to append reply argument to D-Bus message "
+		"for %s.%s",
+		MCE_REQUEST_IF, MCE_STATE_SNAPSHOT_GET);
+	dbus_message_unref(reply);
+	reply = dbus_message_new_error(msg, DBUS_ERROR_FAILED,
+				       "constructing reply failed");
+
+EXIT:
+	/* Send a reply if we have one */
+	if( reply ) {
+		if( dbus_message_get_no_reply(msg) ) {
+			dbus_message_unref(reply), reply = 0;
+			status = TRUE;
+		}
+		else {
+			/* dbus_send_message unrefs the reply message */
+			status = dbus_send_message(reply), reply = 0;
+		}
+	}
+
+	return status;
+}
+
 /**
  * D-Bus rule checker
  *
@@ -1854,6 +2314,46 @@ gboolean mce_dbus_init(const gboolean systembus)
 				 config_set_dbus_cb) == NULL)
 		goto EXIT;
 
+	/* get_datapipe_stats */
+	if (mce_dbus_handler_add(MCE_REQUEST_IF,
+				 MCE_DATAPIPE_STATS_GET,
+				 NULL,
+				 DBUS_MESSAGE_TYPE_METHOD_CALL,
+				 datapipe_stats_get_dbus_cb) == NULL)
+		goto EXIT;
+
+	/* get_datapipe_graph */
+	if (mce_dbus_handler_add(MCE_REQUEST_IF,
+				 MCE_DATAPIPE_GRAPH_GET,
+				 NULL,
+				 DBUS_MESSAGE_TYPE_METHOD_CALL,
+				 datapipe_graph_get_dbus_cb) == NULL)
+		goto EXIT;
+
+	/* get_state_snapshot */
+	if (mce_dbus_handler_add(MCE_REQUEST_IF,
+				 MCE_STATE_SNAPSHOT_GET,
+				 NULL,
+				 DBUS_MESSAGE_TYPE_METHOD_CALL,
+				 state_snapshot_get_dbus_cb) == NULL)
+		goto EXIT;
+
+	/* get_iomon_stats */
+	if (mce_dbus_handler_add(MCE_REQUEST_IF,
+				 MCE_IOMON_STATS_GET,
+				 NULL,
+				 DBUS_MESSAGE_TYPE_METHOD_CALL,
+				 iomon_stats_get_dbus_cb) == NULL)
+		goto EXIT;
+
+	/* get_latency_stats */
+	if (mce_dbus_handler_add(MCE_REQUEST_IF,
+				 MCE_LATENCY_STATS_GET,
+				 NULL,
+				 DBUS_MESSAGE_TYPE_METHOD_CALL,
+				 latency_stats_get_dbus_cb) == NULL)
+		goto EXIT;
+
 	status = TRUE;
 
 EXIT:
@@ -1865,6 +2365,9 @@ EXIT:
  */
 void mce_dbus_exit(void)
 {
+	/* Forget state snapshot providers */
+	g_slist_free(snapshot_providers), snapshot_providers = NULL;
+
 	/* Unregister D-Bus handlers */
 	if (dbus_handlers != NULL) {
 		g_slist_foreach(dbus_handlers,
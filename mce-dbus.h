@@ -26,10 +26,36 @@
 
 #include <mce/dbus-names.h>
 
+#include "mce.h"
+
 #ifndef BUILTIN_GCONF
 # include <gconf/gconf-client.h>
 #endif
 
+/* FIXME: Once the constants are in mce-dev these can be removed */
+#ifndef MCE_DATAPIPE_STATS_GET
+/** Query datapipe execution statistics */
+# define MCE_DATAPIPE_STATS_GET	"get_datapipe_stats"
+#endif
+#ifndef MCE_DATAPIPE_GRAPH_GET
+/** Query datapipe execution graph in Graphviz format */
+# define MCE_DATAPIPE_GRAPH_GET	"get_datapipe_graph"
+#endif
+#ifndef MCE_STATE_SNAPSHOT_GET
+/** Query mce state plus gconf values at once */
+# define MCE_STATE_SNAPSHOT_GET	"get_state_snapshot"
+#endif
+#ifndef MCE_IOMON_STATS_GET
+/** Query I/O monitor throughput and latency statistics,
+ *  plus input device rescan counts */
+# define MCE_IOMON_STATS_GET	"get_iomon_stats"
+#endif
+
+#ifndef MCE_LATENCY_STATS_GET
+/** Query input-to-display latency percentiles */
+# define MCE_LATENCY_STATS_GET	"get_latency_stats"
+#endif
+
 DBusConnection *dbus_connection_get(void);
 
 DBusMessage *dbus_new_signal(const gchar *const path,
@@ -72,6 +98,22 @@ gssize mce_dbus_owner_monitor_remove(const gchar *service,
 				     GSList **monitor_list);
 void mce_dbus_owner_monitor_remove_all(GSList **monitor_list);
 
+/** Callback for adding module state to get_state_snapshot replies
+ *
+ * @param dict DBusMessageIter for the a{sv} array to append to
+ *
+ * @return TRUE on success, FALSE on failure
+ */
+typedef gboolean (*mce_dbus_snapshot_cb_t)(DBusMessageIter *dict);
+
+void mce_dbus_snapshot_add_provider(mce_dbus_snapshot_cb_t cb);
+void mce_dbus_snapshot_remove_provider(mce_dbus_snapshot_cb_t cb);
+gboolean mce_dbus_snapshot_append_basic(DBusMessageIter *dict,
+					const char *key,
+					int type, const void *val);
+
+const gchar *mce_dbus_display_status_name(display_state_t state);
+
 gboolean mce_dbus_init(const gboolean systembus);
 void mce_dbus_exit(void);
 
@@ -11,8 +11,8 @@
  * elements these functions turn in to "NOP and return failure".
  *
  * In addition to the above this module also:
- * - moves sensor input data via pipe from worker thread context to the
- *   thread that is running the glib mainloop.
+ * - moves sensor input data via the datapipe post queue from worker
+ *   thread context to the thread that is running the glib mainloop.
  * - proxies diagnostic output from hybris-plugin to mce_log()
  * ========================================================================= */
 
@@ -21,6 +21,7 @@
 #include "mce-log.h"
 #include "mce-conf.h"
 #include "mce-modules.h"
+#include "datapipe.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -34,115 +35,61 @@ static void mce_hybris_ps_set_hook(mce_hybris_ps_fn cb);
 static void mce_hybris_als_set_hook(mce_hybris_als_fn cb);
 
 /* ------------------------------------------------------------------------- *
- * Feeding sensor data via pipe to glib mainloop goes roughly as follows
+ * Feeding sensor data to glib mainloop goes roughly as follows
  *
  * --- mce-libhybris-plugin worker thread --
  * 1) uses blocking poll_dev->poll() function to read sensor data
- * 2) uses a set of callbacks to write the data to a pipe
+ * 2) uses a set of callbacks to post the data to the datapipe post queue
  * --- mce-libhybris-module --
- * 3) iowatch reads the data from pipe
+ * 3) the post queue wakes up mainloop once per batch of samples
  * 4) and passes the data to mce via another set of callbacks
  * --- mce sensor handling code --
  * 5) can act on the data in the context that runs gmainloop
  * ------------------------------------------------------------------------- */
 
-/** Sensor enumeration for mux @ worker thread -> pipe -> demux @ mainloop */
+/** Sensor enumeration for mux @ worker thread -> queue -> demux @ mainloop */
 enum
 {
   EVEPIPE_ALS,
   EVEPIPE_PS,
 };
 
-/** Sensor data passed over pipe */
-typedef struct
-{
-  int64_t time;  // time stamp from android side
-  int32_t type;  // EVEPIPE_ALS or EVEPIPE_PS
-  float   value; // sensor data from android side
-} evepipe_t;
-
-/** Initialize once flag for sensor data pipe */
-static bool evepipe_done = false;
-
 /** Callback for handling proximity data */
 static mce_hybris_ps_fn  evepipe_ps_cb  = 0;
 
 /** Callback for handling ambient light data */
 static mce_hybris_als_fn evepipe_als_cb = 0;
 
-/** The sensor data pipe */
-static int               evepipe_fd[2]  = { -1, -1 };
-
-/** I/O watch id for the sensor data pipe */
-static guint             evepipe_id     = 0;
-
-/** I/O watch callback for handling pipe input
- *
- * @param channel    (not used)
- * @param condition  (not used)
- * @param data       (not used)
+/** Mainloop handler for sensor data posted from the worker thread
  *
- * @return TRUE to keep the iowatch alive, or FALSE to remove it
+ * @param user_data sensor type, EVEPIPE_ALS or EVEPIPE_PS (as pointer)
+ * @param stamp     time stamp from android side
+ * @param value     sensor data from android side
  */
-static gboolean evepipe_recv_cb(GIOChannel *channel,
-                                GIOCondition condition,
-                                gpointer data)
+static void evepipe_recv_cb(gpointer user_data, gint64 stamp, gdouble value)
 {
-  /* we just want the cb ... */
-  (void)channel; (void)condition; (void)data;
-
-  gboolean keep_going = TRUE;
-
-  evepipe_t eve[64];
-
-  int rc = read(evepipe_fd[0], eve, sizeof eve);
-
-  if( rc < 0 ) {
-    switch( errno ) {
-    case EINTR:
-    case EAGAIN:
-      break;
-
-    default:
-      mce_log(LL_ERR, "failed to read sensor events: %m");
-      keep_going = FALSE;
-      break;
+  switch( GPOINTER_TO_INT(user_data) ) {
+  case EVEPIPE_PS:
+    if( evepipe_ps_cb ) {
+      evepipe_ps_cb(stamp, (float)value);
     }
-    goto cleanup;
-  }
-
-  rc /= sizeof *eve;
-
-  for( int i = 0; i < rc; ++i ) {
-    switch( eve[i].type ) {
-    case EVEPIPE_PS:
-      if( evepipe_ps_cb ) {
-        evepipe_ps_cb(eve[i].time, eve[i].value);
-      }
-      break;
+    break;
 
-    case EVEPIPE_ALS:
-      if( evepipe_als_cb ) {
-        evepipe_als_cb(eve[i].time, eve[i].value);
-      }
-      break;
-
-    default:
-      break;
+  case EVEPIPE_ALS:
+    if( evepipe_als_cb ) {
+      evepipe_als_cb(stamp, (float)value);
     }
-  }
+    break;
 
-cleanup:
-
-  if( !keep_going )  {
-    mce_log(LL_CRIT, "disabling sensor event pipe iowatch");
-    evepipe_id = 0;
+  default:
+    break;
   }
-
-  return keep_going;
 }
 
-/** Write sensor data to the pipe
+/** Post sensor data to the mainloop
+ *
+ * If the mainloop falls so far behind that the queue is full, the
+ * sample is dropped; the next one will carry more recent data anyway.
  *
  * @param timestamp nanoseconds
  * @param type      EVEPIPE_ALS or EVEPIPE_PS
@@ -150,24 +97,11 @@ cleanup:
  */
 static void evepipe_send(int64_t timestamp, int32_t type, float data)
 {
-  evepipe_t eve =
-  {
-    .time  = timestamp,
-    .type  = type,
-    .value = data,
-  };
-
-  int rc = TEMP_FAILURE_RETRY(write(evepipe_fd[1], &eve, sizeof eve));
-
-  if( rc != sizeof eve ) {
-    // TODO: since this happens from separate thread, we might want
-    //       to do something bit more clever in case the sensor data
-    //       overflows the pipe ...
-    abort();
-  }
+  datapipe_post_call(evepipe_recv_cb, GINT_TO_POINTER(type),
+                     timestamp, data);
 }
 
-/** Write PS data to the sensor data pipe
+/** Post PS data to the mainloop
  *
  * @param timestamp nanoseconds
  * @param distance  centimeters
@@ -177,7 +111,7 @@ static void evepipe_send_ps(int64_t timestamp, float distance)
   evepipe_send(timestamp, EVEPIPE_PS, distance);
 }
 
-/** Write ALS data to the sensor data pipe
+/** Post ALS data to the mainloop
  * @param timestamp nanoseconds
  * @param ligt      lux
  */
@@ -186,63 +120,6 @@ static void evepipe_send_als(int64_t timestamp, float light)
   evepipe_send(timestamp, EVEPIPE_ALS, light);
 }
 
-/** Close sensor data pipe
- *
- * @param reset_done true if we wish to return to uninitialized
- *                   state, or false to preserve "already tried
- *                   but failed" state
- */
-static void evepipe_quit(bool reset_done)
-{
-  /* remove io watch */
-  if( evepipe_id ) g_source_remove(evepipe_id), evepipe_id = 0;
-
-  /* close pipe file descriptors */
-  if( evepipe_fd[1] != -1 ) close(evepipe_fd[1]), evepipe_fd[1] = -1;
-  if( evepipe_fd[0] != -1 ) close(evepipe_fd[0]), evepipe_fd[0] = -1;
-
-  if( reset_done ) evepipe_done = false;
-}
-
-/** Initialize sensor data pipe
- *
- * @return true on success, or false in case of errors
- */
-static bool evepipe_init(void)
-{
-  GIOChannel *chn = 0;
-
-  if( evepipe_done ) {
-    goto EXIT;
-  }
-
-  evepipe_done = true;
-
-  if( pipe(evepipe_fd) == -1 ) {
-    goto EXIT;
-  }
-
-  if( !(chn = g_io_channel_unix_new(evepipe_fd[0])) ) {
-    goto EXIT;
-  }
-
-  evepipe_id = g_io_add_watch(chn, G_IO_IN, evepipe_recv_cb, 0);
-
-  if( !evepipe_id ) {
-    goto EXIT;
-  }
-
-EXIT:
-
-  if( chn != 0 ) g_io_channel_unref(chn);
-
-  if( !evepipe_id ) {
-    evepipe_quit(false);
-  }
-
-  return evepipe_id != 0;
-}
-
 /** Callback for forwarding logging from hybris-plugin to mce_log()
  *
  * @param lev  syslog priority (=mce_log level) i.e. LOG_ERR etc
@@ -365,7 +242,8 @@ void mce_hybris_quit(void)
   static void (*real)(void) = 0;
   RESOLVE;
 
-  evepipe_quit(true);
+  evepipe_ps_cb  = 0;
+  evepipe_als_cb = 0;
 
   if( real ) real();
 }
@@ -588,7 +466,6 @@ bool mce_hybris_ps_set_callback(mce_hybris_ps_fn cb)
 
   if( (evepipe_ps_cb = cb) ) {
     mce_hybris_ps_set_hook(evepipe_send_ps);
-    res = evepipe_init();
   }
   else {
     mce_hybris_ps_set_hook(0);
@@ -663,7 +540,6 @@ bool mce_hybris_als_set_callback(mce_hybris_als_fn cb)
 
   if( (evepipe_als_cb = cb) ) {
     mce_hybris_als_set_hook(evepipe_send_als);
-    res = evepipe_init();
   }
   else {
     mce_hybris_als_set_hook(0);
@@ -31,11 +31,27 @@
 #include <string.h>			/* strlen() */
 #include <unistd.h>			/* close(), read(), ftruncate() */
 
+#include <pthread.h>			/* pthread_create(), pthread_join(),
+					 * pthread_mutex_lock(),
+					 * pthread_cond_wait()
+					 */
+
+#include <sys/time.h>			/* struct timeval */
+#include <sys/epoll.h>			/* epoll_create1(), epoll_ctl(),
+					 * epoll_wait(), EPOLLIN, EPOLLPRI
+					 */
+
 #include "mce.h"
 #include "mce-io.h"
 
 #include "mce-log.h"			/* mce_log(), LL_* */
 
+#include "datapipe.h"			/* datapipe_post_call() */
+
+#include "filewatcher.h"		/* filewatcher_create(),
+					 * filewatcher_delete()
+					 */
+
 #ifdef ENABLE_WAKELOCKS
 # include "libwakelock.h"		/* API for wakelocks */
 #endif
@@ -50,13 +66,37 @@ typedef enum {
 	IOMON_CHUNK = 1				/**< Chunk I/O monitor */
 } iomon_type;
 
+/** I/O monitor statistics */
+typedef struct {
+	guint64 wakeups;			/**< Number of read callbacks */
+	guint64 bytes;				/**< Bytes read */
+	guint64 chunks;				/**< Chunks or lines read */
+	guint64 skipped;			/**< Chunks read but discarded
+						 *   by the flush logic */
+	guint64 flushes;			/**< Seeks to the end of file
+						 *   requested by the callback */
+	guint64 calls;				/**< Number of callback calls */
+	guint64 callback_us;			/**< Time spent in callbacks */
+	guint callback_max_us;			/**< Longest single callback */
+	guint64 delays;				/**< Number of delay samples */
+	guint64 delay_us;			/**< Accumulated delay from the
+						 *   event time stamp to the
+						 *   start of the callback */
+	guint delay_max_us;			/**< Longest single delay */
+	guint64 reopens;			/**< Reopens after device loss */
+} iomon_stats_t;
+
 /** I/O monitor structure */
 typedef struct {
 	gchar *file;				/**< Monitored file */
 	GIOChannel *iochan;			/**< I/O channel */
 	iomon_cb callback;			/**< Callback */
+	iomon_batch_cb batch_callback;		/**< Callback for all chunks
+						 *   read at once */
 	iomon_err_cb err_callback;	/**< error callback */
 	gulong chunk_size;			/**< Read-chunk size */
+	gchar *buffer;				/**< Read buffer for chunks */
+	gsize buffer_size;			/**< Size of the read buffer */
 	guint data_source_id;			/**< GSource ID for data */
 	guint error_source_id;			/**< GSource ID for errors */
 	gint fd;				/**< File Descriptor */
@@ -65,14 +105,174 @@ typedef struct {
 	GIOCondition monitored_io_conditions;	/**< Conditions to monitor */
 	GIOCondition latest_io_condition;	/**< Latest I/O condition */
 	gboolean rewind;			/**< Rewind policy */
+	gboolean rewind_policy;			/**< Rewind policy asked for
+						 *   at registration */
 	gboolean suspended;			/**< Is the I/O monitor
 						 *   suspended? */
 	gboolean seekable;			/**< is the I/O channel seekable */
+	gboolean epoll;				/**< Is the fd in the shared
+						 *   epoll set? */
+	gboolean timestamped;			/**< Do chunks start with a
+						 *   struct timeval? */
+	gboolean reopen;			/**< Reopen the file after
+						 *   device loss? */
+	gboolean detached;			/**< File lost; waiting for
+						 *   it to reappear */
+	gboolean resume_on_attach;		/**< Resume once reopened? */
+	guint reopen_delay_ms;			/**< Current reopen backoff */
+	guint reopen_timer_id;			/**< Timer for the next reopen
+						 *   attempt */
+	filewatcher_t *reopen_watcher;		/**< Watch for the file to
+						 *   reappear */
+	iomon_stats_t stats;			/**< Statistics */
 } iomon_struct;
 
+/** Asynchronous output file state shared with the writer thread */
+typedef struct {
+	const output_state_t *output;		/**< Owner; used only as a key */
+	gchar *context;				/**< Copy of output->context */
+	gchar *path;				/**< Copy of output->path */
+	gboolean truncate_file;			/**< Copy of output->truncate_file */
+	gboolean close_on_exit;			/**< Copy of output->close_on_exit */
+	void (*written_cb)(gulong, gint64);	/**< Copy of output->written_cb */
+	int fd;					/**< Open file; writer thread only
+						 *   while busy is set */
+	gboolean reopen;			/**< Path changed; reopen the file */
+	gboolean pending;			/**< Value waiting to be written */
+	gulong number;				/**< The value to write */
+	gboolean busy;				/**< Writer thread is using fd */
+	gboolean failed;			/**< The latest write failed */
+	gboolean closing;			/**< Release once no longer busy */
+	void (*call_cb)(gpointer);		/**< Barrier; called from the
+						 *   mainloop instead of writing */
+	gpointer call_data;			/**< Data for call_cb */
+} mce_io_writer_slot_t;
+
+/** Completion report of an asynchronous write */
+typedef struct {
+	const output_state_t *output;		/**< Owner; used only as a key */
+	gchar *context;				/**< Copy of output->context */
+	void (*written_cb)(gulong, gint64);	/**< Copy of output->written_cb */
+	int err;				/**< errno of the failed write,
+						 *   or 0 on success */
+	gulong number;				/**< The value that was written */
+	gint64 stamp;				/**< Completion time */
+	void (*call_cb)(gpointer);		/**< Copy of slot->call_cb */
+	gpointer call_data;			/**< Copy of slot->call_data */
+} mce_io_writer_done_t;
+
+/** Lock for all writer thread state */
+static pthread_mutex_t mce_io_writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Signaled when slots are queued or the thread should exit */
+static pthread_cond_t mce_io_writer_cond = PTHREAD_COND_INITIALIZER;
+
+/** Signaled when the writer thread runs out of queued slots */
+static pthread_cond_t mce_io_writer_idle_cond = PTHREAD_COND_INITIALIZER;
+
+/** The writer thread */
+static pthread_t mce_io_writer_thread;
+
+/** Is the writer thread running? */
+static gboolean mce_io_writer_running = FALSE;
+
+/** Should the writer thread exit? */
+static gboolean mce_io_writer_exit = FALSE;
+
+/** All asynchronous output slots */
+static GSList *mce_io_writer_slots = NULL;
+
+/** Slots with a pending value, in the order they were queued */
+static GQueue mce_io_writer_queue = G_QUEUE_INIT;
+
+/** Maximum number of epoll events handled in one dispatch */
+#define IOMON_EPOLL_EVENTS			16
+
+/** Custom GSource that multiplexes I/O monitors via one epoll fd */
+typedef struct {
+	GSource source;				/**< Base class */
+	GPollFD pollfd;				/**< The epoll fd for glib */
+} iomon_epoll_source_t;
+
+/** The epoll GSource, or NULL if not created yet */
+static iomon_epoll_source_t *iomon_epoll_source = NULL;
+
+/** Number of I/O monitors in the epoll set */
+static guint iomon_epoll_count = 0;
+
+/** Events being dispatched; entries of removed monitors are cleared */
+static struct epoll_event iomon_epoll_events[IOMON_EPOLL_EVENTS];
+
+/** Number of events in iomon_epoll_events */
+static int iomon_epoll_pending = 0;
+
+/** Maximum size of the read buffer of chunk I/O monitors */
+#define IOMON_BUFFER_SIZE			4096
+
+/** First delay before reopening a lost file */
+#define IOMON_REOPEN_DELAY_MIN_MS		250
+
+/** Longest delay between attempts to reopen a lost file */
+#define IOMON_REOPEN_DELAY_MAX_MS		30000
+
+static gboolean iomon_detach(iomon_struct *iomon);
+
 /** Suffix used for temporary files */
 #define TMP_SUFFIX				".tmp"
 
+/** Delay from the first queued write-behind file to flushing them all */
+#define MCE_IO_PERSIST_DELAY_MS			2000
+
+/** File waiting to be written by the write-behind persistence */
+typedef struct {
+	gchar *path;				/**< File to replace */
+	gchar *data;				/**< New contents */
+	gsize size;				/**< Size of the new contents */
+	mode_t mode;				/**< Protection bits to apply */
+} mce_io_persist_t;
+
+/** Files waiting to be written, in the order they were first queued */
+static GSList *mce_io_persist_queue = NULL;
+
+/** Timer for flushing the write-behind queue */
+static guint mce_io_persist_timer_id = 0;
+
+/** File for keeping cached sysfs attributes over mce restarts */
+#define MCE_IO_CACHE_BOOT_FILE		G_STRINGIFY(MCE_VAR_DIR) "/sysfs.cache"
+
+/** File that identifies the current boot */
+#define MCE_IO_CACHE_BOOT_ID_FILE	"/proc/sys/kernel/random/boot_id"
+
+/** How long a failed access() check is trusted */
+#define MCE_IO_CACHE_RETRY_MS		5000
+
+/** Number of access() modes; R_OK | W_OK | X_OK + 1 */
+#define MCE_IO_CACHE_ACCESS_MODES	8
+
+/** Cached sysfs attribute */
+typedef struct {
+	gchar *path;				/**< Path; also the hash key */
+	gboolean valid;				/**< Is content up to date? */
+	gchar *content;				/**< File contents */
+	gint8 access[MCE_IO_CACHE_ACCESS_MODES];	/**< access() results by
+							 *   mode; -1 = unknown,
+							 *   0 = denied,
+							 *   1 = allowed
+							 */
+	gint64 denied[MCE_IO_CACHE_ACCESS_MODES];	/**< Monotonic time of
+							 *   each failed check
+							 */
+} mce_io_cache_entry_t;
+
+/** Cached attributes by path */
+static GHashTable *mce_io_cache = NULL;
+
+/** Boot id the boot cache entries are valid for */
+static gchar *mce_io_cache_boot_id = NULL;
+
+/** Idle callback for saving the boot cache */
+static guint mce_io_cache_save_id = 0;
+
 /**
  * Helper function for closing files that checks for NULL,
  * prints proper error messages and NULLs the file pointer after close
@@ -426,661 +626,2055 @@ EXIT:
 }
 
 /**
- * Cleanup function for output file control structures
- *
- * Closes file stream associated with output if it is open
+ * Cleanup function for input file control structures
  *
- * It is explicitly permitted to call this function:
- * 1) with NULL output parameter
- * 2) without open stream in ouput
- * 3) more than one times
+ * Closes the file descriptor associated with input if it is open;
+ * like mce_close_output(), this can be called with NULL input,
+ * without an open file, and more than once
  *
- * @param output control structure for writing to a file
+ * @param input control structure for reading a file
  */
-
-void mce_close_output(output_state_t *output)
+void mce_close_input(input_state_t *input)
 {
-	if( output && output->file ) {
-		if( fclose(output->file) == EOF ) {
-			mce_log(LL_WARN,"%s: can't close %s: %m", output->context, output->path);
-		}
-		output->file = 0;
+	if( !input || !input->fd_open )
+		return;
+
+	if( close(input->fd) == -1 ) {
+		mce_log(LL_WARN, "%s: can't close %s: %m",
+			input->context, input->path);
 	}
+
+	input->fd = -1;
+	input->fd_open = FALSE;
 }
 
 /**
- * Write a string representation of a number to a file
- *
- * Note: this variant uses in-place rewrites when truncating.
- * It should thus not be used in cases where atomicity is expected.
- * For atomic replace, use mce_write_number_string_to_file_atomic()
+ * Read data from the beginning of an input file
  *
- * @param output control structure for writing to a file
- * @param number The number to write
+ * The file is opened on the first read and kept open until
+ * mce_close_input() is called or a read fails
  *
+ * @param input control structure for reading a file
+ * @param data buffer for the data
+ * @param[in,out] len [in] The size of the buffer
+ *                    [out] The number of bytes read
  * @return TRUE on success, FALSE on failure
  */
-
-gboolean mce_write_number_string_to_file(output_state_t *output, const gulong number)
+gboolean mce_read_input(input_state_t *input, void *data, gsize *len)
 {
-	gboolean status = FALSE; // assume failure
-
-	if( !output ) {
-		mce_log(LL_CRIT, "NULL output passed, terminating");
-		mce_abort();
-	}
-
-	if( !output->context ) {
-		mce_log(LL_CRIT, "output->context missing, terminating");
-		mce_abort();
-	}
+	gboolean status = FALSE;
+	gssize done = -1;
 
-	if( !output->path ) {
-		if( !output->invalid_config_reported ) {
-			output->invalid_config_reported = TRUE;
-			mce_log(LL_ERR, "%s: output->path not configured", output->context);
-		}
+	if( !input->path )
 		goto EXIT;
-	}
 
-	if( !output->file ) {
-		output->file = fopen(output->path, output->truncate_file ? "w" : "a");
-		if( !output->file ) {
-			mce_log(LL_ERR,"%s: can't open %s: %m", output->context, output->path);
+	if( !input->fd_open ) {
+		input->fd = open(input->path, O_RDONLY | O_CLOEXEC);
+
+		if( input->fd == -1 ) {
+			mce_log(LL_ERR, "%s: can't open %s: %m",
+				input->context, input->path);
 			goto EXIT;
 		}
+
+		input->fd_open = TRUE;
 	}
-	else if( output->truncate_file )
-	{
-		rewind(output->file);
-		if( ftruncate(fileno(output->file), 0) == -1 ) {
-			mce_log(LL_WARN,"%s: can't truncate %s: %m", output->context, output->path);
+
+	if( !input->unseekable ) {
+		done = TEMP_FAILURE_RETRY(pread(input->fd, data, *len, 0));
+
+		if( done == -1 && errno == ESPIPE ) {
+			/* Device nodes return each sample from read() */
+			mce_log(LL_DEBUG, "%s: %s is not seekable",
+				input->context, input->path);
+			input->unseekable = TRUE;
 		}
 	}
 
-	// from now on assume success
-	status = TRUE;
+	if( input->unseekable )
+		done = TEMP_FAILURE_RETRY(read(input->fd, data, *len));
 
-	if( fprintf(output->file, "%lu", number) < 0 ) {
-		mce_log(LL_WARN,"%s: can't write %s: %m", output->context, output->path);
-		status = FALSE;
-	}
+	if( done == -1 ) {
+		mce_log(LL_ERR, "%s: can't read %s: %m",
+			input->context, input->path);
 
-	if( fflush(output->file) == EOF ) {
-		mce_log(LL_WARN,"%s: can't flush %s: %m", output->context, output->path);
-		status = FALSE;
+		/* Reopen on the next read */
+		mce_close_input(input);
+		goto EXIT;
 	}
 
-EXIT:
+	*len = (gsize)done;
+	status = TRUE;
 
-	if( output->close_on_exit && output->file ) {
-		if( fclose(output->file) == EOF ) {
-			mce_log(LL_WARN,"%s: can't close %s: %m", output->context, output->path);
-		}
-		output->file = 0;
-	}
+EXIT:
+	/* Ignore error */
+	errno = 0;
 
 	return status;
 }
 
 /**
- * Write a string representation of a number to a file
- * in an atomic manner
+ * Read a decimal number from the beginning of an input file
  *
- * @param file Path to the file to write to
- * @param number The number to write
+ * @param input control structure for reading a file
+ * @param number where to store the number
  * @return TRUE on success, FALSE on failure
  */
-gboolean mce_write_number_string_to_file_atomic(const gchar *const file,
-						const gulong number)
+gboolean mce_read_input_number(input_state_t *input, gulong *number)
 {
 	gboolean status = FALSE;
-	gchar *tmpname = NULL;
-	FILE *fp = NULL;
-	gint retval;
-	int fd;
+	char data[32];
+	gsize len = sizeof data;
+	gulong value = 0;
+	gsize i = 0;
 
-	if (file == NULL) {
-		mce_log(LL_CRIT,
-			"file == NULL");
+	if( !mce_read_input(input, data, &len) )
 		goto EXIT;
-	}
 
-	if ((tmpname = g_strconcat(file, TMP_SUFFIX, NULL)) == NULL) {
-		mce_log(LL_ERR,
-			"Failed to allocate memory for `%s%s'",
-			file, TMP_SUFFIX);
+	while( i < len && g_ascii_isspace(data[i]) )
+		++i;
+
+	if( i == len || !g_ascii_isdigit(data[i]) ) {
+		mce_log(LL_ERR, "%s: no number in %s",
+			input->context, input->path);
 		goto EXIT;
 	}
 
-	/* If we cannot open the file, abort */
-	if ((fp = fopen(tmpname, "w")) == NULL) {
-		mce_log(LL_ERR,
-			"Cannot open `%s' for writing; %s",
-			tmpname, g_strerror(errno));
+	for( ; i < len && g_ascii_isdigit(data[i]); ++i )
+		value = value * 10 + (gulong)(data[i] - '0');
 
-		/* Ignore error */
-		errno = 0;
-		goto EXIT;
-	}
+	*number = value;
+	status = TRUE;
 
-	retval = fprintf(fp, "%lu", number);
+EXIT:
+	return status;
+}
 
-	/* Was the write successful? */
-	if (retval < 0) {
-		mce_log(LL_ERR,
-			"Failed to write to `%s'; %s",
-			tmpname, g_strerror(errno));
+/**
+ * Convert an unsigned number to decimal string
+ *
+ * @param buf Where to store the string; not zero terminated
+ * @param size Size of buf; must be large enough for any gulong
+ * @param number The number to convert
+ * @return Length of the string
+ */
+static int mce_io_ulong_to_string(char *buf, size_t size, gulong number)
+{
+	char tmp[3 * sizeof number];
+	char *pos = tmp + sizeof tmp;
+	int len;
 
-		/* Ignore error */
-		errno = 0;
-		goto EXIT2;
-	}
+	do {
+		*--pos = (char)('0' + number % 10);
+		number /= 10;
+	} while (number);
 
-	if ((fd = fileno(fp)) == -1) {
-		mce_log(LL_ERR,
-			"Failed to convert *fp to fd; %s",
-			g_strerror(errno));
+	len = (int)(tmp + sizeof tmp - pos);
 
-		/* Ignore error */
-		errno = 0;
-		goto EXIT2;
-	}
+	if ((size_t)len > size)
+		len = (int)size;
 
-	/* Ensure that the data makes it to disk */
-	if (fsync(fd) == -1) {
-		mce_log(LL_ERR,
-			"Failed to fsync `%s'; %s",
-			tmpname, g_strerror(errno));
+	memcpy(buf, pos, len);
 
-		/* Ignore error */
-		errno = 0;
-		goto EXIT2;
-	}
+	return len;
+}
 
-	status = TRUE;
+/**
+ * Close the file of an asynchronous output slot and free it
+ *
+ * Must be called with the writer mutex held and the slot not busy
+ *
+ * @param slot The slot to free
+ */
+static void mce_io_writer_slot_free(mce_io_writer_slot_t *slot)
+{
+	g_queue_remove(&mce_io_writer_queue, slot);
+	mce_io_writer_slots = g_slist_remove(mce_io_writer_slots, slot);
 
-EXIT2:
-	/* Close the temporary file */
-	if (mce_close_file(tmpname, &fp) == FALSE) {
-		status = FALSE;
-		goto EXIT;
-	}
+	if (slot->fd != -1)
+		close(slot->fd);
 
-	/* And if everything has been successful so far,
-	 * rename the temporary file over the old file
-	 */
-	if (status == TRUE) {
-		if (rename(tmpname, file) == -1) {
-			mce_log(LL_ERR,
-				"Failed to rename `%s' to `%s'; %s",
-				tmpname, file, g_strerror(errno));
+	g_free(slot->context);
+	g_free(slot->path);
+	g_free(slot);
+}
 
-			status = FALSE;
+/**
+ * Find the asynchronous output slot of an output
+ *
+ * Must be called with the writer mutex held
+ *
+ * @param output control structure for writing to a file
+ * @return The slot, or NULL if there is none
+ */
+static mce_io_writer_slot_t *mce_io_writer_find(const output_state_t *output)
+{
+	for (GSList *item = mce_io_writer_slots; item; item = item->next) {
+		mce_io_writer_slot_t *slot = item->data;
 
-			/* Ignore error */
-			errno = 0;
-			goto EXIT;
-		}
+		if (slot->output == output && !slot->closing)
+			return slot;
 	}
 
-EXIT:
-	g_free(tmpname);
-
-	return status;
+	return NULL;
 }
 
 /**
- * Callback for successful string I/O
+ * Mainloop handler for asynchronous write completion
  *
- * @param source The source of the activity
- * @param condition The I/O condition
- * @param data The iomon structure
- * @return Depending on error policy this function either exits
- *         or returns TRUE
+ * @param user_data The mce_io_writer_done_t report; freed here
+ * @param stamp Monotonic time of the completion, in microseconds
+ * @param value The number that was written
  */
-static gboolean io_string_cb(GIOChannel *source,
-			     GIOCondition condition,
-			     gpointer data)
+static void mce_io_writer_done_cb(gpointer user_data, gint64 stamp,
+				  gdouble value)
 {
-	iomon_struct *iomon = data;
-	gchar *str = NULL;
-	gsize bytes_read;
-	GError *error = NULL;
-	gboolean status = TRUE;
+	mce_io_writer_done_t *done = user_data;
+	gboolean open;
 
-	/* Silence warnings */
-	(void)condition;
+	if (done->call_cb) {
+		done->call_cb(done->call_data);
+		goto EXIT;
+	}
 
-	if (iomon == NULL) {
-		mce_log(LL_CRIT, "iomon == NULL!");
-		status = FALSE;
+	if (done->err != 0) {
+		mce_log(LL_WARN, "%s: can't write %lu: %s",
+			done->context, (gulong)value, g_strerror(done->err));
 		goto EXIT;
 	}
 
-	iomon->latest_io_condition = 0;
+	mce_log(LL_DEBUG, "%s: wrote %lu", done->context, (gulong)value);
 
-	/* Seek to the beginning of the file before reading if needed */
-	if (iomon->rewind == TRUE) {
-		g_io_channel_seek_position(source, 0, G_SEEK_SET, &error);
+	if (!done->written_cb)
+		goto EXIT;
 
-		if( error ) {
-			mce_log(LL_ERR,	"%s: seek error: %s",
-				iomon->file, error->message);
-		}
-		/* Reset errno,
-		 * to avoid false positives down the line
-		 */
-		errno = 0;
-		g_clear_error(&error);
-	}
+	/* The owner of a closed output may be gone already */
+	pthread_mutex_lock(&mce_io_writer_mutex);
+	open = (mce_io_writer_find(done->output) != NULL);
+	pthread_mutex_unlock(&mce_io_writer_mutex);
 
-	g_io_channel_read_line(source, &str, &bytes_read, NULL, &error);
+	if (open)
+		done->written_cb((gulong)value, stamp);
 
-	/* Errors and empty reads are nasty */
-	if (error != NULL) {
-		mce_log(LL_ERR,
-			"Error when reading from %s: %s",
-			iomon->file, error->message);
-		status = FALSE;
-	} else if ((bytes_read == 0) || (str == NULL) || (strlen(str) == 0)) {
-		mce_log(LL_ERR,
-			"Empty read from %s",
-			iomon->file);
-	} else {
-		(void)iomon->callback(str, bytes_read);
-	}
+EXIT:
 
-	g_free(str);
+	g_free(done->context);
+	g_free(done);
+}
 
-	/* Reset errno,
-	 * to avoid false positives down the line
-	 */
-	errno = 0;
-	g_clear_error(&error);
+/**
+ * Idle callback for asynchronous write completion
+ *
+ * Used when the completion can't be posted to the mainloop
+ *
+ * @param aptr The mce_io_writer_done_t report; freed here
+ * @return Always returns FALSE to disable the idle callback
+ */
+static gboolean mce_io_writer_done_idle_cb(gpointer aptr)
+{
+	mce_io_writer_done_t *done = aptr;
 
-EXIT:
-	if ((status == FALSE) &&
-	    (iomon != NULL) &&
-	    (iomon->error_policy == MCE_IO_ERROR_POLICY_EXIT)) {
-		// FIXME: this is not how one should exit from mainloop
-		mce_quit_mainloop();
-		exit(EXIT_FAILURE);
-	}
+	mce_io_writer_done_cb(done, done->stamp, done->number);
 
-	return TRUE;
+	return FALSE;
 }
+
 /**
- * Get glib io status as human readable string
+ * Report asynchronous write completion to the mainloop
  *
- * @param io_status as returned from g_io_channel_read_chars()
- * @return Name of the status enum, without the common prefix
+ * Called from the writer thread without holding the mutex
+ *
+ * @param done The completion report; ownership is transferred
  */
-
-static const char *io_status_name(GIOStatus io_status)
+static void mce_io_writer_report(mce_io_writer_done_t *done)
 {
-	const char *status_name = "UNKNOWN";
-	switch (io_status) {
-	case G_IO_STATUS_NORMAL: status_name = "NORMAL"; break;
-	case G_IO_STATUS_ERROR:  status_name = "ERROR";  break;
-	case G_IO_STATUS_EOF:    status_name = "EOF";    break;
-	case G_IO_STATUS_AGAIN:  status_name = "AGAIN";  break;
-	default: break; // ... just to keep static analysis happy
-	}
-	return status_name;
+	done->stamp = g_get_monotonic_time();
+
+	/* Completions must not get lost, e.g. fb power changes wait
+	 * for them; should the post queue be full, use an idle
+	 * callback instead */
+	if (!datapipe_post_call(mce_io_writer_done_cb, done,
+				done->stamp, done->number))
+		g_idle_add_full(G_PRIORITY_HIGH, mce_io_writer_done_idle_cb,
+				done, NULL);
 }
 
 /**
- * Callback for successful chunk I/O
+ * Write one value to the file of an asynchronous output slot
  *
- * @param source The source of the activity
- * @param condition The I/O condition
- * @param data The iomon structure
- * @return Depending on error policy this function either exits
- *         or returns TRUE
+ * Called from the writer thread without holding the mutex
+ *
+ * @param slot The slot; busy must be set
+ * @param path Path to the file
+ * @param number The value to write
+ * @return 0 on success, or errno on failure
  */
-static gboolean io_chunk_cb(GIOChannel *source,
-			    GIOCondition condition,
-			    gpointer data)
+static int mce_io_writer_write(mce_io_writer_slot_t *slot,
+			       const char *path, gulong number)
 {
-	iomon_struct *iomon = data;
-	gchar *buffer = NULL;
-	gsize bytes_want = 4096;
-	gsize bytes_read = 0;
-	gsize chunks_read = 0;
-	gsize chunks_done = 0;
-	GIOStatus io_status;
-	GError *error = NULL;
-	gboolean status = TRUE;
-
-	/* Silence warnings */
-	(void)condition;
+	char data[32];
+	int len = mce_io_ulong_to_string(data, sizeof data, number);
+	int err = 0;
 
-	if (iomon == NULL) {
-		mce_log(LL_CRIT, "iomon == NULL!");
-		status = FALSE;
-		goto EXIT;
-	}
+	if (slot->fd == -1) {
+		int flags = O_WRONLY | O_CLOEXEC;
 
-	iomon->latest_io_condition = 0;
+		flags |= slot->truncate_file ? O_TRUNC : O_APPEND;
 
-	/* Seek to the beginning of the file before reading if needed */
-	if (iomon->rewind == TRUE) {
-		g_io_channel_seek_position(source, 0, G_SEEK_SET, &error);
-		if( error ) {
-			mce_log(LL_ERR,	"%s: seek error: %s",
-				iomon->file, error->message);
+		if ((slot->fd = open(path, flags)) == -1) {
+			err = errno;
+			goto EXIT;
 		}
-
-		/* Reset errno,
-		 * to avoid false positives down the line
-		 */
-		errno = 0;
-		g_clear_error(&error);
+	} else if (slot->truncate_file) {
+		/* Failure is expected for sysfs files; ignore */
+		if (ftruncate(slot->fd, 0) == -1)
+			errno = 0;
 	}
 
-	if( iomon->chunk_size < bytes_want ) {
-		bytes_want -= bytes_want % iomon->chunk_size;
+	errno = 0;
+
+	if (slot->truncate_file) {
+		if (pwrite(slot->fd, data, len, 0) != len)
+			err = errno ?: EIO;
 	} else {
-		bytes_want = iomon->chunk_size;
+		if (write(slot->fd, data, len) != len)
+			err = errno ?: EIO;
 	}
 
-	buffer = g_malloc(bytes_want);
+EXIT:
+	if (slot->fd != -1 && (slot->close_on_exit || err != 0))
+		close(slot->fd), slot->fd = -1;
 
-#ifdef ENABLE_WAKELOCKS
-	/* Since the locks on kernel side are released once all
-	 * events are read, we must obtain the userspace lock
-	 * before reading the available data */
-	wakelock_lock("mce_input_handler", -1);
-#endif
+	return err;
+}
 
-	io_status = g_io_channel_read_chars(source, buffer,
-					    bytes_want, &bytes_read, &error);
+/**
+ * Writer thread for asynchronous outputs
+ *
+ * Once asked to exit, the thread still writes the values that
+ * have been queued before exiting
+ *
+ * @param aptr Unused
+ * @return Always NULL
+ */
+static void *mce_io_writer_main(void *aptr)
+{
+	(void)aptr;
 
+	pthread_mutex_lock(&mce_io_writer_mutex);
 
-	/* If the read was interrupted, ignore */
-	if (io_status == G_IO_STATUS_AGAIN) {
-		g_clear_error(&error);
-	}
+	for (;;) {
+		mce_io_writer_slot_t *slot;
+		mce_io_writer_done_t *done;
+		gchar *path;
+		gulong number;
 
-	if( bytes_read % iomon->chunk_size ) {
-		mce_log(LL_WARN, "Incomplete chunks read from: %s", iomon->file);
-	}
+		if (!(slot = g_queue_pop_head(&mce_io_writer_queue))) {
+			if (mce_io_writer_exit)
+				break;
 
-	/* Process the data, and optionally ignore some of it */
-	if( (chunks_read = bytes_read / iomon->chunk_size) ) {
-		gchar *chunk = buffer;
-		for( ; chunks_done < chunks_read ; chunk += iomon->chunk_size ) {
-			++chunks_done;
-			if (iomon->callback(chunk, iomon->chunk_size) != TRUE) {
-				continue;
-			}
-			/* if possible, seek to the end of file */
-			if (iomon->seekable) {
-				g_io_channel_seek_position(iomon->iochan, 0,
-							   G_SEEK_END, &error);
-			}
-			/* in any case ignore rest of the data already read */
-			break;
+			pthread_cond_wait(&mce_io_writer_cond,
+					  &mce_io_writer_mutex);
+			continue;
 		}
-	}
 
-	mce_log(LL_INFO, "%s: status=%s, data=%d/%d=%d+%d, skipped=%d",
-		iomon->file, io_status_name(io_status),
-		bytes_read, (int)iomon->chunk_size, chunks_read,
-		bytes_read % (int)iomon->chunk_size, chunks_read - chunks_done);
+		done = g_malloc0(sizeof *done);
 
-#ifdef ENABLE_WAKELOCKS
-	/* Release the lock after we're done with processing it */
-	wakelock_unlock("mce_input_handler");
-#endif
+		if (slot->call_cb) {
+			/* Everything queued before has been written */
+			done->call_cb = slot->call_cb;
+			done->call_data = slot->call_data;
+			g_free(slot);
 
+			if (g_queue_is_empty(&mce_io_writer_queue))
+				pthread_cond_broadcast(&mce_io_writer_idle_cond);
 
-	g_free(buffer);
+			pthread_mutex_unlock(&mce_io_writer_mutex);
+			mce_io_writer_report(done);
+			pthread_mutex_lock(&mce_io_writer_mutex);
+			continue;
+		}
 
-	/* Were there any errors? */
-	if (error != NULL) {
-		mce_log(LL_ERR,
-			"Error when reading from %s: %s",
-			iomon->file, error->message);
+		slot->pending = FALSE;
+		slot->busy = TRUE;
+		number = slot->number;
+		path = g_strdup(slot->path);
+		done->output = slot->output;
+		done->context = g_strdup(slot->context);
+		done->written_cb = slot->written_cb;
+		done->number = number;
 
-		if ((error->code == G_IO_CHANNEL_ERROR_FAILED) &&
-		    (errno == ENODEV) &&
-		    (iomon->seekable)) {
-			errno = 0;
-			g_clear_error(&error);
-			g_io_channel_seek_position(iomon->iochan, 0,
-						   G_SEEK_END, &error);
-			if( error ) {
-				mce_log(LL_ERR,	"%s: seek error: %s",
-					iomon->file, error->message);
-			}
-		} else {
-			status = FALSE;
-		}
+		if (slot->reopen && slot->fd != -1)
+			close(slot->fd), slot->fd = -1;
+		slot->reopen = FALSE;
 
-		/* Reset errno,
-		 * to avoid false positives down the line
-		 */
-		errno = 0;
-		g_clear_error(&error);
-	} else if ((bytes_read == 0) &&
-		   (io_status != G_IO_STATUS_EOF) &&
-		   (io_status != G_IO_STATUS_AGAIN)) {
-		mce_log(LL_ERR,
-			"Empty read from %s",
-			iomon->file);
-	}
+		pthread_mutex_unlock(&mce_io_writer_mutex);
 
-EXIT:
-	if ((status == FALSE) &&
-	    (iomon != NULL) &&
-	    (iomon->error_policy == MCE_IO_ERROR_POLICY_EXIT)) {
-		// FIXME: this is not how one should exit from mainloop
-		mce_quit_mainloop();
-		exit(EXIT_FAILURE);
+		done->err = mce_io_writer_write(slot, path, number);
+
+		pthread_mutex_lock(&mce_io_writer_mutex);
+
+		slot->busy = FALSE;
+		slot->failed = (done->err != 0);
+
+		if (slot->closing)
+			mce_io_writer_slot_free(slot);
+
+		if (g_queue_is_empty(&mce_io_writer_queue))
+			pthread_cond_broadcast(&mce_io_writer_idle_cond);
+
+		pthread_mutex_unlock(&mce_io_writer_mutex);
+
+		/* Report completion to the mainloop */
+		mce_io_writer_report(done);
+
+		g_free(path);
+
+		pthread_mutex_lock(&mce_io_writer_mutex);
 	}
 
-	return TRUE;
+	pthread_mutex_unlock(&mce_io_writer_mutex);
+
+	return NULL;
 }
 
 /**
- * Callback for I/O errors
+ * Check whether the latest asynchronous write of an output failed
  *
- * @param source Unused
- * @param condition The GIOCondition for the error
- * @param data The iomon structure
- * @return Depending on error policy this function either exits
- *         or returns TRUE
+ * @param output control structure for writing to a file
+ * @return TRUE if the latest write failed, FALSE otherwise
  */
-static gboolean io_error_cb(GIOChannel *source,
-			    GIOCondition condition,
-			    gpointer data)
+static gboolean mce_io_writer_failed(const output_state_t *output)
 {
-	iomon_struct *iomon = data;
-	gboolean exit_on_error = FALSE;
-	loglevel_t loglevel;
+	mce_io_writer_slot_t *slot;
+	gboolean failed = FALSE;
 
-	/* Silence warnings */
-	(void)source;
+	pthread_mutex_lock(&mce_io_writer_mutex);
 
-	if (iomon == NULL) {
-		mce_log(LL_CRIT, "iomon == NULL!");
-		goto EXIT;
-	}
+	if ((slot = mce_io_writer_find(output)))
+		failed = slot->failed;
 
-	switch (iomon->error_policy) {
-	case MCE_IO_ERROR_POLICY_EXIT:
-		exit_on_error = TRUE;
-		loglevel = LL_CRIT;
-		break;
+	pthread_mutex_unlock(&mce_io_writer_mutex);
 
-	case MCE_IO_ERROR_POLICY_WARN:
-		loglevel = LL_WARN;
-		break;
+	return failed;
+}
 
-	case MCE_IO_ERROR_POLICY_IGNORE:
-	default:
-		/* No log message when ignoring errors */
-		loglevel = LL_NONE;
-		break;
-	}
+/**
+ * Queue a value to be written by the writer thread
+ *
+ * If an older value for the same output has not been written yet,
+ * it is replaced by the new one
+ *
+ * @param output control structure for writing to a file
+ * @param number The number to write
+ * @return TRUE if the value was queued, FALSE on failure
+ */
+static gboolean mce_io_writer_queue_number(output_state_t *output,
+					   const gulong number)
+{
+	gboolean status = FALSE;
+	mce_io_writer_slot_t *slot;
 
-	/* We just got an I/O condition we've already reported
-	 * since the last successful read; don't log
-	 */
-	if ((exit_on_error == FALSE) &&
-	    ((iomon->latest_io_condition & condition) == condition)) {
-		loglevel = LL_NONE;
-	} else {
-		iomon->latest_io_condition |= condition;
-	}
+	pthread_mutex_lock(&mce_io_writer_mutex);
 
-	if (loglevel != LL_NONE) {
-		mce_log(loglevel,
-			"Error accessing %s (condition: %d). %s",
-			iomon->file, condition,
-			(exit_on_error == TRUE) ? "Exiting" : "Ignoring");
+	if (!mce_io_writer_running) {
+		mce_io_writer_exit = FALSE;
+
+		if (pthread_create(&mce_io_writer_thread, NULL,
+				   mce_io_writer_main, NULL) != 0) {
+			mce_log(LL_ERR, "%s: can't start writer thread",
+				output->context);
+			goto EXIT;
+		}
+
+		mce_io_writer_running = TRUE;
 	}
 
-EXIT:
-	if ((iomon != NULL) && (exit_on_error == TRUE)) {
-		// FIXME: this is not how one should exit from mainloop
-		mce_quit_mainloop();
-		exit(EXIT_FAILURE);
+	if (!(slot = mce_io_writer_find(output))) {
+		slot = g_malloc0(sizeof *slot);
+		slot->output = output;
+		slot->context = g_strdup(output->context);
+		slot->path = g_strdup(output->path);
+		slot->fd = -1;
+		mce_io_writer_slots = g_slist_prepend(mce_io_writer_slots,
+						      slot);
+	} else if (strcmp(slot->path, output->path)) {
+		g_free(slot->path);
+		slot->path = g_strdup(output->path);
+		slot->reopen = TRUE;
 	}
 
-	/* Call error callback if set */
-	if (iomon->err_callback) {
-		iomon->err_callback(iomon, condition);
+	slot->truncate_file = output->truncate_file;
+	slot->close_on_exit = output->close_on_exit;
+	slot->written_cb = output->written_cb;
+	slot->number = number;
+
+	if (!slot->pending) {
+		slot->pending = TRUE;
+		g_queue_push_tail(&mce_io_writer_queue, slot);
+		pthread_cond_signal(&mce_io_writer_cond);
 	}
 
-	return TRUE;
+	status = TRUE;
+
+EXIT:
+	pthread_mutex_unlock(&mce_io_writer_mutex);
+
+	return status;
 }
 
 /**
- * Suspend an I/O monitor
+ * Release the asynchronous output slot of an output
  *
- * @param io_monitor A pointer to the I/O monitor to suspend
+ * A value that has not been written yet, or a write that is in
+ * progress, is finished by the writer thread before the file is
+ * closed; the written_cb of the output is not called for it
+ *
+ * @param output control structure for writing to a file
  */
-void mce_suspend_io_monitor(gconstpointer io_monitor)
+static void mce_io_writer_close(const output_state_t *output)
 {
-	iomon_struct *iomon = (iomon_struct *)io_monitor;
+	mce_io_writer_slot_t *slot;
 
-	if (iomon == NULL) {
-		mce_log(LL_CRIT, "iomon == NULL!");
-		goto EXIT;
+	pthread_mutex_lock(&mce_io_writer_mutex);
+
+	if ((slot = mce_io_writer_find(output))) {
+		slot->closing = TRUE;
+
+		if (!slot->busy && !slot->pending)
+			mce_io_writer_slot_free(slot);
+	}
+
+	pthread_mutex_unlock(&mce_io_writer_mutex);
+}
+
+/**
+ * Check whether the writer thread has values queued or in progress
+ *
+ * Must be called with the writer mutex held
+ *
+ * @return TRUE if the writer thread is busy, FALSE if it is idle
+ */
+static gboolean mce_io_writer_busy(void)
+{
+	gboolean busy = FALSE;
+
+	if (!mce_io_writer_running)
+		goto EXIT;
+
+	busy = !g_queue_is_empty(&mce_io_writer_queue);
+
+	for (GSList *item = mce_io_writer_slots; item && !busy;
+	     item = item->next) {
+		mce_io_writer_slot_t *slot = item->data;
+
+		busy = slot->busy;
+	}
+
+EXIT:
+	return busy;
+}
+
+/**
+ * Call a function once the values queued so far have been written
+ *
+ * Orders operations after the asynchronous writes that are still in
+ * flight without blocking the mainloop. If nothing is queued, the
+ * function is called right away; otherwise it is called from the
+ * mainloop after the completions of the earlier writes.
+ *
+ * @param cb The function to call
+ * @param data The data to pass to the function
+ */
+void mce_io_writer_after(void (*cb)(gpointer data), gpointer data)
+{
+	mce_io_writer_slot_t *slot = NULL;
+
+	pthread_mutex_lock(&mce_io_writer_mutex);
+
+	if (mce_io_writer_busy()) {
+		slot = g_malloc0(sizeof *slot);
+		slot->call_cb = cb;
+		slot->call_data = data;
+		slot->fd = -1;
+		g_queue_push_tail(&mce_io_writer_queue, slot);
+		pthread_cond_signal(&mce_io_writer_cond);
+	}
+
+	pthread_mutex_unlock(&mce_io_writer_mutex);
+
+	if (!slot)
+		cb(data);
+}
+
+/**
+ * Wait until the writer thread has written all queued values
+ *
+ * Acts as a barrier for operations that must not be reordered with
+ * asynchronous writes that are still in flight, e.g. frame buffer
+ * power changes or LED engine mode writes
+ */
+void mce_io_writer_sync(void)
+{
+	pthread_mutex_lock(&mce_io_writer_mutex);
+
+	while (mce_io_writer_busy()) {
+		pthread_cond_wait(&mce_io_writer_idle_cond,
+				  &mce_io_writer_mutex);
+	}
+
+	pthread_mutex_unlock(&mce_io_writer_mutex);
+}
+
+/**
+ * Stop the writer thread and release all asynchronous outputs
+ *
+ * Values that have not been written yet are written before the
+ * thread exits, so that e.g. the last brightness value set before
+ * shutdown is not lost
+ */
+void mce_io_writer_quit(void)
+{
+	pthread_mutex_lock(&mce_io_writer_mutex);
+
+	if (!mce_io_writer_running) {
+		pthread_mutex_unlock(&mce_io_writer_mutex);
+		goto EXIT;
+	}
+
+	mce_io_writer_exit = TRUE;
+	pthread_cond_signal(&mce_io_writer_cond);
+	pthread_mutex_unlock(&mce_io_writer_mutex);
+
+	pthread_join(mce_io_writer_thread, NULL);
+
+	pthread_mutex_lock(&mce_io_writer_mutex);
+
+	mce_io_writer_running = FALSE;
+
+	while (mce_io_writer_slots)
+		mce_io_writer_slot_free(mce_io_writer_slots->data);
+
+	pthread_mutex_unlock(&mce_io_writer_mutex);
+
+EXIT:
+	return;
+}
+
+/**
+ * Cleanup function for output file control structures
+ *
+ * Closes file stream associated with output if it is open
+ *
+ * It is explicitly permitted to call this function:
+ * 1) with NULL output parameter
+ * 2) without open stream in ouput
+ * 3) more than one times
+ *
+ * @param output control structure for writing to a file
+ */
+
+void mce_close_output(output_state_t *output)
+{
+	if( !output )
+		return;
+
+	if( output->async )
+		mce_io_writer_close(output);
+
+	if( output->fd_open ) {
+		if( close(output->fd) == -1 ) {
+			mce_log(LL_WARN,"%s: can't close %s: %m", output->context, output->path);
+		}
+		output->fd = -1;
+		output->fd_open = FALSE;
+	}
+
+	if( output->write_count || output->skip_count ) {
+		mce_log(LL_DEBUG, "%s: %" G_GUINT64_FORMAT " writes, "
+			"%" G_GUINT64_FORMAT " skipped", output->context,
+			output->write_count, output->skip_count);
+	}
+
+	/* The file might change while it is not open */
+	output->written = FALSE;
+}
+
+/**
+ * Write a string representation of a number to a file
+ *
+ * Note: this variant uses in-place rewrites when truncating.
+ * It should thus not be used in cases where atomicity is expected.
+ * For atomic replace, use mce_write_number_string_to_file_atomic()
+ *
+ * If output->async is set, the value is only queued for the writer
+ * thread; write errors are then logged when the thread reports back
+ *
+ * @param output control structure for writing to a file
+ * @param number The number to write
+ *
+ * @return TRUE on success, FALSE on failure
+ */
+
+gboolean mce_write_number_string_to_file(output_state_t *output, const gulong number)
+{
+	gboolean status = FALSE; // assume failure
+	char data[32];
+	int size, done;
+
+	if( !output ) {
+		mce_log(LL_CRIT, "NULL output passed, terminating");
+		mce_abort();
+	}
+
+	if( !output->context ) {
+		mce_log(LL_CRIT, "output->context missing, terminating");
+		mce_abort();
+	}
+
+	if( !output->path ) {
+		if( !output->invalid_config_reported ) {
+			output->invalid_config_reported = TRUE;
+			mce_log(LL_ERR, "%s: output->path not configured", output->context);
+		}
+		goto EXIT;
+	}
+
+	/* Appended values are never skipped */
+	if( output->skip_unchanged && output->truncate_file &&
+	    output->written && output->last_written == number &&
+	    !(output->async && mce_io_writer_failed(output)) ) {
+		output->skip_count++;
+		status = TRUE;
+		goto EXIT;
+	}
+
+	output->written = FALSE;
+
+	if( output->async ) {
+		if( (status = mce_io_writer_queue_number(output, number)) )
+			goto WRITTEN;
+		goto EXIT;
+	}
+
+	if( !output->fd_open ) {
+		int flags = O_WRONLY | O_CLOEXEC;
+
+		flags |= output->truncate_file ? O_TRUNC : O_APPEND;
+
+		if( (output->fd = open(output->path, flags)) == -1 ) {
+			mce_log(LL_ERR,"%s: can't open %s: %m", output->context, output->path);
+			goto EXIT;
+		}
+		output->fd_open = TRUE;
+	}
+	else if( output->truncate_file )
+	{
+		if( ftruncate(output->fd, 0) == -1 ) {
+			mce_log(LL_WARN,"%s: can't truncate %s: %m", output->context, output->path);
+		}
+	}
+
+	size = mce_io_ulong_to_string(data, sizeof data, number);
+	done = output->truncate_file ?
+		pwrite(output->fd, data, size, 0) :
+		write(output->fd, data, size);
+
+	if( done != size ) {
+		mce_log(LL_WARN,"%s: can't write %s: %m", output->context, output->path);
+		goto EXIT;
+	}
+
+	if( output->written_cb )
+		output->written_cb(number, g_get_monotonic_time());
+
+WRITTEN:
+	status = TRUE;
+	output->written = TRUE;
+	output->last_written = number;
+	output->write_count++;
+
+EXIT:
+
+	if( output->close_on_exit && output->fd_open ) {
+		if( close(output->fd) == -1 ) {
+			mce_log(LL_WARN,"%s: can't close %s: %m", output->context, output->path);
+		}
+		output->fd = -1;
+		output->fd_open = FALSE;
+	}
+
+	return status;
+}
+
+/**
+ * Write a string representation of a number to a file
+ * in an atomic manner
+ *
+ * @param file Path to the file to write to
+ * @param number The number to write
+ * @return TRUE on success, FALSE on failure
+ */
+gboolean mce_write_number_string_to_file_atomic(const gchar *const file,
+						const gulong number)
+{
+	gboolean status = FALSE;
+	gchar *tmpname = NULL;
+	FILE *fp = NULL;
+	gint retval;
+	int fd;
+
+	if (file == NULL) {
+		mce_log(LL_CRIT,
+			"file == NULL");
+		goto EXIT;
+	}
+
+	if ((tmpname = g_strconcat(file, TMP_SUFFIX, NULL)) == NULL) {
+		mce_log(LL_ERR,
+			"Failed to allocate memory for `%s%s'",
+			file, TMP_SUFFIX);
+		goto EXIT;
+	}
+
+	/* If we cannot open the file, abort */
+	if ((fp = fopen(tmpname, "w")) == NULL) {
+		mce_log(LL_ERR,
+			"Cannot open `%s' for writing; %s",
+			tmpname, g_strerror(errno));
+
+		/* Ignore error */
+		errno = 0;
+		goto EXIT;
+	}
+
+	retval = fprintf(fp, "%lu", number);
+
+	/* Was the write successful? */
+	if (retval < 0) {
+		mce_log(LL_ERR,
+			"Failed to write to `%s'; %s",
+			tmpname, g_strerror(errno));
+
+		/* Ignore error */
+		errno = 0;
+		goto EXIT2;
+	}
+
+	if ((fd = fileno(fp)) == -1) {
+		mce_log(LL_ERR,
+			"Failed to convert *fp to fd; %s",
+			g_strerror(errno));
+
+		/* Ignore error */
+		errno = 0;
+		goto EXIT2;
+	}
+
+	/* Ensure that the data makes it to disk */
+	if (fsync(fd) == -1) {
+		mce_log(LL_ERR,
+			"Failed to fsync `%s'; %s",
+			tmpname, g_strerror(errno));
+
+		/* Ignore error */
+		errno = 0;
+		goto EXIT2;
+	}
+
+	status = TRUE;
+
+EXIT2:
+	/* Close the temporary file */
+	if (mce_close_file(tmpname, &fp) == FALSE) {
+		status = FALSE;
+		goto EXIT;
+	}
+
+	/* And if everything has been successful so far,
+	 * rename the temporary file over the old file
+	 */
+	if (status == TRUE) {
+		if (rename(tmpname, file) == -1) {
+			mce_log(LL_ERR,
+				"Failed to rename `%s' to `%s'; %s",
+				tmpname, file, g_strerror(errno));
+
+			status = FALSE;
+
+			/* Ignore error */
+			errno = 0;
+			goto EXIT;
+		}
+	}
+
+EXIT:
+	g_free(tmpname);
+
+	return status;
+}
+
+/**
+ * Account time spent in an I/O monitor callback
+ *
+ * @param iomon The I/O monitor
+ * @param started Monotonic time at the start of the callback
+ */
+static void iomon_stats_add_callback_time(iomon_struct *iomon,
+					  gint64 started)
+{
+	gint64 took = g_get_monotonic_time() - started;
+
+	if( took < 0 )
+		took = 0;
+
+	iomon->stats.calls++;
+	iomon->stats.callback_us += (guint64)took;
+
+	if( iomon->stats.callback_max_us < (guint64)took )
+		iomon->stats.callback_max_us = (guint)MIN(took, G_MAXUINT);
+}
+
+/**
+ * Account the delay from event time stamp to callback start
+ *
+ * Only for I/O monitors whose chunks start with a struct timeval
+ * in CLOCK_REALTIME, such as struct input_event from evdev
+ *
+ * @param iomon The I/O monitor
+ * @param chunk The chunk about to be passed to the callback
+ */
+static void iomon_stats_add_delay(iomon_struct *iomon, const gchar *chunk)
+{
+	struct timeval tv;
+	gint64 stamp;
+	gint64 delay;
+
+	if( !iomon->timestamped || iomon->chunk_size < sizeof tv )
+		goto EXIT;
+
+	memcpy(&tv, chunk, sizeof tv);
+	stamp = (gint64)tv.tv_sec * G_USEC_PER_SEC + tv.tv_usec;
+
+	/* Ignore events without a meaningful time stamp */
+	if( stamp <= 0 )
+		goto EXIT;
+
+	delay = g_get_real_time() - stamp;
+
+	/* Wall clock changes can make the delay negative */
+	if( delay < 0 )
+		goto EXIT;
+
+	iomon->stats.delays++;
+	iomon->stats.delay_us += (guint64)delay;
+
+	if( iomon->stats.delay_max_us < (guint64)delay )
+		iomon->stats.delay_max_us = (guint)MIN(delay, G_MAXUINT);
+
+EXIT:
+	return;
+}
+
+/**
+ * Callback for successful string I/O
+ *
+ * @param source The source of the activity
+ * @param condition The I/O condition
+ * @param data The iomon structure
+ * @return Depending on error policy this function either exits
+ *         or returns TRUE
+ */
+static gboolean io_string_cb(GIOChannel *source,
+			     GIOCondition condition,
+			     gpointer data)
+{
+	iomon_struct *iomon = data;
+	gchar *str = NULL;
+	gsize bytes_read;
+	GError *error = NULL;
+	gboolean status = TRUE;
+
+	/* Silence warnings */
+	(void)condition;
+
+	if (iomon == NULL) {
+		mce_log(LL_CRIT, "iomon == NULL!");
+		status = FALSE;
+		goto EXIT;
+	}
+
+	iomon->latest_io_condition = 0;
+	iomon->stats.wakeups++;
+
+	/* Seek to the beginning of the file before reading if needed */
+	if (iomon->rewind == TRUE) {
+		g_io_channel_seek_position(source, 0, G_SEEK_SET, &error);
+
+		if( error ) {
+			mce_log(LL_ERR,	"%s: seek error: %s",
+				iomon->file, error->message);
+		}
+		/* Reset errno,
+		 * to avoid false positives down the line
+		 */
+		errno = 0;
+		g_clear_error(&error);
+	}
+
+	g_io_channel_read_line(source, &str, &bytes_read, NULL, &error);
+
+	/* Errors and empty reads are nasty */
+	if (error != NULL) {
+		mce_log(LL_ERR,
+			"Error when reading from %s: %s",
+			iomon->file, error->message);
+		status = FALSE;
+	} else if ((bytes_read == 0) || (str == NULL) || (strlen(str) == 0)) {
+		mce_log(LL_ERR,
+			"Empty read from %s",
+			iomon->file);
+	} else {
+		gint64 started = g_get_monotonic_time();
+
+		iomon->stats.bytes += bytes_read;
+		iomon->stats.chunks++;
+		(void)iomon->callback(str, bytes_read);
+		iomon_stats_add_callback_time(iomon, started);
+	}
+
+	g_free(str);
+
+	/* Reset errno,
+	 * to avoid false positives down the line
+	 */
+	errno = 0;
+	g_clear_error(&error);
+
+EXIT:
+	if ((status == FALSE) &&
+	    (iomon != NULL) &&
+	    (iomon->error_policy == MCE_IO_ERROR_POLICY_EXIT)) {
+		// FIXME: this is not how one should exit from mainloop
+		mce_quit_mainloop();
+		exit(EXIT_FAILURE);
+	}
+
+	return TRUE;
+}
+/**
+ * Get glib io status as human readable string
+ *
+ * @param io_status as returned from g_io_channel_read_chars()
+ * @return Name of the status enum, without the common prefix
+ */
+
+static const char *io_status_name(GIOStatus io_status)
+{
+	const char *status_name = "UNKNOWN";
+	switch (io_status) {
+	case G_IO_STATUS_NORMAL: status_name = "NORMAL"; break;
+	case G_IO_STATUS_ERROR:  status_name = "ERROR";  break;
+	case G_IO_STATUS_EOF:    status_name = "EOF";    break;
+	case G_IO_STATUS_AGAIN:  status_name = "AGAIN";  break;
+	default: break; // ... just to keep static analysis happy
+	}
+	return status_name;
+}
+
+/**
+ * Callback for successful chunk I/O
+ *
+ * @param source The source of the activity
+ * @param condition The I/O condition
+ * @param data The iomon structure
+ * @return Depending on error policy this function either exits
+ *         or returns TRUE
+ */
+static gboolean io_chunk_cb(GIOChannel *source,
+			    GIOCondition condition,
+			    gpointer data)
+{
+	iomon_struct *iomon = data;
+	gsize bytes_read = 0;
+	gsize chunks_read = 0;
+	gsize chunks_done = 0;
+	GIOStatus io_status;
+	GError *error = NULL;
+	gboolean status = TRUE;
+
+	/* Silence warnings */
+	(void)condition;
+
+	if (iomon == NULL) {
+		mce_log(LL_CRIT, "iomon == NULL!");
+		status = FALSE;
+		goto EXIT;
+	}
+
+	iomon->latest_io_condition = 0;
+	iomon->stats.wakeups++;
+
+	/* Seek to the beginning of the file before reading if needed */
+	if (iomon->rewind == TRUE) {
+		g_io_channel_seek_position(source, 0, G_SEEK_SET, &error);
+		if( error ) {
+			mce_log(LL_ERR,	"%s: seek error: %s",
+				iomon->file, error->message);
+		}
+
+		/* Reset errno,
+		 * to avoid false positives down the line
+		 */
+		errno = 0;
+		g_clear_error(&error);
+	}
+
+#ifdef ENABLE_WAKELOCKS
+	/* Since the locks on kernel side are released once all
+	 * events are read, we must obtain the userspace lock
+	 * before reading the available data */
+	wakelock_lock("mce_input_handler", -1);
+#endif
+
+	io_status = g_io_channel_read_chars(source, iomon->buffer,
+					    iomon->buffer_size,
+					    &bytes_read, &error);
+
+
+	/* If the read was interrupted, ignore */
+	if (io_status == G_IO_STATUS_AGAIN) {
+		g_clear_error(&error);
+	}
+
+	if( bytes_read % iomon->chunk_size ) {
+		mce_log(LL_WARN, "Incomplete chunks read from: %s", iomon->file);
+	}
+
+	chunks_read = bytes_read / iomon->chunk_size;
+
+	iomon->stats.bytes += bytes_read;
+	iomon->stats.chunks += chunks_read;
+
+	if( chunks_read && iomon->batch_callback ) {
+		gint64 started = g_get_monotonic_time();
+		gboolean flush;
+
+		/* The oldest event is the one that has waited longest */
+		iomon_stats_add_delay(iomon, iomon->buffer);
+
+		/* Pass all complete chunks to the callback at once */
+		chunks_done = chunks_read;
+		flush = iomon->batch_callback(iomon, iomon->buffer,
+					      iomon->chunk_size,
+					      chunks_read);
+		iomon_stats_add_callback_time(iomon, started);
+
+		if( flush && iomon->seekable ) {
+			/* skip the data that has not been read yet */
+			iomon->stats.flushes++;
+			g_io_channel_seek_position(iomon->iochan, 0,
+						   G_SEEK_END, &error);
+		}
+	} else if( chunks_read ) {
+		/* Process the data, and optionally ignore some of it */
+		gchar *chunk = iomon->buffer;
+		gint64 started = g_get_monotonic_time();
+		gboolean flush = FALSE;
+
+		iomon_stats_add_delay(iomon, chunk);
+
+		for( ; chunks_done < chunks_read ; chunk += iomon->chunk_size ) {
+			++chunks_done;
+			if (iomon->callback(chunk, iomon->chunk_size) != TRUE) {
+				continue;
+			}
+			flush = TRUE;
+			break;
+		}
+		iomon_stats_add_callback_time(iomon, started);
+
+		if( flush ) {
+			/* if possible, seek to the end of file */
+			if (iomon->seekable) {
+				iomon->stats.flushes++;
+				g_io_channel_seek_position(iomon->iochan, 0,
+							   G_SEEK_END, &error);
+			}
+			/* in any case ignore rest of the data already read */
+			iomon->stats.skipped += chunks_read - chunks_done;
+		}
+	}
+
+	mce_log(LL_INFO, "%s: status=%s, data=%d/%d=%d+%d, skipped=%d",
+		iomon->file, io_status_name(io_status),
+		bytes_read, (int)iomon->chunk_size, chunks_read,
+		bytes_read % (int)iomon->chunk_size, chunks_read - chunks_done);
+
+#ifdef ENABLE_WAKELOCKS
+	/* Release the lock after we're done with processing it */
+	wakelock_unlock("mce_input_handler");
+#endif
+
+	/* Were there any errors? */
+	if ((error != NULL) &&
+	    (error->code == G_IO_CHANNEL_ERROR_FAILED) &&
+	    (errno == ENODEV) &&
+	    (iomon_detach(iomon) == TRUE)) {
+		/* Reopened once the device is back */
+		errno = 0;
+		g_clear_error(&error);
+	} else if (error != NULL) {
+		mce_log(LL_ERR,
+			"Error when reading from %s: %s",
+			iomon->file, error->message);
+
+		if ((error->code == G_IO_CHANNEL_ERROR_FAILED) &&
+		    (errno == ENODEV) &&
+		    (iomon->seekable)) {
+			errno = 0;
+			g_clear_error(&error);
+			g_io_channel_seek_position(iomon->iochan, 0,
+						   G_SEEK_END, &error);
+			if( error ) {
+				mce_log(LL_ERR,	"%s: seek error: %s",
+					iomon->file, error->message);
+			}
+		} else {
+			status = FALSE;
+		}
+
+		/* Reset errno,
+		 * to avoid false positives down the line
+		 */
+		errno = 0;
+		g_clear_error(&error);
+	} else if ((bytes_read == 0) &&
+		   (io_status != G_IO_STATUS_EOF) &&
+		   (io_status != G_IO_STATUS_AGAIN)) {
+		mce_log(LL_ERR,
+			"Empty read from %s",
+			iomon->file);
+	}
+
+EXIT:
+	if ((status == FALSE) &&
+	    (iomon != NULL) &&
+	    (iomon->error_policy == MCE_IO_ERROR_POLICY_EXIT)) {
+		// FIXME: this is not how one should exit from mainloop
+		mce_quit_mainloop();
+		exit(EXIT_FAILURE);
+	}
+
+	return TRUE;
+}
+
+/**
+ * Callback for I/O errors
+ *
+ * @param source Unused
+ * @param condition The GIOCondition for the error
+ * @param data The iomon structure
+ * @return Depending on error policy this function either exits
+ *         or returns TRUE
+ */
+static gboolean io_error_cb(GIOChannel *source,
+			    GIOCondition condition,
+			    gpointer data)
+{
+	iomon_struct *iomon = data;
+	gboolean exit_on_error = FALSE;
+	loglevel_t loglevel;
+
+	/* Silence warnings */
+	(void)source;
+
+	if (iomon == NULL) {
+		mce_log(LL_CRIT, "iomon == NULL!");
+		goto EXIT;
+	}
+
+	/* Monitors of hotpluggable files wait for the file to come back */
+	if (iomon_detach(iomon) == TRUE)
+		goto DETACHED;
+
+	switch (iomon->error_policy) {
+	case MCE_IO_ERROR_POLICY_EXIT:
+		exit_on_error = TRUE;
+		loglevel = LL_CRIT;
+		break;
+
+	case MCE_IO_ERROR_POLICY_WARN:
+		loglevel = LL_WARN;
+		break;
+
+	case MCE_IO_ERROR_POLICY_IGNORE:
+	default:
+		/* No log message when ignoring errors */
+		loglevel = LL_NONE;
+		break;
+	}
+
+	/* We just got an I/O condition we've already reported
+	 * since the last successful read; don't log
+	 */
+	if ((exit_on_error == FALSE) &&
+	    ((iomon->latest_io_condition & condition) == condition)) {
+		loglevel = LL_NONE;
+	} else {
+		iomon->latest_io_condition |= condition;
+	}
+
+	if (loglevel != LL_NONE) {
+		mce_log(loglevel,
+			"Error accessing %s (condition: %d). %s",
+			iomon->file, condition,
+			(exit_on_error == TRUE) ? "Exiting" : "Ignoring");
+	}
+
+EXIT:
+	if ((iomon != NULL) && (exit_on_error == TRUE)) {
+		// FIXME: this is not how one should exit from mainloop
+		mce_quit_mainloop();
+		exit(EXIT_FAILURE);
+	}
+
+	/* Call error callback if set */
+	if (iomon->err_callback) {
+		iomon->err_callback(iomon, condition);
+	}
+
+DETACHED:
+	return TRUE;
+}
+
+/**
+ * Convert GIOCondition bits to epoll event bits
+ *
+ * @param condition The GIOConditions to monitor
+ * @return epoll event mask
+ */
+static uint32_t iomon_epoll_events_from_condition(GIOCondition condition)
+{
+	uint32_t events = 0;
+
+	if (condition & G_IO_IN)
+		events |= EPOLLIN;
+	if (condition & G_IO_PRI)
+		events |= EPOLLPRI;
+	if (condition & G_IO_OUT)
+		events |= EPOLLOUT;
+
+	/* EPOLLERR and EPOLLHUP are always reported */
+	return events;
+}
+
+/**
+ * Convert epoll event bits to GIOCondition bits
+ *
+ * @param events epoll event mask
+ * @return GIOCondition bits
+ */
+static GIOCondition iomon_epoll_condition_from_events(uint32_t events)
+{
+	GIOCondition condition = 0;
+
+	if (events & EPOLLIN)
+		condition |= G_IO_IN;
+	if (events & EPOLLPRI)
+		condition |= G_IO_PRI;
+	if (events & EPOLLOUT)
+		condition |= G_IO_OUT;
+	if (events & EPOLLERR)
+		condition |= G_IO_ERR;
+	if (events & EPOLLHUP)
+		condition |= G_IO_HUP;
+
+	return condition;
+}
+
+/**
+ * GSource prepare function for the epoll source
+ *
+ * @param source Unused
+ * @param timeout Where to store the poll timeout
+ * @return Always FALSE; the source is ready only when the epoll fd is
+ */
+static gboolean iomon_epoll_prepare(GSource *source, gint *timeout)
+{
+	(void)source;
+
+	*timeout = -1;
+
+	return FALSE;
+}
+
+/**
+ * GSource check function for the epoll source
+ *
+ * @param source The epoll source
+ * @return TRUE if there are events to dispatch, FALSE otherwise
+ */
+static gboolean iomon_epoll_check(GSource *source)
+{
+	iomon_epoll_source_t *self = (iomon_epoll_source_t *)source;
+
+	return (self->pollfd.revents & G_IO_IN) != 0;
+}
+
+/**
+ * GSource dispatch function for the epoll source
+ *
+ * Reads the ready I/O monitors from the epoll fd and calls the
+ * data and error handlers in the same way separate GIOChannel
+ * watches would
+ *
+ * @param source The epoll source
+ * @param callback Unused
+ * @param user_data Unused
+ * @return Always TRUE to keep the source alive
+ */
+static gboolean iomon_epoll_dispatch(GSource *source, GSourceFunc callback,
+				     gpointer user_data)
+{
+	iomon_epoll_source_t *self = (iomon_epoll_source_t *)source;
+
+	(void)callback;
+	(void)user_data;
+
+	iomon_epoll_pending = epoll_wait(self->pollfd.fd, iomon_epoll_events,
+					 IOMON_EPOLL_EVENTS, 0);
+
+	if (iomon_epoll_pending == -1) {
+		if (errno != EINTR)
+			mce_log(LL_ERR, "epoll_wait: %s", g_strerror(errno));
+
+		iomon_epoll_pending = 0;
+		errno = 0;
+		goto EXIT;
+	}
+
+	for (int i = 0; i < iomon_epoll_pending; ++i) {
+		iomon_struct *iomon = iomon_epoll_events[i].data.ptr;
+		GIOCondition condition;
+
+		/* Skip monitors removed or suspended by earlier handlers */
+		if (iomon == NULL || iomon->suspended)
+			continue;
+
+		condition = iomon_epoll_condition_from_events(iomon_epoll_events[i].events);
+
+		if (condition & iomon->monitored_io_conditions) {
+			switch (iomon->type) {
+			case IOMON_STRING:
+				io_string_cb(iomon->iochan, condition, iomon);
+				break;
+
+			case IOMON_CHUNK:
+				io_chunk_cb(iomon->iochan, condition, iomon);
+				break;
+
+			case IOMON_UNSET:
+			default:
+				break;
+			}
+		}
+
+		/* The data handler might have removed the monitor */
+		if (iomon_epoll_events[i].data.ptr == NULL || iomon->suspended)
+			continue;
+
+		if (condition & G_IO_HUP)
+			io_error_cb(iomon->iochan, condition, iomon);
+	}
+
+	iomon_epoll_pending = 0;
+
+EXIT:
+	return TRUE;
+}
+
+/**
+ * GSource finalize function for the epoll source
+ *
+ * @param source The epoll source
+ */
+static void iomon_epoll_finalize(GSource *source)
+{
+	iomon_epoll_source_t *self = (iomon_epoll_source_t *)source;
+
+	if (self->pollfd.fd != -1)
+		close(self->pollfd.fd), self->pollfd.fd = -1;
+}
+
+/** GSource functions for the epoll source */
+static GSourceFuncs iomon_epoll_funcs = {
+	.prepare  = iomon_epoll_prepare,
+	.check    = iomon_epoll_check,
+	.dispatch = iomon_epoll_dispatch,
+	.finalize = iomon_epoll_finalize,
+};
+
+/**
+ * Get the epoll fd, creating the epoll source if needed
+ *
+ * @return epoll file descriptor, or -1 on failure
+ */
+static int iomon_epoll_get_fd(void)
+{
+	GSource *source = NULL;
+	int fd = -1;
+
+	if (iomon_epoll_source != NULL)
+		goto EXIT;
+
+	if ((fd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+		mce_log(LL_ERR, "epoll_create1: %s", g_strerror(errno));
+		errno = 0;
+		goto EXIT;
+	}
+
+	source = g_source_new(&iomon_epoll_funcs,
+			      sizeof (iomon_epoll_source_t));
+	iomon_epoll_source = (iomon_epoll_source_t *)source;
+
+	iomon_epoll_source->pollfd.fd = fd;
+	iomon_epoll_source->pollfd.events = G_IO_IN;
+	iomon_epoll_source->pollfd.revents = 0;
+
+	g_source_add_poll(source, &iomon_epoll_source->pollfd);
+	g_source_attach(source, NULL);
+
+EXIT:
+	return iomon_epoll_source ? iomon_epoll_source->pollfd.fd : -1;
+}
+
+/**
+ * Release the epoll source once no I/O monitors are using it
+ */
+static void iomon_epoll_release(void)
+{
+	if (iomon_epoll_source == NULL || iomon_epoll_count != 0)
+		goto EXIT;
+
+	g_source_destroy(&iomon_epoll_source->source);
+	g_source_unref(&iomon_epoll_source->source);
+	iomon_epoll_source = NULL;
+
+EXIT:
+	return;
+}
+
+/**
+ * Add an I/O monitor to the epoll set
+ *
+ * Files that do not support polling, such as regular files,
+ * can not be added to epoll sets; the monitor then uses
+ * GIOChannel watches instead
+ *
+ * @param iomon The I/O monitor
+ */
+static void iomon_epoll_add(iomon_struct *iomon)
+{
+	struct epoll_event ev;
+	int epfd;
+
+	iomon->epoll = FALSE;
+
+	if ((epfd = iomon_epoll_get_fd()) == -1)
+		goto EXIT;
+
+	/* Monitors start suspended; see iomon_epoll_modify() */
+	memset(&ev, 0, sizeof ev);
+	ev.events = EPOLLONESHOT;
+	ev.data.ptr = iomon;
+
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD,
+		      g_io_channel_unix_get_fd(iomon->iochan), &ev) == -1) {
+		mce_log(LL_DEBUG, "%s: not using epoll: %s",
+			iomon->file, g_strerror(errno));
+		errno = 0;
+		goto EXIT;
+	}
+
+	iomon->epoll = TRUE;
+	++iomon_epoll_count;
+
+EXIT:
+	if (iomon->epoll == FALSE)
+		iomon_epoll_release();
+}
+
+/**
+ * Remove an I/O monitor from the epoll set
+ *
+ * @param iomon The I/O monitor
+ */
+static void iomon_epoll_remove(iomon_struct *iomon)
+{
+	if (iomon->epoll == FALSE)
+		goto EXIT;
+
+	/* Forget events of this monitor that are being dispatched */
+	for (int i = 0; i < iomon_epoll_pending; ++i) {
+		if (iomon_epoll_events[i].data.ptr == iomon)
+			iomon_epoll_events[i].data.ptr = NULL;
+	}
+
+	if (epoll_ctl(iomon_epoll_source->pollfd.fd, EPOLL_CTL_DEL,
+		      g_io_channel_unix_get_fd(iomon->iochan), NULL) == -1) {
+		mce_log(LL_DEBUG, "%s: EPOLL_CTL_DEL: %s",
+			iomon->file, g_strerror(errno));
+		errno = 0;
+	}
+
+	iomon->epoll = FALSE;
+	--iomon_epoll_count;
+	iomon_epoll_release();
+
+EXIT:
+	return;
+}
+
+/**
+ * Update the epoll events an I/O monitor is waiting for
+ *
+ * The kernel always adds EPOLLERR and EPOLLHUP to the mask, so a
+ * suspended monitor is set to EPOLLONESHOT mode; it is then disabled
+ * after at most one error report instead of keeping the mainloop busy
+ *
+ * @param iomon The I/O monitor
+ * @param events epoll event mask; EPOLLONESHOT to suspend
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean iomon_epoll_modify(iomon_struct *iomon, uint32_t events)
+{
+	struct epoll_event ev;
+	gboolean status = FALSE;
+
+	memset(&ev, 0, sizeof ev);
+	ev.events = events;
+	ev.data.ptr = iomon;
+
+	if (epoll_ctl(iomon_epoll_source->pollfd.fd, EPOLL_CTL_MOD,
+		      g_io_channel_unix_get_fd(iomon->iochan), &ev) == -1) {
+		mce_log(LL_ERR, "%s: EPOLL_CTL_MOD: %s",
+			iomon->file, g_strerror(errno));
+		errno = 0;
+		goto EXIT;
+	}
+
+	status = TRUE;
+
+EXIT:
+	return status;
+}
+
+/**
+ * Suspend an I/O monitor
+ *
+ * @param io_monitor A pointer to the I/O monitor to suspend
+ */
+void mce_suspend_io_monitor(gconstpointer io_monitor)
+{
+	iomon_struct *iomon = (iomon_struct *)io_monitor;
+
+	if (iomon == NULL) {
+		mce_log(LL_CRIT, "iomon == NULL!");
+		goto EXIT;
+	}
+
+	/* Only remember the state until the file is reopened */
+	if (iomon->detached == TRUE) {
+		iomon->resume_on_attach = FALSE;
+		goto EXIT;
+	}
+
+	if (iomon->suspended == TRUE)
+		goto EXIT;
+
+	if (iomon->epoll) {
+		/* Keep the fd in the epoll set, but stop waiting for it */
+		iomon_epoll_modify(iomon, EPOLLONESHOT);
+	} else {
+		/* Remove I/O watches */
+		g_source_remove(iomon->data_source_id);
+		g_source_remove(iomon->error_source_id);
+	}
+
+	iomon->suspended = TRUE;
+
+EXIT:
+	return;
+}
+
+/**
+ * Resume an I/O monitor
+ *
+ * @param io_monitor A pointer to the I/O monitor to resume
+ */
+void mce_resume_io_monitor(gconstpointer io_monitor)
+{
+	iomon_struct *iomon = (iomon_struct *)io_monitor;
+	GIOFunc callback = NULL;
+
+	if (iomon == NULL) {
+		mce_log(LL_CRIT, "iomon == NULL!");
+		goto EXIT;
+	}
+
+	/* Only remember the state until the file is reopened */
+	if (iomon->detached == TRUE) {
+		iomon->resume_on_attach = TRUE;
+		goto EXIT;
+	}
+
+	if (iomon->suspended == FALSE)
+		goto EXIT;
+
+	switch (iomon->type) {
+	case IOMON_STRING:
+		callback = io_string_cb;
+		break;
+
+	case IOMON_CHUNK:
+		callback = io_chunk_cb;
+		break;
+
+	case IOMON_UNSET:
+	default:
+		break;
+	}
+
+	if (callback != NULL) {
+		GError *error = NULL;
+
+		/* Seek to the end of the file if the file is seekable,
+		 * unless we use the rewind policy
+		 */
+		if (iomon->seekable && !iomon->rewind) {
+			g_io_channel_seek_position(iomon->iochan, 0,
+						   G_SEEK_END, &error);
+			if( error ) {
+				mce_log(LL_ERR,	"%s: seek error: %s",
+					iomon->file, error->message);
+			}
+			/* Reset errno,
+			 * to avoid false positives down the line
+			 */
+			errno = 0;
+			g_clear_error(&error);
+		}
+
+		if (iomon->epoll) {
+			uint32_t events = iomon_epoll_events_from_condition(iomon->monitored_io_conditions);
+
+			if (!iomon_epoll_modify(iomon, events))
+				goto EXIT;
+		} else {
+			iomon->error_source_id = g_io_add_watch(iomon->iochan,
+								G_IO_HUP | G_IO_NVAL,
+								io_error_cb, iomon);
+			iomon->data_source_id = g_io_add_watch(iomon->iochan,
+							       iomon->monitored_io_conditions,
+							       callback, iomon);
+		}
+		iomon->suspended = FALSE;
+	} else {
+		mce_log(LL_ERR,
+			"Failed to resume `%s'; invalid callback",
+			iomon->file);
+	}
+
+EXIT:
+	return;
+}
+/**
+ * Check if the monitored io channel is truly seekable
+ *
+ * Glib seems to be making guesses based on file type and
+ * gets it massively wrong for the files MCE needs to read.
+ */
+
+static void mce_determine_io_monitor_seekable(iomon_struct *iomon)
+{
+	gboolean glib = FALSE, kernel = FALSE;
+
+	/* glib assumes ... */
+	if (g_io_channel_get_flags(iomon->iochan) & G_IO_FLAG_IS_SEEKABLE) {
+		glib = TRUE;
+	}
+	/* ... kernel knows */
+	if (lseek64(g_io_channel_unix_get_fd(iomon->iochan), 0, SEEK_CUR) != -1) {
+		kernel = TRUE;
+	}
+	/* report the difference */
+	if (kernel != glib) {
+		mce_log(LL_DEBUG, "%s: is %sseekable, while glib thinks it is %sseekable",
+			iomon->file, kernel ? "" : "NOT ", glib ? "" : "NOT ");
+	}
+
+	iomon->seekable = kernel;
+}
+
+/**
+ * Configure the I/O channel of a chunk I/O monitor
+ *
+ * @param iomon The I/O monitor
+ */
+static void iomon_setup_chunk_channel(iomon_struct *iomon)
+{
+	GError *error = NULL;
+
+	/* We only read this file in binary form */
+	(void)g_io_channel_set_encoding(iomon->iochan, NULL, &error);
+
+	/* No buffering since we're using this for reading data from
+	 * device drivers and need to keep the i/o state in sync
+	 * between kernel and user space for the automatic suspend
+	 * prevention via wakelocks to work
+	 */
+	g_io_channel_set_buffered(iomon->iochan, FALSE);
+
+	/* Reset errno,
+	 * to avoid false positives down the line
+	 */
+	errno = 0;
+	g_clear_error(&error);
+
+	/* Don't block */
+	(void)g_io_channel_set_flags(iomon->iochan, G_IO_FLAG_NONBLOCK, &error);
+
+	/* Reset errno,
+	 * to avoid false positives down the line
+	 */
+	errno = 0;
+	g_clear_error(&error);
+}
+
+/**
+ * Close the I/O channel of an I/O monitor that opened the file itself
+ *
+ * @param iomon The I/O monitor
+ */
+static void iomon_close_channel(iomon_struct *iomon)
+{
+	GIOStatus iostatus;
+	GError *error = NULL;
+
+	if (iomon->iochan == NULL)
+		goto EXIT;
+
+	/* We can close this I/O channel, since it's not an external fd */
+	if (iomon->fd == -1) {
+		iostatus = g_io_channel_shutdown(iomon->iochan, TRUE, &error);
+
+		if (iostatus != G_IO_STATUS_NORMAL) {
+			loglevel_t loglevel = LL_ERR;
+
+			/* If we get ENODEV, only log a debug message,
+			 * since this happens for hotpluggable
+			 * /dev/input files
+			 */
+			if ((error->code == G_IO_CHANNEL_ERROR_FAILED) &&
+			    (errno == ENODEV))
+				loglevel = LL_DEBUG;
+
+			mce_log(loglevel,
+				"Cannot close `%s'; %s",
+				iomon->file, error->message);
+		}
+
+		/* Reset errno,
+		 * to avoid false positives down the line
+		 */
+		errno = 0;
+		g_clear_error(&error);
+	}
+
+	g_io_channel_unref(iomon->iochan);
+	iomon->iochan = NULL;
+
+EXIT:
+	return;
+}
+
+/**
+ * Stop waiting for the file of a detached I/O monitor
+ *
+ * @param iomon The I/O monitor
+ */
+static void iomon_reopen_cancel(iomon_struct *iomon)
+{
+	if (iomon->reopen_timer_id) {
+		g_source_remove(iomon->reopen_timer_id);
+		iomon->reopen_timer_id = 0;
+	}
+
+	if (iomon->reopen_watcher) {
+		filewatcher_delete(iomon->reopen_watcher);
+		iomon->reopen_watcher = NULL;
+	}
+}
+
+/**
+ * Try to reopen the file of a detached I/O monitor
+ *
+ * @param iomon The I/O monitor
+ * @return TRUE if the file was reopened, FALSE otherwise
+ */
+static gboolean iomon_reattach(iomon_struct *iomon)
+{
+	gboolean status = FALSE;
+	GError *error = NULL;
+
+	iomon->iochan = g_io_channel_new_file(iomon->file, "r", &error);
+
+	if (iomon->iochan == NULL) {
+		mce_log(LL_DEBUG, "%s: still not available; %s",
+			iomon->file, error->message);
+		goto EXIT;
 	}
 
-	if (iomon->suspended == TRUE)
+	iomon_setup_chunk_channel(iomon);
+	mce_determine_io_monitor_seekable(iomon);
+
+	/* The reopened file might differ in seekability */
+	iomon->rewind = (iomon->rewind_policy && iomon->seekable);
+
+	iomon_reopen_cancel(iomon);
+	iomon->reopen_delay_ms = IOMON_REOPEN_DELAY_MIN_MS;
+	iomon->detached = FALSE;
+	iomon->latest_io_condition = 0;
+	iomon->stats.reopens++;
+
+	mce_log(LL_NOTICE, "%s: reopened", iomon->file);
+
+	/* Restore the state the monitor had when the file was lost */
+	iomon->suspended = TRUE;
+	iomon_epoll_add(iomon);
+
+	if (iomon->resume_on_attach)
+		mce_resume_io_monitor(iomon);
+
+	status = TRUE;
+
+EXIT:
+	/* Reset errno,
+	 * to avoid false positives down the line
+	 */
+	errno = 0;
+	g_clear_error(&error);
+
+	return status;
+}
+
+/**
+ * Timer callback for reopening the file of a detached I/O monitor
+ *
+ * Each failed attempt doubles the delay to the next one, up to
+ * IOMON_REOPEN_DELAY_MAX_MS
+ *
+ * @param data The I/O monitor
+ * @return FALSE to stop the timer
+ */
+static gboolean iomon_reopen_timer_cb(gpointer data)
+{
+	iomon_struct *iomon = data;
+
+	iomon->reopen_timer_id = 0;
+
+	if (iomon_reattach(iomon) == TRUE)
 		goto EXIT;
 
-	/* Remove I/O watches */
-	g_source_remove(iomon->data_source_id);
-	g_source_remove(iomon->error_source_id);
+	iomon->reopen_delay_ms = MIN(iomon->reopen_delay_ms * 2,
+				     IOMON_REOPEN_DELAY_MAX_MS);
 
-	iomon->suspended = TRUE;
+	iomon->reopen_timer_id = g_timeout_add(iomon->reopen_delay_ms,
+					       iomon_reopen_timer_cb, iomon);
 
 EXIT:
-	return;
+	return FALSE;
 }
 
 /**
- * Resume an I/O monitor
+ * Filewatcher callback for the file of a detached I/O monitor
  *
- * @param io_monitor A pointer to the I/O monitor to resume
+ * Moves the next reopen attempt to the next mainloop iteration;
+ * the backoff delay is left as is so that a file that keeps
+ * reappearing in a broken state does not cause a busy loop
+ *
+ * @param path Directory of the file
+ * @param file Name of the file
+ * @param user_data The I/O monitor
  */
-void mce_resume_io_monitor(gconstpointer io_monitor)
+static void iomon_reopen_watch_cb(const char *path, const char *file,
+				  gpointer user_data)
 {
-	iomon_struct *iomon = (iomon_struct *)io_monitor;
-	GIOFunc callback = NULL;
+	iomon_struct *iomon = user_data;
 
-	if (iomon == NULL) {
-		mce_log(LL_CRIT, "iomon == NULL!");
-		goto EXIT;
-	}
+	(void)path;
+	(void)file;
 
-	if (iomon->suspended == FALSE)
-		goto EXIT;
+	mce_log(LL_DEBUG, "%s: changed", iomon->file);
 
-	switch (iomon->type) {
-	case IOMON_STRING:
-		callback = io_string_cb;
-		break;
+	if (iomon->reopen_timer_id)
+		g_source_remove(iomon->reopen_timer_id);
 
-	case IOMON_CHUNK:
-		callback = io_chunk_cb;
-		break;
+	iomon->reopen_timer_id = g_timeout_add(0, iomon_reopen_timer_cb,
+					       iomon);
+}
 
-	case IOMON_UNSET:
-	default:
-		break;
-	}
+/**
+ * Detach an I/O monitor from a file that has gone away
+ *
+ * The file is closed and reopened once it reappears; until then
+ * the monitor stays registered but does not use any resources
+ * besides an inotify watch on the directory and a backoff timer
+ *
+ * @param iomon The I/O monitor
+ * @return TRUE if the monitor was detached,
+ *         FALSE if it does not reopen files
+ */
+static gboolean iomon_detach(iomon_struct *iomon)
+{
+	gboolean status = FALSE;
+	gchar *dir = NULL;
+	gchar *base = NULL;
 
-	if (callback != NULL) {
-		GError *error = NULL;
+	if ((iomon->reopen == FALSE) || (iomon->fd != -1))
+		goto EXIT;
 
-		/* Seek to the end of the file if the file is seekable,
-		 * unless we use the rewind policy
-		 */
-		if (iomon->seekable && !iomon->rewind) {
-			g_io_channel_seek_position(iomon->iochan, 0,
-						   G_SEEK_END, &error);
-			if( error ) {
-				mce_log(LL_ERR,	"%s: seek error: %s",
-					iomon->file, error->message);
-			}
-			/* Reset errno,
-			 * to avoid false positives down the line
-			 */
-			errno = 0;
-			g_clear_error(&error);
-		}
+	status = TRUE;
 
-		iomon->error_source_id = g_io_add_watch(iomon->iochan,
-							G_IO_HUP | G_IO_NVAL,
-							io_error_cb, iomon);
-		iomon->data_source_id = g_io_add_watch(iomon->iochan,
-						       iomon->monitored_io_conditions,
-						       callback, iomon);
-		iomon->suspended = FALSE;
-	} else {
-		mce_log(LL_ERR,
-			"Failed to resume `%s'; invalid callback",
-			iomon->file);
-	}
+	if (iomon->detached == TRUE)
+		goto EXIT;
 
-EXIT:
-	return;
-}
-/**
- * Check if the monitored io channel is truly seekable
- *
- * Glib seems to be making guesses based on file type and
- * gets it massively wrong for the files MCE needs to read.
- */
+	mce_log(LL_WARN, "%s: lost; waiting for it to reappear",
+		iomon->file);
 
-static void mce_determine_io_monitor_seekable(iomon_struct *iomon)
-{
-	gboolean glib = FALSE, kernel = FALSE;
+	iomon->resume_on_attach = !iomon->suspended;
+	mce_suspend_io_monitor(iomon);
+	iomon_epoll_remove(iomon);
+	iomon_close_channel(iomon);
+	iomon->detached = TRUE;
 
-	/* glib assumes ... */
-	if (g_io_channel_get_flags(iomon->iochan) & G_IO_FLAG_IS_SEEKABLE) {
-		glib = TRUE;
-	}
-	/* ... kernel knows */
-	if (lseek64(g_io_channel_unix_get_fd(iomon->iochan), 0, SEEK_CUR) != -1) {
-		kernel = TRUE;
-	}
-	/* report the difference */
-	if (kernel != glib) {
-		mce_log(LL_DEBUG, "%s: is %sseekable, while glib thinks it is %sseekable",
-			iomon->file, kernel ? "" : "NOT ", glib ? "" : "NOT ");
-	}
+	dir = g_path_get_dirname(iomon->file);
+	base = g_path_get_basename(iomon->file);
+	iomon->reopen_watcher = filewatcher_create(dir, base,
+						   iomon_reopen_watch_cb,
+						   iomon, NULL);
 
-	iomon->seekable = kernel;
-}
+	iomon->reopen_delay_ms = IOMON_REOPEN_DELAY_MIN_MS;
+	iomon->reopen_timer_id = g_timeout_add(iomon->reopen_delay_ms,
+					       iomon_reopen_timer_cb, iomon);
+
+EXIT:
+	g_free(base);
+	g_free(dir);
 
+	return status;
+}
 
 /**
  * Register an I/O monitor; reads and returns data
@@ -1093,13 +2687,16 @@ static void mce_determine_io_monitor_seekable(iomon_struct *iomon)
  *                     MCE_IO_ERROR_POLICY_IGNORE to silently ignore errors
  * @param monitored_conditions The GIOConditions to monitor
  * @param callback Function to call with result
+ * @param batch_callback Function to call with all chunks read at once;
+ *                       used instead of callback if not NULL
  * @return An I/O monitor pointer on success, NULL on failure
  */
 static iomon_struct *mce_register_io_monitor(const gint fd,
 					     const gchar *const file,
 					     error_policy_t error_policy,
 					     GIOCondition monitored_conditions,
-					     iomon_cb callback)
+					     iomon_cb callback,
+					     iomon_batch_cb batch_callback)
 {
 	iomon_struct *iomon = NULL;
 	GIOChannel *iochan = NULL;
@@ -1110,7 +2707,7 @@ static iomon_struct *mce_register_io_monitor(const gint fd,
 		goto EXIT;
 	}
 
-	if (callback == NULL) {
+	if ((callback == NULL) && (batch_callback == NULL)) {
 		mce_log(LL_CRIT, "callback == NULL!");
 		goto EXIT;
 	}
@@ -1156,12 +2753,24 @@ static iomon_struct *mce_register_io_monitor(const gint fd,
 	iomon->file = g_strdup(file);
 	iomon->iochan = iochan;
 	iomon->callback = callback;
+	iomon->batch_callback = batch_callback;
 	iomon->error_policy = error_policy;
 	iomon->monitored_io_conditions = monitored_conditions;
 	iomon->latest_io_condition = 0;
 	iomon->rewind = FALSE;
+	iomon->rewind_policy = FALSE;
 	iomon->chunk_size = 0;
+	iomon->buffer = NULL;
+	iomon->buffer_size = 0;
 	iomon->err_callback = 0;
+	iomon->timestamped = FALSE;
+	iomon->reopen = FALSE;
+	iomon->detached = FALSE;
+	iomon->resume_on_attach = FALSE;
+	iomon->reopen_delay_ms = IOMON_REOPEN_DELAY_MIN_MS;
+	iomon->reopen_timer_id = 0;
+	iomon->reopen_watcher = NULL;
+	memset(&iomon->stats, 0, sizeof iomon->stats);
 
 	mce_determine_io_monitor_seekable(iomon);
 
@@ -1169,6 +2778,9 @@ static iomon_struct *mce_register_io_monitor(const gint fd,
 
 	iomon->suspended = TRUE;
 
+	/* Monitor the fd via the shared epoll source when possible */
+	iomon_epoll_add(iomon);
+
 EXIT:
 	/* Reset errno,
 	 * to avoid false positives down the line
@@ -1203,11 +2815,13 @@ gconstpointer mce_register_io_monitor_string(const gint fd,
 {
 	iomon_struct *iomon = NULL;
 
-	iomon = mce_register_io_monitor(fd, file, error_policy, monitored_conditions, callback);
+	iomon = mce_register_io_monitor(fd, file, error_policy, monitored_conditions, callback, NULL);
 
 	if (iomon == NULL)
 		goto EXIT;
 
+	iomon->rewind_policy = rewind_policy;
+
 	/* Verify that the rewind policy is sane */
 	if (iomon->seekable) {
 		/* Set the rewind policy */
@@ -1229,7 +2843,7 @@ EXIT:
 }
 
 /**
- * Register an I/O monitor; reads and returns a chunk of specified size
+ * Register an I/O monitor for reading chunks of specified size
  *
  * @param fd File Descriptor; this takes priority over file; -1 if not used
  * @param file Path to the file
@@ -1240,22 +2854,28 @@ EXIT:
  * @param monitored_conditions The GIOConditions to monitor
  * @param rewind_policy TRUE to seek to the beginning,
  *                      FALSE to stay at current position
- * @param callback Function to call with result
+ * @param callback Function to call with each chunk, or NULL
+ * @param batch_callback Function to call with all chunks, or NULL
  * @param chunk_size The number of bytes to read in each chunk
- * @return An I/O monitor cookie on success, NULL on failure
+ * @return An I/O monitor pointer on success, NULL on failure
  */
-gconstpointer mce_register_io_monitor_chunk(const gint fd,
-					    const gchar *const file,
-					    error_policy_t error_policy,
-					    GIOCondition monitored_conditions,
-					    gboolean rewind_policy,
-					    iomon_cb callback,
-					    gulong chunk_size)
+static iomon_struct *mce_register_io_monitor_chunk_common(const gint fd,
+							  const gchar *const file,
+							  error_policy_t error_policy,
+							  GIOCondition monitored_conditions,
+							  gboolean rewind_policy,
+							  iomon_cb callback,
+							  iomon_batch_cb batch_callback,
+							  gulong chunk_size)
 {
 	iomon_struct *iomon = NULL;
-	GError *error = NULL;
 
-	iomon = mce_register_io_monitor(fd, file, error_policy, monitored_conditions, callback);
+	if (chunk_size == 0) {
+		mce_log(LL_CRIT, "chunk_size == 0!");
+		goto EXIT;
+	}
+
+	iomon = mce_register_io_monitor(fd, file, error_policy, monitored_conditions, callback, batch_callback);
 
 	if (iomon == NULL)
 		goto EXIT;
@@ -1263,6 +2883,18 @@ gconstpointer mce_register_io_monitor_chunk(const gint fd,
 	/* Set the read chunk size */
 	iomon->chunk_size = chunk_size;
 
+	/* Allocate a read buffer that holds as many complete
+	 * chunks as fit in IOMON_BUFFER_SIZE, or at least one */
+	if (chunk_size < IOMON_BUFFER_SIZE)
+		iomon->buffer_size = IOMON_BUFFER_SIZE -
+				     IOMON_BUFFER_SIZE % chunk_size;
+	else
+		iomon->buffer_size = chunk_size;
+
+	iomon->buffer = g_malloc(iomon->buffer_size);
+
+	iomon->rewind_policy = rewind_policy;
+
 	/* Verify that the rewind policy is sane */
 	if (iomon->seekable) {
 		/* Set the rewind policy */
@@ -1275,30 +2907,7 @@ gconstpointer mce_register_io_monitor_chunk(const gint fd,
 		iomon->rewind = FALSE;
 	}
 
-	/* We only read this file in binary form */
-	(void)g_io_channel_set_encoding(iomon->iochan, NULL, &error);
-
-	/* No buffering since we're using this for reading data from
-	 * device drivers and need to keep the i/o state in sync
-	 * between kernel and user space for the automatic suspend
-	 * prevention via wakelocks to work
-	 */
-	g_io_channel_set_buffered(iomon->iochan, FALSE);
-
-	/* Reset errno,
-	 * to avoid false positives down the line
-	 */
-	errno = 0;
-	g_clear_error(&error);
-
-	/* Don't block */
-	(void)g_io_channel_set_flags(iomon->iochan, G_IO_FLAG_NONBLOCK, &error);
-
-	/* Reset errno,
-	 * to avoid false positives down the line
-	 */
-	errno = 0;
-	g_clear_error(&error);
+	iomon_setup_chunk_channel(iomon);
 
 	/* Set the I/O monitor type and call resume to add an I/O watch */
 	iomon->type = IOMON_CHUNK;
@@ -1308,6 +2917,74 @@ EXIT:
 	return iomon;
 }
 
+/**
+ * Register an I/O monitor; reads and returns a chunk of specified size
+ *
+ * @param fd File Descriptor; this takes priority over file; -1 if not used
+ * @param file Path to the file
+ * @param error_policy MCE_IO_ERROR_POLICY_EXIT to exit on error,
+ *                     MCE_IO_ERROR_POLICY_WARN to warn about errors
+ *                                              but ignore them,
+ *                     MCE_IO_ERROR_POLICY_IGNORE to silently ignore errors
+ * @param monitored_conditions The GIOConditions to monitor
+ * @param rewind_policy TRUE to seek to the beginning,
+ *                      FALSE to stay at current position
+ * @param callback Function to call with result
+ * @param chunk_size The number of bytes to read in each chunk
+ * @return An I/O monitor cookie on success, NULL on failure
+ */
+gconstpointer mce_register_io_monitor_chunk(const gint fd,
+					    const gchar *const file,
+					    error_policy_t error_policy,
+					    GIOCondition monitored_conditions,
+					    gboolean rewind_policy,
+					    iomon_cb callback,
+					    gulong chunk_size)
+{
+	return mce_register_io_monitor_chunk_common(fd, file, error_policy,
+						    monitored_conditions,
+						    rewind_policy,
+						    callback, NULL,
+						    chunk_size);
+}
+
+/**
+ * Register an I/O monitor; reads chunks of specified size and
+ * passes all complete chunks from one read to the callback at once
+ *
+ * @param fd File Descriptor; this takes priority over file; -1 if not used
+ * @param file Path to the file
+ * @param error_policy MCE_IO_ERROR_POLICY_EXIT to exit on error,
+ *                     MCE_IO_ERROR_POLICY_WARN to warn about errors
+ *                                              but ignore them,
+ *                     MCE_IO_ERROR_POLICY_IGNORE to silently ignore errors
+ * @param monitored_conditions The GIOConditions to monitor
+ * @param rewind_policy TRUE to seek to the beginning,
+ *                      FALSE to stay at current position
+ * @param callback Function to call with the chunks
+ * @param chunk_size The number of bytes in each chunk
+ * @return An I/O monitor cookie on success, NULL on failure
+ */
+gconstpointer mce_register_io_monitor_batch(const gint fd,
+					    const gchar *const file,
+					    error_policy_t error_policy,
+					    GIOCondition monitored_conditions,
+					    gboolean rewind_policy,
+					    iomon_batch_cb callback,
+					    gulong chunk_size)
+{
+	if (callback == NULL) {
+		mce_log(LL_CRIT, "callback == NULL!");
+		return NULL;
+	}
+
+	return mce_register_io_monitor_chunk_common(fd, file, error_policy,
+						    monitored_conditions,
+						    rewind_policy,
+						    NULL, callback,
+						    chunk_size);
+}
+
 /**
  * Unregister an I/O monitor
  * Note: This does NOT shutdown I/O channels created from file descriptors
@@ -1337,59 +3014,135 @@ void mce_unregister_io_monitor(gconstpointer io_monitor)
 
 	/* Remove I/O watches */
 	mce_suspend_io_monitor(iomon);
+	iomon_epoll_remove(iomon);
+	iomon_reopen_cancel(iomon);
 
-	/* We can close this I/O channel, since it's not an external fd */
-	if (iomon->fd == -1) {
-		GIOStatus iostatus;
-		GError *error = NULL;
+	iomon_close_channel(iomon);
 
-		iostatus = g_io_channel_shutdown(iomon->iochan, TRUE, &error);
+	g_free(iomon->buffer);
+	g_free(iomon->file);
+	g_slice_free(iomon_struct, iomon);
 
-		if (iostatus != G_IO_STATUS_NORMAL) {
-			loglevel_t loglevel = LL_ERR;
+EXIT:
+	return;
+}
 
-			/* If we get ENODEV, only log a debug message,
-			 * since this happens for hotpluggable
-			 * /dev/input files
-			 */
-			if ((error->code == G_IO_CHANNEL_ERROR_FAILED) &&
-			    (errno == ENODEV))
-				loglevel = LL_DEBUG;
+/**
+ * Set error handling callback for I/O monitor. Error handling callback
+ * is called from io_error_cb.
+ *
+ * @param io_monitor A pointer to the I/O monitor
+ * @param err_cb A pointer to the error callback. Can be 0 to unset the cb.
+ */
+void mce_set_io_monitor_err_cb(gconstpointer io_monitor, iomon_err_cb err_cb)
+{
+	iomon_struct *iomon = (iomon_struct *)io_monitor;
 
-			mce_log(loglevel,
-				"Cannot close `%s'; %s",
-				iomon->file, error->message);
-		}
+	if (iomon) {
+		iomon->err_callback = err_cb;
+	}
+}
 
-		/* Reset errno,
-		 * to avoid false positives down the line
-		 */
-		errno = 0;
-		g_clear_error(&error);
+/**
+ * Tell whether the chunks of an I/O monitor carry event time stamps
+ *
+ * When enabled, each chunk is expected to start with a struct timeval
+ * in CLOCK_REALTIME, as struct input_event does, and the delay from
+ * that time stamp to the start of the callback is included in the
+ * I/O monitor statistics
+ *
+ * @param io_monitor A pointer to the I/O monitor
+ * @param timestamped TRUE if chunks start with a time stamp
+ */
+void mce_set_io_monitor_timestamped(gconstpointer io_monitor,
+				    gboolean timestamped)
+{
+	iomon_struct *iomon = (iomon_struct *)io_monitor;
+
+	if (iomon) {
+		iomon->timestamped = timestamped;
 	}
+}
 
-	g_io_channel_unref(iomon->iochan);
-	g_free(iomon->file);
-	g_slice_free(iomon_struct, iomon);
+/**
+ * Make an I/O monitor reopen its file after the device goes away
+ *
+ * Instead of reporting errors, a monitor that loses its file closes
+ * it, waits for it to reappear via inotify and reopens it, retrying
+ * with exponential backoff. Only chunk I/O monitors that opened the
+ * file by path can do this.
+ *
+ * @param io_monitor A pointer to the I/O monitor
+ * @param reopen TRUE to reopen the file after device loss
+ */
+void mce_set_io_monitor_reopen(gconstpointer io_monitor, gboolean reopen)
+{
+	iomon_struct *iomon = (iomon_struct *)io_monitor;
+
+	if (iomon == NULL)
+		goto EXIT;
+
+	if (reopen && (iomon->type != IOMON_CHUNK || iomon->fd != -1)) {
+		mce_log(LL_ERR, "%s: can't be reopened", iomon->file);
+		goto EXIT;
+	}
+
+	iomon->reopen = reopen;
 
 EXIT:
 	return;
 }
 
 /**
- * Set error handling callback for I/O monitor. Error handling callback
- * is called from io_error_cb.
+ * Get statistics for all I/O monitors in human readable form
  *
- * @param io_monitor A pointer to the I/O monitor
- * @param err_cb A pointer to the error callback. Can be 0 to unset the cb.
+ * @return The statistics as text; free with g_free()
  */
-void mce_set_io_monitor_err_cb(gconstpointer io_monitor, iomon_err_cb err_cb)
+gchar *mce_io_get_stats(void)
 {
-	iomon_struct *iomon = (iomon_struct *)io_monitor;
+	GString *text = g_string_new(NULL);
+	GSList *item;
+
+	for (item = file_monitors; item != NULL; item = item->next) {
+		const iomon_struct *iomon = item->data;
+		const iomon_stats_t *stats = &iomon->stats;
+		guint64 calls = stats->calls ?: 1;
+
+		g_string_append_printf(text,
+				       "%s: %" G_GUINT64_FORMAT " wakeups, "
+				       "%" G_GUINT64_FORMAT " bytes, "
+				       "%" G_GUINT64_FORMAT " %s, "
+				       "%" G_GUINT64_FORMAT " skipped, "
+				       "%" G_GUINT64_FORMAT " flushes, "
+				       "callback avg %" G_GUINT64_FORMAT
+				       " us max %u us, "
+				       "%" G_GUINT64_FORMAT " reopens%s",
+				       iomon->file,
+				       stats->wakeups,
+				       stats->bytes,
+				       stats->chunks,
+				       (iomon->type == IOMON_STRING) ?
+				       "lines" : "chunks",
+				       stats->skipped,
+				       stats->flushes,
+				       stats->callback_us / calls,
+				       stats->callback_max_us,
+				       stats->reopens,
+				       iomon->detached ? " (detached)" : "");
+
+		if (stats->delays != 0) {
+			g_string_append_printf(text,
+					       ", event delay avg %"
+					       G_GUINT64_FORMAT
+					       " us max %u us",
+					       stats->delay_us / stats->delays,
+					       stats->delay_max_us);
+		}
 
-	if (iomon) {
-		iomon->err_callback = err_cb;
+		g_string_append(text, "\n");
 	}
+
+	return g_string_free(text, FALSE);
 }
 
 /**
@@ -1707,3 +3460,552 @@ EXIT:
 
 	return res;
 }
+
+/** Release a write-behind queue entry
+ *
+ * @param entry The entry to release, or NULL
+ */
+static void mce_io_persist_free(mce_io_persist_t *entry)
+{
+	if( !entry )
+		goto EXIT;
+
+	g_free(entry->path);
+	g_free(entry->data);
+	g_slice_free(mce_io_persist_t, entry);
+
+EXIT:
+	return;
+}
+
+/** Timer callback for flushing the write-behind queue
+ *
+ * @param data Unused
+ *
+ * @return FALSE to stop the timer
+ */
+static gboolean mce_io_persist_timer_cb(gpointer data)
+{
+	(void)data;
+
+	mce_io_persist_timer_id = 0;
+	mce_io_persist_flush();
+
+	return FALSE;
+}
+
+/** Queue a file to be atomically replaced by the write-behind persistence
+ *
+ * Files are collected for MCE_IO_PERSIST_DELAY_MS and then written
+ * out together by mce_io_persist_flush(). Queuing a file that is
+ * already waiting just replaces the pending contents.
+ *
+ * @param path file to write to
+ * @param data start of the data to write
+ * @param size length of the data to write
+ * @param mode protection bits to apply
+ */
+void mce_io_persist_file(const char *path,
+			 const void *data, size_t size,
+			 mode_t mode)
+{
+	mce_io_persist_t *entry = NULL;
+	GSList *item;
+
+	for( item = mce_io_persist_queue; item; item = item->next ) {
+		mce_io_persist_t *pending = item->data;
+
+		if( !strcmp(pending->path, path) ) {
+			entry = pending;
+			break;
+		}
+	}
+
+	if( !entry ) {
+		entry = g_slice_new0(mce_io_persist_t);
+		entry->path = g_strdup(path);
+		mce_io_persist_queue = g_slist_append(mce_io_persist_queue,
+						      entry);
+	}
+
+	g_free(entry->data);
+	entry->data = g_memdup(data, size);
+	entry->size = size;
+	entry->mode = mode;
+
+	mce_log(LL_DEBUG, "%s: queued %zu bytes", path, size);
+
+	if( !mce_io_persist_timer_id ) {
+		mce_io_persist_timer_id =
+			g_timeout_add(MCE_IO_PERSIST_DELAY_MS,
+				      mce_io_persist_timer_cb, NULL);
+	}
+}
+
+/** Write a write-behind queue entry to its temporary file
+ *
+ * The data is synced to disk before returning, so that the
+ * temporary file can be renamed over the original safely.
+ *
+ * @param entry The entry to write
+ * @param temp  Path to the temporary file
+ *
+ * @return TRUE on success, FALSE on errors
+ */
+static gboolean mce_io_persist_stage(const mce_io_persist_t *entry,
+				     const gchar *temp)
+{
+	gboolean res  = FALSE;
+	mode_t   mode = entry->mode ?: 0664;
+	int      fd   = -1;
+
+	fd = TEMP_FAILURE_RETRY(open(temp, O_WRONLY | O_CREAT | O_TRUNC |
+				     O_CLOEXEC, 0600));
+	if( fd == -1 ) {
+		mce_log(LL_WARN, "open(%s): %m", temp);
+		goto EXIT;
+	}
+
+	if( !mce_io_write_all(fd, entry->data, entry->size, 0) ) {
+		mce_log(LL_WARN, "write(%s): %m", temp);
+		goto EXIT;
+	}
+
+	if( fchmod(fd, mode) == -1 ) {
+		mce_log(LL_WARN, "chmod(%s, %03o): %m", temp, (int)mode);
+		goto EXIT;
+	}
+
+	if( fdatasync(fd) == -1 ) {
+		mce_log(LL_WARN, "fdatasync(%s): %m", temp);
+		goto EXIT;
+	}
+
+	res = TRUE;
+
+EXIT:
+	if( fd != -1 && TEMP_FAILURE_RETRY(close(fd)) == -1 ) {
+		mce_log(LL_WARN, "close(%s): %m", temp);
+		res = FALSE;
+	}
+
+	return res;
+}
+
+/** Write all files queued for the write-behind persistence
+ *
+ * Files whose contents would not change are skipped. The rest are
+ * written to temporary files that are synced one by one and then
+ * renamed over the originals; finally each affected directory is
+ * synced once to commit the renames.
+ *
+ * The settings lock is not checked here; the only files that were
+ * ever withheld while it is held, the radio states, are saved
+ * synchronously by their owner, which checks the lock itself.
+ *
+ * Called from a timer, and directly before suspend and at exit.
+ */
+void mce_io_persist_flush(void)
+{
+	GSList *queue = mce_io_persist_queue;
+	GSList *dirs = NULL;
+	GSList *item;
+
+	mce_io_persist_queue = NULL;
+
+	if( mce_io_persist_timer_id ) {
+		g_source_remove(mce_io_persist_timer_id);
+		mce_io_persist_timer_id = 0;
+	}
+
+	/* Replace the files that have changed */
+	for( item = queue; item; item = item->next ) {
+		mce_io_persist_t *entry = item->data;
+		gchar *temp = g_strconcat(entry->path, TMP_SUFFIX, NULL);
+		gchar *dir = NULL;
+		size_t old_size = 0;
+		void  *old_data = mce_io_load_file(entry->path, &old_size);
+
+		if( old_data && old_size == entry->size &&
+		    !memcmp(old_data, entry->data, entry->size) ) {
+			mce_log(LL_DEBUG, "%s: not changed", entry->path);
+		} else if( !mce_io_persist_stage(entry, temp) ) {
+			/* Never rename data that might not be on disk */
+			if( unlink(temp) == -1 && errno != ENOENT )
+				mce_log(LL_WARN, "unlink(%s): %m", temp);
+		} else if( rename(temp, entry->path) == -1 ) {
+			mce_log(LL_WARN, "rename(%s, %s): %m",
+				temp, entry->path);
+		} else {
+			mce_log(LL_NOTICE, "%s: updated", entry->path);
+
+			dir = g_path_get_dirname(entry->path);
+			if( !g_slist_find_custom(dirs, dir,
+						 (GCompareFunc)strcmp) )
+				dirs = g_slist_prepend(dirs, dir), dir = NULL;
+		}
+
+		g_free(dir);
+		g_free(old_data);
+		g_free(temp);
+	}
+
+	/* Commit the renames with one sync per directory */
+	for( item = dirs; item; item = item->next ) {
+		const gchar *dir = item->data;
+		int fd;
+
+		fd = TEMP_FAILURE_RETRY(open(dir, O_RDONLY | O_DIRECTORY |
+					     O_CLOEXEC));
+		if( fd == -1 ) {
+			mce_log(LL_WARN, "open(%s): %m", dir);
+			continue;
+		}
+
+		if( fsync(fd) == -1 )
+			mce_log(LL_WARN, "fsync(%s): %m", dir);
+
+		if( TEMP_FAILURE_RETRY(close(fd)) == -1 )
+			mce_log(LL_WARN, "close(%s): %m", dir);
+	}
+
+	g_slist_free_full(dirs, g_free);
+	g_slist_free_full(queue, (GDestroyNotify)mce_io_persist_free);
+
+	/* Reset errno,
+	 * to avoid false positives down the line
+	 */
+	errno = 0;
+}
+
+/** Release a cached attribute
+ *
+ * @param data The mce_io_cache_entry_t to release
+ */
+static void mce_io_cache_entry_free(gpointer data)
+{
+	mce_io_cache_entry_t *entry = data;
+
+	g_free(entry->content);
+	g_free(entry->path);
+	g_slice_free(mce_io_cache_entry_t, entry);
+}
+
+/** Look up a cached attribute, adding an empty entry if needed
+ *
+ * @param path Path to the attribute
+ * @return The cache entry
+ */
+static mce_io_cache_entry_t *mce_io_cache_entry(const gchar *path)
+{
+	mce_io_cache_entry_t *entry = NULL;
+
+	if( !mce_io_cache )
+		mce_io_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+						     NULL,
+						     mce_io_cache_entry_free);
+
+	if( (entry = g_hash_table_lookup(mce_io_cache, path)) )
+		goto EXIT;
+
+	entry = g_slice_new0(mce_io_cache_entry_t);
+	entry->path = g_strdup(path);
+	memset(entry->access, -1, sizeof entry->access);
+
+	g_hash_table_insert(mce_io_cache, entry->path, entry);
+
+EXIT:
+	return entry;
+}
+
+/** Can a path be stored as a key in the boot cache file?
+ *
+ * @param path Path to check
+ * @return TRUE if the path is a valid key file key, FALSE otherwise
+ */
+static gboolean mce_io_cache_key_valid(const gchar *path)
+{
+	return !strpbrk(path, "=[]\n") && !g_ascii_isspace(*path);
+}
+
+/** Write the cached attributes to the boot cache file
+ */
+static void mce_io_cache_save(void)
+{
+	GKeyFile *file = NULL;
+	gchar *data = NULL;
+	gsize size = 0;
+	GHashTableIter iter;
+	gpointer value;
+
+	if( mce_io_cache_save_id ) {
+		g_source_remove(mce_io_cache_save_id);
+		mce_io_cache_save_id = 0;
+	}
+
+	if( !mce_io_cache || !mce_io_cache_boot_id )
+		goto EXIT;
+
+	file = g_key_file_new();
+	g_key_file_set_string(file, "cache", "boot_id", mce_io_cache_boot_id);
+
+	g_hash_table_iter_init(&iter, mce_io_cache);
+	while( g_hash_table_iter_next(&iter, NULL, &value) ) {
+		mce_io_cache_entry_t *entry = value;
+		gint access[MCE_IO_CACHE_ACCESS_MODES];
+
+		if( !mce_io_cache_key_valid(entry->path) )
+			continue;
+
+		if( entry->valid )
+			g_key_file_set_string(file, "content", entry->path,
+					      entry->content);
+
+		/* A missing file may still appear later during this
+		 * boot, e.g. when a driver module gets loaded; only
+		 * positive results are kept over mce restarts */
+		for( gsize i = 0; i < G_N_ELEMENTS(access); ++i )
+			access[i] = (entry->access[i] == 1) ? 1 : -1;
+
+		g_key_file_set_integer_list(file, "access", entry->path,
+					    access, G_N_ELEMENTS(access));
+	}
+
+	if( (data = g_key_file_to_data(file, &size, NULL)) )
+		mce_io_persist_file(MCE_IO_CACHE_BOOT_FILE, data, size, 0644);
+
+EXIT:
+	g_free(data);
+
+	if( file )
+		g_key_file_free(file);
+}
+
+/** Idle callback for saving the boot cache
+ *
+ * @param data Unused
+ * @return FALSE to stop the idle callback
+ */
+static gboolean mce_io_cache_save_cb(gpointer data)
+{
+	(void)data;
+
+	mce_io_cache_save_id = 0;
+	mce_io_cache_save();
+
+	return FALSE;
+}
+
+/** Schedule saving of the boot cache after an attribute changed
+ */
+static void mce_io_cache_changed(void)
+{
+	if( !mce_io_cache_save_id )
+		mce_io_cache_save_id = g_idle_add(mce_io_cache_save_cb, NULL);
+}
+
+/** Get the contents of an attribute, reading it only once per boot
+ *
+ * Failed reads are not remembered, so an attribute that appears
+ * later is read when it is asked for the next time.
+ *
+ * @param path Path to the attribute
+ * @return Cached contents owned by the cache, or NULL on failure
+ */
+static const gchar *mce_io_cache_lookup(const gchar *path)
+{
+	mce_io_cache_entry_t *entry = mce_io_cache_entry(path);
+	gchar *content = NULL;
+
+	if( entry->valid ) {
+		mce_log(LL_DEBUG, "%s: cached", path);
+		goto EXIT;
+	}
+
+	if( mce_read_string_from_file(path, &content) == FALSE )
+		goto EXIT;
+
+	g_free(entry->content);
+	entry->content = content;
+	entry->valid = TRUE;
+
+	mce_io_cache_changed();
+
+EXIT:
+	return entry->valid ? entry->content : NULL;
+}
+
+/** Read a string from a sysfs attribute through the attribute cache
+ *
+ * @param path Path to the attribute
+ * @param[out] string Newly allocated copy of the contents
+ * @return TRUE on success, FALSE on failure
+ */
+gboolean mce_io_cache_read_string(const gchar *path, gchar **string)
+{
+	const gchar *content = mce_io_cache_lookup(path);
+
+	if( content )
+		*string = g_strdup(content);
+
+	return content != NULL;
+}
+
+/** Read a number from a sysfs attribute through the attribute cache
+ *
+ * @param path Path to the attribute
+ * @param[out] number The number at the start of the attribute
+ * @return TRUE on success, FALSE on failure
+ */
+gboolean mce_io_cache_read_number(const gchar *path, gulong *number)
+{
+	gboolean status = FALSE;
+	const gchar *content = mce_io_cache_lookup(path);
+	gchar *end = NULL;
+	gulong value;
+
+	if( !content )
+		goto EXIT;
+
+	value = strtoul(content, &end, 10);
+
+	if( end == content ) {
+		mce_log(LL_ERR, "%s: not a number", path);
+		goto EXIT;
+	}
+
+	*number = value;
+	status = TRUE;
+
+EXIT:
+	errno = 0;
+
+	return status;
+}
+
+/** Check access to a file, remembering the result for this boot
+ *
+ * Meant for probing hardware specific sysfs entries. A found entry
+ * is not expected to go away while the device is running, but one
+ * that is missing may still appear, e.g. when a driver module gets
+ * loaded; failed checks are thus done again once they are older
+ * than MCE_IO_CACHE_RETRY_MS.
+ *
+ * @param path Path to check
+ * @param mode Accessibility check as for access()
+ * @return TRUE if access is allowed, FALSE otherwise
+ */
+gboolean mce_io_cache_access(const gchar *path, int mode)
+{
+	mce_io_cache_entry_t *entry;
+	gint64 now = g_get_monotonic_time();
+
+	if( mode < 0 || mode >= MCE_IO_CACHE_ACCESS_MODES )
+		return g_access(path, mode) == 0;
+
+	entry = mce_io_cache_entry(path);
+
+	if( entry->access[mode] == 0 &&
+	    now - entry->denied[mode] > MCE_IO_CACHE_RETRY_MS * 1000 )
+		entry->access[mode] = -1;
+
+	if( entry->access[mode] == -1 ) {
+		entry->access[mode] = (g_access(path, mode) == 0);
+
+		/* Only positive results are saved */
+		if( entry->access[mode] == 1 )
+			mce_io_cache_changed();
+		else
+			entry->denied[mode] = now;
+
+		errno = 0;
+	}
+
+	return entry->access[mode] == 1;
+}
+
+/** Load the boot cache left by a previous mce instance
+ *
+ * Entries are used only if they were saved during the current boot
+ */
+void mce_io_cache_init(void)
+{
+	GKeyFile *file = g_key_file_new();
+	gchar *boot_id = NULL;
+	gchar **keys = NULL;
+	GError *error = NULL;
+
+	if( !g_file_get_contents(MCE_IO_CACHE_BOOT_ID_FILE, &mce_io_cache_boot_id,
+				 NULL, &error) ) {
+		mce_log(LL_WARN, "%s: %s; not caching over restarts",
+			MCE_IO_CACHE_BOOT_ID_FILE, error->message);
+		goto EXIT;
+	}
+
+	g_strstrip(mce_io_cache_boot_id);
+
+	if( !g_key_file_load_from_file(file, MCE_IO_CACHE_BOOT_FILE,
+				       G_KEY_FILE_NONE, NULL) )
+		goto EXIT;
+
+	boot_id = g_key_file_get_string(file, "cache", "boot_id", NULL);
+
+	if( g_strcmp0(boot_id, mce_io_cache_boot_id) ) {
+		mce_log(LL_DEBUG, "%s: from a previous boot; ignored",
+			MCE_IO_CACHE_BOOT_FILE);
+		goto EXIT;
+	}
+
+	if( (keys = g_key_file_get_keys(file, "content", NULL, NULL)) ) {
+		for( gsize i = 0; keys[i]; ++i ) {
+			mce_io_cache_entry_t *entry = mce_io_cache_entry(keys[i]);
+
+			g_free(entry->content);
+			entry->content = g_key_file_get_string(file, "content",
+							       keys[i], NULL);
+			entry->valid = (entry->content != NULL);
+		}
+		g_strfreev(keys), keys = NULL;
+	}
+
+	if( (keys = g_key_file_get_keys(file, "access", NULL, NULL)) ) {
+		for( gsize i = 0; keys[i]; ++i ) {
+			mce_io_cache_entry_t *entry = mce_io_cache_entry(keys[i]);
+			gsize count = 0;
+			gint *access = g_key_file_get_integer_list(file, "access",
+								   keys[i],
+								   &count, NULL);
+
+			for( gsize j = 0; j < count && j < MCE_IO_CACHE_ACCESS_MODES; ++j )
+				entry->access[j] = (access[j] < 0) ? -1 : (access[j] > 0);
+
+			g_free(access);
+		}
+	}
+
+	mce_log(LL_NOTICE, "%s: loaded %u attributes", MCE_IO_CACHE_BOOT_FILE,
+		mce_io_cache ? g_hash_table_size(mce_io_cache) : 0);
+
+EXIT:
+	g_strfreev(keys);
+	g_free(boot_id);
+	g_clear_error(&error);
+	g_key_file_free(file);
+
+	errno = 0;
+}
+
+/** Save the boot cache and release the attribute cache
+ */
+void mce_io_cache_exit(void)
+{
+	mce_io_cache_save();
+
+	if( mce_io_cache ) {
+		g_hash_table_destroy(mce_io_cache);
+		mce_io_cache = NULL;
+	}
+
+	g_free(mce_io_cache_boot_id);
+	mce_io_cache_boot_id = NULL;
+}
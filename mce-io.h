@@ -55,6 +55,21 @@ typedef struct {
 	 *  FALSE to leave the file open */
 	gboolean close_on_exit;
 
+	/** TRUE to do the writes from the sysfs writer thread;
+	 *  a value that has not been written yet is replaced
+	 *  by a newer one, FALSE to write from the caller */
+	gboolean async;
+
+	/** TRUE to skip writes of the value that was last written
+	 *  successfully, FALSE to write every value */
+	gboolean skip_unchanged;
+
+	/** Called from the mainloop once a value has been written;
+	 *  for async outputs when the writer thread has completed
+	 *  the write. Gets the value and the monotonic time of the
+	 *  completion in microseconds. NULL if not needed */
+	void (*written_cb)(gulong number, gint64 stamp);
+
 	/* runtime configuration */
 
 	/** Path to the file, or NULL (in which case one misconfiguration
@@ -63,16 +78,67 @@ typedef struct {
 
 	/* dynamic state */
 
-	/** Cached output stream, use mce_close_output() to close */
-	FILE *file;
+	/** Cached file descriptor, valid if fd_open is set;
+	 *  use mce_close_output() to close */
+	int fd;
+
+	/** TRUE if fd is open */
+	gboolean fd_open;
+
+	/** TRUE if last_written holds the latest value written */
+	gboolean written;
+
+	/** The value that was last written successfully */
+	gulong last_written;
+
+	/** Number of values written; for async outputs, queued */
+	guint64 write_count;
+
+	/** Number of writes skipped due to skip_unchanged */
+	guint64 skip_count;
 
 	/** TRUE if missing path configuration error has already been
 	 *  written for this file */
 	gboolean invalid_config_reported;
 } output_state_t;
 
+/** Control structure for polling input files
+ *
+ * The file is kept open between reads and read with pread() at
+ * offset zero, so that each sample costs one system call
+ */
+typedef struct {
+	/* static configuration */
+
+	/** descriptive context information used for identifying the
+	 *  purpose of the input file in diagnostic messages */
+	const gchar *context;
+
+	/* runtime configuration */
+
+	/** Path to the file, or NULL if not available */
+	const char *path;
+
+	/* dynamic state */
+
+	/** Cached file descriptor, valid if fd_open is set;
+	 *  use mce_close_input() to close */
+	int fd;
+
+	/** TRUE if fd is open */
+	gboolean fd_open;
+
+	/** TRUE if the file can not be read with pread(), i.e. it is
+	 *  a device node that does not support seeking */
+	gboolean unseekable;
+} input_state_t;
+
 /** Function pointer for I/O monitor callback */
 typedef gboolean (*iomon_cb)(gpointer data, gsize bytes_read);
+/** Function pointer for batched chunk I/O monitor callback;
+ *  return TRUE to skip data that has not been read yet */
+typedef gboolean (*iomon_batch_cb)(gconstpointer io_monitor, gpointer data,
+				   gsize chunk_size, gsize chunks);
 /** Function pointer for I/O monitor error callback */
 typedef void (*iomon_err_cb)(gpointer data, GIOCondition condition);
 
@@ -87,9 +153,15 @@ gboolean mce_read_number_string_from_file(const gchar *const file,
 gboolean mce_write_string_to_file(const gchar *const file,
 				  const gchar *const string);
 void mce_close_output(output_state_t *output);
+void mce_close_input(input_state_t *input);
+gboolean mce_read_input(input_state_t *input, void *data, gsize *len);
+gboolean mce_read_input_number(input_state_t *input, gulong *number);
 gboolean mce_write_number_string_to_file(output_state_t *output, const gulong number);
 gboolean mce_write_number_string_to_file_atomic(const gchar *const file,
 						const gulong number);
+void mce_io_writer_after(void (*cb)(gpointer data), gpointer data);
+void mce_io_writer_sync(void);
+void mce_io_writer_quit(void);
 void mce_suspend_io_monitor(gconstpointer io_monitor);
 void mce_resume_io_monitor(gconstpointer io_monitor);
 gconstpointer mce_register_io_monitor_string(const gint fd,
@@ -105,7 +177,18 @@ gconstpointer mce_register_io_monitor_chunk(const gint fd,
 					    gboolean rewind_policy,
 					    iomon_cb callback,
 					    gulong chunk_size);
+gconstpointer mce_register_io_monitor_batch(const gint fd,
+					    const gchar *const file,
+					    error_policy_t error_policy,
+					    GIOCondition monitored_conditions,
+					    gboolean rewind_policy,
+					    iomon_batch_cb callback,
+					    gulong chunk_size);
 void mce_set_io_monitor_err_cb(gconstpointer io_monitor, iomon_err_cb err_cb);
+void mce_set_io_monitor_timestamped(gconstpointer io_monitor,
+				    gboolean timestamped);
+void mce_set_io_monitor_reopen(gconstpointer io_monitor, gboolean reopen);
+gchar *mce_io_get_stats(void);
 void mce_unregister_io_monitor(gconstpointer io_monitor);
 const gchar *mce_get_io_monitor_name(gconstpointer io_monitor);
 int mce_get_io_monitor_fd(gconstpointer io_monitor);
@@ -123,5 +206,15 @@ gboolean mce_io_save_file_atomic(const char *path,
 gboolean mce_io_update_file_atomic(const char *path,
 				   const void *data, size_t size,
 				   mode_t mode, gboolean keep_backup);
+void mce_io_persist_file(const char *path,
+			 const void *data, size_t size,
+			 mode_t mode);
+void mce_io_persist_flush(void);
+
+gboolean mce_io_cache_read_string(const gchar *path, gchar **string);
+gboolean mce_io_cache_read_number(const gchar *path, gulong *number);
+gboolean mce_io_cache_access(const gchar *path, int mode);
+void mce_io_cache_init(void);
+void mce_io_cache_exit(void);
 
 #endif /* _MCE_IO_H_ */
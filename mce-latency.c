@@ -0,0 +1,254 @@
+/**
+ * @file mce-latency.c
+ * Input-to-display latency tracing for the Mode Control Entity
+ * <p>
+ * Copyright © 2026 Jolla Mobile Ltd.
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A trace is started from the kernel time stamp of an input event
+ * that is expected to turn the display on, e.g. a power key press
+ * while the display is off. The first time each stage is reached
+ * after that, the time elapsed since the input event is noted.
+ * When the backlight is written, the noted times are added to the
+ * per-stage sample rings that the percentiles are computed from.
+ *
+ * Only one trace is tracked at a time; stages are attributed to it
+ * by time alone, so work unrelated to the input event that happens
+ * to run while the trace is active can shorten the earlier stages.
+ */
+
+#include <glib.h>
+
+#include <stdlib.h>			/* qsort() */
+#include <string.h>			/* memcpy() */
+
+#include "mce-latency.h"
+
+#include "mce-log.h"			/* mce_log(), LL_* */
+
+/** Human readable stage names */
+static const char * const latency_stage_name[MCE_LATENCY_STAGES] = {
+	[MCE_LATENCY_INPUT]       = "input",
+	[MCE_LATENCY_POWERKEY]    = "powerkey",
+	[MCE_LATENCY_DISPLAY_REQ] = "display_req",
+	[MCE_LATENCY_STM]         = "stm",
+	[MCE_LATENCY_RENDERER]    = "renderer",
+	[MCE_LATENCY_BACKLIGHT]   = "backlight",
+};
+
+/** Latency samples of one stage */
+typedef struct {
+	guint32 sample[MCE_LATENCY_SAMPLES];	/**< Ring of latencies in us */
+	guint64 count;				/**< Number of samples added */
+} latency_ring_t;
+
+/** Latency samples of each stage */
+static latency_ring_t latency_ring[MCE_LATENCY_STAGES];
+
+/** Real time of the input event of the active trace; 0 if none */
+static gint64 latency_origin = 0;
+
+/** Latency of each stage in the active trace; -1 if not reached */
+static gint64 latency_trace[MCE_LATENCY_STAGES];
+
+/** Is the active trace waiting for the backlight to come on? */
+static gboolean latency_backlight_pending = FALSE;
+
+/** Number of completed traces */
+static guint64 latency_completed = 0;
+
+/** Number of traces abandoned before the backlight came on */
+static guint64 latency_abandoned = 0;
+
+/**
+ * Drop the active trace
+ */
+static void latency_abandon(void)
+{
+	latency_backlight_pending = FALSE;
+
+	if (latency_origin != 0) {
+		latency_abandoned++;
+		latency_origin = 0;
+	}
+}
+
+/**
+ * Add the stage latencies of the active trace to the sample rings
+ */
+static void latency_commit(void)
+{
+	for (int i = 0; i < MCE_LATENCY_STAGES; ++i) {
+		latency_ring_t *ring = &latency_ring[i];
+
+		if (latency_trace[i] < 0)
+			continue;
+
+		ring->sample[ring->count++ % MCE_LATENCY_SAMPLES] =
+			(guint32)MIN(latency_trace[i], G_MAXUINT32);
+	}
+
+	latency_completed++;
+	latency_origin = 0;
+	latency_backlight_pending = FALSE;
+
+	mce_log(LL_DEBUG, "input to backlight: %" G_GINT64_FORMAT " us",
+		latency_trace[MCE_LATENCY_BACKLIGHT]);
+}
+
+/**
+ * Start a latency trace
+ *
+ * A trace that is still active is abandoned
+ *
+ * @param stamp Kernel time stamp of the input event
+ */
+void mce_latency_begin(const struct timeval *stamp)
+{
+	latency_abandon();
+
+	latency_origin = (gint64)stamp->tv_sec * G_USEC_PER_SEC +
+			 stamp->tv_usec;
+
+	for (int i = 0; i < MCE_LATENCY_STAGES; ++i)
+		latency_trace[i] = -1;
+
+	latency_backlight_pending = TRUE;
+}
+
+/**
+ * Tell whether the active trace still waits for the backlight
+ *
+ * Lets the backlight writers skip marking brightness changes that
+ * can not complete a trace, e.g. the steps of a fade; the flag is
+ * cleared by the first MCE_LATENCY_BACKLIGHT mark after a trace
+ * was started
+ *
+ * @return TRUE if a trace was started and the backlight has not
+ *         been marked since, FALSE otherwise
+ */
+gboolean mce_latency_backlight_pending(void)
+{
+	return latency_backlight_pending;
+}
+
+/**
+ * Note that the active latency trace has reached a stage
+ *
+ * Reaching MCE_LATENCY_BACKLIGHT completes the trace
+ *
+ * @param stage The stage
+ */
+void mce_latency_mark(mce_latency_stage_t stage)
+{
+	mce_latency_mark_at(stage, g_get_monotonic_time());
+}
+
+/**
+ * Note that the active latency trace reached a stage at a given time
+ *
+ * For stages that complete outside of the mainloop, e.g. in the
+ * sysfs writer thread, and are reported to the mainloop later
+ *
+ * @param stage The stage
+ * @param stamp Monotonic time the stage was reached, in microseconds
+ */
+void mce_latency_mark_at(mce_latency_stage_t stage, gint64 stamp)
+{
+	gint64 elapsed;
+
+	if (latency_origin == 0 || (unsigned)stage >= MCE_LATENCY_STAGES)
+		goto EXIT;
+
+	/* Input events carry real time stamps */
+	elapsed = g_get_real_time() - (g_get_monotonic_time() - stamp) -
+		  latency_origin;
+
+	/* The display did not come on; do not skew the statistics */
+	if (elapsed > MCE_LATENCY_TIMEOUT_US) {
+		latency_abandon();
+		goto EXIT;
+	}
+
+	if (latency_trace[stage] < 0)
+		latency_trace[stage] = MAX(elapsed, 0);
+
+	if (stage == MCE_LATENCY_BACKLIGHT)
+		latency_commit();
+
+EXIT:
+	return;
+}
+
+/**
+ * Compare latency samples for qsort()
+ *
+ * @param a Pointer to the first sample
+ * @param b Pointer to the second sample
+ * @return <0, 0 or >0 like strcmp()
+ */
+static int latency_compare(const void *a, const void *b)
+{
+	guint32 x = *(const guint32 *)a;
+	guint32 y = *(const guint32 *)b;
+
+	return (x > y) - (x < y);
+}
+
+/**
+ * Get latency percentiles of each stage in text form
+ *
+ * The latencies are measured from the kernel time stamp of the
+ * input event and cover the last MCE_LATENCY_SAMPLES traces
+ *
+ * @return Statistics text; free with g_free()
+ */
+gchar *mce_latency_get_stats(void)
+{
+	GString *text = g_string_new(NULL);
+	guint32 sorted[MCE_LATENCY_SAMPLES];
+
+	g_string_append_printf(text,
+			       "traces: %" G_GUINT64_FORMAT " completed, "
+			       "%" G_GUINT64_FORMAT " abandoned\n",
+			       latency_completed, latency_abandoned);
+
+	for (int i = 0; i < MCE_LATENCY_STAGES; ++i) {
+		const latency_ring_t *ring = &latency_ring[i];
+		gsize n = MIN(ring->count, MCE_LATENCY_SAMPLES);
+
+		if (n == 0) {
+			g_string_append_printf(text, "%s: no samples\n",
+					       latency_stage_name[i]);
+			continue;
+		}
+
+		memcpy(sorted, ring->sample, n * sizeof *sorted);
+		qsort(sorted, n, sizeof *sorted, latency_compare);
+
+		g_string_append_printf(text,
+				       "%s: %" G_GSIZE_FORMAT " samples, "
+				       "p50 %u us, p90 %u us, p99 %u us, "
+				       "max %u us\n",
+				       latency_stage_name[i], n,
+				       sorted[n * 50 / 100],
+				       sorted[n * 90 / 100],
+				       sorted[n * 99 / 100],
+				       sorted[n - 1]);
+	}
+
+	return g_string_free(text, FALSE);
+}
@@ -0,0 +1,58 @@
+/**
+ * @file mce-latency.h
+ * Headers for the input-to-display latency tracing of the Mode Control Entity
+ * <p>
+ * Copyright © 2026 Jolla Mobile Ltd.
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MCE_LATENCY_H_
+#define _MCE_LATENCY_H_
+
+#include <glib.h>
+
+#include <sys/time.h>			/* struct timeval */
+
+/** Number of latency samples kept for each stage */
+#define MCE_LATENCY_SAMPLES		256
+
+/** Time after which an incomplete trace is abandoned; 3 seconds */
+#define MCE_LATENCY_TIMEOUT_US		(3 * G_USEC_PER_SEC)
+
+/**
+ * Stages of the path from an input event to the backlight coming on
+ */
+typedef enum {
+	/** Input event handled by mce */
+	MCE_LATENCY_INPUT = 0,
+	/** Power key datapipe trigger */
+	MCE_LATENCY_POWERKEY = 1,
+	/** Display state request reached the display state machine */
+	MCE_LATENCY_DISPLAY_REQ = 2,
+	/** Display state machine evaluated the request */
+	MCE_LATENCY_STM = 3,
+	/** Rendering enabled in the UI */
+	MCE_LATENCY_RENDERER = 4,
+	/** Backlight brightness written; completes the trace */
+	MCE_LATENCY_BACKLIGHT = 5,
+	/** Number of stages */
+	MCE_LATENCY_STAGES
+} mce_latency_stage_t;
+
+void mce_latency_begin(const struct timeval *stamp);
+void mce_latency_mark(mce_latency_stage_t stage);
+void mce_latency_mark_at(mce_latency_stage_t stage, gint64 stamp);
+gboolean mce_latency_backlight_pending(void);
+gchar *mce_latency_get_stats(void);
+
+#endif /* _MCE_LATENCY_H_ */
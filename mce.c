@@ -106,6 +106,11 @@
 #include "mce-gconf.h"			/* mce_gconf_init(),
 					 * mce_gconf_exit()
 					 */
+#include "mce-io.h"			/* mce_io_writer_quit(),
+					 * mce_io_persist_flush(),
+					 * mce_io_cache_init(),
+					 * mce_io_cache_exit()
+					 */
 #include "mce-modules.h"		/* mce_modules_dump_info(),
 					 * mce_modules_init(),
 					 * mce_modules_exit()
@@ -117,8 +122,14 @@
 					 * mce_switches_exit()
 					 */
 #include "datapipe.h"			/* setup_datapipe(),
+					 * datapipe_post_init(),
+					 * datapipe_post_quit(),
 					 * free_datapipe()
 					 */
+#include "datapipe-trace.h"		/* datapipe_trace_start(),
+					 * datapipe_trace_replay(),
+					 * datapipe_trace_stop()
+					 */
 #include "modetransition.h"		/* mce_mode_init(),
 					 * mce_mode_exit()
 					 */
@@ -134,6 +145,10 @@
 # include "libwakelock.h"
 #endif
 
+#ifdef ENABLE_HYBRIS
+# include "mce-hybris.h"		/* mce_hybris_quit() */
+#endif
+
 #include <systemd/sd-daemon.h>
 
 /** Path to the lockfile */
@@ -183,6 +198,12 @@ static const char usage_fmt[] =
 "  -v, --verbose              increase debug message verbosity\n"
 "  -t, --trace=<what>         enable domain specific debug logging;\n"
 "                               supported values: \"wakelocks\"\n"
+"  -r, --record-datapipes=<file>\n"
+"                             record datapipe input to a ring file\n"
+"  -R, --replay-datapipes=<file>\n"
+"                             feed recorded datapipe input back to\n"
+"                               the datapipes; use with --debug-mode\n"
+"                               when no hardware is present\n"
 "  -h, --help                 display this help and exit\n"
 "  -V, --version              output version information and exit\n"
 "\n"
@@ -759,8 +780,10 @@ int main(int argc, char **argv)
 	gboolean systembus = TRUE;
 	gboolean debugmode = FALSE;
 	gboolean systemd_notify = FALSE;
+	const gchar *record_path = NULL;
+	const gchar *replay_path = NULL;
 
-	const char optline[] = "dsTSMDqvhVt:n";
+	const char optline[] = "dsTSMDqvhVt:nr:R:";
 
 	struct option const options[] = {
 		{ "systemd",          no_argument,       0, 'n' },
@@ -775,6 +798,8 @@ int main(int argc, char **argv)
 		{ "help",             no_argument,       0, 'h' },
 		{ "version",          no_argument,       0, 'V' },
 		{ "trace",            required_argument, 0, 't' },
+		{ "record-datapipes", required_argument, 0, 'r' },
+		{ "replay-datapipes", required_argument, 0, 'R' },
 		{ 0, 0, 0, 0 }
         };
 
@@ -835,6 +860,15 @@ int main(int argc, char **argv)
 			if( !mce_enable_trace(optarg) )
 				exit(EXIT_FAILURE);
 			break;
+
+		case 'r':
+			record_path = optarg;
+			break;
+
+		case 'R':
+			replay_path = optarg;
+			break;
+
 		default:
 			usage();
 			exit(EXIT_FAILURE);
@@ -885,6 +919,9 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
+	/* Reuse sysfs probe results from earlier during this boot */
+	mce_io_cache_init();
+
 	/* Initialise D-Bus */
 	if (mce_dbus_init(systembus) == FALSE) {
 		mce_log(LL_CRIT,
@@ -904,73 +941,121 @@ int main(int argc, char **argv)
 	}
 
 	/* Setup all datapipes */
-	setup_datapipe(&system_state_pipe, READ_WRITE, DONT_FREE_CACHE,
+	setup_datapipe(&system_state_pipe, "system_state_pipe",
+		       READ_WRITE, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(MCE_STATE_UNDEF));
-	setup_datapipe(&master_radio_pipe, READ_WRITE, DONT_FREE_CACHE,
+	setup_datapipe(&master_radio_pipe, "master_radio_pipe",
+		       READ_WRITE, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(0));
-	setup_datapipe(&call_state_pipe, READ_WRITE, DONT_FREE_CACHE,
+	setup_datapipe(&call_state_pipe, "call_state_pipe",
+		       READ_WRITE, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(CALL_STATE_NONE));
-	setup_datapipe(&call_type_pipe, READ_WRITE, DONT_FREE_CACHE,
+	setup_datapipe(&call_type_pipe, "call_type_pipe",
+		       READ_WRITE, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(NORMAL_CALL));
-	setup_datapipe(&alarm_ui_state_pipe, READ_ONLY, DONT_FREE_CACHE,
+	setup_datapipe(&alarm_ui_state_pipe, "alarm_ui_state_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(MCE_ALARM_UI_INVALID_INT32));
-	setup_datapipe(&submode_pipe, READ_ONLY, DONT_FREE_CACHE,
+	setup_datapipe(&submode_pipe, "submode_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(MCE_NORMAL_SUBMODE));
-	setup_datapipe(&display_state_pipe, READ_WRITE, DONT_FREE_CACHE,
+	setup_datapipe(&display_state_pipe, "display_state_pipe",
+		       READ_WRITE, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(MCE_DISPLAY_UNDEF));
-	setup_datapipe(&display_state_req_pipe, READ_WRITE, DONT_FREE_CACHE,
+	setup_datapipe(&display_state_req_pipe, "display_state_req_pipe",
+		       READ_WRITE, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(MCE_DISPLAY_UNDEF));
-	setup_datapipe(&display_brightness_pipe, READ_WRITE, DONT_FREE_CACHE,
+	setup_datapipe(&display_brightness_pipe, "display_brightness_pipe",
+		       READ_WRITE, DONT_FREE_CACHE, SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(0));
-	setup_datapipe(&led_brightness_pipe, READ_WRITE, DONT_FREE_CACHE,
+	setup_datapipe(&led_brightness_pipe, "led_brightness_pipe",
+		       READ_WRITE, DONT_FREE_CACHE, SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(0));
-	setup_datapipe(&led_pattern_activate_pipe, READ_ONLY, FREE_CACHE,
+	setup_datapipe(&led_pattern_activate_pipe, "led_pattern_activate_pipe",
+		       READ_ONLY, FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, NULL);
-	setup_datapipe(&led_pattern_deactivate_pipe, READ_ONLY, FREE_CACHE,
+	setup_datapipe(&led_pattern_deactivate_pipe, "led_pattern_deactivate_pipe",
+		       READ_ONLY, FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, NULL);
-	setup_datapipe(&key_backlight_pipe, READ_WRITE, DONT_FREE_CACHE,
+	setup_datapipe(&key_backlight_pipe, "key_backlight_pipe",
+		       READ_WRITE, DONT_FREE_CACHE, SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(0));
-	setup_datapipe(&keypress_pipe, READ_ONLY, FREE_CACHE,
+	setup_datapipe(&keypress_pipe, "keypress_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       sizeof (struct input_event), NULL);
-	setup_datapipe(&touchscreen_pipe, READ_ONLY, FREE_CACHE,
+	setup_datapipe(&touchscreen_pipe, "touchscreen_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       sizeof (struct input_event), NULL);
-	setup_datapipe(&device_inactive_pipe, READ_WRITE, DONT_FREE_CACHE,
+	setup_datapipe(&device_inactive_pipe, "device_inactive_pipe",
+		       READ_WRITE, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(FALSE));
-	setup_datapipe(&lockkey_pipe, READ_ONLY, DONT_FREE_CACHE,
+	setup_datapipe(&lockkey_pipe, "lockkey_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(0));
-	setup_datapipe(&keyboard_slide_pipe, READ_ONLY, DONT_FREE_CACHE,
+	setup_datapipe(&keyboard_slide_pipe, "keyboard_slide_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(0));
-	setup_datapipe(&lid_cover_pipe, READ_ONLY, DONT_FREE_CACHE,
+	setup_datapipe(&lid_cover_pipe, "lid_cover_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(0));
-	setup_datapipe(&lens_cover_pipe, READ_ONLY, DONT_FREE_CACHE,
+	setup_datapipe(&lens_cover_pipe, "lens_cover_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(0));
-	setup_datapipe(&proximity_sensor_pipe, READ_ONLY, DONT_FREE_CACHE,
+	setup_datapipe(&proximity_sensor_pipe, "proximity_sensor_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(0));
-	setup_datapipe(&tk_lock_pipe, READ_ONLY, DONT_FREE_CACHE,
+	setup_datapipe(&tk_lock_pipe, "tk_lock_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(LOCK_UNDEF));
-	setup_datapipe(&charger_state_pipe, READ_ONLY, DONT_FREE_CACHE,
+	setup_datapipe(&charger_state_pipe, "charger_state_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(0));
-	setup_datapipe(&battery_status_pipe, READ_ONLY, DONT_FREE_CACHE,
+	setup_datapipe(&battery_status_pipe, "battery_status_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(BATTERY_STATUS_UNDEF));
-	setup_datapipe(&battery_level_pipe, READ_ONLY, DONT_FREE_CACHE,
+	setup_datapipe(&battery_level_pipe, "battery_level_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(100));
-	setup_datapipe(&camera_button_pipe, READ_ONLY, DONT_FREE_CACHE,
+	setup_datapipe(&camera_button_pipe, "camera_button_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(CAMERA_BUTTON_UNDEF));
-	setup_datapipe(&inactivity_timeout_pipe, READ_ONLY, DONT_FREE_CACHE,
+	setup_datapipe(&inactivity_timeout_pipe, "inactivity_timeout_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(DEFAULT_INACTIVITY_TIMEOUT));
-	setup_datapipe(&audio_route_pipe, READ_ONLY, DONT_FREE_CACHE,
+	setup_datapipe(&audio_route_pipe, "audio_route_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(AUDIO_ROUTE_UNDEF));
-	setup_datapipe(&usb_cable_pipe, READ_ONLY, DONT_FREE_CACHE,
+	setup_datapipe(&usb_cable_pipe, "usb_cable_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(0));
-	setup_datapipe(&jack_sense_pipe, READ_ONLY, DONT_FREE_CACHE,
+	setup_datapipe(&jack_sense_pipe, "jack_sense_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(0));
-	setup_datapipe(&power_saving_mode_pipe, READ_ONLY, DONT_FREE_CACHE,
+	setup_datapipe(&power_saving_mode_pipe, "power_saving_mode_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(0));
-	setup_datapipe(&thermal_state_pipe, READ_ONLY, DONT_FREE_CACHE,
+	setup_datapipe(&thermal_state_pipe, "thermal_state_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(THERMAL_STATE_UNDEF));
-	setup_datapipe(&heartbeat_pipe, READ_ONLY, DONT_FREE_CACHE,
+	setup_datapipe(&heartbeat_pipe, "heartbeat_pipe",
+		       READ_ONLY, DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED,
 		       0, GINT_TO_POINTER(0));
 
+	/* Set up posting to datapipes from other threads
+	 * pre-requisite: g_main_loop_new()
+	 */
+	if (datapipe_post_init() == FALSE) {
+		goto EXIT;
+	}
+
+	/* Start recording datapipe input
+	 * pre-requisite: all datapipes have been set up
+	 */
+	if ((record_path != NULL) &&
+	    (datapipe_trace_start(record_path) == FALSE)) {
+		goto EXIT;
+	}
+
 	/* Initialise mode management
 	 * pre-requisite: mce_gconf_init()
 	 * pre-requisite: mce_dbus_init()
@@ -1023,6 +1108,14 @@ int main(int argc, char **argv)
 		goto EXIT;
 	}
 
+	/* Start feeding recorded input to the datapipes
+	 * pre-requisite: mce_modules_init()
+	 */
+	if ((replay_path != NULL) &&
+	    (datapipe_trace_replay(replay_path) == FALSE)) {
+		goto EXIT;
+	}
+
 	/* MCE startup succeeded */
 	status = EXIT_SUCCESS;
 
@@ -1050,6 +1143,21 @@ EXIT:
 	mce_dsme_exit();
 	mce_mode_exit();
 
+	/* Stop recording and replaying datapipe input */
+	datapipe_trace_stop();
+
+	/* Stop the sysfs writer thread before it can no
+	 * longer report back to the mainloop */
+	mce_io_writer_quit();
+
+#ifdef ENABLE_HYBRIS
+	/* Stop the hybris sensor threads posting to the mainloop */
+	mce_hybris_quit();
+#endif
+
+	/* Stop handling datapipe posts from other threads */
+	datapipe_post_quit();
+
 	/* Free all datapipes */
 	free_datapipe(&thermal_state_pipe);
 	free_datapipe(&power_saving_mode_pipe);
@@ -1088,6 +1196,12 @@ EXIT:
 	mce_dbus_exit();
 	mce_conf_exit();
 
+	/* Queue the sysfs attribute cache for saving */
+	mce_io_cache_exit();
+
+	/* Write out files still waiting in the write-behind queue */
+	mce_io_persist_flush();
+
 	/* If the mainloop is initialised, unreference it */
 	if (mainloop != NULL) {
 		g_main_loop_unref(mainloop);
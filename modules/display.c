@@ -41,10 +41,7 @@
 #include <mce/mode-names.h>		/* MCE_CABC_MODE_OFF,
 					 * MCE_CABC_MODE_UI,
 					 * MCE_CABC_MODE_STILL_IMAGE,
-					 * MCE_CABC_MODE_MOVING_IMAGE,
-					 * MCE_DISPLAY_ON_STRING,
-					 * MCE_DISPLAY_DIM_STRING,
-					 * MCE_DISPLAY_OFF_STRING
+					 * MCE_CABC_MODE_MOVING_IMAGE
 					 */
 
 #include "mce.h"			/* display_state_t,
@@ -60,9 +57,14 @@
 #include "display.h"
 
 #include "mce-io.h"			/* mce_close_file(),
-					 * mce_read_string_from_file(),
 					 * mce_read_number_string_from_file(),
-					 * mce_write_number_string_to_file()
+					 * mce_io_cache_read_string(),
+					 * mce_io_cache_read_number(),
+					 * mce_io_cache_access(),
+					 * mce_write_number_string_to_file(),
+					 * mce_io_writer_after(),
+					 * mce_io_writer_sync(),
+					 * mce_io_persist_flush()
 					 */
 #include "mce-lib.h"			/* strstr_delim(),
 					 * mce_translate_string_to_int_with_default(),
@@ -75,6 +77,10 @@
 #include "mce-dbus.h"			/* Direct:
 					 * ---
 					 * mce_dbus_handler_add(),
+					 * mce_dbus_snapshot_add_provider(),
+					 * mce_dbus_snapshot_remove_provider(),
+					 * mce_dbus_snapshot_append_basic(),
+					 * mce_dbus_display_status_name(),
 					 * mce_dbus_owner_monitor_add(),
 					 * mce_dbus_owner_monitor_remove(),
 					 * dbus_send_message(),
@@ -116,8 +122,14 @@
 #include "datapipe.h"			/* datapipe_get_gint(),
 					 * execute_datapipe(),
 					 * append_output_trigger_to_datapipe(),
+					 * append_prioritized_output_trigger_to_datapipe(),
 					 * remove_output_trigger_from_datapipe()
 					 */
+#include "mce-latency.h"		/* mce_latency_mark(),
+					 * mce_latency_mark_at(),
+					 * mce_latency_backlight_pending(),
+					 * MCE_LATENCY_*
+					 */
 #include "tklock.h"
 
 #ifdef ENABLE_WAKELOCKS
@@ -296,12 +308,16 @@ static gboolean charger_connected = FALSE;
 /** Maximum display brightness, hw specific */
 static gint maximum_display_brightness = DEFAULT_MAXIMUM_DISPLAY_BRIGHTNESS;
 
+static void brightness_written_cb(gulong number, gint64 stamp);
+
 /** File used to set display brightness */
 static output_state_t brightness_output =
 {
   .context = "brightness",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .async = TRUE,
+  .written_cb = brightness_written_cb,
 };
 
 /** File used to get maximum display brightness */
@@ -578,7 +594,9 @@ static gboolean get_brightness_controls(const gchar *dirpath,
 	gchar *set = g_strdup_printf("%s/brightness", dirpath);
 	gchar *max = g_strdup_printf("%s/max_brightness", dirpath);
 
-	if( set && max && !g_access(set, W_OK) && !g_access(max, R_OK) ) {
+	if( set && max &&
+	    mce_io_cache_access(set, W_OK) &&
+	    mce_io_cache_access(max, R_OK) ) {
 		*setpath = set, set = 0;
 		*maxpath = max, max = 0;
 		res = TRUE;
@@ -614,7 +632,7 @@ static gboolean get_display_type_from_config(display_type_t *display_type)
 	 * max_brightness files */
 	if( (vdir = mce_conf_get_string_list(group, "brightness_dir", 0)) ) {
 		for( size_t i = 0; vdir[i]; ++i ) {
-			if( !*vdir[i] || g_access(vdir[i], F_OK) )
+			if( !*vdir[i] || !mce_io_cache_access(vdir[i], F_OK) )
 				continue;
 
 			if( get_brightness_controls(vdir[i], &set, &max) )
@@ -631,14 +649,14 @@ static gboolean get_display_type_from_config(display_type_t *display_type)
 		goto EXIT;
 
 	for( size_t i = 0; vset[i]; ++i ) {
-		if( *vset[i] && !g_access(vset[i], W_OK) ) {
+		if( *vset[i] && mce_io_cache_access(vset[i], W_OK) ) {
 			set = g_strdup(vset[i]);
 			break;
 		}
 	}
 
 	for( size_t i = 0; vmax[i]; ++i ) {
-		if( *vmax[i] && !g_access(vmax[i], R_OK) ) {
+		if( *vmax[i] && mce_io_cache_access(vmax[i], R_OK) ) {
 			max = g_strdup(vmax[i]);
 			break;
 		}
@@ -807,7 +825,7 @@ static display_type_t get_display_type(void)
 	else if( get_display_type_from_config(&display_type) ) {
 		// nop
 	}
-	else if (g_access(DISPLAY_BACKLIGHT_PATH DISPLAY_ACX565AKM, W_OK) == 0) {
+	else if (mce_io_cache_access(DISPLAY_BACKLIGHT_PATH DISPLAY_ACX565AKM, W_OK)) {
 		display_type = DISPLAY_TYPE_ACX565AKM;
 
 		brightness_output.path = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_ACX565AKM, DISPLAY_CABC_BRIGHTNESS_FILE, NULL);
@@ -816,8 +834,8 @@ static display_type_t get_display_type(void)
 		cabc_available_modes_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_ACX565AKM, DISPLAY_CABC_AVAILABLE_MODES_FILE, NULL);
 
 		cabc_supported =
-			(g_access(cabc_mode_file, W_OK) == 0);
-	} else if (g_access(DISPLAY_BACKLIGHT_PATH DISPLAY_L4F00311, W_OK) == 0) {
+			mce_io_cache_access(cabc_mode_file, W_OK);
+	} else if (mce_io_cache_access(DISPLAY_BACKLIGHT_PATH DISPLAY_L4F00311, W_OK)) {
 		display_type = DISPLAY_TYPE_L4F00311;
 
 		brightness_output.path = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_L4F00311, DISPLAY_CABC_BRIGHTNESS_FILE, NULL);
@@ -826,8 +844,8 @@ static display_type_t get_display_type(void)
 		cabc_available_modes_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_L4F00311, DISPLAY_CABC_AVAILABLE_MODES_FILE, NULL);
 
 		cabc_supported =
-			(g_access(cabc_mode_file, W_OK) == 0);
-	} else if (g_access(DISPLAY_BACKLIGHT_PATH DISPLAY_TAAL, W_OK) == 0) {
+			mce_io_cache_access(cabc_mode_file, W_OK);
+	} else if (mce_io_cache_access(DISPLAY_BACKLIGHT_PATH DISPLAY_TAAL, W_OK)) {
 		display_type = DISPLAY_TYPE_TAAL;
 
 		brightness_output.path = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_TAAL, DISPLAY_CABC_BRIGHTNESS_FILE, NULL);
@@ -837,8 +855,8 @@ static display_type_t get_display_type(void)
 		cabc_available_modes_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_TAAL, "/device", DISPLAY_CABC_AVAILABLE_MODES_FILE, NULL);
 
 		cabc_supported =
-			(g_access(cabc_mode_file, W_OK) == 0);
-	} else if (g_access(DISPLAY_BACKLIGHT_PATH DISPLAY_HIMALAYA, W_OK) == 0) {
+			mce_io_cache_access(cabc_mode_file, W_OK);
+	} else if (mce_io_cache_access(DISPLAY_BACKLIGHT_PATH DISPLAY_HIMALAYA, W_OK)) {
 		display_type = DISPLAY_TYPE_HIMALAYA;
 
 		brightness_output.path = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_HIMALAYA, DISPLAY_CABC_BRIGHTNESS_FILE, NULL);
@@ -848,8 +866,8 @@ static display_type_t get_display_type(void)
 		cabc_available_modes_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_HIMALAYA, "/device", DISPLAY_CABC_AVAILABLE_MODES_FILE, NULL);
 
 		cabc_supported =
-			(g_access(cabc_mode_file, W_OK) == 0);
-	} else if (g_access(DISPLAY_BACKLIGHT_PATH DISPLAY_DISPLAY0, W_OK) == 0) {
+			mce_io_cache_access(cabc_mode_file, W_OK);
+	} else if (mce_io_cache_access(DISPLAY_BACKLIGHT_PATH DISPLAY_DISPLAY0, W_OK)) {
 		display_type = DISPLAY_TYPE_DISPLAY0;
 
 		brightness_output.path = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_DISPLAY0, DISPLAY_CABC_BRIGHTNESS_FILE, NULL);
@@ -862,23 +880,23 @@ static display_type_t get_display_type(void)
 		low_power_mode_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_DISPLAY0, DISPLAY_DEVICE_PATH, DISPLAY_LPM_FILE, NULL);
 
 		cabc_supported =
-			(g_access(cabc_mode_file, W_OK) == 0);
+			mce_io_cache_access(cabc_mode_file, W_OK);
 		hw_fading_supported =
-			(g_access(hw_fading_output.path, W_OK) == 0);
+			mce_io_cache_access(hw_fading_output.path, W_OK);
 		high_brightness_mode_supported =
-			(g_access(high_brightness_mode_output.path, W_OK) == 0);
+			mce_io_cache_access(high_brightness_mode_output.path, W_OK);
 		low_power_mode_supported =
-			(g_access(low_power_mode_file, W_OK) == 0);
+			mce_io_cache_access(low_power_mode_file, W_OK);
 
 		/* Enable hardware fading if supported */
 		if (hw_fading_supported == TRUE)
 			(void)mce_write_number_string_to_file(&hw_fading_output, 1);
-	} else if (g_access(DISPLAY_BACKLIGHT_PATH DISPLAY_ACPI_VIDEO0, W_OK) == 0) {
+	} else if (mce_io_cache_access(DISPLAY_BACKLIGHT_PATH DISPLAY_ACPI_VIDEO0, W_OK)) {
 		display_type = DISPLAY_TYPE_ACPI_VIDEO0;
 
 		brightness_output.path = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_ACPI_VIDEO0, DISPLAY_CABC_BRIGHTNESS_FILE, NULL);
 		max_brightness_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_ACPI_VIDEO0, DISPLAY_CABC_MAX_BRIGHTNESS_FILE, NULL);
-	} else if (g_access(DISPLAY_GENERIC_PATH, W_OK) == 0) {
+	} else if (mce_io_cache_access(DISPLAY_GENERIC_PATH, W_OK)) {
 		display_type = DISPLAY_TYPE_GENERIC;
 
 		brightness_output.path = g_strconcat(DISPLAY_GENERIC_PATH, DISPLAY_GENERIC_BRIGHTNESS_FILE, NULL);
@@ -1230,8 +1248,8 @@ static void set_cabc_mode(const gchar *const mode)
 
 		available_modes_scanned = TRUE;
 
-		if (mce_read_string_from_file(cabc_available_modes_file,
-					      &available_modes) == FALSE)
+		if (mce_io_cache_read_string(cabc_available_modes_file,
+					     &available_modes) == FALSE)
 			goto EXIT;
 
 		for (i = 0; (tmp = cabc_mode_mapping[i].sysfs) != NULL; i++) {
@@ -1377,18 +1395,32 @@ EXIT:
 	return status;
 }
 
-/** Set the frame buffer power state
+/** Apply a frame buffer power state change
  *
- * @param value The ioctl value to pass to the backlight
- * @return TRUE on success, FALSE on failure
+ * @param aptr The ioctl value to pass to the backlight (as pointer)
  */
-static gboolean backlight_ioctl(int value)
+static void backlight_ioctl_cb(gpointer aptr)
 {
+	int value = GPOINTER_TO_INT(aptr);
+
 	if( backlight_ioctl_hook )
-		return backlight_ioctl_hook(value);
+		backlight_ioctl_hook(value);
+	else
+		mce_log(LL_ERR, "value = %d before initializing hook", value);
+}
 
-	mce_log(LL_ERR, "value = %d before initializing hook", value);
-	return FALSE;
+/** Set the frame buffer power state
+ *
+ * Brightness writes queued before must reach the driver before the
+ * frame buffer power state changes; if the sysfs writer thread still
+ * has some in flight, the change is made from the mainloop once
+ * they have completed instead of waiting for them here.
+ *
+ * @param value The ioctl value to pass to the backlight
+ */
+static void backlight_ioctl(int value)
+{
+	mce_io_writer_after(backlight_ioctl_cb, GINT_TO_POINTER(value));
 }
 /** Set display brightness via sysfs write */
 static void write_brightness_value_default(int number)
@@ -1396,11 +1428,29 @@ static void write_brightness_value_default(int number)
 	mce_write_number_string_to_file(&brightness_output, number);
 }
 
+/** Handle completed write to the brightness file
+ *
+ * @param number brightness value that was written
+ * @param stamp monotonic time of the write completion, in microseconds
+ */
+static void brightness_written_cb(gulong number, gint64 stamp)
+{
+	/* Only the first write after a wakeup completes the latency
+	 * trace; the rest are fade steps */
+	if( number > 0 && mce_latency_backlight_pending() )
+		mce_latency_mark_at(MCE_LATENCY_BACKLIGHT, stamp);
+}
+
 #ifdef ENABLE_HYBRIS
 /** Set display brightness via libhybris */
 static void write_brightness_value_hybris(int number)
 {
 	mce_hybris_backlight_set_brightness(number);
+
+	/* The write is done synchronously; as above, only the
+	 * first one after a wakeup completes the latency trace */
+	if( number > 0 && mce_latency_backlight_pending() )
+		mce_latency_mark(MCE_LATENCY_BACKLIGHT);
 }
 #endif
 
@@ -2398,6 +2448,9 @@ static void renderer_set_state_cb(DBusPendingCall *pending,
 
 	mce_log(LL_NOTICE, "RENDERER state=%d", renderer_ui_state);
 
+	if( renderer_ui_state == RENDERER_ENABLED )
+		mce_latency_mark(MCE_LATENCY_RENDERER);
+
 	stm_rethink_schedule();
 
 cleanup:
@@ -2504,29 +2557,9 @@ static gboolean send_display_status(DBusMessage *const method_call)
 	static const gchar *prev_state = "";
 	display_state_t display_state = datapipe_get_gint(display_state_pipe);
 	DBusMessage *msg = NULL;
-	const gchar *state = NULL;
+	const gchar *state = mce_dbus_display_status_name(display_state);
 	gboolean status = FALSE;
 
-	switch (display_state) {
-	case MCE_DISPLAY_UNDEF:
-	case MCE_DISPLAY_OFF:
-	case MCE_DISPLAY_LPM_OFF:
-	case MCE_DISPLAY_LPM_ON:
-	case MCE_DISPLAY_POWER_DOWN:
-	case MCE_DISPLAY_POWER_UP:
-		state = MCE_DISPLAY_OFF_STRING;
-		break;
-
-	case MCE_DISPLAY_DIM:
-		state = MCE_DISPLAY_DIM_STRING;
-		break;
-
-	case MCE_DISPLAY_ON:
-	default:
-		state = MCE_DISPLAY_ON_STRING;
-		break;
-	}
-
 	if( !method_call ) {
 		if( !strcmp(prev_state, state))
 			goto EXIT;
@@ -2577,6 +2610,12 @@ typedef struct
 	/** frame buffer suspended flag */
 	bool suspended;
 
+	/** frame buffer state last seen by the worker thread */
+	volatile gint fb_state;
+
+	/** worker thread generation; bumped whenever the thread is cancelled */
+	guint generation;
+
 	/** worker thread id */
 	pthread_t thread;
 
@@ -2594,18 +2633,48 @@ typedef struct
 
 	/** sleep file descriptor */
 	int         sleep_fd;
+} waitfb_t;
 
-	/** write end of wakeup mainloop pipe */
-	int  pipe_fd;
+static void waitfb_event_cb(gpointer aptr, gint64 stamp, gdouble value);
+static gboolean waitfb_idle_cb(gpointer aptr);
 
-	/** pipe reader io watch id */
-	guint     pipe_id;
-} waitfb_t;
+/** Publish fb state change and notify mainloop about it
+ *
+ * The state is stored before notifying so that the mainloop always
+ * picks up the latest state no matter in which order, or how many of,
+ * the notifications arrive. Should the post queue be full, the
+ * notification is delivered via glib idle callback instead.
+ *
+ * @param self       state data
+ * @param generation generation of the calling thread
+ * @param suspended  true if fb went to sleep, false if it woke up
+ */
+static void waitfb_post(waitfb_t *self, guint generation, bool suspended)
+{
+	g_atomic_int_set(&self->fb_state, suspended);
+
+	/* A slot claimed from the post queue must get published, and
+	 * glib takes locks; must not get cancelled in either of them */
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, 0);
+
+	if( datapipe_post_call(waitfb_event_cb, GUINT_TO_POINTER(generation),
+			       0, suspended) )
+		goto EXIT;
+
+	fprintf(stderr, "waitfb: post queue full; using idle callback\n");
+
+	g_idle_add_full(G_PRIORITY_HIGH, waitfb_idle_cb,
+			GUINT_TO_POINTER(generation), 0);
+
+EXIT:
+	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, 0);
+	return;
+}
 
 /** Wait for fb sleep/wakeup thread
  *
  * Alternates between waiting for fb wakeup and sleep.
- * Signals mainloop about the changes via a pipe.
+ * Signals mainloop about the changes via the datapipe post queue.
  *
  * @param aptr state data (as void pointer)
  *
@@ -2614,6 +2683,7 @@ typedef struct
 static void *waitfb_thread(void *aptr)
 {
 	waitfb_t *self = aptr;
+	const guint generation = self->generation;
 
 	/* allow quick and dirty cancellation */
 	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, 0);
@@ -2640,7 +2710,7 @@ static void *waitfb_thread(void *aptr)
 		TEMP_FAILURE_RETRY(close(self->wake_fd)), self->wake_fd = -1;
 
 		/* send "woke up" to mainloop */
-		TEMP_FAILURE_RETRY(write(self->pipe_fd, "W", 1));
+		waitfb_post(self, generation, false);
 
 		/* wait for fb sleep */
 		self->sleep_fd = TEMP_FAILURE_RETRY(open(self->sleep_path,
@@ -2657,7 +2727,7 @@ static void *waitfb_thread(void *aptr)
 		TEMP_FAILURE_RETRY(close(self->sleep_fd)), self->sleep_fd = -1;
 
 		/* send "sleeping" to mainloop */
-		TEMP_FAILURE_RETRY(write(self->pipe_fd, "S", 1));
+		waitfb_post(self, generation, true);
 	}
 
 	/* mark thread done and exit */
@@ -2685,17 +2755,8 @@ static void waitfb_cancel(waitfb_t *self)
 	}
 	self->thread  = 0;
 
-	/* remove pipe input io watch */
-	if( self->pipe_id ) {
-		mce_log(LL_DEBUG, "remove pipe input watch");
-		g_source_remove(self->pipe_id), self->pipe_id = 0;
-	}
-
-	/* close pipe output fd */
-	if( self->pipe_fd != -1) {
-		mce_log(LL_DEBUG, "close pipe write fd");
-		close(self->pipe_fd), self->pipe_fd = -1;
-	}
+	/* invalidate events the worker thread might have posted */
+	self->generation++;
 
 	/* close sysfs input fds */
 	if( self->sleep_fd != -1 ) {
@@ -2708,58 +2769,59 @@ static void waitfb_cancel(waitfb_t *self)
 	}
 }
 
-/** Input watch callback for frame buffer resume waiting
- *
- * Gets triggered when worker thread writes to pipe
+/** State information for wait for fb resume thread */
+static waitfb_t waitfb =
+{
+	.suspended  = false,
+	.fb_state   = 0,
+	.generation = 0,
+	.thread     = 0,
+	.finished   = false,
+	.wake_path  = "/sys/power/wait_for_fb_wake",
+	.wake_fd    = -1,
+	.sleep_path = "/sys/power/wait_for_fb_sleep",
+	.sleep_fd   = -1,
+};
+
+/** Mainloop handler for frame buffer resume waiting
  *
- * @param chn  (not used)
- * @param cnd  (not used)
- * @param aptr state data (as void pointer)
+ * Gets called when worker thread posts a sleep/wakeup event
  *
- * @return FALSE (to disable the input watch)
+ * @param aptr  generation of the posting thread (as void pointer)
+ * @param stamp (not used)
+ * @param value (not used, the state is taken from waitfb.fb_state)
  */
-static gboolean waitfb_event_cb(GIOChannel *chn,
-				  GIOCondition cnd,
-				  gpointer aptr)
+static void waitfb_event_cb(gpointer aptr, gint64 stamp, gdouble value)
 {
-	// we just want the wakeup
-	(void)chn; (void)cnd;
-
-	waitfb_t *self = aptr;
-	gboolean  keep = FALSE;
-
-
-	if( !self->pipe_id )
-		goto EXIT;
+	(void)stamp;
+	(void)value;
 
-	char tmp[64];
-	int fd = g_io_channel_unix_get_fd(chn);
-	int rc = read(fd, tmp, sizeof tmp);
+	waitfb_t *self = &waitfb;
 
-	if( rc == -1 ) {
-		if( errno == EINTR || errno == EAGAIN )
-			keep = TRUE;
-		else
-			mce_log(LL_ERR, "read events: %m");
-		goto EXIT;
-	}
-	if( rc == 0 ) {
-		mce_log(LL_ERR, "read events: EOF");
+	/* ignore events posted by cancelled / restarted threads */
+	if( GPOINTER_TO_UINT(aptr) != self->generation )
 		goto EXIT;
-	}
 
-	keep = TRUE;
-	self->suspended = (tmp[rc-1] == 'S');
-	mce_log(LL_NOTICE, "read:%d, suspended:%d", rc, self->suspended);
+	self->suspended = (g_atomic_int_get(&self->fb_state) != 0);
+	mce_log(LL_NOTICE, "suspended:%d", self->suspended);
 	stm_rethink_schedule();
 
 EXIT:
-	if( !keep && self->pipe_id ) {
-		self->pipe_id = 0;
-		mce_log(LL_CRIT, "stopping io watch");
-		waitfb_cancel(self);
-	}
-	return keep;
+	return;
+}
+
+/** Idle callback for frame buffer resume waiting
+ *
+ * Used instead of the datapipe post queue when it is full
+ *
+ * @param aptr generation of the posting thread (as void pointer)
+ *
+ * @return FALSE to stop the idle callback from repeating
+ */
+static gboolean waitfb_idle_cb(gpointer aptr)
+{
+	waitfb_event_cb(aptr, 0, 0);
+	return FALSE;
 }
 
 /** Start delayed display state change broadcast
@@ -2771,8 +2833,6 @@ EXIT:
 static gboolean waitfb_start(waitfb_t *self)
 {
 	gboolean    res    = FALSE;
-	GIOChannel *chn    = 0;
-	int         pfd[2] = {-1, -1};
 
 	waitfb_cancel(self);
 
@@ -2781,23 +2841,6 @@ static gboolean waitfb_start(waitfb_t *self)
 	    access(self->sleep_path, F_OK) == -1 )
 		goto EXIT;
 
-	if( pipe2(pfd, O_CLOEXEC) == -1 ) {
-		mce_log(LL_ERR, "pipe: %m");
-		goto EXIT;
-	}
-
-	self->pipe_fd = pfd[1], pfd[1] = -1;
-
-	if( !(chn = g_io_channel_unix_new(pfd[0])) ) {
-		goto EXIT;
-	}
-	self->pipe_id = g_io_add_watch(chn, G_IO_IN, waitfb_event_cb, self);
-	if( !self->pipe_id ) {
-		goto EXIT;
-	}
-	g_io_channel_set_close_on_unref(chn, TRUE), pfd[0] = -1;
-
-
 	self->finished = false;
 
 	if( pthread_create(&self->thread, 0, waitfb_thread, self) ) {
@@ -2809,30 +2852,12 @@ static gboolean waitfb_start(waitfb_t *self)
 #endif /* ENABLE_WAKELOCKS */
 
 EXIT:
-	if( chn != 0 ) g_io_channel_unref(chn);
-	if( pfd[1] != -1 ) close(pfd[1]);
-	if( pfd[0] != -1 ) close(pfd[0]);
-
 	/* all or nothing */
 	if( !res ) waitfb_cancel(self);
 
 	return res;
 }
 
-/** State information for wait for fb resume thread */
-static waitfb_t waitfb =
-{
-	.suspended  = false,
-	.thread     = 0,
-	.finished   = false,
-	.wake_path  = "/sys/power/wait_for_fb_wake",
-	.wake_fd    = -1,
-	.sleep_path = "/sys/power/wait_for_fb_sleep",
-	.sleep_fd   = -1,
-	.pipe_fd    = -1,
-	.pipe_id    = 0,
-};
-
 /**
  * D-Bus callback for the get display status method call
  *
@@ -2915,16 +2940,13 @@ EXIT:
 }
 
 /**
- * Send a CABC status reply
+ * Get the D-Bus name of the current CABC mode
  *
- * @param method_call A DBusMessage to reply to
- * @return TRUE on success, FALSE on failure
+ * @return CABC mode name, MCE_CABC_MODE_OFF if the mode is not known
  */
-static gboolean send_cabc_mode(DBusMessage *const method_call)
+static const gchar *get_dbus_cabc_mode(void)
 {
 	const gchar *dbus_cabc_mode = NULL;
-	DBusMessage *msg = NULL;
-	gboolean status = FALSE;
 	gint i;
 
 	for (i = 0; cabc_mode_mapping[i].sysfs != NULL; i++) {
@@ -2937,6 +2959,36 @@ static gboolean send_cabc_mode(DBusMessage *const method_call)
 	if (dbus_cabc_mode == NULL)
 		dbus_cabc_mode = MCE_CABC_MODE_OFF;
 
+	return dbus_cabc_mode;
+}
+
+/**
+ * Add the display specific state to a state snapshot
+ *
+ * @param dict DBusMessageIter for the a{sv} array
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean display_snapshot_cb(DBusMessageIter *dict)
+{
+	const gchar *dbus_cabc_mode = get_dbus_cabc_mode();
+
+	return mce_dbus_snapshot_append_basic(dict, "cabc_mode",
+					      DBUS_TYPE_STRING,
+					      &dbus_cabc_mode);
+}
+
+/**
+ * Send a CABC status reply
+ *
+ * @param method_call A DBusMessage to reply to
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean send_cabc_mode(DBusMessage *const method_call)
+{
+	const gchar *dbus_cabc_mode = get_dbus_cabc_mode();
+	DBusMessage *msg = NULL;
+	gboolean status = FALSE;
+
 	mce_log(LL_DEBUG,
 		"Sending CABC mode: %s",
 		dbus_cabc_mode);
@@ -4089,6 +4141,10 @@ UPDATE:
 static void display_state_req_trigger(gconstpointer data)
 {
 	display_state_t display_state = GPOINTER_TO_INT(data);
+
+	if( display_state == MCE_DISPLAY_ON )
+		mce_latency_mark(MCE_LATENCY_DISPLAY_REQ);
+
 	stm_target_push_change(display_state);
 }
 
@@ -4621,10 +4677,13 @@ static bool stm_suspend_allowed_late(void)
 
 static void stm_suspend_start(void)
 {
+	/* Do not leave settings in memory over suspend */
+	mce_io_persist_flush();
+
 #ifdef ENABLE_WAKELOCKS
 	mce_log(LL_NOTICE, "suspending");
 	if( waitfb.thread )
-		wakelock_allow_suspend();
+		mce_io_writer_sync(), wakelock_allow_suspend();
 	else
 		waitfb.suspended = true, backlight_ioctl(FB_BLANK_POWERDOWN);
 #else
@@ -4821,8 +4880,10 @@ static void stm_rethink_step(void)
 	case STM_UNSET:
 	default:
 		stm_wakelock_acquire();
-		if( stm_display_state_needs_power(stm_want) )
+		if( stm_display_state_needs_power(stm_want) ) {
+			mce_latency_mark(MCE_LATENCY_STM);
 			stm_trans(STM_RENDERER_INIT_START);
+		}
 		break;
 
 	case STM_RENDERER_INIT_START:
@@ -5298,8 +5359,9 @@ const gchar *g_module_check_init(GModule *module)
 					  charger_state_trigger);
 	append_output_trigger_to_datapipe(&display_brightness_pipe,
 					  display_brightness_trigger);
-	append_output_trigger_to_datapipe(&display_state_pipe,
-					  display_state_trigger);
+	append_prioritized_output_trigger_to_datapipe(&display_state_pipe,
+						      display_state_trigger,
+						      TRIGGER_PRIORITY_CRITICAL);
 	append_output_trigger_to_datapipe(&display_state_req_pipe,
 					  display_state_req_trigger);
 	append_output_trigger_to_datapipe(&submode_pipe,
@@ -5310,8 +5372,9 @@ const gchar *g_module_check_init(GModule *module)
 					  call_state_trigger);
 	append_output_trigger_to_datapipe(&power_saving_mode_pipe,
 					  power_saving_mode_trigger);
-	append_output_trigger_to_datapipe(&proximity_sensor_pipe,
-					  proximity_sensor_trigger);
+	append_prioritized_output_trigger_to_datapipe(&proximity_sensor_pipe,
+						      proximity_sensor_trigger,
+						      TRIGGER_PRIORITY_CRITICAL);
 	append_output_trigger_to_datapipe(&alarm_ui_state_pipe,
 					  alarm_ui_state_trigger);
 
@@ -5321,8 +5384,7 @@ const gchar *g_module_check_init(GModule *module)
 			"defaulting to %d",
 			maximum_display_brightness);
 	}
-	else if( !mce_read_number_string_from_file(max_brightness_file,
-						   &tmp, NULL, FALSE, TRUE) ) {
+	else if( !mce_io_cache_read_number(max_brightness_file, &tmp) ) {
 		mce_log(LL_ERR,
 			"Could not read the maximum brightness from %s; "
 			"defaulting to %d",
@@ -5357,6 +5419,8 @@ const gchar *g_module_check_init(GModule *module)
 				 cabc_mode_get_dbus_cb) == NULL)
 		goto EXIT;
 
+	mce_dbus_snapshot_add_provider(display_snapshot_cb);
+
 	/* req_display_state_on */
 	if (mce_dbus_handler_add(MCE_REQUEST_IF,
 				 MCE_DISPLAY_ON_REQ,
@@ -5643,6 +5707,8 @@ void g_module_unload(GModule *module)
 	/* Mark down that we are unloading */
 	module_unloading = TRUE;
 
+	mce_dbus_snapshot_remove_provider(display_snapshot_cb);
+
 	/* Kill the framebuffer sleep/wakeup thread */
 	waitfb_cancel(&waitfb);
 
@@ -22,7 +22,6 @@
  */
 #include <glib.h>
 #include <gmodule.h>
-#include <glib/gstdio.h>		/* g_access() */
 
 #include <errno.h>			/* errno */
 #include <fcntl.h>			/* open() */
@@ -58,7 +57,8 @@
 
 #include "mce-io.h"			/* mce_read_string_from_file(),
 					 * mce_read_number_string_from_file(),
-					 * mce_write_number_string_to_file()
+					 * mce_write_number_string_to_file(),
+					 * mce_io_cache_access()
 					 */
 #include "mce-lib.h"			/* strstr_delim(),
 					 * mce_translate_string_to_int_with_default(),
@@ -407,21 +407,21 @@ static display_type_t get_display_type(void)
 	if (display_type != DISPLAY_TYPE_UNSET)
 		goto EXIT;
 
-	if (g_access(DISPLAY_BACKLIGHT_PATH DISPLAY_ACX565AKM, W_OK) == 0) {
+	if (mce_io_cache_access(DISPLAY_BACKLIGHT_PATH DISPLAY_ACX565AKM, W_OK)) {
 		display_type = DISPLAY_TYPE_ACX565AKM;
 
 		brightness_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_ACX565AKM, DISPLAY_CABC_BRIGHTNESS_FILE, NULL);
 		max_brightness_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_ACX565AKM, DISPLAY_CABC_MAX_BRIGHTNESS_FILE, NULL);
 		cabc_mode_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_ACX565AKM, DISPLAY_CABC_MODE_FILE, NULL);
 		cabc_available_modes_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_ACX565AKM, DISPLAY_CABC_AVAILABLE_MODES_FILE, NULL);
-	} else if (g_access(DISPLAY_BACKLIGHT_PATH DISPLAY_L4F00311, W_OK) == 0) {
+	} else if (mce_io_cache_access(DISPLAY_BACKLIGHT_PATH DISPLAY_L4F00311, W_OK)) {
 		display_type = DISPLAY_TYPE_L4F00311;
 
 		brightness_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_L4F00311, DISPLAY_CABC_BRIGHTNESS_FILE, NULL);
 		max_brightness_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_L4F00311, DISPLAY_CABC_MAX_BRIGHTNESS_FILE, NULL);
 		cabc_mode_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_L4F00311, DISPLAY_CABC_MODE_FILE, NULL);
 		cabc_available_modes_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_L4F00311, DISPLAY_CABC_AVAILABLE_MODES_FILE, NULL);
-	} else if (g_access(DISPLAY_BACKLIGHT_PATH DISPLAY_TAAL, W_OK) == 0) {
+	} else if (mce_io_cache_access(DISPLAY_BACKLIGHT_PATH DISPLAY_TAAL, W_OK)) {
 		display_type = DISPLAY_TYPE_TAAL;
 
 		brightness_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_TAAL, DISPLAY_CABC_BRIGHTNESS_FILE, NULL);
@@ -429,7 +429,7 @@ static display_type_t get_display_type(void)
 
 		cabc_mode_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_TAAL, "/device", DISPLAY_CABC_MODE_FILE, NULL);
 		cabc_available_modes_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_TAAL, "/device", DISPLAY_CABC_AVAILABLE_MODES_FILE, NULL);
-	} else if (g_access(DISPLAY_BACKLIGHT_PATH DISPLAY_HIMALAYA, W_OK) == 0) {
+	} else if (mce_io_cache_access(DISPLAY_BACKLIGHT_PATH DISPLAY_HIMALAYA, W_OK)) {
 		display_type = DISPLAY_TYPE_HIMALAYA;
 
 		brightness_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_HIMALAYA, DISPLAY_CABC_BRIGHTNESS_FILE, NULL);
@@ -437,7 +437,7 @@ static display_type_t get_display_type(void)
 
 		cabc_mode_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_HIMALAYA, "/device", DISPLAY_CABC_MODE_FILE, NULL);
 		cabc_available_modes_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_HIMALAYA, "/device", DISPLAY_CABC_AVAILABLE_MODES_FILE, NULL);
-	} else if (g_access(DISPLAY_BACKLIGHT_PATH DISPLAY_DISPLAY0, W_OK) == 0) {
+	} else if (mce_io_cache_access(DISPLAY_BACKLIGHT_PATH DISPLAY_DISPLAY0, W_OK)) {
 		display_type = DISPLAY_TYPE_DISPLAY0;
 
 		brightness_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_DISPLAY0, DISPLAY_CABC_BRIGHTNESS_FILE, NULL);
@@ -445,12 +445,12 @@ static display_type_t get_display_type(void)
 
 		cabc_mode_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_DISPLAY0, "/device", DISPLAY_CABC_MODE_FILE, NULL);
 		cabc_available_modes_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_DISPLAY0, "/device", DISPLAY_CABC_AVAILABLE_MODES_FILE, NULL);
-	} else if (g_access(DISPLAY_BACKLIGHT_PATH DISPLAY_ACPI_VIDEO0, W_OK) == 0) {
+	} else if (mce_io_cache_access(DISPLAY_BACKLIGHT_PATH DISPLAY_ACPI_VIDEO0, W_OK)) {
 		display_type = DISPLAY_TYPE_ACPI_VIDEO0;
 
 		brightness_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_ACPI_VIDEO0, DISPLAY_CABC_BRIGHTNESS_FILE, NULL);
 		max_brightness_file = g_strconcat(DISPLAY_BACKLIGHT_PATH, DISPLAY_ACPI_VIDEO0, DISPLAY_CABC_MAX_BRIGHTNESS_FILE, NULL);
-	} else if (g_access(DISPLAY_GENERIC_PATH, W_OK) == 0) {
+	} else if (mce_io_cache_access(DISPLAY_GENERIC_PATH, W_OK)) {
 		display_type = DISPLAY_TYPE_GENERIC;
 
 		brightness_file = g_strconcat(DISPLAY_GENERIC_PATH, DISPLAY_GENERIC_BRIGHTNESS_FILE, NULL);
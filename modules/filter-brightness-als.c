@@ -23,7 +23,6 @@
  */
 #include <glib.h>
 #include <gmodule.h>
-#include <glib/gstdio.h>		/* g_access */
 
 #include <errno.h>			/* errno */
 #include <fcntl.h>			/* O_NONBLOCK */
@@ -34,13 +33,15 @@
 #include "mce.h"
 #include "filter-brightness-als.h"
 
-#include "mce-io.h"			/* mce_close_file(),
-					 * mce_read_chunk_from_file(),
-					 * mce_read_number_string_from_file(),
+#include "mce-io.h"			/* mce_close_input(),
+					 * mce_read_input(),
+					 * mce_read_input_number(),
 					 * mce_write_string_to_file(),
 					 * mce_write_number_string_to_file(),
 					 * mce_register_io_monitor_chunk(),
-					 * mce_unregister_io_monitor()
+					 * mce_set_io_monitor_reopen(),
+					 * mce_unregister_io_monitor(),
+					 * mce_io_cache_access()
 					 */
 #include "mce-lib.h"			/* mce_translate_string_to_int_with_default(),
 					 * mce_translation_t
@@ -59,6 +60,9 @@
 #include "mce-dbus.h"			/* Direct:
 					 * ---
 					 * mce_dbus_handler_add(),
+					 * mce_dbus_snapshot_add_provider(),
+					 * mce_dbus_snapshot_remove_provider(),
+					 * mce_dbus_snapshot_append_basic(),
 					 * dbus_send_message(),
 					 * dbus_new_method_reply(),
 					 * dbus_new_signal(),
@@ -75,6 +79,7 @@
 					 * MCE_REQUEST_IF
 					 */
 #include "datapipe.h"			/* execute_datapipe(),
+					 * execute_datapipe_deferred(),
 					 * append_output_trigger_to_datapipe(),
 					 * append_filter_to_datapipe(),
 					 * remove_filter_from_datapipe(),
@@ -822,8 +827,17 @@ static gint brightness_stepdown_delay = ALS_BRIGHTNESS_STEPDOWN_DELAY;
 /** ID for brightness stepdown delay timer */
 static guint brightness_delay_timer_cb_id = 0;
 
-/** FILE * for the ambient_light_sensor */
-static FILE *als_fp = NULL;
+/** Ambient light sensor device node (Avago, Dipro) */
+static input_state_t als_device_input =
+{
+  .context = "als_device",
+};
+
+/** Ambient light sensor lux file (TSL2562, TSL2563) */
+static input_state_t als_lux_input =
+{
+  .context = "als_lux",
+};
 
 /** Ambient Light Sensor type */
 typedef enum {
@@ -953,9 +967,10 @@ static als_type_t get_als_type(void)
 	if (als_type != ALS_TYPE_UNSET)
 		goto EXIT;
 
-	if (g_access(ALS_DEVICE_PATH_AVAGO, R_OK) == 0) {
+	if (mce_io_cache_access(ALS_DEVICE_PATH_AVAGO, R_OK)) {
 		als_type = ALS_TYPE_AVAGO;
 		als_device_path = ALS_DEVICE_PATH_AVAGO;
+		als_device_input.path = als_device_path;
 		als_calib0_output.path = ALS_CALIB_PATH_AVAGO;
 		als_threshold_range_path = ALS_THRESHOLD_RANGE_PATH_AVAGO;
 		als_threshold_max = ALS_THRESHOLD_MAX_AVAGO;
@@ -966,12 +981,13 @@ static als_type_t get_als_type(void)
 		display_cpa_enable_path = COLOUR_PHASE_ENABLE_PATH;
 		display_cpa_coefficients_path = COLOUR_PHASE_COEFFICIENTS_PATH;
 
-		if (g_access(display_cpa_enable_path, W_OK) == 0) {
+		if (mce_io_cache_access(display_cpa_enable_path, W_OK)) {
 			display_cpa_profile_static = rm696_phase_profile;
 		}
-	} else if (g_access(ALS_DEVICE_PATH_DIPRO, R_OK) == 0) {
+	} else if (mce_io_cache_access(ALS_DEVICE_PATH_DIPRO, R_OK)) {
 		als_type = ALS_TYPE_DIPRO;
 		als_device_path = ALS_DEVICE_PATH_DIPRO;
+		als_device_input.path = als_device_path;
 		als_calib0_output.path = ALS_CALIB_PATH_DIPRO;
 		als_threshold_range_path = ALS_THRESHOLD_RANGE_PATH_DIPRO;
 		als_threshold_max = ALS_THRESHOLD_MAX_DIPRO;
@@ -983,21 +999,23 @@ static als_type_t get_als_type(void)
 		display_cpa_enable_path = COLOUR_PHASE_ENABLE_PATH;
 		display_cpa_coefficients_path = COLOUR_PHASE_COEFFICIENTS_PATH;
 
-		if (g_access(display_cpa_enable_path, W_OK) == 0) {
+		if (mce_io_cache_access(display_cpa_enable_path, W_OK)) {
 			display_cpa_profile_static = rm680_phase_profile;
 		}
-	} else if (g_access(ALS_LUX_PATH_TSL2563, R_OK) == 0) {
+	} else if (mce_io_cache_access(ALS_LUX_PATH_TSL2563, R_OK)) {
 		als_type = ALS_TYPE_TSL2563;
 		als_lux_path = ALS_LUX_PATH_TSL2563;
+		als_lux_input.path = als_lux_path;
 		als_calib0_output.path = ALS_CALIB0_PATH_TSL2563;
 		als_calib1_output.path = ALS_CALIB1_PATH_TSL2563;
 		display_als_profiles = display_als_profiles_rx51;
 		led_als_profiles = led_als_profiles_rx51;
 		kbd_als_profiles = kbd_als_profiles_rx51;
 		use_median_filter = TRUE;
-	} else if (g_access(ALS_LUX_PATH_TSL2562, R_OK) == 0) {
+	} else if (mce_io_cache_access(ALS_LUX_PATH_TSL2562, R_OK)) {
 		als_type = ALS_TYPE_TSL2562;
 		als_lux_path = ALS_LUX_PATH_TSL2562;
+		als_lux_input.path = als_lux_path;
 		als_calib0_output.path = ALS_CALIB0_PATH_TSL2562;
 		als_calib1_output.path = ALS_CALIB1_PATH_TSL2562;
 		display_als_profiles = display_als_profiles_rx44;
@@ -1020,7 +1038,7 @@ static als_type_t get_als_type(void)
 
 	/* If the range path doesn't exist, disable it */
 	if (als_threshold_range_path != NULL) {
-		if (g_access(als_threshold_range_path, W_OK) == -1)
+		if (!mce_io_cache_access(als_threshold_range_path, W_OK))
 			als_threshold_range_path = NULL;
 	}
 
@@ -1304,23 +1322,21 @@ static gint als_median_filter_map(gint value)
 static gint als_read_value_filtered(void)
 {
 	gint filtered_read = -2;
-	void *tmp = NULL;
 	gulong lux;
 
 	if (als_enabled == FALSE)
 		goto EXIT;
 
 	if (get_als_type() == ALS_TYPE_AVAGO) {
-		struct avago_als *als;
-		gssize len = sizeof (struct avago_als);
+		struct avago_als als;
+		gsize len = sizeof als;
 
-		if (mce_read_chunk_from_file(als_device_path, &tmp, &len,
-					     0) == FALSE) {
+		if (mce_read_input(&als_device_input, &als, &len) == FALSE) {
 			filtered_read = -1;
 			goto EXIT;
 		}
 
-		if (len != sizeof (struct avago_als)) {
+		if (len != sizeof als) {
 			mce_log(LL_ERR,
 				"Short read from `%s'",
 				als_device_path);
@@ -1328,24 +1344,21 @@ static gint als_read_value_filtered(void)
 			goto EXIT;
 		}
 
-		als = (struct avago_als *)tmp;
-
-		if ((als->status & APDS990X_ALS_SATURATED) != 0) {
+		if ((als.status & APDS990X_ALS_SATURATED) != 0) {
 			lux = G_MAXINT;
 		} else {
-			lux = als->lux;
+			lux = als.lux;
 		}
 	} else if (get_als_type() == ALS_TYPE_DIPRO) {
-		struct dipro_als *als;
-		gssize len = sizeof (struct dipro_als);
+		struct dipro_als als;
+		gsize len = sizeof als;
 
-		if (mce_read_chunk_from_file(als_device_path, &tmp, &len,
-					     0) == FALSE) {
+		if (mce_read_input(&als_device_input, &als, &len) == FALSE) {
 			filtered_read = -1;
 			goto EXIT;
 		}
 
-		if (len != sizeof (struct dipro_als)) {
+		if (len != sizeof als) {
 			mce_log(LL_ERR,
 				"Short read from `%s'",
 				als_device_path);
@@ -1353,8 +1366,7 @@ static gint als_read_value_filtered(void)
 			goto EXIT;
 		}
 
-		als = (struct dipro_als *)tmp;
-		lux = als->lux;
+		lux = als.lux;
 	}
 #ifdef ENABLE_HYBRIS
 	else if( get_als_type() == ALS_TYPE_HYBRIS ) {
@@ -1364,9 +1376,7 @@ static gint als_read_value_filtered(void)
 #endif
 	else {
 		/* Read lux value from ALS */
-		if (mce_read_number_string_from_file(als_lux_path,
-						     &lux, &als_fp,
-						     TRUE, FALSE) == FALSE) {
+		if (mce_read_input_number(&als_lux_input, &lux) == FALSE) {
 			filtered_read = -1;
 			goto EXIT;
 		}
@@ -1375,8 +1385,6 @@ static gint als_read_value_filtered(void)
 	filtered_read = als_median_filter_map(lux);
 
 EXIT:
-	g_free(tmp);
-
 	return filtered_read;
 }
 
@@ -1464,13 +1472,14 @@ static gboolean als_poll_timer_cb(gpointer data)
 
 	als_lux = new_lux;
 
-	/* Re-filter the brightness */
-	(void)execute_datapipe(&display_brightness_pipe, NULL,
-			       USE_CACHE, DONT_CACHE_INDATA);
-	(void)execute_datapipe(&led_brightness_pipe, NULL,
-			       USE_CACHE, DONT_CACHE_INDATA);
-	(void)execute_datapipe(&key_backlight_pipe, NULL,
-			       USE_CACHE, DONT_CACHE_INDATA);
+	/* Re-filter the brightness; defer it so that it gets merged
+	 * with other brightness updates in the same mainloop round */
+	execute_datapipe_deferred(&display_brightness_pipe, NULL,
+				  USE_CACHE, DONT_CACHE_INDATA);
+	execute_datapipe_deferred(&led_brightness_pipe, NULL,
+				  USE_CACHE, DONT_CACHE_INDATA);
+	execute_datapipe_deferred(&key_backlight_pipe, NULL,
+				  USE_CACHE, DONT_CACHE_INDATA);
 
 	/* Adjust the colour phase coefficients */
 	if (display_cpa_profile() != NULL) {
@@ -1786,11 +1795,11 @@ static void setup_als_poll_timer(void)
 	if (als_poll_interval == 0) {
 		cancel_als_poll_timer();
 
-		/* Close the file pointer when we disable the als polling
+		/* Close the files when we disable the als polling
 		 * to ensure that the ALS can sleep
 		 */
-		if( als_fp )
-			mce_close_file(als_lux_path, &als_fp);
+		mce_close_input(&als_lux_input);
+		mce_close_input(&als_device_input);
 		goto EXIT;
 	}
 
@@ -1806,11 +1815,13 @@ static void setup_als_poll_timer(void)
 	case ALS_TYPE_AVAGO:
 		/* Register ALS I/O monitor */
 		als_iomon_id = mce_register_io_monitor_chunk(-1, als_device_path, MCE_IO_ERROR_POLICY_WARN, G_IO_IN | G_IO_PRI | G_IO_ERR, FALSE, als_avago_iomon_cb, sizeof (struct avago_als));
+		mce_set_io_monitor_reopen(als_iomon_id, TRUE);
 		break;
 
 	case ALS_TYPE_DIPRO:
 		/* Register ALS I/O monitor */
 		als_iomon_id = mce_register_io_monitor_chunk(-1, als_device_path, MCE_IO_ERROR_POLICY_WARN, G_IO_IN | G_IO_PRI | G_IO_ERR, FALSE, als_dipro_iomon_cb, sizeof (struct dipro_als));
+		mce_set_io_monitor_reopen(als_iomon_id, TRUE);
 		break;
 
 #ifdef ENABLE_HYBRIS
@@ -2107,6 +2118,22 @@ EXIT:
 	return status;
 }
 
+/**
+ * Add the current color profile id to a state snapshot
+ *
+ * @param dict DBusMessageIter for the a{sv} array
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean color_profile_snapshot_cb(DBusMessageIter *dict)
+{
+	const gchar *id_to_send = (current_color_profile_id == NULL ?
+				   COLOR_PROFILE_ID_HARDCODED :
+				   current_color_profile_id);
+
+	return mce_dbus_snapshot_append_basic(dict, "color_profile",
+					      DBUS_TYPE_STRING, &id_to_send);
+}
+
 /**
  * Send the current profile id
  *
@@ -2662,6 +2689,8 @@ const gchar *g_module_check_init(GModule *module)
 				 color_profile_get_req_dbus_cb) == NULL)
 		goto EXIT;
 
+	mce_dbus_snapshot_add_provider(color_profile_snapshot_cb);
+
 	/* get_color_profile_ids */
 	if (mce_dbus_handler_add(MCE_REQUEST_IF,
 				 MCE_COLOR_PROFILE_IDS_GET,
@@ -2776,6 +2805,8 @@ void g_module_unload(GModule *module)
 {
 	(void)module;
 
+	mce_dbus_snapshot_remove_provider(color_profile_snapshot_cb);
+
 	display_cpa_profile_dynamic = NULL;
 	current_color_profile_id = NULL;
 	free_color_profiles(display_cpa_profiles);
@@ -2786,8 +2817,9 @@ void g_module_unload(GModule *module)
 
 	als_enabled = FALSE;
 
-	/* Close the ALS file pointer */
-	(void)mce_close_file(als_lux_path, &als_fp);
+	/* Close the ALS files */
+	mce_close_input(&als_lux_input);
+	mce_close_input(&als_device_input);
 
 	/* Remove triggers/filters from datapipes */
 	remove_output_trigger_from_datapipe(&display_state_pipe,
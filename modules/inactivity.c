@@ -29,6 +29,9 @@
 #include "mce-dbus.h"			/* Direct:
 					 * ---
 					 * mce_dbus_handler_add(),
+					 * mce_dbus_snapshot_add_provider(),
+					 * mce_dbus_snapshot_remove_provider(),
+					 * mce_dbus_snapshot_append_basic(),
 					 * dbus_send_message(),
 					 * dbus_new_method_reply(),
 					 * dbus_new_signal(),
@@ -150,6 +153,20 @@ EXIT:
 	return status;
 }
 
+/**
+ * Add the inactivity status to a state snapshot
+ *
+ * @param dict DBusMessageIter for the a{sv} array
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean inactivity_snapshot_cb(DBusMessageIter *dict)
+{
+	dbus_bool_t inactive = device_inactive;
+
+	return mce_dbus_snapshot_append_basic(dict, "inactivity_status",
+					      DBUS_TYPE_BOOLEAN, &inactive);
+}
+
 /**
  * D-Bus callback for the get inactivity status method call
  *
@@ -559,6 +576,8 @@ const gchar *g_module_check_init(GModule *module)
 				 inactivity_status_get_dbus_cb) == NULL)
 		goto EXIT;
 
+	mce_dbus_snapshot_add_provider(inactivity_snapshot_cb);
+
 	/* add_activity_callback */
 	if (mce_dbus_handler_add(MCE_REQUEST_IF,
 				 MCE_ADD_ACTIVITY_CALLBACK_REQ,
@@ -593,6 +612,8 @@ void g_module_unload(GModule *module)
 {
 	(void)module;
 
+	mce_dbus_snapshot_remove_provider(inactivity_snapshot_cb);
+
 	/* Remove triggers/filters from datapipes */
 	remove_output_trigger_from_datapipe(&inactivity_timeout_pipe,
 					    inactivity_timeout_trigger);
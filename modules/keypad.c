@@ -36,6 +36,9 @@
 #include "mce-dbus.h"			/* Direct:
 					 * ---
 					 * mce_dbus_handler_add(),
+					 * mce_dbus_snapshot_add_provider(),
+					 * mce_dbus_snapshot_remove_provider(),
+					 * mce_dbus_snapshot_append_basic(),
 					 * dbus_send_message(),
 					 * dbus_new_method_reply(),
 					 * dbus_message_append_args(),
@@ -56,6 +59,7 @@
 					 * datapipe_get_guint(),
 					 * datapipe_get_old_gint(),
 					 * append_output_trigger_to_datapipe(),
+					 * append_prioritized_output_trigger_to_datapipe(),
 					 * remove_output_trigger_from_datapipe()
 					 */
 #include "mce-conf.h"			/* mce_conf_get_bool() */
@@ -103,6 +107,7 @@ static output_state_t led_current_kb0_output =
   .context = "led_current_kb0",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .skip_unchanged = TRUE,
 };
 /** Key backlight channel 1 LED current path */
 static output_state_t led_current_kb1_output =
@@ -110,6 +115,7 @@ static output_state_t led_current_kb1_output =
   .context = "led_current_kb1",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .skip_unchanged = TRUE,
 };
 /** Key backlight channel 2 LED current path */
 static output_state_t led_current_kb2_output =
@@ -117,6 +123,7 @@ static output_state_t led_current_kb2_output =
   .context = "led_current_kb2",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .skip_unchanged = TRUE,
 };
 /** Key backlight channel 3 LED current path */
 static output_state_t led_current_kb3_output =
@@ -124,6 +131,7 @@ static output_state_t led_current_kb3_output =
   .context = "led_current_kb3",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .skip_unchanged = TRUE,
 };
 /** Key backlight channel 4 LED current path */
 static output_state_t led_current_kb4_output =
@@ -131,6 +139,7 @@ static output_state_t led_current_kb4_output =
   .context = "led_current_kb4",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .skip_unchanged = TRUE,
 };
 /** Key backlight channel 5 LED current path */
 static output_state_t led_current_kb5_output =
@@ -138,6 +147,7 @@ static output_state_t led_current_kb5_output =
   .context = "led_current_kb5",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .skip_unchanged = TRUE,
 };
 
 /** Key backlight channel 0 backlight path */
@@ -640,6 +650,20 @@ EXIT:
 	return status;
 }
 
+/**
+ * Add the key backlight state to a state snapshot
+ *
+ * @param dict DBusMessageIter for the a{sv} array
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean key_backlight_snapshot_cb(DBusMessageIter *dict)
+{
+	dbus_bool_t state = key_backlight_is_enabled;
+
+	return mce_dbus_snapshot_append_basic(dict, "key_backlight_state",
+					      DBUS_TYPE_BOOLEAN, &state);
+}
+
 /**
  * Datapipe trigger for device inactivity
  *
@@ -751,8 +775,9 @@ const gchar *g_module_check_init(GModule *module)
 					  device_inactive_trigger);
 	append_output_trigger_to_datapipe(&keyboard_slide_pipe,
 					  keyboard_slide_trigger);
-	append_output_trigger_to_datapipe(&display_state_pipe,
-					  display_state_trigger);
+	append_prioritized_output_trigger_to_datapipe(&display_state_pipe,
+						      display_state_trigger,
+						      TRIGGER_PRIORITY_IDLE);
 
 	/* Get configuration options */
 	key_backlight_timeout =
@@ -788,6 +813,8 @@ const gchar *g_module_check_init(GModule *module)
 				 key_backlight_state_get_dbus_cb) == NULL)
 		goto EXIT;
 
+	mce_dbus_snapshot_add_provider(key_backlight_snapshot_cb);
+
 	setup_key_backlight();
 
 EXIT:
@@ -804,6 +831,8 @@ void g_module_unload(GModule *module)
 {
 	(void)module;
 
+	mce_dbus_snapshot_remove_provider(key_backlight_snapshot_cb);
+
 	/* Close files */
 	mce_close_output(&led_current_kb0_output);
 	mce_close_output(&led_current_kb1_output);
@@ -41,7 +41,8 @@
 
 #include "mce-io.h"			/* mce_close_file(),
 					 * mce_write_string_to_file(),
-					 * mce_write_number_string_to_file()
+					 * mce_write_number_string_to_file(),
+					 * mce_io_writer_sync()
 					 */
 #include "mce-hal.h"			/* get_product_id(),
 					 * product_id_t
@@ -84,6 +85,7 @@
 #include "datapipe.h"			/* execute_datapipe(),
 					 * datapipe_get_gint(),
 					 * append_output_trigger_to_datapipe(),
+					 * append_prioritized_output_trigger_to_datapipe(),
 					 * remove_output_trigger_from_datapipe()
 					 */
 
@@ -263,6 +265,8 @@ static output_state_t led_current_rm_output =
   .context = "led_current_rm",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .async = TRUE,
+  .skip_unchanged = TRUE,
 };
 
 /** Path to green channel LED current path */
@@ -271,6 +275,8 @@ static output_state_t led_current_g_output =
   .context = "led_current_g",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .async = TRUE,
+  .skip_unchanged = TRUE,
 };
 
 /** Path to blue channel LED current path */
@@ -279,6 +285,8 @@ static output_state_t led_current_b_output =
   .context = "led_current_b",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .async = TRUE,
+  .skip_unchanged = TRUE,
 };
 
 /** Path to monochrome/red channel LED brightness path  */
@@ -287,6 +295,7 @@ static output_state_t led_brightness_rm_output =
   .context = "led_brightness_rm",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .async = TRUE,
 };
 
 /** Path to red channel LED brightness path */
@@ -295,6 +304,7 @@ static output_state_t led_brightness_g_output =
   .context = "led_brightness_g",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .async = TRUE,
 };
 
 /** Path to blue channel LED brightness path */
@@ -303,6 +313,7 @@ static output_state_t led_brightness_b_output =
   .context = "led_brightness_b",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .async = TRUE,
 };
 
 /** Path to engine 1 mode */
@@ -794,6 +805,10 @@ static void lysti_disable_led(void)
 		(void)mce_write_number_string_to_file(&led_brightness_g_output, 0);
 		(void)mce_write_number_string_to_file(&led_brightness_b_output, 0);
 	}
+
+	/* Do not let the queued writes land after engine writes
+	 * that follow, e.g. when a new pattern is programmed */
+	mce_io_writer_sync();
 }
 
 /**
@@ -822,6 +837,10 @@ static void njoy_disable_led(void)
 		(void)mce_write_number_string_to_file(&led_brightness_g_output, 0);
 		(void)mce_write_number_string_to_file(&led_brightness_b_output, 0);
 	}
+
+	/* Do not let the queued writes land after engine writes
+	 * that follow, e.g. when a new pattern is programmed */
+	mce_io_writer_sync();
 }
 
 /**
@@ -2346,8 +2365,9 @@ const gchar *g_module_check_init(GModule *module)
 	/* Append triggers/filters to datapipes */
 	append_output_trigger_to_datapipe(&system_state_pipe,
 					  system_state_trigger);
-	append_output_trigger_to_datapipe(&display_state_pipe,
-					  display_state_trigger);
+	append_prioritized_output_trigger_to_datapipe(&display_state_pipe,
+						      display_state_trigger,
+						      TRIGGER_PRIORITY_IDLE);
 	append_output_trigger_to_datapipe(&led_brightness_pipe,
 					  led_brightness_trigger);
 	append_output_trigger_to_datapipe(&led_pattern_activate_pipe,
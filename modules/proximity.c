@@ -21,7 +21,6 @@
  */
 #include <glib.h>
 #include <gmodule.h>
-#include <glib/gstdio.h>		/* g_access */
 
 #include <errno.h>			/* errno */
 #include <fcntl.h>			/* O_NONBLOCK */
@@ -32,11 +31,14 @@
 #include "mce.h"
 #include "proximity.h"
 
-#include "mce-io.h"			/* mce_read_chunk_from_file(),
+#include "mce-io.h"			/* mce_read_input(),
+					 * mce_close_input(),
 					 * mce_write_string_to_file(),
 					 * mce_write_number_string_to_file(),
 					 * mce_register_io_monitor_chunk(),
-					 * mce_unregister_io_monitor()
+					 * mce_set_io_monitor_reopen(),
+					 * mce_unregister_io_monitor(),
+					 * mce_io_cache_access()
 					 */
 #include "mce-hal.h"			/* get_sysinfo_value() */
 #include "mce-log.h"			/* mce_log(), LL_* */
@@ -116,6 +118,11 @@ static gconstpointer proximity_sensor_iomon_id = NULL;
 
 /** Path to the proximity sensor device file entry */
 static const gchar *ps_device_path = NULL;
+/** Proximity sensor device used for polled readings */
+static input_state_t ps_device_input =
+{
+	.context = "ps_device",
+};
 /** Path to the proximity sensor enable/disable file entry */
 static const gchar *ps_enable_path = NULL;
 /** Path to the proximity sensor on/off mode file entry */
@@ -171,14 +178,16 @@ static ps_type_t get_ps_type(void)
 	if (ps_type != PS_TYPE_UNSET)
 		goto EXIT;
 
-	if (g_access(PS_DEVICE_PATH_AVAGO, R_OK) == 0) {
+	if (mce_io_cache_access(PS_DEVICE_PATH_AVAGO, R_OK)) {
 		ps_type = PS_TYPE_AVAGO;
 		ps_device_path = PS_DEVICE_PATH_AVAGO;
+		ps_device_input.path = ps_device_path;
 		ps_enable_path = PS_PATH_AVAGO_ENABLE;
 		ps_onoff_mode_output.path = PS_PATH_AVAGO_ONOFF_MODE;
-	} else if (g_access(PS_DEVICE_PATH_DIPRO, R_OK) == 0) {
+	} else if (mce_io_cache_access(PS_DEVICE_PATH_DIPRO, R_OK)) {
 		ps_type = PS_TYPE_DIPRO;
 		ps_device_path = PS_DEVICE_PATH_DIPRO;
+		ps_device_input.path = ps_device_path;
 		ps_calib0_output.path = PS_CALIB_PATH_DIPRO;
 		ps_threshold = &dipro_ps_threshold_dipro;
 	}
@@ -449,26 +458,23 @@ EXIT:
 static void update_proximity_sensor_state_avago(void)
 {
 	cover_state_t proximity_sensor_state;
-	struct avago_ps *ps;
-	void *tmp = NULL;
-	gssize len = sizeof (struct avago_ps);
+	struct avago_ps ps;
+	gsize len = sizeof ps;
 
-	if (mce_read_chunk_from_file(ps_device_path, &tmp, &len, 0) == FALSE)
+	if (mce_read_input(&ps_device_input, &ps, &len) == FALSE)
 		goto EXIT;
 
-	if (len != sizeof (struct avago_ps)) {
+	if (len != sizeof ps) {
 		mce_log(LL_ERR,
 			"Short read from `%s'",
 			ps_device_path);
 		goto EXIT;
 	}
 
-	ps = (struct avago_ps *)tmp;
-
-	if ((ps->status & APDS990X_PS_UPDATED) == 0)
+	if ((ps.status & APDS990X_PS_UPDATED) == 0)
 		goto EXIT;
 
-	if (ps->ps != 0)
+	if (ps.ps != 0)
 		proximity_sensor_state = COVER_CLOSED;
 	else
 		proximity_sensor_state = COVER_OPEN;
@@ -480,8 +486,6 @@ static void update_proximity_sensor_state_avago(void)
 			       USE_INDATA, CACHE_INDATA);
 
 EXIT:
-	g_free(tmp);
-
 	return;
 }
 
@@ -493,23 +497,20 @@ EXIT:
 static void update_proximity_sensor_state_dipro(void)
 {
 	cover_state_t proximity_sensor_state;
-	struct dipro_ps *ps;
-	void *tmp = NULL;
-	gssize len = sizeof (struct dipro_ps);
+	struct dipro_ps ps;
+	gsize len = sizeof ps;
 
-	if (mce_read_chunk_from_file(ps_device_path, &tmp, &len, 0) == FALSE)
+	if (mce_read_input(&ps_device_input, &ps, &len) == FALSE)
 		goto EXIT;
 
-	if (len != sizeof (struct dipro_ps)) {
+	if (len != sizeof ps) {
 		mce_log(LL_ERR,
 			"Short read from `%s'",
 			ps_device_path);
 		goto EXIT;
 	}
 
-	ps = (struct dipro_ps *)tmp;
-
-	if (ps->led1 < ps_threshold->threshold_rising)
+	if (ps.led1 < ps_threshold->threshold_rising)
 		proximity_sensor_state = COVER_OPEN;
 	else
 		proximity_sensor_state = COVER_CLOSED;
@@ -521,8 +522,6 @@ static void update_proximity_sensor_state_dipro(void)
 			       USE_INDATA, CACHE_INDATA);
 
 EXIT:
-	g_free(tmp);
-
 	return;
 }
 
@@ -562,6 +561,7 @@ static void enable_proximity_monitor(void)
 			if ((proximity_sensor_iomon_id = mce_register_io_monitor_chunk(-1, ps_device_path, MCE_IO_ERROR_POLICY_WARN, G_IO_IN | G_IO_PRI | G_IO_ERR, FALSE, ps_avago_iomon_cb, sizeof (struct avago_ps))) == NULL)
 				goto EXIT;
 
+			mce_set_io_monitor_reopen(proximity_sensor_iomon_id, TRUE);
 			update_proximity_sensor_state_avago();
 			break;
 
@@ -569,6 +569,7 @@ static void enable_proximity_monitor(void)
 			if ((proximity_sensor_iomon_id = mce_register_io_monitor_chunk(-1, ps_device_path, MCE_IO_ERROR_POLICY_WARN, G_IO_IN | G_IO_PRI | G_IO_ERR, FALSE, ps_dipro_iomon_cb, sizeof (struct dipro_ps))) == NULL)
 				goto EXIT;
 
+			mce_set_io_monitor_reopen(proximity_sensor_iomon_id, TRUE);
 			update_proximity_sensor_state_dipro();
 			break;
 		default:
@@ -608,6 +609,9 @@ static void disable_proximity_monitor(void)
 			mce_unregister_io_monitor(proximity_sensor_iomon_id);
 			proximity_sensor_iomon_id = NULL;
 		}
+
+		/* Let the sensor sleep while nobody is polling it */
+		mce_close_input(&ps_device_input);
 		break;
 	}
 EXIT:
@@ -923,5 +927,7 @@ void g_module_unload(GModule *module)
 	/* Unregister I/O monitors */
 	mce_unregister_io_monitor(proximity_sensor_iomon_id);
 
+	mce_close_input(&ps_device_input);
+
 	return;
 }
@@ -43,6 +43,9 @@
 #include "mce-dbus.h"		/* Direct:
 				 * ---
 				 * mce_dbus_handler_add(),
+				 * mce_dbus_snapshot_add_provider(),
+				 * mce_dbus_snapshot_remove_provider(),
+				 * mce_dbus_snapshot_append_basic(),
 				 * dbus_send_message(),
 				 * dbus_new_method_reply(),
 				 * dbus_new_signal(),
@@ -200,6 +203,20 @@ EXIT:
 	return status;
 }
 
+/**
+ * Add the radio states to a state snapshot
+ *
+ * @param dict DBusMessageIter for the a{sv} array
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean radio_states_snapshot_cb(DBusMessageIter *dict)
+{
+	dbus_uint32_t data = active_radio_states;
+
+	return mce_dbus_snapshot_append_basic(dict, "radio_states",
+					      DBUS_TYPE_UINT32, &data);
+}
+
 /**
  * Set the radio states
  *
@@ -1099,6 +1116,8 @@ const gchar *g_module_check_init(GModule *module)
 				 req_radio_states_change_dbus_cb) == NULL)
 		goto EXIT;
 
+	mce_dbus_snapshot_add_provider(radio_states_snapshot_cb);
+
 	if( !xconnman_init() )
 		mce_log(LL_WARN, "failed to set up connman mirroring");
 
@@ -1118,6 +1137,8 @@ void g_module_unload(GModule *module)
 {
 	(void)module;
 
+	mce_dbus_snapshot_remove_provider(radio_states_snapshot_cb);
+
 	xconnman_quit();
 
 	/* Remove triggers/filters from datapipes */
@@ -72,6 +72,7 @@
 					 * append_input_trigger_to_datapipe(),
 					 * remove_input_trigger_from_datapipe()
 					 */
+#include "mce-latency.h"		/* mce_latency_mark() */
 
 /**
  * The ID of the timeout used when determining
@@ -298,6 +299,8 @@ EXIT:
  */
 static void handle_shortpress(void)
 {
+	mce_latency_mark(MCE_LATENCY_POWERKEY);
+
 	cancel_powerkey_timeout();
 
 	if (doublepress_timeout_cb_id == 0) {
@@ -527,15 +530,13 @@ static void powerkey_trigger(gconstpointer const data)
 {
         system_state_t system_state = datapipe_get_gint(system_state_pipe);
 	submode_t submode = mce_get_submode_int32();
-	struct input_event const *const *evp;
 	struct input_event const *ev;
 
 	/* Don't dereference until we know it's safe */
 	if (data == NULL)
 		goto EXIT;
 
-	evp = data;
-	ev = *evp;
+	ev = data;
 
 	if ((ev != NULL) && (ev->code == KEY_POWER)) {
 		/* If set, the [power] key was pressed */
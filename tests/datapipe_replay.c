@@ -0,0 +1,277 @@
+/**
+ * @file datapipe_replay.c
+ * Check that replaying a datapipe trace repeats each execution once
+ * <p>
+ * Copyright © 2026 Jolla Mobile Ltd.
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The outer pipe has a trigger that executes the inner pipe directly
+ * and the later pipe deferred. The inner pipe is also executed once
+ * from outside of any datapipe. Only the two top-level executions may
+ * end up in the trace; replaying it must then run each pipe exactly
+ * as many times as the recording did.
+ *
+ * The text pipe gets one string that fits in a trace record and one
+ * that does not; only the one that fits may be replayed.
+ */
+
+#include <glib.h>
+
+#include <stdarg.h>			/* va_start(), va_end() */
+#include <stdio.h>			/* fprintf(), printf(), vasprintf() */
+#include <stdlib.h>			/* free(), EXIT_SUCCESS, EXIT_FAILURE */
+#include <string.h>			/* strcmp() */
+#include <unistd.h>			/* getpid(), unlink() */
+
+#include "../datapipe.h"
+#include "../datapipe-trace.h"
+#include "../mce-log.h"
+
+/** Pipe whose trigger executes the other pipes */
+static datapipe_struct outer_pipe;
+
+/** Pipe executed both directly and from the outer pipe */
+static datapipe_struct inner_pipe;
+
+/** Pipe executed deferred from the outer pipe */
+static datapipe_struct later_pipe;
+
+/** Pipe with string data */
+static datapipe_struct text_pipe;
+
+/** String that fits in a trace record */
+#define SHORT_TEXT "short"
+
+/** String that does not fit in a trace record */
+#define LONG_TEXT "a string longer than the data of a trace record"
+
+/** Number of outer pipe trigger runs */
+static guint outer_count = 0;
+
+/** Number of inner pipe trigger runs */
+static guint inner_count = 0;
+
+/** Number of later pipe trigger runs */
+static guint later_count = 0;
+
+/** Number of text pipe trigger runs */
+static guint text_count = 0;
+
+/** String seen by the latest text pipe trigger run */
+static gchar *text_last = NULL;
+
+/**
+ * Compatibility with mce-log.h
+ */
+void mce_log_file(loglevel_t loglevel, const char *const file,
+		  const char *const function, const char *const fmt, ...)
+{
+	va_list va;
+	char *msg = NULL;
+
+	(void)file;
+	(void)function;
+
+	if (loglevel > LL_WARN)
+		return;
+
+	va_start(va, fmt);
+	if (vasprintf(&msg, fmt, va) < 0)
+		msg = NULL;
+	va_end(va);
+
+	fprintf(stderr, "datapipe_replay: %s\n", msg ?: "error");
+	free(msg);
+}
+
+/**
+ * Output trigger of the outer pipe
+ *
+ * @param data Value of the outer pipe
+ */
+static void outer_trigger(gconstpointer data)
+{
+	gint value = GPOINTER_TO_INT(data);
+
+	outer_count++;
+
+	(void)execute_datapipe(&inner_pipe, GINT_TO_POINTER(value + 100),
+			       USE_INDATA, CACHE_INDATA);
+	execute_datapipe_deferred(&later_pipe, GINT_TO_POINTER(value + 200),
+				  USE_INDATA, CACHE_INDATA);
+}
+
+/**
+ * Output trigger of the inner pipe
+ *
+ * @param data Unused
+ */
+static void inner_trigger(gconstpointer data)
+{
+	(void)data;
+
+	inner_count++;
+}
+
+/**
+ * Output trigger of the later pipe
+ *
+ * @param data Unused
+ */
+static void later_trigger(gconstpointer data)
+{
+	(void)data;
+
+	later_count++;
+}
+
+/**
+ * Output trigger of the text pipe
+ *
+ * @param data String value of the text pipe
+ */
+static void text_trigger(gconstpointer data)
+{
+	text_count++;
+
+	g_free(text_last);
+	text_last = g_strdup(data);
+}
+
+/**
+ * Timer callback for ending the replay
+ *
+ * @param data The mainloop to quit
+ * @return Always returns FALSE to disable the timeout
+ */
+static gboolean replay_done_cb(gpointer data)
+{
+	g_main_loop_quit(data);
+
+	return FALSE;
+}
+
+/**
+ * Handle pending mainloop events
+ */
+static void flush_mainloop(void)
+{
+	while (g_main_context_iteration(NULL, FALSE) == TRUE)
+		;
+}
+
+/**
+ * Check the trigger run counts
+ *
+ * @param stage Name of the stage for the report
+ * @param texts Expected number of text pipe trigger runs
+ * @param text Expected string of the latest text pipe trigger run
+ * @return TRUE if the counts are as expected, FALSE otherwise
+ */
+static gboolean check_counts(const gchar *stage, guint texts,
+			     const gchar *text)
+{
+	gboolean ok = ((outer_count == 1) && (inner_count == 2) &&
+		       (later_count == 1) && (text_count == texts) &&
+		       (text_last != NULL) && (strcmp(text_last, text) == 0));
+
+	printf("%s: outer=%u inner=%u later=%u text=%u \"%s\" -> %s\n",
+	       stage, outer_count, inner_count, later_count, text_count,
+	       text_last ?: "", ok ? "OK" : "FAIL");
+
+	outer_count = inner_count = later_count = text_count = 0;
+	g_free(text_last), text_last = NULL;
+
+	return ok;
+}
+
+/**
+ * Main entry point
+ *
+ * @return EXIT_SUCCESS if the replay matches the recording,
+ *         EXIT_FAILURE otherwise
+ */
+int main(void)
+{
+	int status = EXIT_FAILURE;
+	GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+	gchar *path = g_strdup_printf("%s/datapipe_replay.%d",
+				      g_get_tmp_dir(), (int)getpid());
+
+	setup_datapipe(&outer_pipe, "outer_pipe", READ_WRITE,
+		       DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED, 0, NULL);
+	setup_datapipe(&inner_pipe, "inner_pipe", READ_WRITE,
+		       DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED, 0, NULL);
+	setup_datapipe(&later_pipe, "later_pipe", READ_WRITE,
+		       DONT_FREE_CACHE, DONT_SUPPRESS_UNCHANGED, 0, NULL);
+	setup_datapipe(&text_pipe, "text_pipe", READ_WRITE,
+		       FREE_CACHE, DONT_SUPPRESS_UNCHANGED, 0, NULL);
+
+	append_output_trigger_to_datapipe(&outer_pipe, outer_trigger);
+	append_output_trigger_to_datapipe(&inner_pipe, inner_trigger);
+	append_output_trigger_to_datapipe(&later_pipe, later_trigger);
+	append_output_trigger_to_datapipe(&text_pipe, text_trigger);
+
+	if (datapipe_trace_start(path) == FALSE)
+		goto EXIT;
+
+	(void)execute_datapipe(&outer_pipe, GINT_TO_POINTER(1),
+			       USE_INDATA, CACHE_INDATA);
+	(void)execute_datapipe(&inner_pipe, GINT_TO_POINTER(2),
+			       USE_INDATA, CACHE_INDATA);
+	(void)execute_datapipe(&text_pipe, g_strdup(SHORT_TEXT),
+			       USE_INDATA, CACHE_INDATA);
+	(void)execute_datapipe(&text_pipe, g_strdup(LONG_TEXT),
+			       USE_INDATA, CACHE_INDATA);
+	flush_mainloop();
+
+	datapipe_trace_stop();
+
+	if (check_counts("record", 2, LONG_TEXT) == FALSE)
+		goto EXIT;
+
+	if (datapipe_trace_replay(path) == FALSE)
+		goto EXIT;
+
+	g_timeout_add(500, replay_done_cb, loop);
+	g_main_loop_run(loop);
+	flush_mainloop();
+
+	if (check_counts("replay", 1, SHORT_TEXT) == FALSE)
+		goto EXIT;
+
+	status = EXIT_SUCCESS;
+
+EXIT:
+	datapipe_trace_stop();
+
+	remove_output_trigger_from_datapipe(&text_pipe, text_trigger);
+	remove_output_trigger_from_datapipe(&later_pipe, later_trigger);
+	remove_output_trigger_from_datapipe(&inner_pipe, inner_trigger);
+	remove_output_trigger_from_datapipe(&outer_pipe, outer_trigger);
+
+	free_datapipe(&text_pipe);
+	free_datapipe(&later_pipe);
+	free_datapipe(&inner_pipe);
+	free_datapipe(&outer_pipe);
+
+	g_free(text_last);
+	unlink(path);
+	g_free(path);
+	g_main_loop_unref(loop);
+
+	return status;
+}
@@ -0,0 +1,177 @@
+/**
+ * @file persist_flush.c
+ * Check that the write-behind persistence writes what was queued
+ * <p>
+ * Copyright © 2026 Jolla Mobile Ltd.
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Two files are queued, and the first one is queued again with new
+ * contents before the flush. After the flush both files must hold
+ * the latest contents with the requested modes. Flushing the same
+ * contents again must leave the files alone, which is seen from the
+ * inode numbers: a replaced file gets a new one.
+ */
+
+#include <glib.h>
+
+#include <sys/stat.h>			/* stat(), mkdir() */
+
+#include <stdarg.h>			/* va_start(), va_end() */
+#include <stdio.h>			/* fprintf(), printf(), vasprintf() */
+#include <stdlib.h>			/* free(), abort(), EXIT_SUCCESS,
+					 * EXIT_FAILURE
+					 */
+#include <string.h>			/* strlen(), memcmp() */
+#include <unistd.h>			/* getpid(), unlink(), rmdir() */
+
+#include "../mce-io.h"
+#include "../mce-log.h"
+
+/** Contents first queued for the first file */
+#define OLD_TEXT "old contents\n"
+
+/** Contents queued for the first file before the flush */
+#define NEW_TEXT "new contents\n"
+
+/** Contents queued for the second file */
+#define OTHER_TEXT "other contents\n"
+
+/**
+ * Compatibility with mce-log.h
+ */
+void mce_log_file(loglevel_t loglevel, const char *const file,
+		  const char *const function, const char *const fmt, ...)
+{
+	va_list va;
+	char *msg = NULL;
+
+	(void)file;
+	(void)function;
+
+	if (loglevel > LL_WARN)
+		return;
+
+	va_start(va, fmt);
+	if (vasprintf(&msg, fmt, va) < 0)
+		msg = NULL;
+	va_end(va);
+
+	fprintf(stderr, "persist_flush: %s\n", msg ?: "error");
+	free(msg);
+}
+
+/**
+ * Compatibility with mce.h
+ */
+void mce_abort(void)
+{
+	abort();
+}
+
+/**
+ * Compatibility with mce.h
+ */
+void mce_quit_mainloop(void)
+{
+}
+
+/**
+ * Check the contents and mode of a file
+ *
+ * @param path The file to check
+ * @param text The expected contents
+ * @param mode The expected protection bits
+ * @param ino Where to store the inode number of the file
+ * @return TRUE if the file is as expected, FALSE otherwise
+ */
+static gboolean check_file(const gchar *path, const gchar *text,
+			   mode_t mode, ino_t *ino)
+{
+	gboolean ok = FALSE;
+	size_t size = 0;
+	void *data = mce_io_load_file(path, &size);
+	struct stat st;
+
+	if (stat(path, &st) == -1)
+		goto EXIT;
+
+	*ino = st.st_ino;
+
+	ok = ((data != NULL) && (size == strlen(text)) &&
+	      (memcmp(data, text, size) == 0) &&
+	      ((st.st_mode & 0777) == mode));
+
+EXIT:
+	printf("%s: %s\n", path, ok ? "OK" : "FAIL");
+	g_free(data);
+
+	return ok;
+}
+
+/**
+ * Main entry point
+ *
+ * @return EXIT_SUCCESS if the files are written as expected,
+ *         EXIT_FAILURE otherwise
+ */
+int main(void)
+{
+	int status = EXIT_FAILURE;
+	gchar *dir = g_strdup_printf("%s/persist_flush.%d",
+				     g_get_tmp_dir(), (int)getpid());
+	gchar *path1 = g_strdup_printf("%s/first", dir);
+	gchar *path2 = g_strdup_printf("%s/second", dir);
+	ino_t ino1 = 0, ino2 = 0, again1 = 0, again2 = 0;
+
+	if (mkdir(dir, 0755) == -1)
+		goto EXIT;
+
+	mce_io_persist_file(path1, OLD_TEXT, strlen(OLD_TEXT), 0644);
+	mce_io_persist_file(path2, OTHER_TEXT, strlen(OTHER_TEXT), 0600);
+	mce_io_persist_file(path1, NEW_TEXT, strlen(NEW_TEXT), 0644);
+	mce_io_persist_flush();
+
+	if ((check_file(path1, NEW_TEXT, 0644, &ino1) == FALSE) ||
+	    (check_file(path2, OTHER_TEXT, 0600, &ino2) == FALSE))
+		goto EXIT;
+
+	mce_io_persist_file(path1, NEW_TEXT, strlen(NEW_TEXT), 0644);
+	mce_io_persist_file(path2, OTHER_TEXT, strlen(OTHER_TEXT), 0600);
+	mce_io_persist_flush();
+
+	if ((check_file(path1, NEW_TEXT, 0644, &again1) == FALSE) ||
+	    (check_file(path2, OTHER_TEXT, 0600, &again2) == FALSE))
+		goto EXIT;
+
+	printf("unchanged files kept: %s\n",
+	       ((ino1 == again1) && (ino2 == again2)) ? "OK" : "FAIL");
+
+	if ((ino1 != again1) || (ino2 != again2))
+		goto EXIT;
+
+	status = EXIT_SUCCESS;
+
+EXIT:
+	unlink(path1);
+	unlink(path2);
+	rmdir(dir);
+
+	g_free(path2);
+	g_free(path1);
+	g_free(dir);
+
+	return status;
+}
@@ -20,7 +20,6 @@
  * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <glib.h>
-#include <glib/gstdio.h>		/* g_access() */
 
 #include <errno.h>			/* errno */
 #include <string.h>			/* strcmp() */
@@ -35,13 +34,15 @@
 #include "tklock.h"
 
 #include "mce-io.h"			/* mce_write_string_to_file(),
-					 * mce_write_number_string_to_file()
+					 * mce_write_number_string_to_file(),
+					 * mce_io_cache_access()
 					 */
 #include "mce-log.h"			/* mce_log(), LL_* */
 #include "datapipe.h"			/* execute_datapipe(),
 					 * datapipe_get_gint(),
 					 * append_input_trigger_to_datapipe(),
 					 * append_output_trigger_to_datapipe(),
+					 * append_prioritized_output_trigger_to_datapipe(),
 					 * remove_input_trigger_from_datapipe(),
 					 * remove_output_trigger_from_datapipe()
 					 */
@@ -69,6 +70,7 @@
 					 * dbus_bool_t,
 					 * dbus_uint32_t, dbus_int32_t
 					 */
+#include "gesture.h"			/* GESTURE_DOUBLETAP, GESTURE_SWIPE */
 #include "mce-gconf.h"			/* mce_gconf_notifier_add(),
 					 * mce_gconf_get_bool(),
 					 * gconf_entry_get_key(),
@@ -2449,15 +2451,13 @@ static void keypress_trigger(gconstpointer const data)
 {
 	display_state_t display_state = datapipe_get_gint(display_state_pipe);
 	static gboolean skip_release = FALSE;
-	struct input_event const *const *evp;
 	struct input_event const *ev;
 
 	/* Don't dereference until we know it's safe */
 	if (data == NULL)
 		goto EXIT;
 
-	evp = data;
-	ev = *evp;
+	ev = data;
 
 	disable_autorelock_policy();
 
@@ -2524,15 +2524,13 @@ static void camera_button_trigger(gconstpointer const data)
  */
 static void autorelock_touchscreen_trigger(gconstpointer const data)
 {
-	struct input_event const *const *evp;
 	struct input_event const *ev;
 
 	/* Don't dereference until we know it's safe */
 	if (data == NULL)
 		goto EXIT;
 
-	evp = data;
-	ev = *evp;
+	ev = data;
 
 	if (ev == NULL)
 		goto EXIT;
@@ -2556,7 +2554,6 @@ static void touchscreen_trigger(gconstpointer const data)
 	call_state_t call_state = datapipe_get_gint(call_state_pipe);
 	alarm_ui_state_t alarm_ui_state =
 		datapipe_get_gint(alarm_ui_state_pipe);
-	struct input_event const *const *evp;
 	struct input_event const *ev;
 
 	/* If we're not in USER state, and there's no call or alarm active,
@@ -2573,17 +2570,17 @@ static void touchscreen_trigger(gconstpointer const data)
 	if (data == NULL)
 		goto EXIT;
 
-	evp = data;
-	ev = *evp;
+	ev = data;
 
 	if (ev == NULL)
 		goto EXIT;
 
 	if (is_tklock_enabled() == TRUE) {
-		/* Double tap */
+		/* Double tap, or swipe emulated by mce */
 		if ((ev->type == EV_MSC) &&
 		    (ev->code == MSC_GESTURE) &&
-		    (ev->value == 0x4)) {
+		    ((ev->value == GESTURE_DOUBLETAP) ||
+		     (ev->value == GESTURE_SWIPE))) {
 			if (doubletap_gesture_policy == 1) {
 				trigger_visual_tklock(FALSE);
 			} else if (doubletap_gesture_policy == 2) {
@@ -3197,13 +3194,13 @@ gboolean mce_tklock_init(void)
 	gboolean status = FALSE;
 
 	/* Init event control files */
-	if (g_access(MCE_RX51_KEYBOARD_SYSFS_DISABLE_PATH, W_OK) == 0) {
+	if (mce_io_cache_access(MCE_RX51_KEYBOARD_SYSFS_DISABLE_PATH, W_OK)) {
 		mce_keypad_sysfs_disable_output.path =
 			MCE_RX51_KEYBOARD_SYSFS_DISABLE_PATH;
-	} else if (g_access(MCE_RX44_KEYBOARD_SYSFS_DISABLE_PATH, W_OK) == 0) {
+	} else if (mce_io_cache_access(MCE_RX44_KEYBOARD_SYSFS_DISABLE_PATH, W_OK)) {
 		mce_keypad_sysfs_disable_output.path =
 			MCE_RX44_KEYBOARD_SYSFS_DISABLE_PATH;
-	} else if (g_access(MCE_KEYPAD_SYSFS_DISABLE_PATH, W_OK) == 0) {
+	} else if (mce_io_cache_access(MCE_KEYPAD_SYSFS_DISABLE_PATH, W_OK)) {
 		mce_keypad_sysfs_disable_output.path =
 			MCE_KEYPAD_SYSFS_DISABLE_PATH;
 	} else {
@@ -3211,13 +3208,13 @@ gboolean mce_tklock_init(void)
 			"No touchscreen event control interface available");
 	}
 
-	if (g_access(MCE_RM680_TOUCHSCREEN_SYSFS_DISABLE_PATH, W_OK) == 0) {
+	if (mce_io_cache_access(MCE_RM680_TOUCHSCREEN_SYSFS_DISABLE_PATH, W_OK)) {
 		mce_touchscreen_sysfs_disable_output.path =
 			MCE_RM680_TOUCHSCREEN_SYSFS_DISABLE_PATH;
-	} else if (g_access(MCE_RX44_TOUCHSCREEN_SYSFS_DISABLE_PATH_KERNEL2637, W_OK) == 0) {
+	} else if (mce_io_cache_access(MCE_RX44_TOUCHSCREEN_SYSFS_DISABLE_PATH_KERNEL2637, W_OK)) {
 		mce_touchscreen_sysfs_disable_output.path =
 			MCE_RX44_TOUCHSCREEN_SYSFS_DISABLE_PATH_KERNEL2637;
-	} else if (g_access(MCE_RX44_TOUCHSCREEN_SYSFS_DISABLE_PATH, W_OK) == 0) {
+	} else if (mce_io_cache_access(MCE_RX44_TOUCHSCREEN_SYSFS_DISABLE_PATH, W_OK)) {
 		mce_touchscreen_sysfs_disable_output.path =
 			MCE_RX44_TOUCHSCREEN_SYSFS_DISABLE_PATH;
 	} else {
@@ -3225,7 +3222,7 @@ gboolean mce_tklock_init(void)
 			"No keypress event control interface available");
 	}
 
-	if (g_access(MCE_RM680_DOUBLETAP_SYSFS_PATH, W_OK) == 0) {
+	if (mce_io_cache_access(MCE_RM680_DOUBLETAP_SYSFS_PATH, W_OK)) {
 		mce_touchscreen_gesture_control_path =
 			MCE_RM680_DOUBLETAP_SYSFS_PATH;
 	} else {
@@ -3233,7 +3230,7 @@ gboolean mce_tklock_init(void)
 			"No touchscreen gesture control interface available");
 	}
 
-	if (g_access(MCE_RM680_TOUCHSCREEN_CALIBRATION_PATH, W_OK) == 0) {
+	if (mce_io_cache_access(MCE_RM680_TOUCHSCREEN_CALIBRATION_PATH, W_OK)) {
 		mce_touchscreen_calibration_control_path =
 			MCE_RM680_TOUCHSCREEN_CALIBRATION_PATH;
 	} else {
@@ -3267,14 +3264,16 @@ gboolean mce_tklock_init(void)
 					 camera_button_trigger);
 	append_output_trigger_to_datapipe(&system_state_pipe,
 					  system_state_trigger);
-	append_output_trigger_to_datapipe(&display_state_pipe,
-					  display_state_trigger);
+	append_prioritized_output_trigger_to_datapipe(&display_state_pipe,
+						      display_state_trigger,
+						      TRIGGER_PRIORITY_CRITICAL);
 	append_output_trigger_to_datapipe(&alarm_ui_state_pipe,
 					  alarm_ui_state_trigger);
 	append_output_trigger_to_datapipe(&lid_cover_pipe,
 					  lid_cover_trigger);
-	append_output_trigger_to_datapipe(&proximity_sensor_pipe,
-					  proximity_sensor_trigger);
+	append_prioritized_output_trigger_to_datapipe(&proximity_sensor_pipe,
+						      proximity_sensor_trigger,
+						      TRIGGER_PRIORITY_CRITICAL);
 	append_output_trigger_to_datapipe(&lens_cover_pipe,
 					  lens_cover_trigger);
 	append_output_trigger_to_datapipe(&tk_lock_pipe,
@@ -0,0 +1,256 @@
+/* ------------------------------------------------------------------------- *
+ * Copyright (C) 2026 Jolla Mobile Ltd.
+ * License: GPLv2
+ * ------------------------------------------------------------------------- */
+
+/* Micro-benchmark for datapipe dispatch
+ *
+ * Sets up one datapipe per subscriber count, registers that many
+ * filters or output triggers and times execute_datapipe() on it.
+ * The callbacks do next to nothing, so the figures are the cost of
+ * the dispatch itself.
+ */
+
+#include "../datapipe.h"
+#include "../mce-log.h"
+
+#include <glib.h>
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+/** Largest number of subscribers benchmarked */
+#define BENCH_SUBSCRIBERS_MAX 64
+
+/** Sink for the callbacks; keeps them from being optimized away */
+static volatile gint bench_sink = 0;
+
+/** Define a distinct trigger and filter for subscriber slot N */
+#define BENCH_CALLBACKS(N) \
+  static void bench_trigger_##N(gconstpointer data) \
+  { bench_sink += GPOINTER_TO_INT(data); } \
+  static gpointer bench_filter_##N(gpointer data) \
+  { return GINT_TO_POINTER(GPOINTER_TO_INT(data) + 1); }
+
+/** Define subscriber slots N .. N+7 */
+#define BENCH_CALLBACKS8(N) \
+  BENCH_CALLBACKS(N##0) BENCH_CALLBACKS(N##1) \
+  BENCH_CALLBACKS(N##2) BENCH_CALLBACKS(N##3) \
+  BENCH_CALLBACKS(N##4) BENCH_CALLBACKS(N##5) \
+  BENCH_CALLBACKS(N##6) BENCH_CALLBACKS(N##7)
+
+BENCH_CALLBACKS8(0) BENCH_CALLBACKS8(1) BENCH_CALLBACKS8(2)
+BENCH_CALLBACKS8(3) BENCH_CALLBACKS8(4) BENCH_CALLBACKS8(5)
+BENCH_CALLBACKS8(6) BENCH_CALLBACKS8(7)
+
+/** List subscriber slots N .. N+7 */
+#define BENCH_LIST8(P, N) \
+  P##_##N##0, P##_##N##1, P##_##N##2, P##_##N##3, \
+  P##_##N##4, P##_##N##5, P##_##N##6, P##_##N##7
+
+/** Distinct output triggers */
+static void (*const bench_trigger[BENCH_SUBSCRIBERS_MAX])(gconstpointer) =
+{
+  BENCH_LIST8(bench_trigger, 0), BENCH_LIST8(bench_trigger, 1),
+  BENCH_LIST8(bench_trigger, 2), BENCH_LIST8(bench_trigger, 3),
+  BENCH_LIST8(bench_trigger, 4), BENCH_LIST8(bench_trigger, 5),
+  BENCH_LIST8(bench_trigger, 6), BENCH_LIST8(bench_trigger, 7),
+};
+
+/** Distinct filters */
+static gpointer (*const bench_filter[BENCH_SUBSCRIBERS_MAX])(gpointer) =
+{
+  BENCH_LIST8(bench_filter, 0), BENCH_LIST8(bench_filter, 1),
+  BENCH_LIST8(bench_filter, 2), BENCH_LIST8(bench_filter, 3),
+  BENCH_LIST8(bench_filter, 4), BENCH_LIST8(bench_filter, 5),
+  BENCH_LIST8(bench_filter, 6), BENCH_LIST8(bench_filter, 7),
+};
+
+/** Program name string */
+static const char *progname = 0;
+
+/** Compatibility with mce-log.h
+ */
+void
+mce_log_file(loglevel_t loglevel,
+             const char *const file,
+             const char *const function,
+             const char *const fmt, ...)
+{
+  char   *msg = 0;
+  va_list va;
+
+  (void)file, (void)function; // unused
+
+  if( loglevel > LL_WARN )
+  {
+    return;
+  }
+
+  va_start(va, fmt);
+  if( vasprintf(&msg, fmt, va) < 0 )
+  {
+    msg = 0;
+  }
+  va_end(va);
+
+  fprintf(stderr, "%s: %s\n", progname, msg ?: "error");
+  free(msg);
+}
+
+/** Get monotonic time in nanoseconds
+ */
+static double
+bench_now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/** Time executions of a datapipe with given number of subscribers
+ *
+ * @param count   number of subscribers
+ * @param filters nonzero to register filters, zero for output triggers
+ * @param rounds  number of executions to time
+ *
+ * @return nanoseconds per execution
+ */
+static double
+bench_run(int count, int filters, long rounds)
+{
+  datapipe_struct pipe;
+  double t0, t1;
+
+  memset(&pipe, 0, sizeof pipe);
+  setup_datapipe(&pipe, "bench_pipe", READ_WRITE, DONT_FREE_CACHE,
+                 DONT_SUPPRESS_UNCHANGED, 0, GINT_TO_POINTER(0));
+
+  for( int i = 0; i < count; ++i )
+  {
+    if( filters )
+      append_filter_to_datapipe(&pipe, bench_filter[i]);
+    else
+      append_output_trigger_to_datapipe(&pipe, bench_trigger[i]);
+  }
+
+  // warm up caches before timing
+  for( long i = 0; i < rounds / 10; ++i )
+  {
+    execute_datapipe(&pipe, GINT_TO_POINTER(i & 1),
+                     USE_INDATA, CACHE_INDATA);
+  }
+
+  t0 = bench_now_ns();
+  for( long i = 0; i < rounds; ++i )
+  {
+    execute_datapipe(&pipe, GINT_TO_POINTER(i & 1),
+                     USE_INDATA, CACHE_INDATA);
+  }
+  t1 = bench_now_ns();
+
+  for( int i = 0; i < count; ++i )
+  {
+    if( filters )
+      remove_filter_from_datapipe(&pipe, bench_filter[i]);
+    else
+      remove_output_trigger_from_datapipe(&pipe, bench_trigger[i]);
+  }
+
+  free_datapipe(&pipe);
+
+  return (t1 - t0) / rounds;
+}
+
+/** Provide runtime usage information
+ */
+static void usage(void)
+{
+  printf("USAGE\n"
+         "  %s [options]\n"
+         "\n"
+         "OPTIONS\n"
+         "  -h, --help            -- this help text\n"
+         "  -r, --rounds=<count>  -- executions per measurement\n"
+         "                           (default 200000)\n"
+         "\n"
+         "NOTES\n"
+         "  For each subscriber count, prints the cost of one\n"
+         "  execute_datapipe() call in nanoseconds and the cost\n"
+         "  per registered filter or output trigger.\n"
+         "\n",
+         progname);
+}
+
+/** Main entry point
+ */
+int
+main(int argc, char **argv)
+{
+  static const struct option optL[] =
+  {
+    {"help",   0, 0, 'h' },
+    {"rounds", 1, 0, 'r' },
+    {0,0,0,0}
+  };
+  static const char optS[] = "hr:";
+
+  long rounds = 200000;
+
+  progname = basename(*argv);
+
+  for( ;; )
+  {
+    int opt = getopt_long(argc, argv, optS, optL, 0);
+
+    if( opt < 0 )
+    {
+      break;
+    }
+
+    switch( opt )
+    {
+    case 'h':
+      usage();
+      exit(EXIT_SUCCESS);
+
+    case 'r':
+      rounds = strtol(optarg, 0, 0);
+      break;
+
+    case '?':
+    case ':':
+      exit(EXIT_FAILURE);
+
+    default:
+      fprintf(stderr, "getopt() -> %d\n", opt);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if( rounds < 10 )
+  {
+    fprintf(stderr, "%s: too few rounds\n", progname);
+    exit(EXIT_FAILURE);
+  }
+
+  printf("%11s %14s %14s %14s %14s\n", "subscribers",
+         "trigger ns", "ns/trigger", "filter ns", "ns/filter");
+
+  for( int count = 1; count <= BENCH_SUBSCRIBERS_MAX; count *= 2 )
+  {
+    double trig = bench_run(count, 0, rounds);
+    double filt = bench_run(count, 1, rounds);
+
+    printf("%11d %14.1f %14.2f %14.1f %14.2f\n", count,
+           trig, trig / count, filt, filt / count);
+  }
+
+  return EXIT_SUCCESS;
+}
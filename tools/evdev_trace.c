@@ -19,6 +19,11 @@
 #include <stdlib.h>
 #include <glob.h>
 #include <getopt.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+/** Number of times each device is probed when measuring probe cost */
+#define PROBE_ROUNDS 100
 
 /** Read and show input events
  *
@@ -66,6 +71,152 @@ process_events(int fd, const char *title)
   return 1;
 }
 
+/** Get monotonic time in microseconds
+ */
+static
+double
+probe_now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/** Query what mce needs for classifying a device without the cache
+ *
+ * @param fd input device file descriptor
+ */
+static
+void
+probe_full(int fd)
+{
+  unsigned long types[EV_CNT / LONG_BIT + 1];
+  unsigned long codes[KEY_CNT / LONG_BIT + 1];
+  char          name[256];
+
+  ioctl(fd, EVIOCGNAME(sizeof name), name);
+
+  memset(types, 0, sizeof types);
+  ioctl(fd, EVIOCGBIT(0, EV_CNT), types);
+
+  for( int type = 1; type < EV_CNT; ++type )
+  {
+    if( types[type / LONG_BIT] & (1ul << (type % LONG_BIT)) )
+    {
+      ioctl(fd, EVIOCGBIT(type, KEY_CNT), codes);
+    }
+  }
+}
+
+/** Query what mce needs for looking a device up from the probe cache
+ *
+ * @param fd input device file descriptor
+ */
+static
+void
+probe_cached(int fd)
+{
+  struct input_id id;
+  char            name[256];
+
+  ioctl(fd, EVIOCGNAME(sizeof name), name);
+  ioctl(fd, EVIOCGID, &id);
+  ioctl(fd, EVIOCGPHYS(sizeof name), name);
+}
+
+/** Time opening and probing an input device
+ *
+ * @param path  input device path
+ * @param probe probe function to time
+ *
+ * @return microseconds per probe, or -1 on errors
+ */
+static
+double
+probe_time(const char *path, void (*probe)(int))
+{
+  double t0 = probe_now_us();
+
+  for( int round = 0; round < PROBE_ROUNDS; ++round )
+  {
+    int fd = evdev_open_device(path);
+
+    if( fd == -1 )
+    {
+      return -1;
+    }
+
+    probe(fd);
+    close(fd);
+  }
+
+  return (probe_now_us() - t0) / PROBE_ROUNDS;
+}
+
+/** Time how long mce takes to classify an input device
+ *
+ * Without the evdev probe cache, mce classifies a device from its
+ * name and a sweep of EVIOCGBIT queries over all supported event
+ * types. With the cache, a known device needs only the name, id
+ * and phys queries.
+ *
+ * @param path     input device path
+ * @param full_us  where to store microseconds per full probe
+ * @param cache_us where to store microseconds per cached lookup
+ *
+ * @return 0 on success, -1 on errors
+ */
+static
+int
+probe_cost(const char *path, double *full_us, double *cache_us)
+{
+  // warm up kernel side caches before timing
+  if( probe_time(path, probe_full) < 0 )
+  {
+    return -1;
+  }
+
+  *full_us  = probe_time(path, probe_full);
+  *cache_us = probe_time(path, probe_cached);
+
+  return (*full_us < 0 || *cache_us < 0) ? -1 : 0;
+}
+
+/** Print the classification cost of input devices
+ *
+ * @param path  vector of input device paths
+ * @param count number of paths in the path
+ */
+static
+void
+probe_cost_all(char **path, int count)
+{
+  double full_total  = 0;
+  double cache_total = 0;
+
+  printf("%-24s %12s %12s\n", "device", "probe us", "cached us");
+
+  for( int i = 0; i < count; ++i )
+  {
+    double full_us, cache_us;
+
+    if( probe_cost(path[i], &full_us, &cache_us) == -1 )
+    {
+      mce_log(LL_WARN, "%s: not an input device", path[i]);
+      continue;
+    }
+
+    printf("%-24s %12.1f %12.1f\n", path[i], full_us, cache_us);
+
+    full_total  += full_us;
+    cache_total += cache_us;
+  }
+
+  printf("%-24s %12.1f %12.1f\n", "total", full_total, cache_total);
+}
+
 /** Mainloop for processing event input devices
  *
  * @param path  vector of input device paths
@@ -139,6 +290,7 @@ static struct option optL[] =
   { "help",     0, 0, 'h' },
   { "trace",    0, 0, 'i' },
   { "identify", 0, 0, 't' },
+  { "probe-cost", 0, 0, 'p' },
   { 0,0,0,0 }
 };
 
@@ -147,6 +299,7 @@ static const char optS[] =
 "h" // --help
 "t" // --trace
 "i" // --identify
+"p" // --probe-cost
 ;
 
 /** Program name string */
@@ -196,9 +349,11 @@ static void usage(void)
          "  %s [options] [devicepath] ...\n"
          "\n"
          "OPTIONS\n"
-         "  -h, --help      -- this help text\n"
-         "  -i, --identify  -- identify input device\n"
-         "  -t, --trace     -- trace input events\n"
+         "  -h, --help        -- this help text\n"
+         "  -i, --identify    -- identify input device\n"
+         "  -t, --trace       -- trace input events\n"
+         "  -p, --probe-cost  -- time device classification with\n"
+         "                       and without the mce probe cache\n"
 	 "\n"
 	 "NOTES\n"
          "  If no device paths are given, /dev/input/event* is assumed.\n"
@@ -255,6 +410,7 @@ main(int argc, char **argv)
 
   int f_trace    = 0;
   int f_identify = 0;
+  int f_probe    = 0;
 
   glob_t gb;
 
@@ -285,6 +441,10 @@ main(int argc, char **argv)
       f_identify = 1;
       break;
 
+    case 'p':
+      f_probe = 1;
+      break;
+
     case '?':
     case ':':
       goto cleanup;
@@ -295,7 +455,7 @@ main(int argc, char **argv)
     }
   }
 
-  if( !f_identify && !f_trace )
+  if( !f_identify && !f_trace && !f_probe )
   {
     f_identify = 1;
   }
@@ -308,6 +468,10 @@ main(int argc, char **argv)
       char *path = get_device_path(argv[i]);
       if( path ) argv[argc++] = path;
     }
+    if( f_probe )
+    {
+      probe_cost_all(argv, argc);
+    }
     mainloop(argv, argc, f_identify, f_trace);
     while( argc > 0 )
     {
@@ -324,6 +488,10 @@ main(int argc, char **argv)
       goto cleanup;
     }
 
+    if( f_probe )
+    {
+      probe_cost_all(gb.gl_pathv, gb.gl_pathc);
+    }
     mainloop(gb.gl_pathv, gb.gl_pathc, f_identify, f_trace);
   }
 
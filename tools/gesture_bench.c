@@ -0,0 +1,470 @@
+/* ------------------------------------------------------------------------- *
+ * Copyright (C) 2026 Jolla Mobile Ltd.
+ * License: GPLv2
+ * ------------------------------------------------------------------------- */
+
+/* Offline benchmark for the touch gesture recognizer
+ *
+ * Feeds recorded touchscreen frames to gesture_process_frame() and
+ * reports how long the recognizer takes per frame and per event,
+ * along with the gestures it recognized. The recording is either
+ * evdev_trace output captured from a touchscreen, or a built-in
+ * protocol B recording of one double tap, two swipes and one long
+ * press; in one of the swipes a second finger rests near where the
+ * first one landed.
+ */
+
+#include "../gesture.h"
+#include "../mce-log.h"
+
+#include <glib.h>
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+/** Recorded input events */
+typedef struct
+{
+  struct input_event *ev;   /**< Events */
+  size_t              len;  /**< Number of events */
+  size_t              cap;  /**< Allocated number of events */
+} rec_t;
+
+/** Program name string */
+static const char *progname = 0;
+
+/** Compatibility with mce-log.h
+ */
+void
+mce_log_file(loglevel_t loglevel,
+             const char *const file,
+             const char *const function,
+             const char *const fmt, ...)
+{
+  char   *msg = 0;
+  va_list va;
+
+  (void)file, (void)function; // unused
+
+  if( loglevel > LL_WARN )
+  {
+    return;
+  }
+
+  va_start(va, fmt);
+  if( vasprintf(&msg, fmt, va) < 0 )
+  {
+    msg = 0;
+  }
+  va_end(va);
+
+  fprintf(stderr, "%s: %s\n", progname, msg ?: "error");
+  free(msg);
+}
+
+/** Get monotonic time in nanoseconds
+ */
+static double
+bench_now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/** Append an event to a recording
+ *
+ * @param rec   recording to append to
+ * @param ms    time stamp in milliseconds
+ * @param type  event type
+ * @param code  event code
+ * @param value event value
+ */
+static void
+rec_event(rec_t *rec, long ms, int type, int code, int value)
+{
+  struct input_event *ev;
+
+  if( rec->len == rec->cap )
+  {
+    rec->cap = rec->cap ? rec->cap * 2 : 256;
+    rec->ev  = g_realloc(rec->ev, rec->cap * sizeof *rec->ev);
+  }
+
+  ev = &rec->ev[rec->len++];
+  memset(ev, 0, sizeof *ev);
+  ev->time.tv_sec  = ms / 1000;
+  ev->time.tv_usec = ms % 1000 * 1000;
+  ev->type  = type;
+  ev->code  = code;
+  ev->value = value;
+}
+
+/** Append a protocol B contact update to a recording
+ *
+ * @param rec  recording to append to
+ * @param ms   time stamp in milliseconds
+ * @param slot multitouch slot
+ * @param x    x position
+ * @param y    y position
+ */
+static void
+rec_move(rec_t *rec, long ms, int slot, int x, int y)
+{
+  rec_event(rec, ms, EV_ABS, ABS_MT_SLOT, slot);
+  rec_event(rec, ms, EV_ABS, ABS_MT_POSITION_X, x);
+  rec_event(rec, ms, EV_ABS, ABS_MT_POSITION_Y, y);
+  rec_event(rec, ms, EV_ABS, ABS_MT_TOUCH_MAJOR, 6);
+}
+
+/** Append a protocol B contact landing to a recording
+ *
+ * @param rec  recording to append to
+ * @param ms   time stamp in milliseconds
+ * @param slot multitouch slot
+ * @param id   tracking id
+ * @param x    x position
+ * @param y    y position
+ */
+static void
+rec_press(rec_t *rec, long ms, int slot, int id, int x, int y)
+{
+  rec_event(rec, ms, EV_ABS, ABS_MT_SLOT, slot);
+  rec_event(rec, ms, EV_ABS, ABS_MT_TRACKING_ID, id);
+  rec_move(rec, ms, slot, x, y);
+}
+
+/** Append a protocol B contact lift to a recording
+ *
+ * @param rec  recording to append to
+ * @param ms   time stamp in milliseconds
+ * @param slot multitouch slot
+ */
+static void
+rec_release(rec_t *rec, long ms, int slot)
+{
+  rec_event(rec, ms, EV_ABS, ABS_MT_SLOT, slot);
+  rec_event(rec, ms, EV_ABS, ABS_MT_TRACKING_ID, -1);
+}
+
+/** Append end of frame to a recording
+ *
+ * @param rec  recording to append to
+ * @param ms   time stamp in milliseconds
+ */
+static void
+rec_sync(rec_t *rec, long ms)
+{
+  rec_event(rec, ms, EV_SYN, SYN_REPORT, 0);
+}
+
+/** Append a single finger stroke to a recording
+ *
+ * @param rec   recording to append to
+ * @param ms    time stamp of the press in milliseconds
+ * @param id    tracking id
+ * @param x0    x position of the press
+ * @param y0    y position of the press
+ * @param x1    x position of the release
+ * @param y1    y position of the release
+ * @param moves number of motion frames in between
+ * @param step  milliseconds between frames
+ *
+ * @return time stamp of the release
+ */
+static long
+rec_stroke(rec_t *rec, long ms, int id,
+           int x0, int y0, int x1, int y1, int moves, int step)
+{
+  rec_press(rec, ms, 0, id, x0, y0);
+  rec_event(rec, ms, EV_KEY, BTN_TOUCH, 1);
+  rec_sync(rec, ms);
+
+  for( int i = 1; i <= moves; ++i )
+  {
+    ms += step;
+    rec_move(rec, ms, 0,
+             x0 + (x1 - x0) * i / moves,
+             y0 + (y1 - y0) * i / moves);
+    rec_sync(rec, ms);
+  }
+
+  ms += step;
+  rec_release(rec, ms, 0);
+  rec_event(rec, ms, EV_KEY, BTN_TOUCH, 0);
+  rec_sync(rec, ms);
+
+  return ms;
+}
+
+/** Build the built-in recording
+ *
+ * @param rec recording to fill in
+ */
+static void
+rec_builtin(rec_t *rec)
+{
+  long ms = 1000;
+  int  id = 100;
+
+  /* Double tap */
+  ms = rec_stroke(rec, ms, id++, 500, 800, 502, 801, 2, 20);
+  ms = rec_stroke(rec, ms + 120, id++, 510, 805, 511, 806, 2, 20);
+
+  /* Swipe up */
+  ms = rec_stroke(rec, ms + 1000, id++, 100, 1000, 100, 400, 30, 8);
+
+  /* Long press */
+  ms = rec_stroke(rec, ms + 1000, id++, 300, 300, 304, 302, 12, 100);
+
+  /* Swipe up while a second finger rests near where the first
+   * landed; the second finger reports its position last */
+  ms += 1000;
+  rec_press(rec, ms, 0, id++, 100, 1000);
+  rec_event(rec, ms, EV_KEY, BTN_TOUCH, 1);
+  rec_sync(rec, ms);
+
+  ms += 8;
+  rec_press(rec, ms, 1, id++, 110, 990);
+  rec_sync(rec, ms);
+
+  for( int i = 1; i <= 30; ++i )
+  {
+    ms += 8;
+    rec_move(rec, ms, 0, 100, 1000 - 20 * i);
+    rec_move(rec, ms, 1, 110, 990 + i % 2);
+    rec_sync(rec, ms);
+  }
+
+  ms += 8;
+  rec_release(rec, ms, 0);
+  rec_sync(rec, ms);
+
+  ms += 8;
+  rec_move(rec, ms, 1, 110, 990);
+  rec_release(rec, ms, 1);
+  rec_event(rec, ms, EV_KEY, BTN_TOUCH, 0);
+  rec_sync(rec, ms);
+}
+
+/** Load a recording from evdev_trace output
+ *
+ * Lines that do not look like trace output are skipped, so the
+ * file should hold a trace of the touchscreen device only.
+ *
+ * @param rec  recording to fill in
+ * @param path file to read
+ *
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean
+rec_load(rec_t *rec, const char *path)
+{
+  FILE  *file = fopen(path, "r");
+  char   line[512];
+
+  if( !file )
+  {
+    fprintf(stderr, "%s: %s: %m\n", progname, path);
+    return FALSE;
+  }
+
+  while( fgets(line, sizeof line, file) )
+  {
+    const char *pos = strstr(line, ": ");
+    long sec, msec;
+    unsigned type, code;
+    int value;
+
+    if( !pos || sscanf(pos + 2, "%ld.%ld - 0x%x/%*s - 0x%x/%*s - %d",
+                       &sec, &msec, &type, &code, &value) != 5 )
+    {
+      continue;
+    }
+
+    rec_event(rec, sec * 1000 + msec, type, code, value);
+  }
+
+  fclose(file);
+
+  return TRUE;
+}
+
+/** Feed a recording to the recognizer one frame at a time
+ *
+ * @param rec    recording to feed
+ * @param frames where to count frames, or NULL
+ * @param found  where to count recognized gestures, or NULL
+ */
+static void
+bench_feed(const rec_t *rec, long *frames, long *found)
+{
+  const struct input_event *ev = rec->ev;
+  gsize start = 0;
+
+  gesture_reset();
+
+  for( size_t i = 0; i < rec->len; ++i )
+  {
+    int gesture;
+
+    if( ev[i].type != EV_SYN || ev[i].code != SYN_REPORT )
+    {
+      continue;
+    }
+
+    gesture = gesture_process_frame(ev + start, i + 1 - start);
+    start = i + 1;
+
+    if( frames )
+    {
+      ++*frames;
+    }
+
+    if( found )
+    {
+      switch( gesture )
+      {
+      case GESTURE_DOUBLETAP:  ++found[0]; break;
+      case GESTURE_SWIPE:      ++found[1]; break;
+      case GESTURE_LONGPRESS:  ++found[2]; break;
+      default: break;
+      }
+    }
+  }
+}
+
+/** Provide runtime usage information
+ */
+static void usage(void)
+{
+  printf("USAGE\n"
+         "  %s [options] [trace file]\n"
+         "\n"
+         "OPTIONS\n"
+         "  -h, --help            -- this help text\n"
+         "  -r, --rounds=<count>  -- passes over the recording\n"
+         "                           (default 10000)\n"
+         "\n"
+         "NOTES\n"
+         "  The trace file is output of 'evdev_trace -t <touchscreen>'.\n"
+         "  Without one, a built-in recording is used.\n"
+         "  \n"
+         "  Prints the gestures recognized in one pass and the\n"
+         "  recognizer cost in nanoseconds per frame and per event.\n"
+         "\n",
+         progname);
+}
+
+/** Main entry point
+ */
+int
+main(int argc, char **argv)
+{
+  static const struct option optL[] =
+  {
+    {"help",   0, 0, 'h' },
+    {"rounds", 1, 0, 'r' },
+    {0,0,0,0}
+  };
+  static const char optS[] = "hr:";
+
+  int     result = EXIT_FAILURE;
+  long    rounds = 10000;
+  long    frames = 0;
+  long    found[3] = { 0, 0, 0 };
+  rec_t   rec = { 0, 0, 0 };
+  double  t0, t1;
+
+  progname = basename(*argv);
+
+  for( ;; )
+  {
+    int opt = getopt_long(argc, argv, optS, optL, 0);
+
+    if( opt < 0 )
+    {
+      break;
+    }
+
+    switch( opt )
+    {
+    case 'h':
+      usage();
+      exit(EXIT_SUCCESS);
+
+    case 'r':
+      rounds = strtol(optarg, 0, 0);
+      break;
+
+    case '?':
+    case ':':
+      goto cleanup;
+
+    default:
+      fprintf(stderr, "getopt() -> %d\n", opt);
+      goto cleanup;
+    }
+  }
+
+  if( rounds < 1 )
+  {
+    fprintf(stderr, "%s: too few rounds\n", progname);
+    goto cleanup;
+  }
+
+  if( optind < argc )
+  {
+    if( !rec_load(&rec, argv[optind]) )
+    {
+      goto cleanup;
+    }
+  }
+  else
+  {
+    rec_builtin(&rec);
+  }
+
+  bench_feed(&rec, &frames, found);
+
+  if( frames == 0 )
+  {
+    fprintf(stderr, "%s: no frames in recording\n", progname);
+    goto cleanup;
+  }
+
+  // warm up caches before timing
+  for( long i = 0; i < rounds / 10; ++i )
+  {
+    bench_feed(&rec, 0, 0);
+  }
+
+  t0 = bench_now_ns();
+  for( long i = 0; i < rounds; ++i )
+  {
+    bench_feed(&rec, 0, 0);
+  }
+  t1 = bench_now_ns();
+
+  printf("frames     %ld\n", frames);
+  printf("events     %zu\n", rec.len);
+  printf("doubletap  %ld\n", found[0]);
+  printf("swipe      %ld\n", found[1]);
+  printf("longpress  %ld\n", found[2]);
+  printf("ns/frame   %.1f\n", (t1 - t0) / rounds / frames);
+  printf("ns/event   %.1f\n", (t1 - t0) / rounds / rec.len);
+
+  result = EXIT_SUCCESS;
+
+cleanup:
+
+  g_free(rec.ev);
+
+  return result;
+}
@@ -38,6 +38,7 @@
 #include <mce/mode-names.h>
 
 #include "../tklock.h"
+#include "../mce-dbus.h"
 #include "../event-input.h"
 #include "../modules/display.h"
 #include "../modules/powersavemode.h"
@@ -533,6 +534,26 @@ static gboolean dbushelper_read_int(DBusMessageIter *iter, gint *value)
         return *value = data, TRUE;
 }
 
+/** Helper for parsing unsigned int value from D-Bus message iterator
+ *
+ * @param iter D-Bus message iterator
+ * @param value Where to store the value (not modified on failure)
+ *
+ * @return TRUE if value could be read, FALSE on failure
+ */
+static gboolean dbushelper_read_uint(DBusMessageIter *iter, guint *value)
+{
+        dbus_uint32_t data = 0;
+
+        if( !dbushelper_require_type(iter, DBUS_TYPE_UINT32) )
+                return FALSE;
+
+        dbus_message_iter_get_basic(iter, &data);
+        dbus_message_iter_next(iter);
+
+        return *value = data, TRUE;
+}
+
 /** Helper for parsing boolean value from D-Bus message iterator
  *
  * @param iter D-Bus message iterator
@@ -859,6 +880,159 @@ EXIT:
         return req;
 }
 
+/* ------------------------------------------------------------------------- *
+ * MCE STATE SNAPSHOT
+ * ------------------------------------------------------------------------- */
+
+/** GConf keys to include in the state snapshot used by --status */
+static const char * const xmce_snapshot_keys[] =
+{
+        MCE_GCONF_DISPLAY_BRIGHTNESS_PATH,
+        MCE_GCONF_DISPLAY_DIM_TIMEOUT_PATH,
+        MCE_GCONF_DISPLAY_ADAPTIVE_DIMMING_PATH,
+        MCE_GCONF_DISPLAY_ADAPTIVE_DIM_THRESHOLD_PATH,
+        MCE_GCONF_DISPLAY_NEVER_BLANK_PATH,
+        MCE_GCONF_DISPLAY_BLANK_TIMEOUT_PATH,
+        MCE_GCONF_BLANKING_INHIBIT_MODE_PATH,
+        MCE_GCONF_PSM_PATH,
+        MCE_GCONF_FORCED_PSM_PATH,
+        MCE_GCONF_PSM_THRESHOLD_PATH,
+        MCE_GCONF_TK_AUTOLOCK_ENABLED_PATH,
+        MCE_GCONF_TK_DOUBLE_TAP_GESTURE_PATH,
+        MCE_GCONF_USE_LOW_POWER_MODE_PATH,
+        MCE_GCONF_DISPLAY_ALS_ENABLED_PATH,
+        MCE_GCONF_DISPLAY_DIM_TIMEOUT_LIST_PATH,
+        MCE_GCONF_USE_AUTOSUSPEND_PATH,
+        MCE_GCONF_CPU_SCALING_GOVERNOR_PATH,
+#ifdef ENABLE_DOUBLETAP_EMULATION
+        MCE_GCONF_USE_FAKE_DOUBLETAP_PATH,
+#endif
+        MCE_GCONF_TK_AUTO_BLANK_DISABLE_PATH,
+};
+
+/** Reply to get_state_snapshot method call, or NULL if not loaded */
+static DBusMessage *xmce_snapshot = 0;
+
+/** Fetch state snapshot from mce
+ *
+ * While the snapshot is loaded, the getters below use it instead of
+ * making separate method calls. Failures are not reported as errors;
+ * the getters just fall back to individual method calls then.
+ */
+static void xmce_snapshot_load(void)
+{
+        DBusMessage *req = 0;
+        DBusError    err = DBUS_ERROR_INIT;
+
+        DBusMessageIter  stack[2];
+        DBusMessageIter *wpos = stack;
+
+        if( xmce_snapshot )
+                goto EXIT;
+
+        if( !(req = mcetool_config_request(MCE_STATE_SNAPSHOT_GET)) )
+                goto EXIT;
+        if( !dbushelper_init_write_iterator(req, wpos) )
+                goto EXIT;
+        if( !dbushelper_push_array(&wpos, DBUS_TYPE_STRING_AS_STRING) )
+                goto EXIT;
+
+        for( size_t i = 0; i < G_N_ELEMENTS(xmce_snapshot_keys); ++i ) {
+                const char *key = xmce_snapshot_keys[i];
+                if( !dbus_message_iter_append_basic(wpos, DBUS_TYPE_STRING,
+                                                    &key) )
+                        goto EXIT;
+        }
+
+        if( !dbushelper_pop_container(&wpos) )
+                goto EXIT;
+
+        xmce_snapshot = dbus_connection_send_with_reply_and_block(xdbus_init(),
+                                                                  req, -1,
+                                                                  &err);
+        if( !xmce_snapshot )
+                debugf("%s: %s: %s\n", MCE_STATE_SNAPSHOT_GET,
+                       err.name, err.message);
+
+EXIT:
+        if( wpos != stack )
+                dbushelper_abandon_stack(stack, wpos);
+
+        dbus_error_free(&err);
+
+        if( req ) dbus_message_unref(req);
+}
+
+/** Release state snapshot fetched with xmce_snapshot_load()
+ */
+static void xmce_snapshot_free(void)
+{
+        if( xmce_snapshot )
+                dbus_message_unref(xmce_snapshot), xmce_snapshot = 0;
+}
+
+/** Find a value from the loaded state snapshot
+ *
+ * @param key     name of the snapshot entry
+ * @param variant where to store iterator for the variant value
+ *
+ * @return TRUE if the entry was found, FALSE otherwise
+ */
+static gboolean xmce_snapshot_lookup(const char *key, DBusMessageIter *variant)
+{
+        DBusMessageIter body, dict, entry;
+
+        if( !xmce_snapshot )
+                return FALSE;
+
+        if( !dbus_message_iter_init(xmce_snapshot, &body) )
+                return FALSE;
+        if( !dbushelper_read_array(&body, &dict) )
+                return FALSE;
+
+        while( dbus_message_iter_get_arg_type(&dict) == DBUS_TYPE_DICT_ENTRY ) {
+                const char *name = 0;
+
+                dbus_message_iter_recurse(&dict, &entry);
+                dbus_message_iter_next(&dict);
+
+                if( dbus_message_iter_get_arg_type(&entry) != DBUS_TYPE_STRING )
+                        continue;
+
+                dbus_message_iter_get_basic(&entry, &name);
+                dbus_message_iter_next(&entry);
+
+                if( strcmp(name, key) )
+                        continue;
+
+                return dbushelper_read_variant(&entry, variant);
+        }
+
+        return FALSE;
+}
+
+/** Get a string value from the loaded state snapshot
+ *
+ * @param key name of the snapshot entry
+ *
+ * @return copy of the string that must be released with free(),
+ *         or NULL if the value is not available
+ */
+static char *xmce_snapshot_get_string(const char *key)
+{
+        DBusMessageIter variant;
+        const char     *str = 0;
+
+        if( !xmce_snapshot_lookup(key, &variant) )
+                return 0;
+
+        if( dbus_message_iter_get_arg_type(&variant) != DBUS_TYPE_STRING )
+                return 0;
+
+        dbus_message_iter_get_basic(&variant, &str);
+        return strdup(str);
+}
+
 /** Return a boolean from the specified GConf key
  *
  * @param key The GConf key to get the value from
@@ -875,6 +1049,11 @@ static gboolean mcetool_gconf_get_bool(const gchar *const key, gboolean *value)
 
         DBusMessageIter body, variant;
 
+        if( xmce_snapshot_lookup(key, &variant) ) {
+                res = dbushelper_read_boolean(&variant, value);
+                goto EXIT;
+        }
+
         if( !(req = mcetool_config_request(MCE_DBUS_GET_CONFIG_REQ)) )
                 goto EXIT;
         if( !dbushelper_init_write_iterator(req, &body) )
@@ -914,6 +1093,11 @@ static gboolean mcetool_gconf_get_int(const gchar *const key, gint *value)
 
         DBusMessageIter body, variant;
 
+        if( xmce_snapshot_lookup(key, &variant) ) {
+                res = dbushelper_read_int(&variant, value);
+                goto EXIT;
+        }
+
         if( !(req = mcetool_config_request(MCE_DBUS_GET_CONFIG_REQ)) )
                 goto EXIT;
         if( !dbushelper_init_write_iterator(req, &body) )
@@ -954,6 +1138,11 @@ static gboolean mcetool_gconf_get_int_array(const gchar *const key, gint **value
 
         DBusMessageIter body, variant;
 
+        if( xmce_snapshot_lookup(key, &variant) ) {
+                res = dbushelper_read_int_array(&variant, values, count);
+                goto EXIT;
+        }
+
         if( !(req = mcetool_config_request(MCE_DBUS_GET_CONFIG_REQ)) )
                 goto EXIT;
         if( !dbushelper_init_write_iterator(req, &body) )
@@ -1578,8 +1767,9 @@ static void xmce_set_color_profile(const char *args)
  */
 static void xmce_get_color_profile(void)
 {
-        char *str = 0;
-        xmce_ipc_string_reply(MCE_COLOR_PROFILE_GET, &str, DBUS_TYPE_INVALID);
+        char *str = xmce_snapshot_get_string("color_profile");
+        if( !str )
+                xmce_ipc_string_reply(MCE_COLOR_PROFILE_GET, &str, DBUS_TYPE_INVALID);
         printf("%-"PAD1"s %s\n","Color profile:", str ?: "unknown");
         free(str);
 }
@@ -1626,7 +1816,11 @@ static void xmce_get_radio_states(void)
 {
         guint mask = 0;
 
-        if( !xmce_ipc_uint_reply(MCE_RADIO_STATES_GET, &mask, DBUS_TYPE_INVALID) ) {
+        DBusMessageIter variant;
+
+        if( !(xmce_snapshot_lookup("radio_states", &variant) &&
+              dbushelper_read_uint(&variant, &mask)) &&
+            !xmce_ipc_uint_reply(MCE_RADIO_STATES_GET, &mask, DBUS_TYPE_INVALID) ) {
                 printf(" %-40s %s\n", "Radio states:", "unknown");
                 return;
         }
@@ -1692,9 +1886,17 @@ static void xmce_get_call_state(void)
 {
         const char  *callstate = 0;
         const char  *calltype  = 0;
+        char        *snapstate = xmce_snapshot_get_string("call_state");
+        char        *snaptype  = xmce_snapshot_get_string("call_type");
         DBusMessage *rsp = NULL;
         DBusError    err = DBUS_ERROR_INIT;
 
+        if( snapstate && snaptype ) {
+                callstate = snapstate;
+                calltype  = snaptype;
+                goto EXIT;
+        }
+
         if( !xmce_ipc_message_reply(MCE_CALL_STATE_GET, &rsp, DBUS_TYPE_INVALID) )
                 goto EXIT;
 
@@ -1715,6 +1917,9 @@ EXIT:
                calltype ?:  "unknown");
 
         if( rsp ) dbus_message_unref(rsp);
+
+        free(snapstate);
+        free(snaptype);
 }
 
 /* ------------------------------------------------------------------------- *
@@ -1742,8 +1947,9 @@ static void xmce_set_display_state(const char *args)
  */
 static void xmce_get_display_state(void)
 {
-        char *str = 0;
-        xmce_ipc_string_reply(MCE_DISPLAY_STATUS_GET, &str, DBUS_TYPE_INVALID);
+        char *str = xmce_snapshot_get_string("display_status");
+        if( !str )
+                xmce_ipc_string_reply(MCE_DISPLAY_STATUS_GET, &str, DBUS_TYPE_INVALID);
         printf("%-"PAD1"s %s\n","Display state:", str ?: "unknown");
         free(str);
 }
@@ -1839,8 +2045,9 @@ static void xmce_set_cabc_mode(const char *args)
  */
 static void xmce_get_cabc_mode(void)
 {
-        char *str = 0;
-        xmce_ipc_string_reply(MCE_CABC_MODE_GET, &str, DBUS_TYPE_INVALID);
+        char *str = xmce_snapshot_get_string("cabc_mode");
+        if( !str )
+                xmce_ipc_string_reply(MCE_CABC_MODE_GET, &str, DBUS_TYPE_INVALID);
         printf("%-"PAD1"s %s\n","CABC mode:", str ?: "unknown");
         free(str);
 }
@@ -2104,10 +2311,14 @@ static void xmce_get_power_saving_mode(void)
         char txt1[32] = "unknown";
         char txt2[32] = "unknown";
 
+        DBusMessageIter variant;
+
         if( mcetool_gconf_get_bool(MCE_GCONF_PSM_PATH, &mode) )
                 snprintf(txt1, sizeof txt1, "%s", mode ? "enabled" : "disabled");
 
-        if( xmce_ipc_bool_reply(MCE_PSM_STATE_GET, &state, DBUS_TYPE_INVALID) )
+        if( (xmce_snapshot_lookup("psm_state", &variant) &&
+             dbushelper_read_boolean(&variant, &state)) ||
+            xmce_ipc_bool_reply(MCE_PSM_STATE_GET, &state, DBUS_TYPE_INVALID) )
                 snprintf(txt2, sizeof txt2, "%s", state ? "active" : "inactive");
 
         printf("%-"PAD1"s %s (%s)\n", "Power saving mode:", txt1, txt2);
@@ -2474,8 +2685,9 @@ static void xmce_set_tklock_mode(const char *args)
  */
 static void xmce_get_tklock_mode(void)
 {
-        char *str = 0;
-        xmce_ipc_string_reply(MCE_TKLOCK_MODE_GET, &str, DBUS_TYPE_INVALID);
+        char *str = xmce_snapshot_get_string("tklock_mode");
+        if( !str )
+                xmce_ipc_string_reply(MCE_TKLOCK_MODE_GET, &str, DBUS_TYPE_INVALID);
         printf("%-"PAD1"s %s\n", "Touchscreen/Keypad lock:", str ?: "unknown");
         free(str);
 }
@@ -2514,8 +2726,9 @@ static void xmce_get_tklock_blank(void)
  */
 static void xmce_get_version(void)
 {
-        char *str = 0;
-        xmce_ipc_string_reply(MCE_VERSION_GET, &str, DBUS_TYPE_INVALID);
+        char *str = xmce_snapshot_get_string("version");
+        if( !str )
+                xmce_ipc_string_reply(MCE_VERSION_GET, &str, DBUS_TYPE_INVALID);
         printf("%-"PAD1"s %s\n","MCE version:", str ?: "unknown");
         free(str);
 }
@@ -2526,8 +2739,11 @@ static void xmce_get_inactivity_state(void)
 {
         gboolean val = 0;
         char txt[32];
+        DBusMessageIter variant;
         strcpy(txt, "unknown");
-        if( xmce_ipc_bool_reply(MCE_INACTIVITY_STATUS_GET, &val, DBUS_TYPE_INVALID) )
+        if( (xmce_snapshot_lookup("inactivity_status", &variant) &&
+             dbushelper_read_boolean(&variant, &val)) ||
+            xmce_ipc_bool_reply(MCE_INACTIVITY_STATUS_GET, &val, DBUS_TYPE_INVALID) )
                 snprintf(txt, sizeof txt, "%s", val ? "inactive" : "active");
         printf("%-"PAD1"s %s\n","Inactivity status:", txt);
 }
@@ -2538,8 +2754,11 @@ static void xmce_get_keyboard_backlight_state(void)
 {
         gboolean val = 0;
         char txt[32];
+        DBusMessageIter variant;
         strcpy(txt, "unknown");
-        if( xmce_ipc_bool_reply(MCE_KEY_BACKLIGHT_STATE_GET, &val, DBUS_TYPE_INVALID) )
+        if( (xmce_snapshot_lookup("key_backlight_state", &variant) &&
+             dbushelper_read_boolean(&variant, &val)) ||
+            xmce_ipc_bool_reply(MCE_KEY_BACKLIGHT_STATE_GET, &val, DBUS_TYPE_INVALID) )
                 snprintf(txt, sizeof txt, "%s", val ? "enabled" : "disabled");
         printf("%-"PAD1"s %s\n","Keyboard backlight:", txt);
 }
@@ -2552,6 +2771,9 @@ static void xmce_get_status(void)
                 "MCE status:\n"
                 "-----------\n");
 
+        /* Get datapipe states and settings with one method call */
+        xmce_snapshot_load();
+
         xmce_get_version();
         xmce_get_radio_states();
         xmce_get_call_state();
@@ -2583,9 +2805,27 @@ static void xmce_get_status(void)
 #endif
         xmce_get_tklock_blank();
 
+        xmce_snapshot_free();
+
         printf("\n");
 }
 
+/* ------------------------------------------------------------------------- *
+ * diagnostics
+ * ------------------------------------------------------------------------- */
+
+/** Get a text report from mce and print it out
+ *
+ * @param method name of the D-Bus method returning the report
+ */
+static void xmce_get_text(const char *method)
+{
+        char *str = 0;
+        xmce_ipc_string_reply(method, &str, DBUS_TYPE_INVALID);
+        printf("%s", str ?: "");
+        free(str);
+}
+
 /* ------------------------------------------------------------------------- *
  * special
  * ------------------------------------------------------------------------- */
@@ -2773,6 +3013,19 @@ EXTRA"  set the display demo mode  to STATE;\n"
 EXTRA"     valid states are: 'on' and 'off'\n"
 PARAM"-N, --status\n"
 EXTRA"output MCE status\n"
+PARAM"-Z, --datapipe-stats\n"
+EXTRA"output datapipe execution counts and\n"
+EXTRA"  callback latency histograms\n"
+PARAM"-x, --datapipe-graph\n"
+EXTRA"output the datapipe execution graph\n"
+EXTRA"  in Graphviz dot format\n"
+PARAM"-W, --iomon-stats\n"
+EXTRA"output I/O monitor wakeups, bytes and chunks read,\n"
+EXTRA"  callback run times, input event delays and\n"
+EXTRA"  input device rescans\n"
+PARAM"-X, --latency-stats\n"
+EXTRA"output input-to-display latency percentiles\n"
+EXTRA"  for each stage of the display power up\n"
 PARAM"-B, --block[=<secs>]\n"
 EXTRA"block after executing commands\n"
 EXTRA"  for D-Bus\n"
@@ -2851,8 +3104,8 @@ PROG_NAME" v"G_STRINGIFY(PRG_VERSION)"\n"
 ;
 
 // Unused short options left ....
-// - - - - - - - - - - - - - - - - - - - - u - w x - z
-// - - - - - - - - - - - - - - - - - - - - - - W X - Z
+// - - - - - - - - - - - - - - - - - - - - u - w - - z
+// - - - - - - - - - - - - - - - - - - - - - - - - - -
 
 const char OPT_S[] =
 "B::" // --block,
@@ -2880,6 +3133,10 @@ const char OPT_S[] =
 "Y:"  // --deactivate-led-pattern,
 "e:"  // --powerkey-event,
 "N"   // --status,
+"Z"   // --datapipe-stats,
+"x"   // --datapipe-graph,
+"W"   // --iomon-stats,
+"X"   // --latency-stats,
 "h"   // --help,
 "H"   // --long-help,
 "V"   // --version,
@@ -2935,6 +3192,10 @@ struct option const OPT_L[] =
         { "deactivate-led-pattern",    1, 0, 'Y' }, // set_led_pattern_state()
         { "powerkey-event",            1, 0, 'e' }, // xmce_powerkey_event()
         { "status",                    0, 0, 'N' }, // xmce_get_status()
+        { "datapipe-stats",            0, 0, 'Z' }, // xmce_get_text()
+        { "datapipe-graph",            0, 0, 'x' }, // xmce_get_text()
+        { "iomon-stats",               0, 0, 'W' }, // xmce_get_text()
+        { "latency-stats",             0, 0, 'X' }, // xmce_get_text()
         { "help",                      0, 0, 'h' }, // N/A
         { "long-help",                 0, 0, 'H' }, // N/A
         { "version",                   0, 0, 'V' }, // N/A
@@ -3039,6 +3300,10 @@ int main(int argc, char **argv)
                 case 'D': xmce_set_demo_mode(optarg);             break;
 
                 case 'N': xmce_get_status();                      break;
+                case 'Z': xmce_get_text(MCE_DATAPIPE_STATS_GET);  break;
+                case 'x': xmce_get_text(MCE_DATAPIPE_GRAPH_GET);  break;
+                case 'W': xmce_get_text(MCE_IOMON_STATS_GET);     break;
+                case 'X': xmce_get_text(MCE_LATENCY_STATS_GET);   break;
                 case 'B': mcetool_block(optarg);                  break;
 
                 case 'h':